@@ -41,8 +41,11 @@ namespace Memory{
 		MAIN_MEMORY
 	};
 
+	/* Number of requests in each RequestPool slab */
 	const int REQUEST_POOL_SIZE = 1024;
-	const double REQUEST_POOL_LOW_RATIO = 0.1;
+
+	/* Number of history records kept per request, must be power of 2 */
+	const int MEM_REQUEST_HISTORY_SIZE = 16;
 
 	/* CPU Controller */
 	const int CPU_CONT_PENDING_REQ_SIZE = 128;
@@ -61,6 +64,23 @@ namespace Memory{
 	 */
 	const int MEM_BANKS = 64;
 
+	/*
+	 * Maximum number of channels of DRAMController, only used to size
+	 * per channel statistics.
+	 */
+	const int DRAM_MAX_CHANNELS = 16;
+
+	/*
+	 * Mesh and ring interconnect limits, only used to size the routers'
+	 * virtual channel state and per link statistics.
+	 */
+	const int NOC_MAX_NODES = 64;
+	const int NOC_NUM_PORTS = 4;
+	const int NOC_MAX_LINKS = NOC_MAX_NODES * NOC_NUM_PORTS;
+	const int NOC_MAX_VCS = 8;
+	const int NOC_MAX_HOPS = 64;
+	const int NOC_HOP_LATENCY_BUCKETS = 32;
+
 	/* Average wait dealy for retrying (general) */
 	const int AVG_WAIT_DELAY = 5;
 }
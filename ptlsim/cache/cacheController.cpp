@@ -62,7 +62,8 @@ CacheController::CacheController(W8 coreid, const char *name,
 {
     memoryHierarchy_->add_cache_mem_controller(this);
 
-    cacheLines_ = get_cachelines(type);
+    cacheLines_ = get_cachelines(type, name,
+            memoryHierarchy_->get_machine());
 
     if(!memoryHierarchy_->get_machine().get_option(name, "last_private", isLowestPrivate_)) {
         isLowestPrivate_ = false;
@@ -904,6 +905,30 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	out << YAML::EndMap;
 }
 
+int CacheController::warm_probe(MemoryRequest *request, bool is_write)
+{
+	CacheLine *line = cacheLines_->probe(request);
+
+	if(!line || line->state == LINE_NOT_VALID)
+		return WARM_MISS;
+
+	if(is_write && wt_disabled_)
+		line->state = LINE_MODIFIED;
+
+	return WARM_HIT;
+}
+
+void CacheController::warm_fill(MemoryRequest *request, bool is_write,
+		bool shared)
+{
+	W64 oldTag;
+	CacheLine *line = cacheLines_->insert(request, oldTag);
+
+	line->init(cacheLines_->tagOf(request->get_physical_address()));
+	line->prefetched = 0;
+	line->state = (is_write && wt_disabled_) ? LINE_MODIFIED : LINE_VALID;
+}
+
 
 /* Cache Controller Builder */
 
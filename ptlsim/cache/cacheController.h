@@ -213,6 +213,9 @@ class CacheController : public Controller
 		void annul_request(MemoryRequest *request);
 		void dump_configuration(YAML::Emitter &out) const;
 
+		int warm_probe(MemoryRequest *request, bool is_write);
+		void warm_fill(MemoryRequest *request, bool is_write, bool shared);
+
 		// Callback functions for signals of cache
 		bool cache_hit_cb(void *arg);
 		bool cache_miss_cb(void *arg);
@@ -0,0 +1,303 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryHierarchy.h>
+#include <memoryRequest.h>
+#include <cacheLines.h>
+#include <machine.h>
+
+using namespace Memory;
+
+static void cache_geometry_error(const char *name, const char *msg)
+{
+	stringbuf err;
+	err << "::ERROR::Cache '" << name << "' geometry: " << msg << endl;
+	ptl_logfile << err;
+	cerr << err;
+	assert(0);
+}
+
+static inline bool is_pow2(W64 v)
+{
+	return v && !(v & (v - 1));
+}
+
+DynamicCacheLines::DynamicCacheLines(int setCount, int wayCount,
+		int lineSize, int latency, int readPorts, int writePorts) :
+	setCount_(setCount)
+	, wayCount_(wayCount)
+	, lineSize_(lineSize)
+	, latency_(latency)
+	, readPortUsed_(0)
+	, writePortUsed_(0)
+	, readPorts_(readPorts)
+	, writePorts_(writePorts)
+	, lastAccessCycle_(0)
+{
+	assert(is_pow2(setCount_));
+	assert(is_pow2(lineSize_));
+	assert(wayCount_ > 0 && wayCount_ <= 64);
+
+	lineBits_ = msbindex64(lineSize_);
+	setMask_ = setCount_ - 1;
+	tagMask_ = ~W64(lineSize_ - 1);
+
+	tags_ = new W64[setCount_ * wayCount_];
+	lines_ = new CacheLine[setCount_ * wayCount_];
+	evictmaps_ = new W64[setCount_];
+
+	foreach(i, setCount_ * wayCount_) {
+		tags_[i] = InvalidTag<W64>::INVALID;
+		lines_[i].reset();
+	}
+
+	foreach(i, setCount_) {
+		evictmaps_[i] = 0;
+	}
+}
+
+DynamicCacheLines::~DynamicCacheLines()
+{
+	delete[] tags_;
+	delete[] lines_;
+	delete[] evictmaps_;
+}
+
+void DynamicCacheLines::init()
+{
+	foreach(i, setCount_ * wayCount_) {
+		lines_[i].init(-1);
+	}
+}
+
+/* Same tag match as FullyAssociativeTags::match */
+int DynamicCacheLines::match(int set, W64 tag) const
+{
+	return match_tags(&tags_[set * wayCount_], wayCount_, tag);
+}
+
+void DynamicCacheLines::invalidate_way(int set, int way)
+{
+	int idx = set * wayCount_ + way;
+	tags_[idx] = InvalidTag<W64>::INVALID;
+	evictmaps_[set] &= ~(1ULL << way);
+	lines_[idx].reset();
+}
+
+CacheLine* DynamicCacheLines::probe(MemoryRequest *request)
+{
+	W64 address = request->get_physical_address();
+	int set = setOf(address);
+	int way = match(set, tagOf(address));
+
+	if(way < 0)
+		return NULL;
+
+	evictmaps_[set] |= (1ULL << way);
+	return &lines_[set * wayCount_ + way];
+}
+
+CacheLine* DynamicCacheLines::insert(MemoryRequest *request, W64& oldTag)
+{
+	W64 address = request->get_physical_address();
+	W64 tag = tagOf(address);
+	int set = setOf(address);
+	W64 allSet = (wayCount_ == 64) ? W64(-1) : bitmask(wayCount_);
+	W64& evictmap = evictmaps_[set];
+
+	int way = match(set, tag);
+
+	if(way < 0) {
+		/* Pseudo-LRU, same as FullyAssociativeTags::select */
+		if(evictmap == allSet) {
+			way = 0;
+			evictmap = 0;
+		} else {
+			way = lsbindex64(~evictmap & allSet);
+		}
+
+		oldTag = tags_[set * wayCount_ + way];
+		tags_[set * wayCount_ + way] = tag;
+	}
+
+	evictmap |= (1ULL << way);
+	if(evictmap == allSet)
+		evictmap = (1ULL << way);
+
+	return &lines_[set * wayCount_ + way];
+}
+
+int DynamicCacheLines::invalidate(MemoryRequest *request)
+{
+	W64 address = request->get_physical_address();
+	int set = setOf(address);
+	int way = match(set, tagOf(address));
+
+	if(way < 0)
+		return -1;
+
+	invalidate_way(set, way);
+	return way;
+}
+
+bool DynamicCacheLines::get_port(MemoryRequest *request)
+{
+	bool rc = false;
+
+	if(lastAccessCycle_ < sim_cycle) {
+		lastAccessCycle_ = sim_cycle;
+		writePortUsed_ = 0;
+		readPortUsed_ = 0;
+	}
+
+	switch(request->get_type()) {
+		case MEMORY_OP_READ:
+			rc = (readPortUsed_ < readPorts_) ? ++readPortUsed_ : 0;
+			break;
+		case MEMORY_OP_WRITE:
+		case MEMORY_OP_UPDATE:
+		case MEMORY_OP_EVICT:
+			rc = (writePortUsed_ < writePorts_) ? ++writePortUsed_ : 0;
+			break;
+		default:
+			memdebug("Unknown type of memory request: " <<
+					request->get_type() << endl);
+			assert(0);
+	};
+	return rc;
+}
+
+void DynamicCacheLines::print(ostream& os) const
+{
+	foreach(i, setCount_ * wayCount_) {
+		os << lines_[i];
+	}
+}
+
+/* Parse size with optional K, M or G suffix, 0 on error */
+static W64 parse_cache_size(const char *str)
+{
+	char *end;
+	W64 size = strtoull(str, &end, 10);
+
+	switch(*end) {
+		case 'k': case 'K': size <<= 10; end++; break;
+		case 'm': case 'M': size <<= 20; end++; break;
+		case 'g': case 'G': size <<= 30; end++; break;
+		default: break;
+	}
+
+	return (*end == '\0') ? size : 0;
+}
+
+/*
+ * Apply the first -cache-geometry entry whose name prefix matches the
+ * cache, "<name prefix>:<size>[:<ways>[:<latency>]]" with entries
+ * separated by ','. Fields left out keep the machine options.
+ */
+static void override_cache_geometry(const char *name, W64& size,
+		int& wayCount, int& latency)
+{
+	if(!config.cache_geometry.set())
+		return;
+
+	char *geometry = strdup(config.cache_geometry.buf);
+	char *saveEntry = NULL;
+
+	for(char *entry = strtok_r(geometry, ",", &saveEntry); entry;
+			entry = strtok_r(NULL, ",", &saveEntry)) {
+		char *fields[4] = {NULL, NULL, NULL, NULL};
+		int nfields = 0;
+		char *p = entry;
+
+		while(p && nfields < 4) {
+			fields[nfields++] = p;
+			p = strchr(p, ':');
+			if(p) *p++ = '\0';
+		}
+
+		if(!strlen(fields[0]) ||
+				strncmp(name, fields[0], strlen(fields[0])) != 0)
+			continue;
+
+		if(fields[1] && strlen(fields[1])) {
+			size = parse_cache_size(fields[1]);
+			if(!size)
+				cache_geometry_error(name, "invalid -cache-geometry size");
+		}
+
+		if(fields[2] && strlen(fields[2]))
+			wayCount = atoi(fields[2]);
+
+		if(fields[3] && strlen(fields[3]))
+			latency = atoi(fields[3]);
+
+		break;
+	}
+
+	free(geometry);
+}
+
+CacheLinesBase* Memory::get_dynamic_cachelines(const char *name,
+		BaseMachine &machine, int lineSize, int readPorts, int writePorts)
+{
+	W64 size = 0;
+	int wayCount = 0;
+	int latency = 0;
+	stringbuf sizeStr;
+
+	/* SIZE is bytes with optional K, M or G suffix, as in cache params */
+	if(machine.get_option(name, "SIZE", sizeStr))
+		size = parse_cache_size(sizeStr.buf);
+
+	machine.get_option(name, "ASSOC", wayCount);
+	machine.get_option(name, "LATENCY", latency);
+
+	override_cache_geometry(name, size, wayCount, latency);
+
+	if(!size)
+		cache_geometry_error(name, "invalid SIZE");
+
+	if(wayCount <= 0 || wayCount > 64)
+		cache_geometry_error(name, "ASSOC must be between 1 and 64");
+
+	if(latency <= 0)
+		cache_geometry_error(name, "LATENCY must be positive");
+
+	W64 setCount = size / (W64(wayCount) * lineSize);
+	if(!is_pow2(setCount) || setCount * wayCount * lineSize != size)
+		cache_geometry_error(name, "number of sets must be a power of 2");
+
+	ptl_logfile << "Cache '" << name << "' geometry: " << setCount <<
+				" sets, " << wayCount << " ways, " << lineSize <<
+				"-byte lines, latency " << latency << endl;
+
+	return new DynamicCacheLines(setCount, wayCount, lineSize, latency,
+			readPorts, writePorts);
+}
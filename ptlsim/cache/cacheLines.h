@@ -30,6 +30,8 @@
 
 #include <logic.h>
 
+struct BaseMachine;
+
 namespace Memory {
 
     struct CacheLine
@@ -38,15 +40,21 @@ namespace Memory {
         /* This is a generic variable used by all caches to represent its
          * coherence state */
         W8 state;
+        /* Set when line was brought in by prefetcher and not used yet */
+        W8 prefetched;
 
         void init(W64 tag_t) {
             tag = tag_t;
-            if (tag == (W64)-1) state = 0;
+            if (tag == (W64)-1) {
+                state = 0;
+                prefetched = 0;
+            }
         }
 
         void reset() {
             tag = -1;
             state = 0;
+            prefetched = 0;
         }
 
         void invalidate() { reset(); }
@@ -74,6 +82,7 @@ namespace Memory {
     struct CacheLinesBase
     {
         public:
+            virtual ~CacheLinesBase() {}
             virtual void init()=0;
             virtual W64 tagOf(W64 address)=0;
             virtual int latency() const =0;
@@ -91,6 +100,104 @@ namespace Memory {
 			virtual int get_line_size() const=0;
     };
 
+    /*
+     * Cache lines with geometry given at run time.
+     *
+     * Tags, MRU bits and line states of all sets are kept in separate
+     * contiguous arrays so a probe only walks the tags of one set. Set index
+     * and tag masks are computed once from power of 2 set count and line
+     * size. Replacement is the same pseudo-LRU as FullyAssociativeTags, so
+     * for same geometry it behaves exactly as the templated CacheLines.
+     *
+     * Used for cache types with 'DYNAMIC: true' in their params. Their size,
+     * associativity and latency are read from machine options at run time,
+     * so machines of a cache size sweep share one cache type and one build.
+     */
+    class DynamicCacheLines : public CacheLinesBase
+    {
+        private:
+            int setCount_;
+            int wayCount_;
+            int lineSize_;
+            int latency_;
+
+            int lineBits_;
+            W64 setMask_;
+            W64 tagMask_;
+
+            /* [set * wayCount_ + way] */
+            W64 *tags_;
+            CacheLine *lines_;
+            /* One MRU bit per way, per set */
+            W64 *evictmaps_;
+
+            int readPortUsed_;
+            int writePortUsed_;
+            int readPorts_;
+            int writePorts_;
+            W64 lastAccessCycle_;
+
+            int setOf(W64 address) const {
+                return (address >> lineBits_) & setMask_;
+            }
+
+            int match(int set, W64 tag) const;
+            void invalidate_way(int set, int way);
+
+        public:
+            DynamicCacheLines(int setCount, int wayCount, int lineSize,
+                    int latency, int readPorts, int writePorts);
+            ~DynamicCacheLines();
+
+            void init();
+            W64 tagOf(W64 address) { return address & tagMask_; }
+            int latency() const { return latency_; }
+            CacheLine* probe(MemoryRequest *request);
+            CacheLine* insert(MemoryRequest *request, W64& oldTag);
+            int invalidate(MemoryRequest *request);
+            bool get_port(MemoryRequest *request);
+            void print(ostream& os) const;
+
+            int get_size() const {
+                return (setCount_ * wayCount_ * lineSize_);
+            }
+
+            int get_set_count() const { return setCount_; }
+            int get_way_count() const { return wayCount_; }
+            int get_line_size() const { return lineSize_; }
+            int get_line_bits() const { return lineBits_; }
+            int get_access_latency() const { return latency_; }
+    };
+
+    /**
+     * @brief Create CacheLines for a cache controller
+     *
+     * @param type Cache type from cacheTypes.h
+     * @param name Name of the controller
+     * @param machine Machine the controller belongs to
+     *
+     * Generated by config_gen.py. Returns DynamicCacheLines for cache
+     * types with DYNAMIC set in their params, else the templated
+     * CacheLines of the type.
+     */
+    CacheLinesBase* get_cachelines(int type, const char *name,
+            BaseMachine &machine);
+
+    /**
+     * @brief Create DynamicCacheLines of a cache controller
+     *
+     * @param name Name of the cache controller
+     * @param machine Machine with the SIZE, ASSOC and LATENCY options of
+     * the controller, set from its cache params in the machine YAML;
+     * -cache-geometry overrides them at run time
+     * @param lineSize Line size of the cache type
+     * @param readPorts Read ports of the cache type
+     * @param writePorts Write ports of the cache type
+     */
+    CacheLinesBase* get_dynamic_cachelines(const char *name,
+            BaseMachine &machine, int lineSize, int readPorts,
+            int writePorts);
+
     template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
         class CacheLines : public CacheLinesBase,
         public AssociativeArray<W64, CacheLine, SET_COUNT,
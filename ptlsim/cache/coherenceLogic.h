@@ -66,6 +66,18 @@ namespace Memory {
                 virtual void invalidate_line(CacheLine *line)              = 0;
                 virtual void handle_response(CacheQueueEntry *entry,
                         Message &message) = 0;
+
+                /* Functional warming of line states, see
+                 * MemoryHierarchy::warm_access */
+
+                /* Hit on a valid line, return false if a write needs
+                 * to invalidate other copies first */
+                virtual bool warm_hit(CacheLine *line, bool is_write)     = 0;
+                /* Line filled or upgraded, 'shared' if others have it */
+                virtual void warm_fill(CacheLine *line, bool is_write,
+                        bool shared)                                       = 0;
+                /* Other cache accessed the line, return true if valid */
+                virtual bool warm_snoop(CacheLine *line, bool is_write)   = 0;
 				virtual void dump_configuration(YAML::Emitter &out) const = 0;
 
                 CacheController* controller;
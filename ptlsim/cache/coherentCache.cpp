@@ -51,11 +51,14 @@ CacheController::CacheController(W8 coreid, const char *name,
     , directory_(NULL)
     , lowerCont_(NULL)
     , coherence_logic_(NULL)
+    , prefetcher_(NULL)
+    , prefetchStats_(NULL)
 {
     memoryHierarchy_->add_cache_mem_controller(this);
     new_stats = new MESIStats(name, &memoryHierarchy->get_machine());
 
-    cacheLines_ = get_cachelines(type);
+    cacheLines_ = get_cachelines(type, name,
+            memoryHierarchy_->get_machine());
 
     if(!memoryHierarchy_->get_machine().get_option(name, "last_private", isLowestPrivate_)) {
         isLowestPrivate_ = false;
@@ -66,6 +69,11 @@ CacheController::CacheController(W8 coreid, const char *name,
 
     cacheLines_->init();
 
+    prefetcher_ = PrefetcherBuilder::get_prefetcher(
+            memoryHierarchy_->get_machine(), name, cacheLineBits_);
+    if(prefetcher_)
+        prefetchStats_ = new PrefetchStats("prefetch", new_stats);
+
 
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
@@ -92,6 +100,8 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+    delete prefetcher_;
+    delete prefetchStats_;
     delete new_stats;
 }
 
@@ -99,25 +109,23 @@ CacheQueueEntry* CacheController::find_dependency(MemoryRequest *request)
 {
     W64 requestLineAddress = get_line_address(request);
 
-    CacheQueueEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
-            prevEntry) {
+    for(int idx = mshr_.head(requestLineAddress); idx >= 0;
+            idx = mshr_.next(idx)) {
+        CacheQueueEntry* queueEntry = &pendingRequests_[idx];
 
         if(request == queueEntry->request || queueEntry->annuled)
             continue;
 
-        if(get_line_address(queueEntry->request) == requestLineAddress) {
-            /*
-             * Found an entry with same line address, check if other
-             * entry also depends on this entry or not and to
-             * maintain a chain of dependent entries, return the
-             * last entry in the chain
-             */
-            while(queueEntry->depends >= 0)
-                queueEntry = &pendingRequests_[queueEntry->depends];
+        /*
+         * Found an entry with same line address, check if other
+         * entry also depends on this entry or not and to
+         * maintain a chain of dependent entries, return the
+         * last entry in the chain
+         */
+        while(queueEntry->depends >= 0)
+            queueEntry = &pendingRequests_[queueEntry->depends];
 
-            return queueEntry;
-        }
+        return queueEntry;
     }
     return NULL;
 }
@@ -128,30 +136,39 @@ bool CacheController::is_line_in_use(W64 tag)
         return false;
     }
 
-    /* Check each local cache request for same line tag */
-    CacheQueueEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
-            prevEntry) {
-        if (get_line_address(queueEntry->request) == tag) {
-            return true;
-        }
-    }
-
-    return false;
+    /* Check for any local cache request with same line tag */
+    return (mshr_.head(tag) >= 0);
 }
 
 CacheQueueEntry* CacheController::find_match(MemoryRequest *request)
 {
-    CacheQueueEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
-            prevEntry) {
-        if(request == queueEntry->request)
-            return queueEntry;
+    for(int idx = mshr_.head(get_line_address(request)); idx >= 0;
+            idx = mshr_.next(idx)) {
+        if(request == pendingRequests_[idx].request)
+            return &pendingRequests_[idx];
     }
 
     return NULL;
 }
 
+CacheQueueEntry* CacheController::alloc_queue_entry(MemoryRequest *request)
+{
+    CacheQueueEntry *queueEntry = pendingRequests_.alloc();
+
+    if(queueEntry) {
+        queueEntry->request = request;
+        mshr_.add(get_line_address(request), queueEntry->idx);
+    }
+
+    return queueEntry;
+}
+
+void CacheController::free_queue_entry(CacheQueueEntry *queueEntry)
+{
+    mshr_.remove(queueEntry->idx);
+    pendingRequests_.free(queueEntry);
+}
+
 void CacheController::print(ostream& os) const
 {
     os << "---Cache-Controller: " << get_name() << endl;
@@ -171,13 +188,12 @@ bool CacheController::handle_upper_interconnect(Message &message)
         return false;
     }
 
-    CacheQueueEntry *queueEntry = pendingRequests_.alloc();
+    CacheQueueEntry *queueEntry = alloc_queue_entry(message.request);
 
     if(queueEntry == NULL) {
         return false;
     }
 
-    queueEntry->request = message.request;
     queueEntry->sender  = (Interconnect*)message.sender;
     queueEntry->isSnoop = false;
     queueEntry->m_arg   = message.arg;
@@ -197,6 +213,10 @@ bool CacheController::handle_upper_interconnect(Message &message)
         queueEntry->waitFor = dependsOn->idx;
         OP_TYPE type       = queueEntry->request->get_type();
         bool kernel_req    = queueEntry->request->is_kernel();
+        if(dependsOn->prefetch) {
+            /* Prefetched line has not arrived yet */
+            N_STAT_UPDATE(prefetchStats_->late, ++, kernel_req);
+        }
         if(type == MEMORY_OP_READ) {
             N_STAT_UPDATE(new_stats->cpurequest.stall.read.dependency, ++, kernel_req);
         } else if(type == MEMORY_OP_WRITE) {
@@ -240,9 +260,8 @@ bool CacheController::handle_lower_interconnect(Message &message)
         if (message.hasData)
             return true;
 
-        CacheQueueEntry *newEntry = pendingRequests_.alloc();
+        CacheQueueEntry *newEntry = alloc_queue_entry(message.request);
         assert(newEntry);
-        newEntry->request = message.request;
         newEntry->isSnoop = true;
         newEntry->sender  = (Interconnect*)message.sender;
         newEntry->source  = (Controller*)message.origin;
@@ -259,10 +278,10 @@ bool CacheController::handle_lower_interconnect(Message &message)
             if(message.request->get_type() == MEMORY_OP_EVICT ||
                     message.request->get_type() == MEMORY_OP_UPDATE) {
                 /* alloc new queueentry and evict the cache line if present */
-                CacheQueueEntry *evictEntry = pendingRequests_.alloc();
+                CacheQueueEntry *evictEntry = alloc_queue_entry(
+                        message.request);
                 assert(evictEntry);
 
-                evictEntry->request = message.request;
                 evictEntry->request->incRefCounter();
                 evictEntry->isSnoop = true;
                 evictEntry->m_arg   = message.arg;
@@ -296,7 +315,7 @@ void CacheController::send_message(CacheQueueEntry *queueEntry,
     request->set_physical_address(tag);
     request->set_op_type(type);
 
-    CacheQueueEntry *evictEntry = pendingRequests_.alloc();
+    CacheQueueEntry *evictEntry = alloc_queue_entry(request);
     assert(evictEntry);
 
     /* set full flag if buffer is full */
@@ -304,7 +323,6 @@ void CacheController::send_message(CacheQueueEntry *queueEntry,
         memoryHierarchy_->set_controller_full(this, true);
     }
 
-    evictEntry->request = request;
     evictEntry->sender  = NULL;
     evictEntry->sendTo  = interconn;
     evictEntry->dest    = queueEntry->dest;
@@ -369,6 +387,12 @@ bool CacheController::complete_request(Message &message,
         CacheLine *line = cacheLines_->insert(queueEntry->request,
                 oldTag);
 
+        /* Prefetched line evicted before any demand access */
+        if (line->prefetched && oldTag != InvalidTag<W64>::INVALID) {
+            N_STAT_UPDATE(prefetchStats_->useless, ++,
+                    queueEntry->request->is_kernel());
+        }
+
         /* If line is in use then don't evict it, it will be inserted later. */
         if (is_line_in_use(oldTag)) {
             oldTag = -1;
@@ -384,12 +408,19 @@ bool CacheController::complete_request(Message &message,
     assert(message.hasData);
 
     coherence_logic_->complete_request(queueEntry, message);
+    queueEntry->line->prefetched = queueEntry->prefetch;
 
     /* insert the updated line into cache */
     queueEntry->eventFlags[CACHE_INSERT_EVENT]++;
     marss_add_event(&cacheInsert_, 0,
             (void*)(queueEntry));
 
+    /* Prefetched line stays in this cache, there is no one to respond */
+    if(queueEntry->prefetch) {
+        memdebug("Cache Prefetch completed: " << *queueEntry << endl);
+        return true;
+    }
+
     /* send back the response */
     queueEntry->sendTo = queueEntry->sender;
     marss_add_event(&waitInterconnect_, 1, queueEntry);
@@ -538,7 +569,19 @@ bool CacheController::cache_hit_cb(void *arg)
         } else {
             coherence_logic_->handle_interconn_hit(queueEntry);
         }
+    } else if(queueEntry->prefetch) {
+        if(is_line_valid(queueEntry->line)) {
+            /* Line is already present, drop the prefetch */
+            N_STAT_UPDATE(prefetchStats_->redundant, ++,
+                    queueEntry->request->is_kernel());
+            clear_entry_cb(queueEntry);
+        } else {
+            cache_miss_cb(queueEntry);
+        }
     } else {
+        /* Hits on invalid lines are trained as miss by cache_miss_cb */
+        if(prefetcher_ && is_line_valid(queueEntry->line))
+            train_prefetcher(queueEntry, true);
         coherence_logic_->handle_local_hit(queueEntry);
     }
 
@@ -574,6 +617,12 @@ bool CacheController::cache_miss_cb(void *arg)
         queueEntry->responseData = false;
         coherence_logic_->handle_interconn_miss(queueEntry);
     } else {
+        if(queueEntry->prefetch) {
+            N_STAT_UPDATE(prefetchStats_->issued, ++,
+                    queueEntry->request->is_kernel());
+        } else if(prefetcher_) {
+            train_prefetcher(queueEntry, false);
+        }
         coherence_logic_->handle_local_miss(queueEntry);
     }
 
@@ -652,7 +701,7 @@ bool CacheController::cache_access_cb(void *arg)
             signal = &cacheHit_;
             delay = cacheAccessLatency_;
 
-			if (!queueEntry->isSnoop) {
+			if (!queueEntry->isSnoop && !queueEntry->prefetch) {
 				if(type == MEMORY_OP_READ) {
 					N_STAT_UPDATE(new_stats->cpurequest.count.hit.read.hit, ++,
 							kernel_req);
@@ -668,7 +717,7 @@ bool CacheController::cache_access_cb(void *arg)
             N_STAT_UPDATE(new_stats->miss_state.cpu, [4]++,
                     kernel_req);
 
-			if (!queueEntry->isSnoop) {
+			if (!queueEntry->isSnoop && !queueEntry->prefetch) {
 				if(type == MEMORY_OP_READ) {
 					N_STAT_UPDATE(new_stats->cpurequest.count.miss.read, ++,
 							kernel_req);
@@ -813,7 +862,7 @@ bool CacheController::clear_entry_cb(void *arg)
                         queueEntry << endl);
             }
 
-            pendingRequests_.free(queueEntry);
+            free_queue_entry(queueEntry);
         }
 
         /*
@@ -830,9 +879,11 @@ bool CacheController::clear_entry_cb(void *arg)
 
 void CacheController::annul_request(MemoryRequest *request)
 {
-    CacheQueueEntry *queueEntry;
-    foreach_list_mutable(pendingRequests_.list(), queueEntry,
-            entry, nextentry) {
+    int idx = mshr_.head(get_line_address(request));
+    while(idx >= 0) {
+        CacheQueueEntry *queueEntry = &pendingRequests_[idx];
+        idx = mshr_.next(idx);
+
         if (queueEntry->request->is_same(request)) {
             queueEntry->annuled = true;
             /* Fix dependency chain if this entry was waiting for
@@ -852,7 +903,7 @@ void CacheController::annul_request(MemoryRequest *request)
                 pendingRequests_[queueEntry->waitFor].depends = -1;
             }
 
-            pendingRequests_.free(queueEntry);
+            free_queue_entry(queueEntry);
             ADD_HISTORY_REM(queueEntry->request);
 
             queueEntry->request->decRefCounter();
@@ -860,6 +911,91 @@ void CacheController::annul_request(MemoryRequest *request)
     }
 }
 
+/**
+ * @brief Train prefetcher with a demand access and issue its prefetches
+ *
+ * @param queueEntry Demand request entry
+ * @param hit True if request hit a valid line
+ */
+void CacheController::train_prefetcher(CacheQueueEntry *queueEntry, bool hit)
+{
+    MemoryRequest *request = queueEntry->request;
+    OP_TYPE type = request->get_type();
+    bool kernel_req = request->is_kernel();
+
+    if(type != MEMORY_OP_READ && type != MEMORY_OP_WRITE)
+        return;
+
+    prefetchLines_.clear();
+
+    if(hit) {
+        bool prefetched = queueEntry->line->prefetched;
+
+        if(prefetched) {
+            queueEntry->line->prefetched = false;
+            N_STAT_UPDATE(prefetchStats_->useful, ++, kernel_req);
+            N_STAT_UPDATE(prefetchStats_->demand_misses, ++, kernel_req);
+        }
+
+        prefetcher_->hit(request, prefetched, prefetchLines_);
+    } else {
+        N_STAT_UPDATE(prefetchStats_->demand_misses, ++, kernel_req);
+        prefetcher_->miss(request, prefetchLines_);
+    }
+
+    foreach(i, prefetchLines_.count()) {
+        issue_prefetch(queueEntry, prefetchLines_[i]);
+    }
+}
+
+/**
+ * @brief Add a prefetch request for given line to the pending queue
+ *
+ * @param queueEntry Demand request entry that triggered the prefetch
+ * @param line Line address to prefetch
+ *
+ * Prefetch is a normal read request from the request pool that goes
+ * through cache access and the lower interconnect like a demand miss,
+ * except the filled line is not sent to upper level.
+ */
+void CacheController::issue_prefetch(CacheQueueEntry *queueEntry, W64 line)
+{
+    bool kernel_req = queueEntry->request->is_kernel();
+
+    N_STAT_UPDATE(prefetchStats_->requests, ++, kernel_req);
+
+    /* Keep queue space for demand requests */
+    if(pendingRequests_.count() > pendingRequests_.size() * 0.7) {
+        N_STAT_UPDATE(prefetchStats_->dropped, ++, kernel_req);
+        return;
+    }
+
+    if(is_line_in_use(line)) {
+        N_STAT_UPDATE(prefetchStats_->redundant, ++, kernel_req);
+        return;
+    }
+
+    MemoryRequest *request = memoryHierarchy_->get_free_request(
+            queueEntry->request->get_coreid());
+    assert(request);
+
+    request->init(queueEntry->request);
+    request->set_physical_address(line << cacheLineBits_);
+    request->set_op_type(MEMORY_OP_READ);
+
+    CacheQueueEntry *prefetchEntry = alloc_queue_entry(request);
+    assert(prefetchEntry);
+
+    prefetchEntry->prefetch = true;
+    prefetchEntry->source   = queueEntry->source;
+    prefetchEntry->dest     = queueEntry->dest;
+    request->incRefCounter();
+    ADD_HISTORY_ADD(request);
+
+    prefetchEntry->eventFlags[CACHE_ACCESS_EVENT]++;
+    marss_add_event(&cacheAccess_, 1, prefetchEntry);
+}
+
 CacheQueueEntry* CacheController::get_new_queue_entry()
 {
     CacheQueueEntry *queueEntry = pendingRequests_.alloc();
@@ -885,7 +1021,55 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "latency", cacheLines_->get_access_latency());
 	YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 
+	if (prefetcher_)
+		prefetcher_->dump_configuration(out);
+
 	coherence_logic_->dump_configuration(out);
 
 	out << YAML::EndMap;
 }
+
+int CacheController::warm_probe(MemoryRequest *request, bool is_write)
+{
+    CacheLine *line = cacheLines_->probe(request);
+
+    if (!line || !coherence_logic_->is_line_valid(line))
+        return WARM_MISS;
+
+    if (!coherence_logic_->warm_hit(line, is_write))
+        return WARM_UPGRADE;
+
+    return WARM_HIT;
+}
+
+/**
+ * @brief Insert line or upgrade its state without any request
+ *
+ * Evicted line is dropped, caches above or below are not notified.
+ */
+void CacheController::warm_fill(MemoryRequest *request, bool is_write,
+        bool shared)
+{
+    CacheLine *line = cacheLines_->probe(request);
+
+    if (!line) {
+        W64 oldTag;
+        line = cacheLines_->insert(request, oldTag);
+        line->init(cacheLines_->tagOf(request->get_physical_address()));
+        line->prefetched = 0;
+    }
+
+    /* Caches kept coherent by a directory fill read lines as shared so
+     * that a later write to them goes to the directory */
+    coherence_logic_->warm_fill(line, is_write, shared || directory_);
+}
+
+bool CacheController::warm_snoop(MemoryRequest *request, bool is_write)
+{
+    CacheLine *line = cacheLines_->probe(request);
+
+    if (!line)
+        return false;
+
+    return coherence_logic_->warm_snoop(line, is_write);
+}
@@ -36,6 +36,7 @@
 #include <memoryStats.h>
 #include <statsBuilder.h>
 #include <cacheLines.h>
+#include <prefetcher.h>
 
 namespace Memory {
 
@@ -81,6 +82,7 @@ namespace Memory {
                 bool isSnoop;
                 bool isShared;
                 bool responseData;
+                bool prefetch;
 
                 void init() {
                     request      = NULL;
@@ -96,6 +98,7 @@ namespace Memory {
                     isSnoop      = false;
                     isShared     = false;
                     responseData = false;
+                    prefetch     = false;
                     source       = NULL;
                     dest         = NULL;
                     eventFlags.reset();
@@ -147,6 +150,7 @@ namespace Memory {
                     os << "] isSnoop[" << isSnoop;
                     os << "] isShared[" << isShared;
                     os << "] responseData[" << responseData;
+                    os << "] prefetch[" << prefetch;
                     os << "] ";
                     os << endl;
                     return os;
@@ -159,6 +163,131 @@ namespace Memory {
             return entry.print(os);
         }
 
+        // MSHRTable
+        // Line address index of pending queue entries. Each line has a
+        // list of queue entry indices in the order they were allocated,
+        // so lookups only visit entries of the same line instead of the
+        // whole queue. Lines are hashed with linear probing into a table
+        // of twice the queue size, so it never fills up.
+
+        template<int SIZE>
+        struct MSHRTable
+        {
+            private:
+                static const int TABLE_SIZE = SIZE * 2;
+
+                struct Slot {
+                    W64 line;
+                    int head;
+                    int tail;
+                };
+
+                Slot slots_[TABLE_SIZE];
+
+                // Per queue entry links and line
+                int next_[SIZE];
+                int prev_[SIZE];
+                W64 line_[SIZE];
+
+                int hash(W64 line) const {
+                    return int((line ^ (line >> 13)) % TABLE_SIZE);
+                }
+
+                int find_slot(W64 line) const {
+                    int i = hash(line);
+                    while(slots_[i].head >= 0) {
+                        if(slots_[i].line == line)
+                            return i;
+                        i = (i + 1) % TABLE_SIZE;
+                    }
+                    return -1;
+                }
+
+                // Backward shift deletion so probe chains stay intact
+                void remove_slot(int i) {
+                    int j = i;
+                    while(1) {
+                        slots_[i].head = -1;
+                        while(1) {
+                            j = (j + 1) % TABLE_SIZE;
+                            if(slots_[j].head < 0)
+                                return;
+                            int k = hash(slots_[j].line);
+                            if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+                                continue;
+                            break;
+                        }
+                        slots_[i] = slots_[j];
+                        i = j;
+                    }
+                }
+
+            public:
+                MSHRTable() { reset(); }
+
+                void reset() {
+                    foreach(i, TABLE_SIZE) {
+                        slots_[i].head = -1;
+                        slots_[i].tail = -1;
+                    }
+                    foreach(i, SIZE) {
+                        next_[i] = prev_[i] = -1;
+                    }
+                }
+
+                // Oldest entry of given line, -1 if none
+                int head(W64 line) const {
+                    int i = find_slot(line);
+                    return (i >= 0) ? slots_[i].head : -1;
+                }
+
+                // Next entry of same line in allocation order
+                int next(int idx) const {
+                    return next_[idx];
+                }
+
+                void add(W64 line, int idx) {
+                    int i = find_slot(line);
+                    line_[idx] = line;
+                    next_[idx] = -1;
+
+                    if(i < 0) {
+                        i = hash(line);
+                        while(slots_[i].head >= 0)
+                            i = (i + 1) % TABLE_SIZE;
+                        slots_[i].line = line;
+                        slots_[i].head = idx;
+                        slots_[i].tail = idx;
+                        prev_[idx] = -1;
+                        return;
+                    }
+
+                    prev_[idx] = slots_[i].tail;
+                    next_[slots_[i].tail] = idx;
+                    slots_[i].tail = idx;
+                }
+
+                void remove(int idx) {
+                    int i = find_slot(line_[idx]);
+                    assert(i >= 0);
+
+                    if(prev_[idx] >= 0)
+                        next_[prev_[idx]] = next_[idx];
+                    else
+                        slots_[i].head = next_[idx];
+
+                    if(next_[idx] >= 0)
+                        prev_[next_[idx]] = prev_[idx];
+                    else
+                        slots_[i].tail = prev_[idx];
+
+                    next_[idx] = prev_[idx] = -1;
+
+                    if(slots_[i].head < 0)
+                        remove_slot(i);
+                }
+        };
+
         class CacheController : public Controller
         {
             private:
@@ -175,6 +304,9 @@ namespace Memory {
                 // A Queue conatining pending requests for this cache
                 FixStateList<CacheQueueEntry, 256> pendingRequests_;
 
+                // Line address index of pendingRequests_
+                MSHRTable<256> mshr_;
+
                 // Flag to indicate if this cache is lowest private
                 // level cache
                 bool isLowestPrivate_;
@@ -205,6 +337,18 @@ namespace Memory {
 
                 CoherenceLogic *coherence_logic_;
 
+                // Hardware prefetcher, NULL if not configured
+                Prefetcher *prefetcher_;
+                PrefetchStats *prefetchStats_;
+                dynarray<W64> prefetchLines_;
+
+                // Allocate/free pending queue entries, keeps mshr_ updated
+                CacheQueueEntry* alloc_queue_entry(MemoryRequest *request);
+                void free_queue_entry(CacheQueueEntry *queueEntry);
+
+                void train_prefetcher(CacheQueueEntry *queueEntry, bool hit);
+                void issue_prefetch(CacheQueueEntry *queueEntry, W64 line);
+
                 CacheQueueEntry* find_dependency(MemoryRequest *request);
 
                 // This function is used to find pending request with either
@@ -275,6 +419,11 @@ namespace Memory {
                 void annul_request(MemoryRequest *request);
 				void dump_configuration(YAML::Emitter &out) const;
 
+                int warm_probe(MemoryRequest *request, bool is_write);
+                void warm_fill(MemoryRequest *request, bool is_write,
+                        bool shared);
+                bool warm_snoop(MemoryRequest *request, bool is_write);
+
                 // Callback functions for signals of cache
                 virtual bool cache_hit_cb(void *arg);
                 virtual bool cache_miss_cb(void *arg);
@@ -78,10 +78,18 @@ static inline ostream& operator <<(ostream& os, const Message& msg)
 
 class MemoryHierarchy;
 
+/* Result of Controller::warm_probe */
+enum WarmResult {
+	WARM_HIT = 0,
+	WARM_MISS,
+	WARM_UPGRADE, /* Write hit on a line other caches can share */
+};
+
 class Controller
 {
 	private:
         stringbuf name_;
+        W16 historyId_;
 		Signal handle_interconnect_;
 		bool isPrivate_;
 
@@ -96,6 +104,7 @@ class Controller
 			, idx(coreid)
 		{
 			name_ << name;
+			historyId_ = MemoryRequest::register_history_name(name);
 			isPrivate_ = false;
 
 			handle_interconnect_.connect(signal_mem_ptr \
@@ -123,7 +132,25 @@ class Controller
 			return 0;
 		}
 
-		int get_no_pending_request(W8 coreid) { assert(0); return 0; }
+		virtual int get_no_pending_request(W8 coreid) { assert(0); return 0; }
+
+		/*
+		 * Functional warming used while fast-forwarding, see
+		 * MemoryHierarchy::warm_access. These only change tags and
+		 * line states, no request is queued and no stats are updated.
+		 * Controllers without cache lines end the warming path.
+		 */
+		virtual int warm_probe(MemoryRequest *request, bool is_write) {
+			return WARM_HIT;
+		}
+
+		virtual void warm_fill(MemoryRequest *request, bool is_write,
+				bool shared) {}
+
+		/* Another cache accessed the line, return true if it was valid */
+		virtual bool warm_snoop(MemoryRequest *request, bool is_write) {
+			return false;
+		}
 
 		Signal* get_interconnect_signal() {
 			return &handle_interconnect_;
@@ -133,6 +160,11 @@ class Controller
 			return name_.buf;
 		}
 
+		/* Id used in MemoryRequest history records */
+		W16 get_history_id() const {
+			return historyId_;
+		}
+
 		void set_private(bool flag) {
 			isPrivate_ = flag;
 		}
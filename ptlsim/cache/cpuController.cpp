@@ -431,6 +431,37 @@ void CPUController::clock()
 	}
 }
 
+/**
+ * @brief Cycle at which clock() will finalize the next pending request
+ *
+ * @return -1 if no request is counting down, entries waiting for a cache
+ * response are completed by the interconnect and not by clock()
+ */
+W64 CPUController::get_next_event_cycle()
+{
+	W64 next = (W64)-1;
+	CPUControllerQueueEntry* queueEntry;
+	foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
+			prev_t) {
+		if(queueEntry->cycles > 0)
+			next = min(next, sim_cycle + queueEntry->cycles - 1);
+	}
+	return next;
+}
+
+/**
+ * @brief Same as calling clock() 'cycles' times when no request is
+ * finalized in between, see get_next_event_cycle()
+ */
+void CPUController::skip_cycles(W64 cycles)
+{
+	CPUControllerQueueEntry* queueEntry;
+	foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
+			prev_t) {
+		queueEntry->cycles -= cycles;
+	}
+}
+
 void CPUController::print(ostream& os) const
 {
 	os << "---CPU-Controller: "<< get_name()<< endl;
@@ -146,6 +146,8 @@ class CPUController : public Controller
 		int access_fast_path(Interconnect *interconnect,
 				MemoryRequest *request);
 		void clock();
+		W64 get_next_event_cycle();
+		void skip_cycles(W64 cycles);
         void register_interconnect(Interconnect *interconnect, int type);
 		void register_interconnect_L1_d(Interconnect *interconnect);
 		void register_interconnect_L1_i(Interconnect *interconnect);
@@ -0,0 +1,595 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#define PTLSIM_PUBLIC_ONLY
+#include <ptlhwdef.h>
+#endif
+
+#include <dramController.h>
+#include <memoryHierarchy.h>
+
+#include <machine.h>
+
+extern uint64_t qemu_ram_size;
+using namespace Memory;
+
+static const char* dram_field_names[NUM_DRAM_FIELDS] = {
+	"channel",
+	"rank",
+	"bank",
+	"row",
+	"column",
+};
+
+/* Number of address bits used by a power of 2 count */
+static inline int dram_bits(W64 count)
+{
+	return (count > 1) ? msbindex64(count - 1) + 1 : 0;
+}
+
+static void dram_config_error(const char *name, const char *msg)
+{
+	stringbuf err;
+	err << "::ERROR::DRAM Controller '" << name << "': " << msg << endl;
+	ptl_logfile << err;
+	cerr << err;
+	assert(0);
+}
+
+DRAMController::DRAMController(W8 coreid, const char *name,
+		MemoryHierarchy *memoryHierarchy) :
+	Controller(coreid, name, memoryHierarchy)
+	, cacheInterconnect_(NULL)
+	, fullChannels_(0)
+	, new_stats(name, &memoryHierarchy->get_machine())
+{
+	memoryHierarchy_->add_cache_mem_controller(this);
+
+	BaseMachine &machine = memoryHierarchy_->get_machine();
+
+	if(!machine.get_option(name, "channels", channelCount_))
+		channelCount_ = 2;
+	if(!machine.get_option(name, "ranks", rankCount_))
+		rankCount_ = 2;
+	if(!machine.get_option(name, "banks", bankCount_))
+		bankCount_ = 8;
+	if(!machine.get_option(name, "row_size", rowSize_))
+		rowSize_ = 8192;
+	if(!machine.get_option(name, "queue_size", queueSize_))
+		queueSize_ = 32;
+	if(!machine.get_option(name, "address_mapping", addressMapping_))
+		addressMapping_ << "row:rank:bank:channel:column";
+
+	/* Timings are given in nano seconds, default is DDR3-1600 11-11-11 */
+	if(!machine.get_option(name, "controller_latency", controllerLatency_))
+		controllerLatency_ = 10;
+	if(!machine.get_option(name, "cas_latency", casLatency_))
+		casLatency_ = 14;
+	if(!machine.get_option(name, "rcd_latency", rcdLatency_))
+		rcdLatency_ = 14;
+	if(!machine.get_option(name, "precharge_latency", prechargeLatency_))
+		prechargeLatency_ = 14;
+	if(!machine.get_option(name, "burst_latency", burstLatency_))
+		burstLatency_ = 5;
+
+	controllerLatency_ = ns_to_simcycles(controllerLatency_);
+	casLatency_ = max(1, (int)ns_to_simcycles(casLatency_));
+	rcdLatency_ = ns_to_simcycles(rcdLatency_);
+	prechargeLatency_ = ns_to_simcycles(prechargeLatency_);
+	burstLatency_ = max(1, (int)ns_to_simcycles(burstLatency_));
+
+	if(channelCount_ <= 0 || channelCount_ > DRAM_MAX_CHANNELS)
+		dram_config_error(name, "channels must be between 1 and 16");
+	if(queueSize_ <= 0)
+		dram_config_error(name, "queue_size must be positive");
+	if(popcount(channelCount_) != 1 || popcount(rankCount_) != 1 ||
+			popcount(bankCount_) != 1 || popcount(rowSize_) != 1)
+		dram_config_error(name,
+				"channels, ranks, banks and row_size must be power of 2");
+	if(rowSize_ < 64)
+		dram_config_error(name, "row_size must be at least one line");
+
+	setup_address_mapping();
+
+	channels_ = new DRAMChannel[channelCount_];
+	foreach(i, channelCount_) {
+		DRAMChannel &channel = channels_[i];
+		channel.id = i;
+		channel.banks = new DRAMBank[rankCount_ * bankCount_];
+		foreach(j, rankCount_ * bankCount_) {
+			channel.banks[j].reset();
+		}
+		channel.entries = new DRAMQueueEntry[queueSize_];
+		foreach(j, queueSize_) {
+			channel.entries[j].init();
+			channel.freeList.enqueue((selfqueuelink*)&channel.entries[j]);
+		}
+		channel.dataBusReadyCycle = 0;
+		channel.scheduleCycle = 0;
+		channel.isScheduled = false;
+	}
+
+	foreach(i, NUM_SIM_CORES) {
+		pendingCount_[i] = 0;
+	}
+
+	SET_SIGNAL_CB(name, "_Schedule_Channel", scheduleChannel_,
+			&DRAMController::schedule_channel_cb);
+
+	SET_SIGNAL_CB(name, "_Access_Completed", accessCompleted_,
+			&DRAMController::access_completed_cb);
+
+	SET_SIGNAL_CB(name, "_Wait_Interconnect", waitInterconnect_,
+			&DRAMController::wait_interconnect_cb);
+}
+
+DRAMController::~DRAMController()
+{
+	foreach(i, channelCount_) {
+		delete [] channels_[i].banks;
+		delete [] channels_[i].entries;
+	}
+	delete [] channels_;
+}
+
+/*
+ * @brief: parse 'address_mapping' option. Mapping lists the address fields
+ *         from most to least significant bits separated by ':', for example
+ *         'row:rank:bank:channel:column'. Column bits select a line within
+ *         a row. If row is not the most significant field its width is
+ *         computed from the size of guest RAM.
+ */
+void DRAMController::setup_address_mapping()
+{
+	dynarray<stringbuf*> fields;
+	addressMapping_.split(fields, ":");
+
+	if(fields.count() != NUM_DRAM_FIELDS)
+		dram_config_error(get_name(), "address_mapping must list "
+				"channel, rank, bank, row and column");
+
+	bool isFieldSet[NUM_DRAM_FIELDS] = {false};
+	foreach(i, fields.count()) {
+		int field = -1;
+		foreach(j, NUM_DRAM_FIELDS) {
+			if(strequal(fields[i]->buf, dram_field_names[j]))
+				field = j;
+		}
+		if(field < 0 || isFieldSet[field])
+			dram_config_error(get_name(), "invalid address_mapping");
+
+		isFieldSet[field] = true;
+		fieldOrder_[NUM_DRAM_FIELDS - 1 - i] = field;
+		delete fields[i];
+	}
+
+	fieldBits_[DRAM_FIELD_CHANNEL] = dram_bits(channelCount_);
+	fieldBits_[DRAM_FIELD_RANK] = dram_bits(rankCount_);
+	fieldBits_[DRAM_FIELD_BANK] = dram_bits(bankCount_);
+	fieldBits_[DRAM_FIELD_COLUMN] = dram_bits(rowSize_ / 64);
+
+	int usedBits = 6;
+	foreach(i, NUM_DRAM_FIELDS) {
+		if(i != DRAM_FIELD_ROW)
+			usedBits += fieldBits_[i];
+	}
+	fieldBits_[DRAM_FIELD_ROW] = max(1, dram_bits(qemu_ram_size) - usedBits);
+}
+
+void DRAMController::decode_address(W64 physaddr, DRAMAddress &addr) const
+{
+	W64 fieldValue[NUM_DRAM_FIELDS];
+	W64 bits = physaddr >> 6;
+
+	foreach(i, NUM_DRAM_FIELDS) {
+		int field = fieldOrder_[i];
+		if(i == NUM_DRAM_FIELDS - 1 && field == DRAM_FIELD_ROW) {
+			fieldValue[field] = bits;
+		} else {
+			fieldValue[field] = lowbits(bits, fieldBits_[field]);
+			bits >>= fieldBits_[field];
+		}
+	}
+
+	addr.channel = fieldValue[DRAM_FIELD_CHANNEL];
+	addr.rank = fieldValue[DRAM_FIELD_RANK];
+	addr.bank = fieldValue[DRAM_FIELD_BANK];
+	addr.row = fieldValue[DRAM_FIELD_ROW];
+}
+
+DRAMChannel& DRAMController::get_channel(MemoryRequest *request) const
+{
+	DRAMAddress addr;
+	decode_address(request->get_physical_address(), addr);
+	return channels_[addr.channel];
+}
+
+DRAMBank& DRAMController::get_bank(DRAMChannel &channel,
+		DRAMAddress &addr) const
+{
+	return channel.banks[addr.rank * bankCount_ + addr.bank];
+}
+
+void DRAMController::register_interconnect(Interconnect *interconnect,
+		int type)
+{
+	switch(type) {
+		case INTERCONN_TYPE_UPPER:
+			cacheInterconnect_ = interconnect;
+			break;
+		default:
+			assert(0);
+	}
+}
+
+bool DRAMController::handle_interconnect_cb(void *arg)
+{
+	Message *message = (Message*)arg;
+	MemoryRequest *request = message->request;
+
+	memdebug("Received message in DRAM controller: ", get_name(), " ",
+			*message, endl);
+
+	if(message->hasData && request->get_type() != MEMORY_OP_UPDATE)
+		return true;
+
+	/* We ignore all the evict messages */
+	if(request->get_type() == MEMORY_OP_EVICT)
+		return true;
+
+	DRAMChannel &channel = get_channel(request);
+
+	/*
+	 * Merge memory update with a pending update to the same line that
+	 * is not issued yet, same as the simple memory controller.
+	 */
+	if(request->get_type() == MEMORY_OP_UPDATE) {
+		DRAMQueueEntry *entry;
+		foreach_list_mutable_backwards(channel.pendingList, entry,
+				entry_t, preventry_t) {
+			if(entry->request->get_physical_address() ==
+					request->get_physical_address()) {
+				if(!entry->inUse && entry->request->get_type() ==
+						MEMORY_OP_UPDATE) {
+					return true;
+				}
+				break;
+			}
+		}
+	}
+
+	/* if queue is full return false to indicate failure */
+	if(channel.freeList.empty()) {
+		memdebug("DRAM channel ", channel.id, " queue is full\n");
+		return false;
+	}
+
+	DRAMQueueEntry *queueEntry = (DRAMQueueEntry*)channel.freeList.peek();
+	channel.freeList.remove_to_list(&channel.pendingList, false,
+			queueEntry);
+	queueEntry->init();
+
+	/*
+	 * Other channels can still take requests, the sender of a request to a
+	 * full channel gets false above and retries. Stall upstream controllers
+	 * only once all channels are full, same as is_full().
+	 */
+	if(channel.freeList.empty()) {
+		fullChannels_++;
+		if(fullChannels_ == channelCount_)
+			memoryHierarchy_->set_controller_full(this, true);
+	}
+
+	queueEntry->request = request;
+	queueEntry->source = (Controller*)message->origin;
+	queueEntry->arrivalCycle = sim_cycle;
+	decode_address(request->get_physical_address(), queueEntry->addr);
+
+	queueEntry->request->incRefCounter();
+	ADD_HISTORY_ADD(queueEntry->request);
+
+	assert(request->get_coreid() < NUM_SIM_CORES);
+	pendingCount_[request->get_coreid()]++;
+
+	bool kernel = request->is_kernel();
+	N_STAT_UPDATE(new_stats.channel_access, [channel.id]++, kernel);
+	switch(request->get_type()) {
+		case MEMORY_OP_READ:
+			N_STAT_UPDATE(new_stats.read, ++, kernel);
+			break;
+		case MEMORY_OP_WRITE:
+			N_STAT_UPDATE(new_stats.write, ++, kernel);
+			break;
+		case MEMORY_OP_UPDATE:
+			N_STAT_UPDATE(new_stats.update, ++, kernel);
+			break;
+		default:
+			assert(0);
+	}
+
+	schedule_channel(channel, 1);
+
+	return true;
+}
+
+/*
+ * @brief: make sure channel scheduler runs after 'delay' cycles. Only the
+ *         earliest requested cycle is kept, events for later cycles that
+ *         are already in the event queue are ignored when they fire.
+ */
+void DRAMController::schedule_channel(DRAMChannel &channel, int delay)
+{
+	W64 cycle = sim_cycle + delay;
+
+	if(channel.isScheduled && channel.scheduleCycle <= cycle)
+		return;
+
+	channel.isScheduled = true;
+	channel.scheduleCycle = cycle;
+	marss_add_event(&scheduleChannel_, delay, &channel);
+}
+
+/*
+ * @brief: FR-FCFS selection, oldest row hit to a ready bank first and
+ *         if there is none then oldest request to a ready bank.
+ */
+DRAMQueueEntry* DRAMController::find_next_request(DRAMChannel &channel)
+{
+	DRAMQueueEntry *oldestReady = NULL;
+	DRAMQueueEntry *entry;
+
+	foreach_list_mutable(channel.pendingList, entry, entry_t, nextentry_t) {
+		if(entry->inUse)
+			continue;
+
+		DRAMBank &bank = get_bank(channel, entry->addr);
+		if(bank.readyCycle > sim_cycle)
+			continue;
+
+		if(bank.isRowOpen && bank.openRow == entry->addr.row)
+			return entry;
+
+		if(!oldestReady)
+			oldestReady = entry;
+	}
+
+	return oldestReady;
+}
+
+void DRAMController::issue_request(DRAMChannel &channel,
+		DRAMQueueEntry *entry)
+{
+	DRAMBank &bank = get_bank(channel, entry->addr);
+	bool kernel = entry->request->is_kernel();
+	int activateLatency;
+
+	if(bank.isRowOpen && bank.openRow == entry->addr.row) {
+		activateLatency = 0;
+		N_STAT_UPDATE(new_stats.row_hit, ++, kernel);
+	} else if(!bank.isRowOpen) {
+		activateLatency = rcdLatency_;
+		N_STAT_UPDATE(new_stats.row_miss, ++, kernel);
+	} else {
+		activateLatency = prechargeLatency_ + rcdLatency_;
+		N_STAT_UPDATE(new_stats.row_conflict, ++, kernel);
+	}
+
+	bank.isRowOpen = true;
+	bank.openRow = entry->addr.row;
+
+	/* Column accesses to an open row can be pipelined every burst */
+	bank.readyCycle = sim_cycle + activateLatency + burstLatency_;
+
+	W64 dataCycle = max(sim_cycle + activateLatency + casLatency_,
+			channel.dataBusReadyCycle);
+	channel.dataBusReadyCycle = dataCycle + burstLatency_;
+
+	W64 doneCycle = channel.dataBusReadyCycle + controllerLatency_;
+
+	N_STAT_UPDATE(new_stats.queue_cycles, += (sim_cycle -
+				entry->arrivalCycle), kernel);
+	N_STAT_UPDATE(new_stats.access_cycles, += (doneCycle -
+				entry->arrivalCycle), kernel);
+
+	entry->inUse = true;
+	marss_add_event(&accessCompleted_, doneCycle - sim_cycle, entry);
+}
+
+bool DRAMController::schedule_channel_cb(void *arg)
+{
+	DRAMChannel &channel = *(DRAMChannel*)arg;
+
+	/* Ignore events superseded by an earlier schedule */
+	if(!channel.isScheduled || channel.scheduleCycle != sim_cycle)
+		return true;
+
+	channel.isScheduled = false;
+
+	/* One command per cycle on a channel */
+	DRAMQueueEntry *entry = find_next_request(channel);
+	if(entry)
+		issue_request(channel, entry);
+
+	/* Find when the next waiting request can be issued */
+	W64 nextCycle = (W64)-1;
+	foreach_list_mutable(channel.pendingList, entry, entry_t, nextentry_t) {
+		if(entry->inUse)
+			continue;
+
+		DRAMBank &bank = get_bank(channel, entry->addr);
+		nextCycle = min(nextCycle, max(bank.readyCycle, sim_cycle + 1));
+	}
+
+	if(nextCycle != (W64)-1)
+		schedule_channel(channel, nextCycle - sim_cycle);
+
+	return true;
+}
+
+bool DRAMController::access_completed_cb(void *arg)
+{
+	DRAMQueueEntry *queueEntry = (DRAMQueueEntry*)arg;
+
+	if(!queueEntry->annuled) {
+		/* Send response back to cache */
+		memdebug("DRAM access done for Request: ", *queueEntry->request,
+				endl);
+		wait_interconnect_cb(queueEntry);
+	} else {
+		free_entry(queueEntry);
+	}
+
+	return true;
+}
+
+bool DRAMController::wait_interconnect_cb(void *arg)
+{
+	DRAMQueueEntry *queueEntry = (DRAMQueueEntry*)arg;
+
+	/* Don't send response if its a memory update request */
+	if(queueEntry->request->get_type() == MEMORY_OP_UPDATE) {
+		free_entry(queueEntry);
+		return true;
+	}
+
+	Message& message = *memoryHierarchy_->get_message();
+	message.sender = this;
+	message.dest = queueEntry->source;
+	message.request = queueEntry->request;
+	message.hasData = true;
+
+	memdebug("DRAM sending message: ", message);
+	bool success = cacheInterconnect_->get_controller_request_signal()->
+		emit(&message);
+	memoryHierarchy_->free_message(&message);
+
+	if(!success) {
+		/* Failed to response to cache, retry after 1 cycle */
+		marss_add_event(&waitInterconnect_, 1, queueEntry);
+	} else {
+		free_entry(queueEntry);
+	}
+
+	return true;
+}
+
+void DRAMController::free_entry(DRAMQueueEntry *queueEntry)
+{
+	DRAMChannel &channel = channels_[queueEntry->addr.channel];
+
+	queueEntry->request->decRefCounter();
+	ADD_HISTORY_REM(queueEntry->request);
+	pendingCount_[queueEntry->request->get_coreid()]--;
+
+	if(channel.freeList.empty()) {
+		if(fullChannels_ == channelCount_)
+			memoryHierarchy_->set_controller_full(this, false);
+		fullChannels_--;
+	}
+
+	channel.pendingList.remove_to_list(&channel.freeList, false,
+			queueEntry);
+	queueEntry->init();
+}
+
+void DRAMController::annul_request(MemoryRequest *request)
+{
+	DRAMChannel &channel = get_channel(request);
+	DRAMQueueEntry *queueEntry;
+
+	foreach_list_mutable(channel.pendingList, queueEntry, entry,
+			nextentry) {
+		if(queueEntry->request->is_same(request)) {
+			queueEntry->annuled = true;
+			if(!queueEntry->inUse)
+				free_entry(queueEntry);
+		}
+	}
+}
+
+int DRAMController::get_no_pending_request(W8 coreid)
+{
+	assert(coreid < NUM_SIM_CORES);
+	return pendingCount_[coreid];
+}
+
+void DRAMController::print(ostream& os) const
+{
+	os << "---DRAM-Controller: ", get_name(), endl;
+	foreach(i, channelCount_) {
+		DRAMChannel &channel = channels_[i];
+		os << "Channel ", i, " dataBusReady[",
+		   channel.dataBusReadyCycle, "] scheduled[",
+		   channel.isScheduled, "@", channel.scheduleCycle, "]", endl;
+		if(channel.pendingList.count > 0)
+			os << "Queue : ", channel.pendingList, endl;
+	}
+	os << "---End DRAM-Controller: ", get_name(), endl;
+}
+
+/**
+ * @brief Dump DRAM Controller in YAML Format
+ *
+ * @param out YAML Object
+ */
+void DRAMController::dump_configuration(YAML::Emitter &out) const
+{
+	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+	YAML_KEY_VAL(out, "type", "dram_cont");
+	YAML_KEY_VAL(out, "scheduler", "frfcfs");
+	YAML_KEY_VAL(out, "RAM_size", ram_size); /* ram_size is from QEMU */
+	YAML_KEY_VAL(out, "channels", channelCount_);
+	YAML_KEY_VAL(out, "ranks", rankCount_);
+	YAML_KEY_VAL(out, "banks", bankCount_);
+	YAML_KEY_VAL(out, "row_size", rowSize_);
+	YAML_KEY_VAL(out, "row_bits", fieldBits_[DRAM_FIELD_ROW]);
+	YAML_KEY_VAL(out, "address_mapping", addressMapping_.buf);
+	YAML_KEY_VAL(out, "queue_size", queueSize_);
+	YAML_KEY_VAL(out, "controller_latency", controllerLatency_);
+	YAML_KEY_VAL(out, "cas_latency", casLatency_);
+	YAML_KEY_VAL(out, "rcd_latency", rcdLatency_);
+	YAML_KEY_VAL(out, "precharge_latency", prechargeLatency_);
+	YAML_KEY_VAL(out, "burst_latency", burstLatency_);
+
+	out << YAML::EndMap;
+}
+
+/* DRAM Controller Builder */
+struct DRAMControllerBuilder : public ControllerBuilder
+{
+	DRAMControllerBuilder(const char* name) :
+		ControllerBuilder(name)
+	{}
+
+	Controller* get_new_controller(W8 coreid, W8 type,
+			MemoryHierarchy& mem, const char *name) {
+		return new DRAMController(coreid, name, &mem);
+	}
+};
+
+DRAMControllerBuilder dramControllerBuilder("frfcfs_dram_cont");
@@ -0,0 +1,204 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef DRAM_CONTROLLER_H
+#define DRAM_CONTROLLER_H
+
+#include <controller.h>
+#include <interconnect.h>
+#include <superstl.h>
+#include <statelist.h>
+#include <memoryStats.h>
+
+namespace Memory {
+
+/*
+ * Fields of a physical address used by DRAMController address mapping.
+ * Line offset bits are always removed before the mapping is applied.
+ */
+enum DRAMAddressField {
+	DRAM_FIELD_CHANNEL,
+	DRAM_FIELD_RANK,
+	DRAM_FIELD_BANK,
+	DRAM_FIELD_ROW,
+	DRAM_FIELD_COLUMN,
+	NUM_DRAM_FIELDS
+};
+
+struct DRAMAddress {
+	int channel;
+	int rank;
+	int bank;
+	W64 row;
+};
+
+struct DRAMQueueEntry : public selfqueuelink
+{
+	MemoryRequest *request;
+	Controller *source;
+	DRAMAddress addr;
+	W64 arrivalCycle;
+	bool annuled;
+	bool inUse;
+
+	void init() {
+		request = NULL;
+		source = NULL;
+		arrivalCycle = 0;
+		annuled = false;
+		inUse = false;
+	}
+
+	ostream& print(ostream &os) const {
+		if(request)
+			os << "Request{", *request, "} ";
+		os << "channel[", addr.channel, "] ";
+		os << "rank[", addr.rank, "] ";
+		os << "bank[", addr.bank, "] ";
+		os << "row[", addr.row, "] ";
+		os << "arrival[", arrivalCycle, "] ";
+		os << "annuled[", annuled, "] ";
+		os << "inUse[", inUse, "] ";
+		os << endl;
+		return os;
+	}
+};
+
+struct DRAMBank {
+	W64 openRow;
+	bool isRowOpen;
+	W64 readyCycle;
+
+	void reset() {
+		openRow = 0;
+		isRowOpen = false;
+		readyCycle = 0;
+	}
+};
+
+struct DRAMChannel {
+	int id;
+	DRAMBank *banks;
+	DRAMQueueEntry *entries;
+	StateList pendingList;
+	StateList freeList;
+	W64 dataBusReadyCycle;
+	W64 scheduleCycle;
+	bool isScheduled;
+};
+
+/*
+ * DRAMController
+ *
+ * Native main memory model with multiple channels, each with its own
+ * request queue, ranks and banks. Every bank keeps its open row and serves
+ * requests with row hit, row miss (closed bank) or row conflict timing.
+ * Requests of a channel are issued with FR-FCFS: the oldest row hit to a
+ * ready bank first, otherwise the oldest request to a ready bank.
+ *
+ * All geometry, timing and queue options are read from the machine
+ * configuration (memory 'params' or per instance 'option'), see
+ * config/default.conf for the list of options.
+ */
+class DRAMController : public Controller
+{
+	private:
+		Interconnect *cacheInterconnect_;
+
+		Signal scheduleChannel_;
+		Signal accessCompleted_;
+		Signal waitInterconnect_;
+
+		DRAMChannel *channels_;
+
+		int channelCount_;
+		int rankCount_;
+		int bankCount_;
+		int rowSize_;
+		int queueSize_;
+		int fullChannels_;
+		int pendingCount_[NUM_SIM_CORES];
+
+		/* Address mapping from LSB to MSB after line offset */
+		int fieldOrder_[NUM_DRAM_FIELDS];
+		int fieldBits_[NUM_DRAM_FIELDS];
+		stringbuf addressMapping_;
+
+		/* All timings are in simulation cycles */
+		int controllerLatency_;
+		int casLatency_;
+		int rcdLatency_;
+		int prechargeLatency_;
+		int burstLatency_;
+
+		DRAMStats new_stats;
+
+		void setup_address_mapping();
+		void decode_address(W64 physaddr, DRAMAddress &addr) const;
+
+		DRAMChannel& get_channel(MemoryRequest *request) const;
+		DRAMBank& get_bank(DRAMChannel &channel, DRAMAddress &addr) const;
+
+		DRAMQueueEntry* find_next_request(DRAMChannel &channel);
+		void issue_request(DRAMChannel &channel, DRAMQueueEntry *entry);
+		void schedule_channel(DRAMChannel &channel, int delay);
+		void free_entry(DRAMQueueEntry *entry);
+
+	public:
+		DRAMController(W8 coreid, const char *name,
+				MemoryHierarchy *memoryHierarchy);
+		~DRAMController();
+
+		virtual bool handle_interconnect_cb(void *arg);
+		void print(ostream& os) const;
+
+		virtual void register_interconnect(Interconnect *interconnect,
+				int type);
+
+		bool schedule_channel_cb(void *arg);
+		virtual bool access_completed_cb(void *arg);
+		virtual bool wait_interconnect_cb(void *arg);
+
+		void annul_request(MemoryRequest *request);
+		virtual void dump_configuration(YAML::Emitter &out) const;
+
+		virtual int get_no_pending_request(W8 coreid);
+
+		bool is_full(bool fromInterconnect = false,
+				MemoryRequest *request = NULL) const {
+			if(request)
+				return get_channel(request).freeList.empty();
+			return fullChannels_ == channelCount_;
+		}
+
+		void print_map(ostream& os)
+		{
+			os << "DRAM Controller: ", get_name(), endl;
+			os << "\tconnected to:", endl;
+			os << "\t\tinterconnect: ", cacheInterconnect_->get_name(), endl;
+		}
+};
+
+};
+
+#endif // DRAM_CONTROLLER_H
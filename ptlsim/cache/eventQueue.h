@@ -0,0 +1,454 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Copyright 2009 Avadh Patel <apatel@cs.binghamton.edu>
+ * Copyright 2009 Furat Afram <fafram@cs.binghamton.edu>
+ *
+ */
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statelist.h>
+
+namespace Memory {
+
+  class Event : public FixStateListObject
+	{
+		private:
+			Signal *signal_;
+			W64    clock_;
+			void   *arg_;
+			int    next_;
+
+		public:
+			void init() {
+				signal_ = NULL;
+				clock_ = -1;
+				arg_ = NULL;
+				next_ = -1;
+			}
+
+			void setup(Signal *signal, W64 clock, void *arg) {
+				signal_ = signal;
+				clock_ = clock;
+				arg_ = arg;
+			}
+
+			bool execute() {
+				return signal_->emit(arg_);
+			}
+
+			W64 get_clock() {
+				return clock_;
+			}
+
+			Signal* get_signal() {
+				return signal_;
+			}
+
+			void* get_arg() {
+				return arg_;
+			}
+
+			/* Index of next event in same EventWheel bucket */
+			int get_next() {
+				return next_;
+			}
+
+			void set_next(int next) {
+				next_ = next;
+			}
+
+			ostream& print(ostream& os) const {
+				os << "Event< ";
+				if(signal_)
+					os << "Signal:" << signal_->get_name() << " ";
+				os << "Clock:" << clock_ << " ";
+				os << "arg:" << arg_ ;
+				os << ">" << endl, flush;
+				return os;
+			}
+
+			bool operator ==(Event &event) {
+				if(clock_ == event.clock_)
+					return true;
+				return false;
+			}
+
+			bool operator >(Event &event) {
+				if(clock_ > event.clock_)
+					return true;
+				return false;
+			}
+
+			bool operator <(Event &event) {
+				if(clock_ < event.clock_)
+					return true;
+				return false;
+			}
+
+            bool operator >=(Event &event) {
+                if (clock_ >= event.clock_)
+                    return true;
+                return false;
+            }
+	};
+
+  static inline ostream& operator <<(ostream& os, const Event& event) {
+      return event.print(os);
+  }
+
+  /*
+   * Both event queues below provide the same interface to MemoryHierarchy:
+   *
+   *   alloc()       - get a free Event, NULL if queue is full
+   *   schedule(e)   - queue an allocated and setup Event by its clock
+   *   pop(cycle)    - oldest Event with clock <= cycle, NULL if none. Events
+   *                   with same clock are returned in schedule order. Caller
+   *                   must free() the returned Event before next pop().
+   *   free(e)       - return Event to the free pool
+   *   next_clock()  - clock of earliest pending Event, -1 if none
+   */
+
+  /*
+   * EventList
+   *
+   * Events are kept in a single list sorted by clock. Insertion walks the
+   * list from head so its O(number of pending events).
+   */
+  template <int SIZE>
+  class EventList
+  {
+	  private:
+		  FixStateList<Event, SIZE> events_;
+
+	  public:
+		  Event* alloc() {
+			  return events_.alloc();
+		  }
+
+		  void free(Event *event) {
+			  events_.free(event);
+		  }
+
+		  void schedule(Event *event) {
+			  // First make sure that given event is in tail of queue
+			  assert(events_.tail() == event);
+
+			  // No need to sort if only 1 event
+			  if(events_.count() == 1)
+				  return;
+
+			  Event* entryEvent;
+			  foreach_list_mutable(events_.list(), entryEvent, entry,
+					  preventry) {
+				  if(*event < *entryEvent) {
+					  events_.unlink(event);
+					  events_.insert_after(event,
+							  (Event*)(entryEvent->prev));
+					  return;
+				  }
+			  }
+
+			  // Entry is already at the tail of queue, keep it there
+		  }
+
+		  Event* pop(W64 cycle) {
+			  Event *event = events_.head();
+			  if(event && event->get_clock() <= cycle)
+				  return event;
+			  return NULL;
+		  }
+
+		  W64 next_clock() {
+			  Event *event = events_.head();
+			  return event ? event->get_clock() : (W64)-1;
+		  }
+
+		  bool empty() {
+			  return events_.empty();
+		  }
+
+		  int count() const {
+			  return events_.count();
+		  }
+
+		  void reset() {
+			  events_.reset();
+		  }
+
+		  void print(ostream& os) const {
+			  events_.print(os);
+		  }
+  };
+
+  /*
+   * EventWheel
+   *
+   * Two level hierarchical timing wheel with an overflow bucket.
+   *
+   * Level 0 has one bucket per cycle of the current 256 cycle block, level 1
+   * has one bucket per 256 cycle block of the current 64K cycle span and
+   * everything further out goes to a single overflow bucket. Each bucket is a
+   * FIFO chain of Event indices so scheduling is O(1).
+   *
+   * When the wheel enters a new block, the level 1 bucket of that block is
+   * moved into level 0 (and at a span boundary overflow events of the new
+   * span are moved down first). An event can only be placed directly into a
+   * bucket once the wheel has entered that bucket's range, which is after all
+   * earlier scheduled events for that range have been moved in. So events
+   * with the same clock always come out in the order they were scheduled,
+   * exactly as with EventList.
+   *
+   * After pop(cycle) the wheel has moved past 'cycle', but caches and cores
+   * clocked later in the same cycle can still schedule events with a clock
+   * of 'cycle' or less. EventList sorts those ahead of everything scheduled
+   * for later clocks, so they are kept in a separate 'late' chain sorted by
+   * clock that is drained before any bucket.
+   */
+  template <int SIZE>
+  class EventWheel
+  {
+	  private:
+		  static const int LEVEL0_BITS = 8;
+		  static const int LEVEL1_BITS = 8;
+		  static const int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+		  static const int LEVEL1_SIZE = 1 << LEVEL1_BITS;
+		  static const W64 LEVEL0_MASK = LEVEL0_SIZE - 1;
+		  static const W64 LEVEL1_MASK = LEVEL1_SIZE - 1;
+		  static const W64 SPAN_MASK = (1ULL << (LEVEL0_BITS + LEVEL1_BITS)) - 1;
+
+		  struct Bucket {
+			  int head;
+			  int tail;
+
+			  void reset() {
+				  head = -1;
+				  tail = -1;
+			  }
+		  };
+
+		  FixStateList<Event, SIZE> events_;
+
+		  Bucket level0_[LEVEL0_SIZE];
+		  Bucket level1_[LEVEL1_SIZE];
+		  Bucket overflow_;
+		  Bucket late_;
+
+		  int level0Count_;
+		  int level1Count_;
+		  int count_;
+
+		  /* Next cycle whose level 0 bucket has not been drained */
+		  W64 now_;
+
+		  void append(Bucket &bucket, Event *event) {
+			  event->set_next(-1);
+			  if(bucket.head < 0)
+				  bucket.head = event->idx;
+			  else
+				  events_[bucket.tail].set_next(event->idx);
+			  bucket.tail = event->idx;
+		  }
+
+		  Event* remove_head(Bucket &bucket) {
+			  Event *event = &events_[bucket.head];
+			  bucket.head = event->get_next();
+			  if(bucket.head < 0)
+				  bucket.tail = -1;
+			  event->set_next(-1);
+			  return event;
+		  }
+
+		  /* Insert into late chain after all events with same or lower clock */
+		  void place_late(Event *event) {
+			  int prev = -1;
+			  int next = late_.head;
+
+			  while(next >= 0 &&
+					  events_[next].get_clock() <= event->get_clock()) {
+				  prev = next;
+				  next = events_[next].get_next();
+			  }
+
+			  event->set_next(next);
+			  if(prev < 0)
+				  late_.head = event->idx;
+			  else
+				  events_[prev].set_next(event->idx);
+			  if(next < 0)
+				  late_.tail = event->idx;
+		  }
+
+		  /* Event clock must not be before now_ */
+		  void place(Event *event) {
+			  W64 clock = event->get_clock();
+
+			  if((clock >> LEVEL0_BITS) == (now_ >> LEVEL0_BITS)) {
+				  append(level0_[clock & LEVEL0_MASK], event);
+				  level0Count_++;
+			  } else if((clock & ~SPAN_MASK) == (now_ & ~SPAN_MASK)) {
+				  append(level1_[(clock >> LEVEL0_BITS) & LEVEL1_MASK], event);
+				  level1Count_++;
+			  } else {
+				  append(overflow_, event);
+			  }
+		  }
+
+		  /* Called when now_ enters a new level 0 block */
+		  void cascade() {
+			  if((now_ & SPAN_MASK) == 0 && overflow_.head >= 0) {
+				  Bucket pending = overflow_;
+				  overflow_.reset();
+				  while(pending.head >= 0)
+					  place(remove_head(pending));
+			  }
+
+			  Bucket &bucket = level1_[(now_ >> LEVEL0_BITS) & LEVEL1_MASK];
+			  while(bucket.head >= 0) {
+				  level1Count_--;
+				  place(remove_head(bucket));
+			  }
+		  }
+
+	  public:
+		  EventWheel() {
+			  now_ = 0;
+			  reset_buckets();
+		  }
+
+		  Event* alloc() {
+			  return events_.alloc();
+		  }
+
+		  void free(Event *event) {
+			  events_.free(event);
+		  }
+
+		  void schedule(Event *event) {
+			  if(event->get_clock() < now_)
+				  place_late(event);
+			  else
+				  place(event);
+			  count_++;
+		  }
+
+		  Event* pop(W64 cycle) {
+			  if(count_ == 0) {
+				  now_ = max(now_, cycle + 1);
+				  return NULL;
+			  }
+
+			  /* Late events have a clock before now_, so before all buckets */
+			  if(late_.head >= 0 &&
+					  events_[late_.head].get_clock() <= cycle) {
+				  count_--;
+				  return remove_head(late_);
+			  }
+
+			  while(now_ <= cycle) {
+				  Bucket &bucket = level0_[now_ & LEVEL0_MASK];
+				  if(bucket.head >= 0) {
+					  level0Count_--;
+					  count_--;
+					  return remove_head(bucket);
+				  }
+
+				  /* Skip over empty blocks and spans without walking them */
+				  if(level0Count_ == 0) {
+					  W64 last = (level1Count_ == 0) ? (now_ | SPAN_MASK) :
+						  (now_ | LEVEL0_MASK);
+					  now_ = min(last, cycle);
+				  }
+
+				  now_++;
+				  if((now_ & LEVEL0_MASK) == 0)
+					  cascade();
+			  }
+
+			  return NULL;
+		  }
+
+		  /* Clock of earliest pending Event, only used when simulation is
+		   * idle so a walk over all pending events is fine */
+		  W64 next_clock() {
+			  W64 clock = (W64)-1;
+			  Event *event;
+			  foreach_list_mutable(events_.list(), event, entry, preventry) {
+				  clock = min(clock, event->get_clock());
+			  }
+			  return clock;
+		  }
+
+		  bool empty() {
+			  return count_ == 0;
+		  }
+
+		  int count() const {
+			  return count_;
+		  }
+
+		  void reset_buckets() {
+			  foreach(i, LEVEL0_SIZE) {
+				  level0_[i].reset();
+			  }
+			  foreach(i, LEVEL1_SIZE) {
+				  level1_[i].reset();
+			  }
+			  overflow_.reset();
+			  late_.reset();
+			  level0Count_ = 0;
+			  level1Count_ = 0;
+			  count_ = 0;
+		  }
+
+		  void reset() {
+			  events_.reset();
+			  reset_buckets();
+		  }
+
+		  void print(ostream& os) const {
+			  os << "EventWheel now[", now_, "] level0[", level0Count_,
+				 "] level1[", level1Count_, "] total[", count_, "]", endl;
+			  events_.print(os);
+		  }
+  };
+
+  template <int SIZE>
+  static inline ostream& operator <<(ostream& os, const EventList<SIZE>& queue)
+  {
+	  queue.print(os);
+	  return os;
+  }
+
+  template <int SIZE>
+  static inline ostream& operator <<(ostream& os, const EventWheel<SIZE>& queue)
+  {
+	  queue.print(os);
+	  return os;
+  }
+
+};
+
+#endif // EVENT_QUEUE_H
@@ -22,6 +22,10 @@ static W64 get_line_addr(W64 addr)
 /**
  * @brief Reset the directory entry
  */
+const char* sharer_encoding_names[NUM_SHARER_ENCODINGS] = {
+    "full", "limited", "coarse"
+};
+
 void DirectoryEntry::reset()
 {
     present.reset();
@@ -29,6 +33,7 @@ void DirectoryEntry::reset()
     owner = -1;
     dirty = 0;
 	locked = 0;
+    lastUse = 0;
 }
 
 void DirectoryEntry::init(W64 tag_)
@@ -40,64 +45,303 @@ void DirectoryEntry::init(W64 tag_)
     present.reset();
 }
 
-Directory::Directory()
+Directory::Directory(int sets, int ways, int latency, int ports,
+        SharerEncoding encoding, int pointers, int groupSize)
+    : sets_(sets)
+      , ways_(ways)
+      , latency_(latency)
+      , interleave_(1)
+      , encoding_(encoding)
+      , pointers_(pointers)
+      , groupSize_(groupSize)
+      , useCounter_(0)
 {
-    entries = new base_t();
+    entries_ = new DirectoryEntry[sets_ * ways_];
+
+    portFree_.resize(ports);
+    foreach (i, ports)
+        portFree_[i] = 0;
 }
 
-DirectoryEntry* Directory::insert(MemoryRequest *req, W64& old_tag)
+Directory::~Directory()
 {
-    W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->select(phys_addr, old_tag);
+    delete [] entries_;
+}
 
-    return entry;
+/**
+ * @brief Get the first entry of the set of given address
+ *
+ * Lines are interleaved across banks so the bank index bits are skipped
+ * when selecting the set.
+ */
+DirectoryEntry* Directory::get_set(W64 addr)
+{
+    W64 set = (get_line_addr(addr) / interleave_) % sets_;
+    return &entries_[set * ways_];
 }
 
 DirectoryEntry* Directory::probe(MemoryRequest *req)
 {
-    W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->probe(phys_addr);
+    W64 tag = tag_of(req->get_physical_address());
+    DirectoryEntry *set = get_set(tag);
 
-    return entry;
+    foreach (i, ways_) {
+        if (set[i].tag == tag) {
+            set[i].lastUse = ++useCounter_;
+            return &set[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Select an entry for given request
+ *
+ * @param req Memory request to insert
+ * @param old_tag Set to tag of the replaced entry, INVALID if none
+ *
+ * @return Selected entry, its content is not reset
+ *
+ * Victim is an invalid entry if any, else an entry without sharers,
+ * else the least recently used one. Locked entries are only replaced
+ * when all entries of the set are locked.
+ */
+DirectoryEntry* Directory::insert(MemoryRequest *req, W64& old_tag)
+{
+    W64 tag = tag_of(req->get_physical_address());
+    DirectoryEntry *set = get_set(tag);
+    DirectoryEntry *victim = NULL;
+
+    foreach (i, ways_) {
+        DirectoryEntry *entry = &set[i];
+
+        if (entry->tag == tag) {
+            victim = entry;
+            break;
+        }
+
+        if (entry->tag == (W64)-1) {
+            if (!victim || victim->tag != (W64)-1)
+                victim = entry;
+            continue;
+        }
+
+        if (!victim) {
+            victim = entry;
+            continue;
+        }
+
+        if (victim->tag == (W64)-1)
+            continue;
+
+        /* Prefer unlocked, then no sharers, then least recently used */
+        if (entry->locked != victim->locked) {
+            if (!entry->locked) victim = entry;
+            continue;
+        }
+
+        if (entry->present.iszero() != victim->present.iszero()) {
+            if (entry->present.iszero()) victim = entry;
+            continue;
+        }
+
+        if (entry->lastUse < victim->lastUse)
+            victim = entry;
+    }
+
+    old_tag = victim->tag;
+    if (victim->tag == (W64)-1)
+        old_tag = InvalidTag<W64>::INVALID;
+    victim->lastUse = ++useCounter_;
+
+    return victim;
 }
 
 int Directory::invalidate(MemoryRequest *req)
 {
-    return entries->invalidate(req->get_physical_address());
+    DirectoryEntry *entry = probe(req);
+
+    if (!entry)
+        return 0;
+
+    entry->reset();
+    return 1;
 }
 
-Directory* Directory::dir = NULL;
-FixStateList<DirContBufferEntry, REQ_Q_SIZE>*
-DirectoryController::pendingRequests_ = NULL;
+/**
+ * @brief Reserve a bank port for one access
+ *
+ * @param cycle Current cycle
+ * @param stall Set to the cycles waited for a free port
+ *
+ * @return Cycles until the access is complete
+ *
+ * Ports are pipelined, each one starts a new access every cycle.
+ */
+int Directory::access(W64 cycle, int& stall)
+{
+    int port = 0;
+
+    foreach (i, portFree_.count()) {
+        if (portFree_[i] < portFree_[port])
+            port = i;
+    }
+
+    W64 start = max(cycle, portFree_[port]);
+    portFree_[port] = start + 1;
+    stall = start - cycle;
+
+    return stall + latency_;
+}
 
 /**
- * @brief Get the global directory
+ * @brief Find the caches that must be invalidated for an entry
  *
- * @return reference to global Directory
+ * @param entry Directory entry with exact sharers
+ * @param caches Bitmap of all caches connected to directory
+ * @param targets Set to caches the encoding can't rule out
+ *
+ * @return true if a limited pointer entry has overflowed
  */
-Directory& Directory::get_directory()
+bool Directory::get_targets(const DirectoryEntry *entry,
+        const bitvec<NUM_SIM_CORES>& caches,
+        bitvec<NUM_SIM_CORES>& targets) const
 {
-    if (dir == NULL) {
-        dir = new Directory();
-        DirectoryController::pendingRequests_ =
-            new FixStateList<DirContBufferEntry, REQ_Q_SIZE>();
+    targets = entry->present;
+
+    switch (encoding_) {
+        case SHARERS_LIMITED:
+            if ((int)entry->present.popcount() > pointers_) {
+                targets = caches;
+                return true;
+            }
+            break;
+        case SHARERS_COARSE:
+            foreach (i, NUM_SIM_CORES) {
+                if (entry->present.test(i)) {
+                    int group = i - (i % groupSize_);
+                    for (int j = group; j < group + groupSize_ &&
+                            j < NUM_SIM_CORES; j++) {
+                        if (caches.test(j))
+                            targets.set(j);
+                    }
+                }
+            }
+            break;
+        default:
+            break;
     }
 
-    return *dir;
+    return false;
+}
+
+/**
+ * @brief Number of sharer bits in each entry for given cache count
+ */
+int Directory::entry_bits(int cacheCount) const
+{
+    int idBits = (cacheCount > 1) ? msbindex64(cacheCount - 1) + 1 : 1;
+
+    switch (encoding_) {
+        case SHARERS_LIMITED:
+            return pointers_ * idBits + 1;
+        case SHARERS_COARSE:
+            return (cacheCount + groupSize_ - 1) / groupSize_;
+        default:
+            return cacheCount;
+    }
 }
 
+FixStateList<DirContBufferEntry, REQ_Q_SIZE>*
+DirectoryController::pendingRequests_ = NULL;
+
 Controller* DirectoryController::controllers[NUM_SIM_CORES] = {0};
 Controller* DirectoryController::lower_cont = NULL;
 
 DirectoryController* DirectoryController::dir_controllers[NUM_SIM_CORES] = {0};
 
+DirectoryController* DirectoryController::homes[NUM_SIM_CORES] = {0};
+int DirectoryController::home_count = 0;
+bitvec<NUM_SIM_CORES> DirectoryController::cache_map;
+
+static void dir_config_error(const char *name, const char *msg)
+{
+    stringbuf err;
+    err << "::ERROR::Directory Controller '" << name << "': " << msg << endl;
+    ptl_logfile << err;
+    cerr << err;
+    assert(0);
+}
+
+/**
+ * @brief Create directory bank from machine config options
+ */
+Directory* DirectoryController::create_directory(const char *name,
+        BaseMachine &machine)
+{
+    int sets, ways, latency, ports, pointers, groupSize;
+    stringbuf sharers;
+    SharerEncoding encoding = NUM_SHARER_ENCODINGS;
+
+    if (!machine.get_option(name, "sets", sets))
+        sets = DIR_SET;
+    if (!machine.get_option(name, "ways", ways))
+        ways = DIR_WAY;
+    if (!machine.get_option(name, "latency", latency))
+        latency = DIR_ACCESS_DELAY;
+    if (!machine.get_option(name, "ports", ports))
+        ports = DIR_PORTS;
+    if (!machine.get_option(name, "sharers", sharers))
+        sharers << sharer_encoding_names[SHARERS_FULL];
+    if (!machine.get_option(name, "sharer_pointers", pointers))
+        pointers = 4;
+    if (!machine.get_option(name, "sharer_group", groupSize))
+        groupSize = 4;
+
+    foreach (i, NUM_SHARER_ENCODINGS) {
+        if (strequal(sharers.buf, sharer_encoding_names[i]))
+            encoding = (SharerEncoding)i;
+    }
+
+    if (encoding == NUM_SHARER_ENCODINGS)
+        dir_config_error(name, "sharers must be full, limited or coarse");
+    if (sets <= 0 || ways <= 0)
+        dir_config_error(name, "sets and ways must be positive");
+    if (latency < 0 || ports <= 0)
+        dir_config_error(name, "ports must be positive");
+    if (pointers <= 0 || groupSize <= 0)
+        dir_config_error(name,
+                "sharer_pointers and sharer_group must be positive");
+
+    return new Directory(sets, ways, latency, ports, encoding, pointers,
+            groupSize);
+}
+
 DirectoryController::DirectoryController(W8 idx, const char *name,
         MemoryHierarchy *memoryHierarchy)
     : Controller(idx, name, memoryHierarchy)
-      , dir_(Directory::get_directory())
+      , interconn_(NULL)
+      , new_stats(name, &memoryHierarchy->get_machine())
 {
     memoryHierarchy_->add_cache_mem_controller(this);
 
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    dir_ = create_directory(name, machine);
+
+    if (!machine.get_option(name, "remote_latency", remoteLatency_))
+        remoteLatency_ = 0;
+
+    if (!pendingRequests_) {
+        pendingRequests_ = new FixStateList<DirContBufferEntry,
+                         REQ_Q_SIZE>();
+    }
+
+    /* This controller is home of every home_count'th line */
+    assert(home_count < NUM_SIM_CORES);
+    homes[home_count++] = this;
+
     req_handlers[MEMORY_OP_READ]   = &DirectoryController::
         handle_read_miss;
     req_handlers[MEMORY_OP_WRITE]  = &DirectoryController::
@@ -176,6 +420,7 @@ void DirectoryController::register_interconnect(Interconnect *interconn,
                         assert(cont);
                         controllers[(*cont)->idx]     = (*cont);
                         dir_controllers[(*cont)->idx] = this;
+                        cache_map.set((*cont)->idx);
                         break;
                     case INTERCONN_TYPE_UPPER2:
                     case INTERCONN_TYPE_I:
@@ -191,6 +436,41 @@ void DirectoryController::register_interconnect(Interconnect *interconn,
     }
 
     assert(lower_cont);
+
+    /* All directory controllers are created by now */
+    dir_->set_interleave(home_count);
+}
+
+/**
+ * @brief Get the directory controller that is home of requested line
+ */
+DirectoryController* DirectoryController::get_home(MemoryRequest *req)
+{
+    return homes[get_line_addr(req->get_physical_address()) % home_count];
+}
+
+/**
+ * @brief Delay to access the home directory bank of a request
+ *
+ * Includes the wait for a free port at the home bank and the latency to
+ * reach a home node other than this controller.
+ */
+int DirectoryController::access_delay(MemoryRequest *req)
+{
+    DirectoryController *home = get_home(req);
+    bool kernel = req->is_kernel();
+    int stall;
+    int delay = home->dir_->access(sim_cycle, stall);
+
+    N_STAT_UPDATE(home->new_stats.access, ++, kernel);
+    N_STAT_UPDATE(home->new_stats.port_stall, += stall, kernel);
+
+    if (home != this) {
+        N_STAT_UPDATE(home->new_stats.remote_access, ++, kernel);
+        delay += remoteLatency_;
+    }
+
+    return delay;
 }
 
 bool DirectoryController::handle_read_miss(Message *msg)
@@ -307,6 +587,8 @@ bool DirectoryController::read_miss_cb(void *arg)
     assert(dir_entry);
     queueEntry->entry = dir_entry;
 
+    int delay = access_delay(queueEntry->request);
+
     memdebug("Read miss handling in Directory with entry: " <<
             *dir_entry << endl);
 
@@ -318,12 +600,10 @@ bool DirectoryController::read_miss_cb(void *arg)
 
         if (sig_dir == this && dir_entry->owner != queueEntry->cont->idx) {
             queueEntry->responder = controllers[dir_entry->owner];
-            marss_add_event(&send_response, DIR_ACCESS_DELAY,
-                    queueEntry);
+            marss_add_event(&send_response, delay, queueEntry);
         } else {
             queueEntry->responder = lower_cont;
-            marss_add_event(&sig_dir->send_update,
-                    DIR_ACCESS_DELAY, queueEntry);
+            marss_add_event(&sig_dir->send_update, delay, queueEntry);
         }
 
         return true;
@@ -342,8 +622,7 @@ bool DirectoryController::read_miss_cb(void *arg)
         queueEntry->responder = lower_cont;
 
     // Send response back
-    marss_add_event(&send_response, DIR_ACCESS_DELAY,
-            queueEntry);
+    marss_add_event(&send_response, delay, queueEntry);
 
     return true;
 }
@@ -365,6 +644,8 @@ bool DirectoryController::write_miss_cb(void *arg)
     assert(dir_entry);
     queueEntry->entry = dir_entry;
 
+    int delay = access_delay(queueEntry->request);
+
     memdebug("Write miss handling in Directory with entry: " <<
             *dir_entry << endl);
 
@@ -377,8 +658,7 @@ bool DirectoryController::write_miss_cb(void *arg)
         // Its not present in requested cache
         queueEntry->responder = lower_cont;
         sig_dir               = dir_controllers[dir_entry->owner];
-        marss_add_event(&sig_dir->send_evict,
-                DIR_ACCESS_DELAY, queueEntry);
+        marss_add_event(&sig_dir->send_evict, delay, queueEntry);
         return true;
     } else {
         // Check if it was present in only requested cache
@@ -388,8 +668,7 @@ bool DirectoryController::write_miss_cb(void *arg)
             // Send evict msg to other caches
             queueEntry->responder = lower_cont;
             sig_dir               = dir_controllers[dir_entry->owner];
-            marss_add_event(&sig_dir->send_evict,
-                    DIR_ACCESS_DELAY, queueEntry);
+            marss_add_event(&sig_dir->send_evict, delay, queueEntry);
             return true;
         }
 
@@ -402,8 +681,7 @@ bool DirectoryController::write_miss_cb(void *arg)
         queueEntry->hasData = 1;
     }
 
-    marss_add_event(&send_response,
-            DIR_ACCESS_DELAY, queueEntry);
+    marss_add_event(&send_response, delay, queueEntry);
 
     return true;
 }
@@ -565,9 +843,14 @@ bool DirectoryController::send_evict_cb(void *arg)
     if (queueEntry->annuled)
         return true;
 
+    /* Caches the sharer encoding of home bank can't rule out */
+    DirectoryController *home = get_home(queueEntry->request);
+    bitvec<NUM_SIM_CORES> targets;
+    bool overflow = home->dir_->get_targets(queueEntry->entry, cache_map,
+            targets);
+
     /* Check if we have enough free entries in queue */
-    if (pendingRequests_->remaining() <
-            (int)queueEntry->entry->present.popcount()) {
+    if (pendingRequests_->remaining() < (int)targets.popcount()) {
         marss_add_event(&send_evict, 1, queueEntry);
         return true;
     }
@@ -583,10 +866,21 @@ bool DirectoryController::send_evict_cb(void *arg)
 
 	queueEntry->entry->locked = 1;
 
-    /* Now for each cached entry, send evict message to that
+    bool kernel = queueEntry->request->is_kernel();
+
+    if (overflow)
+        N_STAT_UPDATE(home->new_stats.overflow, ++, kernel);
+
+    /* Now for each target cache, send evict message to that
      * controller */
     foreach (i, NUM_SIM_CORES) {
-        if (!queueEntry->entry->present.test(i))
+        if (!targets.test(i))
+            continue;
+
+        bool sharer = queueEntry->entry->present.test(i);
+
+        /* Requesting cache is always known to the directory */
+        if (!sharer && queueEntry->cont && queueEntry->cont->idx == i)
             continue;
 
         DirContBufferEntry *newEntry = pendingRequests_->alloc();
@@ -598,8 +892,25 @@ bool DirectoryController::send_evict_cb(void *arg)
         newEntry->request->init(queueEntry->request);
         newEntry->request->incRefCounter();
         newEntry->request->set_op_type(MEMORY_OP_EVICT);
-        newEntry->entry  = queueEntry->entry;
-        newEntry->origin = (queueEntry->cont) ? queueEntry->idx : -1;
+
+        if (sharer) {
+            newEntry->entry  = queueEntry->entry;
+            newEntry->origin = (queueEntry->cont) ? queueEntry->idx : -1;
+        } else {
+            /* Cache doesn't have the line, so nothing waits for
+             * this evict to complete */
+            newEntry->free_on_success = 1;
+            N_STAT_UPDATE(home->new_stats.invalidations.imprecise, ++,
+                    kernel);
+        }
+
+        /* Directory initiated evictions have no requesting cache */
+        if (queueEntry->cont) {
+            N_STAT_UPDATE(home->new_stats.invalidations.write, ++, kernel);
+        } else {
+            N_STAT_UPDATE(home->new_stats.invalidations.eviction, ++,
+                    kernel);
+        }
 
         ADD_HISTORY_ADD(newEntry->request);
 
@@ -781,10 +1092,12 @@ DirContBufferEntry* DirectoryController::find_dependent_enry(
 DirectoryEntry* DirectoryController::get_directory_entry(
         MemoryRequest *req, bool must_present)
 {
-    DirectoryEntry *entry = dir_.probe(req);
+    DirectoryController *home = get_home(req);
+    Directory *dir = home->dir_;
+    DirectoryEntry *entry = dir->probe(req);
 
     if (!entry && must_present) {
-        W64 tag_t = dir_.tag_of(req->get_physical_address());
+        W64 tag_t = dir->tag_of(req->get_physical_address());
         foreach (i, REQ_Q_SIZE) {
             DirectoryEntry* d_entry = &dummy_entries[i];
             if (d_entry->tag == tag_t) {
@@ -797,13 +1110,16 @@ DirectoryEntry* DirectoryController::get_directory_entry(
 
     if (!entry) {
         W64 old_tag = InvalidTag<W64>::INVALID;
-        entry = dir_.insert(req, old_tag);
+        entry = dir->insert(req, old_tag);
         assert(entry);
 
         /* If we are removing any entry with cached line then we
          * must send evict signal to those caches. */
         if ((old_tag != InvalidTag<W64>::INVALID && old_tag != (W64)-1) &&
                 entry->present.nonzero()) {
+            N_STAT_UPDATE(home->new_stats.replacement, ++,
+                    req->is_kernel());
+
             DirContBufferEntry *newEntry = pendingRequests_->alloc();
 
             assert(newEntry);
@@ -831,7 +1147,7 @@ DirectoryEntry* DirectoryController::get_directory_entry(
             }
         }
 
-        entry->init(dir_.tag_of(req->get_physical_address()));
+        entry->init(dir->tag_of(req->get_physical_address()));
     }
 
     return entry;
@@ -965,10 +1281,19 @@ void DirectoryController::dump_configuration(YAML::Emitter &out) const
 	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
 
 	YAML_KEY_VAL(out, "type", "directory");
-	YAML_KEY_VAL(out, "size", DIR_SET * DIR_WAY);
+	YAML_KEY_VAL(out, "banks", home_count);
+	YAML_KEY_VAL(out, "size", dir_->get_sets() * dir_->get_ways());
 	YAML_KEY_VAL(out, "line_size", DIR_LINE_SIZE);
-	YAML_KEY_VAL(out, "sets", DIR_SET);
-	YAML_KEY_VAL(out, "ways", DIR_WAY);
+	YAML_KEY_VAL(out, "sets", dir_->get_sets());
+	YAML_KEY_VAL(out, "ways", dir_->get_ways());
+	YAML_KEY_VAL(out, "latency", dir_->get_latency());
+	YAML_KEY_VAL(out, "ports", dir_->get_ports());
+	YAML_KEY_VAL(out, "remote_latency", remoteLatency_);
+	YAML_KEY_VAL(out, "sharers",
+			sharer_encoding_names[dir_->get_encoding()]);
+	YAML_KEY_VAL(out, "sharer_pointers", dir_->get_pointers());
+	YAML_KEY_VAL(out, "sharer_group", dir_->get_group_size());
+	YAML_KEY_VAL(out, "sharer_bits", dir_->entry_bits(cache_map.popcount()));
 
 	out << YAML::EndMap;
 }
@@ -21,12 +21,24 @@
 
 using namespace Memory;
 
+/* Default geometry and timing of each directory bank */
 #define DIR_SET 4096
 #define DIR_WAY 16
 #define DIR_LINE_SIZE 64
 #define DIR_ACCESS_DELAY 10
+#define DIR_PORTS 2
 #define REQ_Q_SIZE 128
 
+/* Sharer encodings a directory entry can model */
+enum SharerEncoding {
+    SHARERS_FULL,       /* One presence bit per cache */
+    SHARERS_LIMITED,    /* Few pointers, broadcast on overflow (Dir_i_B) */
+    SHARERS_COARSE,     /* One bit per group of caches */
+    NUM_SHARER_ENCODINGS
+};
+
+extern const char* sharer_encoding_names[NUM_SHARER_ENCODINGS];
+
 /**
  * @brief A Directory entry containing information for one line
  */
@@ -36,6 +48,7 @@ struct DirectoryEntry {
     W64  tag;
     W8   owner;
 	bool locked;
+    W64  lastUse;
 
     DirectoryEntry() { reset(); }
     void reset();
@@ -54,38 +67,63 @@ static inline ostream& operator <<(ostream &os, const DirectoryEntry &e)
 }
 
 /**
- * @brief A Directory containing cacheline informations.
+ * @brief One bank of the sparse directory
  *
- * This is a singleton class so there is only one Global directory.
- * All directory controllers get access to this directory and should
- * simulate appropriate access delay. This directory is a set-assoc
- * structure. The size of the directory is statically set.
+ * Each directory controller owns one bank and lines are interleaved
+ * across the banks of all directory controllers (home nodes) by line
+ * address. A bank is a set-assoc structure with runtime size, a number
+ * of pipelined ports and an access latency.
  *
- * TODO:
- *	- Allow configuration options to dynamically set directory size.
- *	- Simulate limited port access
+ * Entries always keep exact sharers in 'present' because the protocol
+ * waits on them. The sharer encoding only decides which caches must be
+ * invalidated, so inexact encodings send extra invalidations to caches
+ * that do not have the line.
  */
 class Directory {
     private:
-        Directory();
-        static Directory* dir;
+        int sets_;
+        int ways_;
+        int latency_;
+        int interleave_;
+        SharerEncoding encoding_;
+        int pointers_;
+        int groupSize_;
 
-        typedef AssociativeArray<W64, DirectoryEntry, DIR_SET,
-                DIR_WAY, DIR_LINE_SIZE> base_t;
-        typedef FullyAssociativeArray<W64, DirectoryEntry, DIR_WAY,
-                NullAssociativeArrayStatisticsCollector<W64,
-                DirectoryEntry> > Set;
+        DirectoryEntry *entries_;
+        W64 useCounter_;
 
-        base_t* entries;
+        /* Cycle when each port is free again */
+        dynarray<W64> portFree_;
+
+        DirectoryEntry* get_set(W64 addr);
 
     public:
-        static Directory& get_directory();
+        Directory(int sets, int ways, int latency, int ports,
+                SharerEncoding encoding, int pointers, int groupSize);
+        ~Directory();
 
         DirectoryEntry *insert(MemoryRequest *req, W64&old_tag);
         DirectoryEntry *probe(MemoryRequest *req);
         int             invalidate(MemoryRequest *req);
 
-        W64 tag_of(W64 addr) { return base_t::tagof(addr); }
+        W64 tag_of(W64 addr) { return floor(addr, DIR_LINE_SIZE); }
+
+        /* Number of banks lines are interleaved across */
+        void set_interleave(int banks) { interleave_ = banks; }
+
+        int access(W64 cycle, int& stall);
+        bool get_targets(const DirectoryEntry *entry,
+                const bitvec<NUM_SIM_CORES>& caches,
+                bitvec<NUM_SIM_CORES>& targets) const;
+        int entry_bits(int cacheCount) const;
+
+        int get_sets() const { return sets_; }
+        int get_ways() const { return ways_; }
+        int get_latency() const { return latency_; }
+        int get_ports() const { return portFree_.count(); }
+        SharerEncoding get_encoding() const { return encoding_; }
+        int get_pointers() const { return pointers_; }
+        int get_group_size() const { return groupSize_; }
 };
 
 struct DirContBufferEntry : public FixStateListObject
@@ -151,12 +189,17 @@ static inline ostream& operator << (ostream& os, const
  * the global directory then in case of cache-eviction, the initiating
  * controller can send 'evict' message to all other controllers.
  * In such scenarios, each controller should simulate some delay.
+ *
+ * Each controller is the home node of one directory bank. Accesses to a
+ * line owned by another home node add 'remote_latency' cycles.
  */
 class DirectoryController : public Controller {
 
     private:
-        Directory    &dir_;
-        Interconnect *interconn_;
+        Directory     *dir_;
+        Interconnect  *interconn_;
+        int            remoteLatency_;
+        DirectoryStats new_stats;
 
         DirectoryEntry dummy_entries[REQ_Q_SIZE];
 
@@ -177,6 +220,16 @@ class DirectoryController : public Controller {
         static Controller   *lower_cont;
 
         static DirectoryController *dir_controllers[NUM_SIM_CORES];
+
+        /* Home node of each directory bank and the cache bitmap */
+        static DirectoryController *homes[NUM_SIM_CORES];
+        static int                  home_count;
+        static bitvec<NUM_SIM_CORES> cache_map;
+
+        static Directory* create_directory(const char *name,
+                BaseMachine &machine);
+        DirectoryController* get_home(MemoryRequest *req);
+        int access_delay(MemoryRequest *req);
     public:
         DirectoryController(W8 idx, const char *name,
                 MemoryHierarchy *memoryHierachy);
@@ -45,6 +45,7 @@ class Interconnect
 {
 	private:
         stringbuf name_;
+        W16 historyId_;
 		Signal controller_request_;
 
 	public:
@@ -54,6 +55,7 @@ class Interconnect
 			, memoryHierarchy_(memoryHierarchy)
 		{
 			name_ << name;
+			historyId_ = MemoryRequest::register_history_name(name);
 			controller_request_.connect(signal_mem_ptr(*this,
 						&Interconnect::controller_request_cb));
 		}
@@ -80,6 +82,11 @@ class Interconnect
 		char* get_name() const {
 			return name_.buf;
 		}
+
+		/* Id used in MemoryRequest history records */
+		W16 get_history_id() const {
+			return historyId_;
+		}
 };
 
 static inline ostream& operator << (ostream& os, const Interconnect&
@@ -0,0 +1,378 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <memTrace.h>
+
+#include <ptlsim.h>
+
+#include <zlib.h>
+
+static const char mem_trace_magic[8] = {'M', 'A', 'R', 'S', 'S', 'M', 'T', 'R'};
+
+static inline W64 zigzag(W64 delta)
+{
+    return (delta << 1) ^ W64(W64s(delta) >> 63);
+}
+
+static inline W64 unzigzag(W64 value)
+{
+    return (value >> 1) ^ -(value & 1);
+}
+
+MemTraceEncoder::MemTraceEncoder(W32 size_)
+    : size(max(size_, W32(MEM_TRACE_MAX_RECORD_SIZE)))
+{
+    buf = new W8[size];
+    reset();
+}
+
+MemTraceEncoder::~MemTraceEncoder()
+{
+    delete[] buf;
+}
+
+void MemTraceEncoder::reset()
+{
+    used = 0;
+    count = 0;
+    last.reset();
+}
+
+void MemTraceEncoder::put(W64 value)
+{
+    while(value >= 0x80) {
+        buf[used++] = W8(value | 0x80);
+        value >>= 7;
+    }
+    buf[used++] = W8(value);
+}
+
+void MemTraceEncoder::add(const MemTraceRecord& rec)
+{
+    assert(!full());
+
+    W8 flags = rec.type & MEM_TRACE_OP_MASK;
+    if(rec.is_icache) flags |= MEM_TRACE_ICACHE;
+    if(rec.kernel) flags |= MEM_TRACE_KERNEL;
+
+    bool new_id = (count == 0) || (rec.coreid != last.coreid) ||
+        (rec.threadid != last.threadid);
+    if(new_id) flags |= MEM_TRACE_NEW_ID;
+
+    buf[used++] = flags;
+
+    if(new_id) {
+        buf[used++] = rec.coreid;
+        buf[used++] = rec.threadid;
+    }
+
+    put(rec.cycle - last.cycle);
+    put(zigzag(rec.physaddr - last.physaddr));
+    put(zigzag(rec.rip - last.rip));
+
+    last = rec;
+    count++;
+}
+
+void MemTraceDecoder::reset(const W8 *buf_, W32 size_)
+{
+    buf = buf_;
+    size = size_;
+    pos = 0;
+    last.reset();
+}
+
+bool MemTraceDecoder::get(W64& value)
+{
+    value = 0;
+
+    for(int shift = 0; shift < 64; shift += 7) {
+        if unlikely (pos >= size) return false;
+
+        W8 b = buf[pos++];
+        value |= W64(b & 0x7f) << shift;
+
+        if(!(b & 0x80)) return true;
+    }
+
+    return false;
+}
+
+bool MemTraceDecoder::next(MemTraceRecord& rec)
+{
+    if(pos >= size) return false;
+
+    W8 flags = buf[pos++];
+
+    rec = last;
+    rec.type = flags & MEM_TRACE_OP_MASK;
+    rec.is_icache = (flags & MEM_TRACE_ICACHE) != 0;
+    rec.kernel = (flags & MEM_TRACE_KERNEL) != 0;
+
+    if(flags & MEM_TRACE_NEW_ID) {
+        if unlikely (pos + 2 > size) return false;
+        rec.coreid = buf[pos++];
+        rec.threadid = buf[pos++];
+    }
+
+    W64 cycles, physaddr, rip;
+    if unlikely (!get(cycles) || !get(physaddr) || !get(rip))
+        return false;
+
+    rec.cycle = last.cycle + cycles;
+    rec.physaddr = last.physaddr + unzigzag(physaddr);
+    rec.rip = last.rip + unzigzag(rip);
+
+    last = rec;
+    return true;
+}
+
+MemTraceWriter::MemTraceWriter(const char *filename, bool compress_,
+        W32 block_size, bool background)
+    : compress(compress_)
+      , pending(NULL)
+      , started(false)
+      , stopping(false)
+      , records(0)
+      , blocks_written(0)
+      , bytes(0)
+      , stalls(0)
+      , stall_ticks(0)
+{
+    blocks[0] = new MemTraceEncoder(block_size);
+    blocks[1] = new MemTraceEncoder(block_size);
+    current = blocks[0];
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&pending_cond, NULL);
+    pthread_cond_init(&free_cond, NULL);
+
+    os.open(filename, std::ios::binary | std::ios::trunc);
+    if(!os.is_open()) return;
+
+    MemTraceFileHeader header;
+    setzero(header);
+    memcpy(header.magic, mem_trace_magic, sizeof(mem_trace_magic));
+    header.format = MEM_TRACE_FORMAT;
+    header.flags = compress ? MEM_TRACE_COMPRESSED : 0;
+    header.core_freq_hz = config.core_freq_hz;
+
+    os.write((const char*)&header, sizeof(header));
+    bytes += sizeof(header);
+
+    if(background) {
+        started = (pthread_create(&thread, NULL, writer_thread, this) == 0);
+
+        /* Fall back to writing on simulation thread */
+        if(!started)
+            ptl_logfile << "Can't start memory trace writer thread, ",
+                        "writing trace in simulation thread", endl;
+    }
+}
+
+MemTraceWriter::~MemTraceWriter()
+{
+    close();
+
+    delete blocks[0];
+    delete blocks[1];
+
+    pthread_cond_destroy(&free_cond);
+    pthread_cond_destroy(&pending_cond);
+    pthread_mutex_destroy(&lock);
+}
+
+void MemTraceWriter::write_block(MemTraceEncoder *block)
+{
+    if(!block->get_count() || !os.is_open()) {
+        block->reset();
+        return;
+    }
+
+    MemTraceBlockHeader bh;
+    bh.record_count = block->get_count();
+    bh.raw_size = block->get_size();
+    bh.stored_size = block->get_size();
+    bh.pad = 0;
+
+    const W8 *data = block->data();
+    W8 *packed = NULL;
+
+    if(compress) {
+        uLongf packed_size = compressBound(bh.raw_size);
+        packed = new W8[packed_size];
+
+        if(compress2(packed, &packed_size, data, bh.raw_size, 1) == Z_OK &&
+                packed_size < bh.raw_size) {
+            bh.stored_size = packed_size;
+            data = packed;
+        }
+    }
+
+    os.write((const char*)&bh, sizeof(bh));
+    os.write((const char*)data, bh.stored_size);
+
+    if(packed) delete[] packed;
+
+    blocks_written++;
+    bytes += sizeof(bh) + bh.stored_size;
+
+    block->reset();
+}
+
+/**
+ * @brief Hand current block to the writer and switch to the other one
+ */
+void MemTraceWriter::submit()
+{
+    if(!started) {
+        write_block(current);
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    if unlikely (pending) {
+        W64 start = rdtsc();
+        stalls++;
+
+        while(pending)
+            pthread_cond_wait(&free_cond, &lock);
+
+        stall_ticks += rdtsc() - start;
+    }
+
+    pending = current;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&lock);
+
+    current = (current == blocks[0]) ? blocks[1] : blocks[0];
+}
+
+void* MemTraceWriter::writer_thread(void *arg)
+{
+    ((MemTraceWriter*)arg)->run();
+    return NULL;
+}
+
+void MemTraceWriter::run()
+{
+    pthread_mutex_lock(&lock);
+
+    for(;;) {
+        while(!pending && !stopping)
+            pthread_cond_wait(&pending_cond, &lock);
+
+        if(!pending)
+            break;
+
+        MemTraceEncoder *block = pending;
+
+        pthread_mutex_unlock(&lock);
+
+        write_block(block);
+
+        pthread_mutex_lock(&lock);
+
+        pending = NULL;
+        pthread_cond_broadcast(&free_cond);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+void MemTraceWriter::close()
+{
+    if(current->get_count())
+        submit();
+
+    if(started) {
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_signal(&pending_cond);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(thread, NULL);
+        started = false;
+    }
+
+    if(os.is_open())
+        os.close();
+}
+
+ostream& MemTraceWriter::print_summary(ostream &out) const
+{
+    out << "Memory trace: ", records, " records in ", blocks_written,
+       " blocks, ", bytes, " bytes, ", stalls, " writer stalls (",
+       W64(ticks_to_native_seconds(stall_ticks) * 1000), " ms)", endl;
+    return out;
+}
+
+MemTraceReader::MemTraceReader()
+    : block_left(0)
+{
+    setzero(header);
+}
+
+bool MemTraceReader::open(const char *filename)
+{
+    is.open(filename, std::ios::binary);
+    if(!is.is_open()) return false;
+
+    is.read((char*)&header, sizeof(header));
+
+    if(!is || memcmp(header.magic, mem_trace_magic,
+                sizeof(mem_trace_magic)) != 0 ||
+            header.format != MEM_TRACE_FORMAT) {
+        is.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool MemTraceReader::read_block()
+{
+    MemTraceBlockHeader bh;
+
+    is.read((char*)&bh, sizeof(bh));
+    if(!is) return false;
+
+    stored.resize(bh.stored_size);
+    is.read((char*)stored.data, bh.stored_size);
+    if(!is) return false;
+
+    if(bh.stored_size == bh.raw_size) {
+        decoder.reset(stored.data, bh.raw_size);
+    } else {
+        uLongf raw_size = bh.raw_size;
+        raw.resize(bh.raw_size);
+
+        if(uncompress(raw.data, &raw_size, stored.data,
+                    bh.stored_size) != Z_OK || raw_size != bh.raw_size)
+            return false;
+
+        decoder.reset(raw.data, bh.raw_size);
+    }
+
+    block_left = bh.record_count;
+    return true;
+}
+
+bool MemTraceReader::next(MemTraceRecord& rec)
+{
+    if(!is.is_open()) return false;
+
+    while(!block_left) {
+        if(!read_block()) return false;
+    }
+
+    if unlikely (!decoder.next(rec)) return false;
+
+    block_left--;
+    return true;
+}
@@ -0,0 +1,246 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef MEM_TRACE_H
+#define MEM_TRACE_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <pthread.h>
+
+/*
+ * Memory access trace file
+ *
+ * File layout:
+ *
+ *   MemTraceFileHeader
+ *   MemTraceBlockHeader + records, ...
+ *
+ * Each record is a flags byte (MEM_TRACE_*), core and thread id bytes if
+ * MEM_TRACE_NEW_ID is set, and three variable length numbers: cycles since
+ * previous record, then physical address and owner RIP as zigzag encoded
+ * differences to previous record. Numbers are stored 7 bits per byte, low
+ * bits first, with the top bit set in all but the last byte.
+ *
+ * Previous record state is reset at start of each block, so each block can
+ * be decoded on its own. Blocks are optionally compressed with zlib, a
+ * block is stored uncompressed if stored_size == raw_size.
+ *
+ * Recorded at MemoryHierarchy::access_cache with '-mem-trace', simulated
+ * with '-trace-sim' (see sim/tracesim.cpp). Use 'util/memtrace.py' to
+ * print or summarize it.
+ */
+
+static const W32 MEM_TRACE_FORMAT = 1;
+static const W32 MEM_TRACE_COMPRESSED = 1;
+
+/* Flags byte of a record */
+static const W8 MEM_TRACE_OP_MASK = 0x03;
+static const W8 MEM_TRACE_ICACHE = 0x04;
+static const W8 MEM_TRACE_KERNEL = 0x08;
+static const W8 MEM_TRACE_NEW_ID = 0x10;
+
+/* Flags, ids and three 64 bit numbers of 10 bytes each */
+static const int MEM_TRACE_MAX_RECORD_SIZE = 3 + (3 * 10);
+
+struct MemTraceFileHeader {
+    char magic[8];
+    W32 format;
+    W32 flags;
+    W64 core_freq_hz;
+};
+
+struct MemTraceBlockHeader {
+    W32 record_count;
+    W32 raw_size;
+    W32 stored_size;
+    W32 pad;
+};
+
+/**
+ * @brief One access sent by a core to the memory hierarchy
+ */
+struct MemTraceRecord {
+    W64 cycle;
+    W64 physaddr;
+    W64 rip;
+    W8 coreid;
+    W8 threadid;
+    W8 type;         // Memory::OP_TYPE
+    bool is_icache;
+    bool kernel;
+
+    void reset() { setzero(*this); }
+};
+
+/**
+ * @brief Encode records into a fixed size block buffer
+ */
+class MemTraceEncoder {
+    private:
+        W8 *buf;
+        W32 size;
+        W32 used;
+        W32 count;
+        MemTraceRecord last;
+
+        void put(W64 value);
+
+    public:
+        MemTraceEncoder(W32 size_);
+        ~MemTraceEncoder();
+
+        /**
+         * @brief Check if one more record may not fit in the block
+         */
+        bool full() const {
+            return (used + MEM_TRACE_MAX_RECORD_SIZE) > size;
+        }
+
+        void add(const MemTraceRecord& rec);
+        void reset();
+
+        const W8* data() const { return buf; }
+        W32 get_size() const { return used; }
+        W32 get_count() const { return count; }
+};
+
+/**
+ * @brief Decode records of one block
+ */
+class MemTraceDecoder {
+    private:
+        const W8 *buf;
+        W32 size;
+        W32 pos;
+        MemTraceRecord last;
+
+        bool get(W64& value);
+
+    public:
+        MemTraceDecoder() { reset(NULL, 0); }
+
+        void reset(const W8 *buf_, W32 size_);
+
+        /**
+         * @brief Decode next record
+         *
+         * @return false at end of block or if block is truncated
+         */
+        bool next(MemTraceRecord& rec);
+};
+
+/**
+ * @brief Write a memory trace file
+ *
+ * Records are encoded into one of two blocks. When it is full it is handed
+ * to a writer thread that compresses and writes it, while the simulation
+ * fills the other one. If the writer thread is still busy with the
+ * previous block, the simulation waits for it; these stalls are counted
+ * and reported in the summary.
+ *
+ * Without a background thread each full block is written right away on
+ * the simulation thread.
+ */
+class MemTraceWriter {
+    private:
+        ofstream os;
+        bool compress;
+        MemTraceEncoder *blocks[2];
+        MemTraceEncoder *current;
+        /* Full block given to writer thread, NULL once written */
+        MemTraceEncoder *pending;
+
+        bool started;
+        bool stopping;
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t pending_cond;
+        pthread_cond_t free_cond;
+
+        W64 records;
+        W64 blocks_written;
+        W64 bytes;
+        W64 stalls;
+        W64 stall_ticks;
+
+        void write_block(MemTraceEncoder *block);
+        void submit();
+        void run();
+
+        static void* writer_thread(void *arg);
+
+    public:
+        /**
+         * @brief Open a trace file
+         *
+         * @param filename File to write, truncated if exists
+         * @param compress_ Compress blocks with zlib
+         * @param block_size Bytes of records per block
+         * @param background Write blocks from a writer thread
+         */
+        MemTraceWriter(const char *filename, bool compress_,
+                W32 block_size = 65536, bool background = true);
+        ~MemTraceWriter();
+
+        bool is_open() const { return os.is_open(); }
+
+        void write(const MemTraceRecord& rec) {
+            current->add(rec);
+            records++;
+
+            if unlikely (current->full())
+                submit();
+        }
+
+        /**
+         * @brief Write all records, stop the thread and close the file
+         */
+        void close();
+
+        W64 get_records() const { return records; }
+        W64 get_stalls() const { return stalls; }
+
+        ostream& print_summary(ostream &out) const;
+};
+
+/**
+ * @brief Read a memory trace file record by record
+ */
+class MemTraceReader {
+    private:
+        ifstream is;
+        MemTraceFileHeader header;
+        dynarray<W8> stored;
+        dynarray<W8> raw;
+        MemTraceDecoder decoder;
+        W32 block_left;
+
+        bool read_block();
+
+    public:
+        MemTraceReader();
+
+        /**
+         * @brief Open a trace file and check its header
+         *
+         * @return false if file can't be read or has a wrong format
+         */
+        bool open(const char *filename);
+
+        /**
+         * @brief Read next record
+         *
+         * @return false at end of trace
+         */
+        bool next(MemTraceRecord& rec);
+
+        W64 get_core_freq_hz() const { return header.core_freq_hz; }
+};
+
+#endif // MEM_TRACE_H
@@ -0,0 +1,251 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef MEMORY_CHANNEL_H
+#define MEMORY_CHANNEL_H
+
+#include <globals.h>
+#include <superstl.h>
+
+namespace Memory {
+
+class MemoryRequest;
+
+/*
+ * Base of the channel types. Their indices are placed on separate host
+ * cache lines with alignto(64), which plain new doesn't honour before
+ * C++17, so heap allocated channels come from posix_memalign.
+ */
+struct CacheLineAligned {
+	static void* operator new(size_t size) {
+		void *mem = NULL;
+		int rc = posix_memalign(&mem, 64, size);
+		assert(rc == 0);
+		return mem;
+	}
+
+	static void operator delete(void *mem) {
+		free(mem);
+	}
+};
+
+/*
+ * SPSCChannel
+ *
+ * Bounded single producer / single consumer ring of fixed size messages.
+ * Producer only writes tail_ and consumer only writes head_, each on its
+ * own cache line, so both ends can run on different host threads without
+ * any lock. Message slot is written before tail_ is published and read
+ * before head_ is released; on x86 (TSO) a compiler barrier is enough to
+ * keep that order.
+ *
+ * Both indices run freely and are masked on access, so SIZE must be a
+ * power of 2 and 'tail_ - head_' is always the number of queued messages.
+ */
+template <typename T, int SIZE>
+class SPSCChannel : public CacheLineAligned
+{
+	private:
+		static const W32 MASK = SIZE - 1;
+
+		/* Consumer side */
+		volatile W32 head_ alignto(64);
+		/* Producer side */
+		volatile W32 tail_ alignto(64);
+
+		T entries_[SIZE] alignto(64);
+
+	public:
+		SPSCChannel() {
+			assert((SIZE & MASK) == 0);
+			reset();
+		}
+
+		/* Only valid when neither side is active */
+		void reset() {
+			head_ = 0;
+			tail_ = 0;
+		}
+
+		/* Producer: returns false if channel is full */
+		bool push(const T& entry) {
+			W32 tail = tail_;
+			if unlikely ((tail - head_) == (W32)SIZE)
+				return false;
+
+			entries_[tail & MASK] = entry;
+			barrier();
+			tail_ = tail + 1;
+			return true;
+		}
+
+		/* Consumer: oldest message without removing it */
+		bool peek(T& entry) const {
+			W32 head = head_;
+			if(head == tail_)
+				return false;
+
+			entry = entries_[head & MASK];
+			return true;
+		}
+
+		/* Consumer: returns false if channel is empty */
+		bool pop(T& entry) {
+			W32 head = head_;
+			if(head == tail_)
+				return false;
+
+			entry = entries_[head & MASK];
+			barrier();
+			head_ = head + 1;
+			return true;
+		}
+
+		bool empty() const {
+			return head_ == tail_;
+		}
+
+		bool full() const {
+			return (tail_ - head_) == (W32)SIZE;
+		}
+
+		int count() const {
+			return int(tail_ - head_);
+		}
+
+		int size() const {
+			return SIZE;
+		}
+};
+
+/*
+ * SpillChannel
+ *
+ * SPSCChannel with an unbounded spill list behind it. In parallel
+ * simulation (-parallel-threads) producer and consumer of a core channel
+ * take turns at quantum barriers, so a producer that finds the ring full
+ * can neither wait for the consumer nor run it in place; it spills the
+ * message instead. While any spilled message is left, push() fails so
+ * later messages are spilled too and order is kept. The spill list is
+ * only touched while the other end is stopped.
+ */
+template <typename T, int SIZE>
+class SpillChannel : public CacheLineAligned
+{
+	private:
+		SPSCChannel<T, SIZE> ring_;
+		dynarray<T> spill_;
+		int spillHead_;
+
+	public:
+		SpillChannel() : spillHead_(0) {}
+
+		void reset() {
+			ring_.reset();
+			spill_.clear();
+			spillHead_ = 0;
+		}
+
+		/* Producer: returns false if ring is full or messages are spilled */
+		bool push(const T& entry) {
+			if unlikely (spill_.length)
+				return false;
+			return ring_.push(entry);
+		}
+
+		/* Producer: queue behind all messages, never fails */
+		void spill(const T& entry) {
+			spill_.push(entry);
+		}
+
+		bool peek(T& entry) const {
+			if likely (ring_.peek(entry))
+				return true;
+			if likely (spillHead_ == spill_.length)
+				return false;
+			entry = spill_.data[spillHead_];
+			return true;
+		}
+
+		bool pop(T& entry) {
+			if likely (ring_.pop(entry))
+				return true;
+			if likely (spillHead_ == spill_.length)
+				return false;
+
+			entry = spill_.data[spillHead_++];
+			if(spillHead_ == spill_.length) {
+				spill_.clear();
+				spillHead_ = 0;
+			}
+			return true;
+		}
+
+		bool empty() const {
+			return ring_.empty() && spillHead_ == spill_.length;
+		}
+
+		int count() const {
+			return ring_.count() + spill_.length - spillHead_;
+		}
+
+		int spilled() const {
+			return spill_.length - spillHead_;
+		}
+};
+
+enum CoreMessageType {
+	CORE_MSG_ACCESS,
+	CORE_MSG_ANNUL,
+};
+
+/* Message sent from a core to the memory hierarchy */
+struct CoreMessage {
+	MemoryRequest *request;
+	/* Core cycle it was sent in, hierarchy takes it in a later cycle */
+	W64 cycle;
+	W8 type;
+};
+
+/*
+ * CoreMemoryChannel
+ *
+ * Pair of channels that connects one core with its CPUController. Core
+ * pushes accesses and annulments into toMemory and the hierarchy pushes
+ * completed requests into toCore, which are delivered to the core by
+ * emitting the request's core signal. Each queued request holds one
+ * reference so it can't be reclaimed by RequestPool while in flight.
+ */
+struct CoreMemoryChannel : public CacheLineAligned {
+	SpillChannel<CoreMessage, 256> toMemory;
+	SpillChannel<MemoryRequest*, 256> toCore;
+
+	void reset() {
+		toMemory.reset();
+		toCore.reset();
+	}
+};
+
+};
+
+#endif // MEMORY_CHANNEL_H
@@ -58,6 +58,7 @@ MemoryController::MemoryController(W8 coreid, const char *name,
             config.dramsim_results_dir_name.buf, qemu_ram_size>>20 ); 
 
     mem->setCPUClockSpeed(config.core_freq_hz); 
+    dramsimCompleted = 0;
 
 	typedef DRAMSim::Callback <Memory::MemoryController, void, uint, uint64_t, uint64_t> dramsim_callback_t;
 	DRAMSim::TransactionCompleteCB *read_cb = new dramsim_callback_t(this, &MemoryController::read_return_cb);
@@ -80,6 +81,10 @@ MemoryController::MemoryController(W8 coreid, const char *name,
 	foreach(i, MEM_BANKS) {
 		banksUsed_[i] = 0;
 	}
+
+	foreach(i, NUM_SIM_CORES) {
+		pendingCount_[i] = 0;
+	}
 }
 
 /*
@@ -97,6 +102,56 @@ int MemoryController::get_bank_id(W64 addr)
     return lowbits(addr >> 6, bankBits_);
 }
 
+/*
+ * @brief: index a newly allocated queue entry by its line address
+ *         and account it to the requesting core
+ *
+ * @param: queueEntry - entry allocated from pendingRequests_ with its
+ *         request already set
+ */
+void MemoryController::add_pending(MemoryQueueEntry *queueEntry)
+{
+	MemoryRequest *request = queueEntry->request;
+
+	pendingMap_.add(request->get_physical_address(), queueEntry->idx);
+
+	assert(request->get_coreid() < NUM_SIM_CORES);
+	pendingCount_[request->get_coreid()]++;
+}
+
+/*
+ * @brief: remove queue entry from the line index and release it back
+ *         to pendingRequests_
+ *
+ * @param: queueEntry - entry to free
+ */
+void MemoryController::free_pending(MemoryQueueEntry *queueEntry)
+{
+	MemoryRequest *request = queueEntry->request;
+
+	pendingMap_.remove(request->get_physical_address(), queueEntry->idx);
+	pendingCount_[request->get_coreid()]--;
+
+	pendingRequests_.free(queueEntry);
+}
+
+/*
+ * @brief: find oldest pending queue entry for given line address
+ *
+ * @param: addr - address of the line
+ *
+ * @return: queue entry or NULL if no request is pending for the line
+ */
+MemoryQueueEntry* MemoryController::find_pending(W64 addr)
+{
+	int idx = pendingMap_.head(addr);
+
+	if(idx < 0)
+		return NULL;
+
+	return &pendingRequests_[idx];
+}
+
 void MemoryController::register_interconnect(Interconnect *interconnect,
         int type)
 {
@@ -131,32 +186,32 @@ bool MemoryController::handle_interconnect_cb(void *arg)
 	 * those requests then merge them into one request
 	 */
 	if(message->request->get_type() == MEMORY_OP_UPDATE) {
-		MemoryQueueEntry *entry;
-		foreach_list_mutable_backwards(pendingRequests_.list(),
-				entry, entry_t, nextentry_t) {
-			if(entry->request->get_physical_address() ==
-					message->request->get_physical_address()) {
-				/*
-				 * found an request for same line, now if this
-				 * request is memory update then merge else
-				 * don't merge to maintain the serialization
-				 * order
-				 */
-				if(!entry->inUse && entry->request->get_type() ==
-						MEMORY_OP_UPDATE) {
-					/*
-					 * We can merge the request, so in simulation
-					 * we dont have data, so don't do anything
-					 */
-					return true;
-				}
-				/*
-				 * we can't merge the request, so do normal
-				 * simuation by adding the entry to pending request
-				 * queue.
-				 */
-				break;
-			}
+		W64 addr = message->request->get_physical_address();
+		MemoryQueueEntry *entry = NULL;
+
+		/* Find the youngest request to exactly the same address */
+		for(int idx = pendingMap_.head(addr); idx >= 0;
+				idx = pendingMap_.next(idx)) {
+			if(pendingRequests_[idx].request->get_physical_address() ==
+					addr)
+				entry = &pendingRequests_[idx];
+		}
+
+		/*
+		 * found an request for same line, now if this
+		 * request is memory update then merge else
+		 * don't merge to maintain the serialization
+		 * order. If we can't merge the request then do
+		 * normal simuation by adding the entry to pending
+		 * request queue.
+		 */
+		if(entry && !entry->inUse && entry->request->get_type() ==
+				MEMORY_OP_UPDATE) {
+			/*
+			 * We can merge the request, so in simulation
+			 * we dont have data, so don't do anything
+			 */
+			return true;
 		}
 	}
 
@@ -174,6 +229,7 @@ bool MemoryController::handle_interconnect_cb(void *arg)
 
 	queueEntry->request = message->request;
 	queueEntry->source = (Controller*)message->origin;
+	add_pending(queueEntry);
 
 	queueEntry->request->incRefCounter();
 	ADD_HISTORY_ADD(queueEntry->request);
@@ -213,7 +269,7 @@ bool MemoryController::handle_interconnect_cb(void *arg)
     if (!accepted) {
         queueEntry->request->decRefCounter();
         //XXX: hack alert -- shouldn't be allocating this entry in the first place if the transaction won't be accepted
-        pendingRequests_.free(queueEntry); 
+        free_pending(queueEntry);
         ptl_logfile << "###### DRAMSIM REJECTING "<< *(queueEntry->request)<<endl; 
         assert(0);
     }
@@ -233,19 +289,14 @@ void MemoryController::print(ostream& os) const
 #ifdef DRAMSIM
 void MemoryController::write_return_cb(uint id, uint64_t addr, uint64_t cycle)
 {
-	MemoryQueueEntry *queueEntry = NULL;
 	memdebug("[DRAMSIM] WRITE ACK" <<std::hex<<addr<<std::dec);
+	dramsimCompleted++;
 
-	foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
-			prev_t) {
-		if (ALIGN_ADDRESS(queueEntry->request->get_physical_address(),dramsim_transaction_size) == addr)
-		{
-			memdebug("[DRAMSIM] entry for address "<< std::hex << addr << std::dec);
-			access_completed_cb(queueEntry);
-			return;
-		}
-	}
-	assert(0);
+	MemoryQueueEntry *queueEntry = find_pending(addr);
+	assert(queueEntry);
+
+	memdebug("[DRAMSIM] entry for address "<< std::hex << addr << std::dec);
+	access_completed_cb(queueEntry);
 }
 
 void MemoryController::read_return_cb(uint id, uint64_t addr, uint64_t cycle)
@@ -254,22 +305,14 @@ void MemoryController::read_return_cb(uint id, uint64_t addr, uint64_t cycle)
 //	assert(pending_map.find(addr) != pending_map.end());
 	// no delay here since we've already waited up to this cycle
 //	Message *message = pending_map[addr];
-	MemoryQueueEntry *queueEntry = NULL;
-
-
 	memdebug("[DRAMSIM] READ RETURN 0x"<<std::hex<<addr<<std::dec);
+	dramsimCompleted++;
 
-	foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
-			prev_t) {
-		if (ALIGN_ADDRESS(queueEntry->request->get_physical_address(),dramsim_transaction_size) == addr)
-		{
-			memdebug("[DRAMSIM] entry for address "<< std::hex << addr << queueEntry->request << std::dec);
-			access_completed_cb(queueEntry);
-			return;
-		}
-	}
-	assert(0);
+	MemoryQueueEntry *queueEntry = find_pending(addr);
+	assert(queueEntry);
 
+	memdebug("[DRAMSIM] entry for address "<< std::hex << addr << queueEntry->request << std::dec);
+	access_completed_cb(queueEntry);
 }
 
 #endif
@@ -327,7 +370,7 @@ bool MemoryController::access_completed_cb(void *arg)
 		 memdebug("!!!!!annuled entry!!!"); 
         queueEntry->request->decRefCounter();
         ADD_HISTORY_REM(queueEntry->request);
-        pendingRequests_.free(queueEntry);
+        free_pending(queueEntry);
     }
 
 	return true;
@@ -345,7 +388,7 @@ bool MemoryController::wait_interconnect_cb(void *arg)
 		memdebug("!!!! ignoring update request !!!!" );
 		queueEntry->request->decRefCounter();
 		ADD_HISTORY_REM(queueEntry->request);
-		pendingRequests_.free(queueEntry);
+		free_pending(queueEntry);
 		return true;
 	}
 
@@ -368,7 +411,7 @@ bool MemoryController::wait_interconnect_cb(void *arg)
 	} else {
 		queueEntry->request->decRefCounter();
 		ADD_HISTORY_REM(queueEntry->request);
-		pendingRequests_.free(queueEntry);
+		free_pending(queueEntry);
 
 		if(!pendingRequests_.isFull()) {
 			memoryHierarchy_->set_controller_full(this, false);
@@ -379,15 +422,17 @@ bool MemoryController::wait_interconnect_cb(void *arg)
 
 void MemoryController::annul_request(MemoryRequest *request)
 {
-    MemoryQueueEntry *queueEntry;
-    foreach_list_mutable(pendingRequests_.list(), queueEntry,
-            entry, nextentry) {
+    int idx = pendingMap_.head(request->get_physical_address());
+    while(idx >= 0) {
+        MemoryQueueEntry *queueEntry = &pendingRequests_[idx];
+        idx = pendingMap_.next(idx);
+
         if(queueEntry->request->is_same(request)) {
             queueEntry->annuled = true;
             if(!queueEntry->inUse) {
                 queueEntry->request->decRefCounter();
                 ADD_HISTORY_REM(queueEntry->request);
-                pendingRequests_.free(queueEntry);
+                free_pending(queueEntry);
             }
         }
     }
@@ -395,14 +440,8 @@ void MemoryController::annul_request(MemoryRequest *request)
 
 int MemoryController::get_no_pending_request(W8 coreid)
 {
-	int count = 0;
-	MemoryQueueEntry *queueEntry;
-	foreach_list_mutable(pendingRequests_.list(), queueEntry,
-			entry, nextentry) {
-		if(queueEntry->request->get_coreid() == coreid)
-			count++;
-	}
-	return count;
+	assert(coreid < NUM_SIM_CORES);
+	return pendingCount_[coreid];
 }
 
 /**
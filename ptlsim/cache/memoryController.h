@@ -32,6 +32,7 @@
 #include <interconnect.h>
 #include <superstl.h>
 #include <memoryStats.h>
+#include <pendingRequestMap.h>
 
 #ifdef DRAMSIM
 #include <DRAMSim.h>
@@ -81,11 +82,17 @@ class MemoryController : public Controller
 		Signal waitInterconnect_;
 
 		FixStateList<MemoryQueueEntry, MEM_REQ_NUM> pendingRequests_;
+		PendingRequestMap<MEM_REQ_NUM> pendingMap_;
+		int pendingCount_[NUM_SIM_CORES];
 
         int latency_;
 		int bankBits_;
 		int get_bank_id(W64 addr);
 
+		void add_pending(MemoryQueueEntry *queueEntry);
+		void free_pending(MemoryQueueEntry *queueEntry);
+		MemoryQueueEntry* find_pending(W64 addr);
+
         RAMStats new_stats;
 
 	public:
@@ -96,6 +103,8 @@ class MemoryController : public Controller
 		void read_return_cb(uint, uint64_t, uint64_t);
 		void write_return_cb(uint, uint64_t, uint64_t);
 		MultiChannelMemorySystem *mem;
+		/* Number of transactions returned by DRAMSim so far */
+		W64 dramsimCompleted;
 #endif
 		virtual bool handle_interconnect_cb(void *arg);
 		void print(ostream& os) const;
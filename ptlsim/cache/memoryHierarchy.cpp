@@ -53,12 +53,41 @@ MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
     machine_(machine)
     , someStructIsFull_(false)
 {
+#ifdef DRAMSIM
+    dramsimClocked_ = false;
+#endif
+
     coreNo_ = machine_.get_num_cores();
 
     foreach(i, NUM_SIM_CORES) {
-        RequestPool* pool = new RequestPool();
+        stringbuf poolName;
+        poolName << "request_pool_" << i;
+        RequestPool* pool = new RequestPool(poolName.buf, &machine_);
         requestPool_.push(pool);
     }
+
+    /* Parallel simulation only talks to the hierarchy through channels */
+    parallel_ = (config.parallel_threads > 0);
+    useChannels_ = config.core_mem_channels || parallel_;
+    messageDigest_ = 0;
+    if(useChannels_) {
+        foreach(i, NUM_SIM_CORES) {
+            channels_.push(new CoreMemoryChannel());
+        }
+    }
+
+    traceWriter_ = NULL;
+    if(config.mem_trace_filename.set()) {
+        traceWriter_ = new MemTraceWriter(config.mem_trace_filename.buf,
+                config.mem_trace_compress);
+
+        if(!traceWriter_->is_open()) {
+            ptl_logfile << "Can't open memory trace ",
+                        config.mem_trace_filename, endl;
+            delete traceWriter_;
+            traceWriter_ = NULL;
+        }
+    }
 }
 
 MemoryHierarchy::~MemoryHierarchy()
@@ -68,11 +97,67 @@ MemoryHierarchy::~MemoryHierarchy()
         delete pool;
     }
     requestPool_.clear();
+
+    foreach(i, channels_.count()) {
+        delete channels_[i];
+    }
+    channels_.clear();
+
+    foreach(i, warmPaths_.count()) {
+        WarmPath* path = warmPaths_[i];
+        foreach(j, path->levels.count()) {
+            delete path->levels[j];
+        }
+        delete path;
+    }
+    warmPaths_.clear();
+
+    if(traceWriter_) {
+        traceWriter_->close();
+        traceWriter_->print_summary(ptl_logfile);
+        delete traceWriter_;
+        traceWriter_ = NULL;
+    }
+}
+
+/**
+ * @brief Add an access sent by a core to the memory trace (-mem-trace)
+ */
+void MemoryHierarchy::trace_access(MemoryRequest *request)
+{
+    MemTraceRecord rec;
+
+    rec.cycle = sim_cycle;
+    rec.physaddr = request->get_physical_address();
+    rec.rip = request->get_owner_rip();
+    rec.coreid = request->get_coreid();
+    rec.threadid = request->get_threadid();
+    rec.type = request->get_type();
+    rec.is_icache = request->is_instruction();
+    rec.kernel = request->is_kernel();
+
+    traceWriter_->write(rec);
 }
 
 bool MemoryHierarchy::access_cache(MemoryRequest *request)
 {
 	W8 coreid = request->get_coreid();
+
+	if unlikely (traceWriter_) {
+		parallel_serialize();
+		trace_access(request);
+	}
+
+	/*
+	 * With channels the request reaches CPUController in next clock(), so
+	 * reads always complete through a wakeup (L1 hits one cycle later than
+	 * in synchronous mode) and only writes are done at this point.
+	 */
+	if(useChannels_) {
+		send_core_message(coreid, request, CORE_MSG_ACCESS);
+		return request->get_type() == MEMORY_OP_WRITE;
+	}
+
 	CPUController *cpuController = (CPUController*)cpuControllers_[coreid];
 	assert(cpuController != NULL);
 
@@ -88,30 +173,227 @@ bool MemoryHierarchy::access_cache(MemoryRequest *request)
 	return false;
 }
 
+/*
+ * Core <-> hierarchy message passing
+ *
+ * Each core has one CoreMemoryChannel. Core side produces into toMemory
+ * (access_cache, annul_request) and consumes toCore (deliver_core_wakeups);
+ * hierarchy side consumes toMemory at start of clock() and produces into
+ * toCore from core_wakeup. Lock handling (grab/probe/invalidate_lock) uses
+ * the global interlock table and stays a direct call.
+ *
+ * In serial simulation both sides run on the simulation thread, so when a
+ * channel is full its consumer is simply run in place to make room. In
+ * parallel simulation (-parallel-threads) the message is spilled instead
+ * and waits for the consumer's next turn. Either way message order is kept
+ * and no request is dropped.
+ *
+ * Hierarchy takes messages in cycle order: at clock() of cycle C it takes
+ * the messages each core sent before C, core by core in core id order.
+ * This merge doesn't depend on which host thread clocked a core or when,
+ * so parallel runs feed the event queue in the same order as a serial
+ * run of the same quantum schedule. A digest of the merged stream is kept
+ * to check that.
+ */
+void MemoryHierarchy::send_core_message(W8 coreid, MemoryRequest *request,
+		W8 type)
+{
+	CoreMessage message;
+	message.request = request;
+	message.cycle = sim_cycle;
+	message.type = type;
+
+	/* Reference is released once the hierarchy has handled the message */
+	request->incRefCounter();
+
+	CoreMemoryChannel *channel = channels_[coreid];
+	if unlikely (!channel->toMemory.push(message)) {
+		if(parallel_) {
+			channel->toMemory.spill(message);
+			return;
+		}
+		handle_core_messages(coreid, (W64)-1);
+		bool pushed = channel->toMemory.push(message);
+		assert(pushed);
+	}
+}
+
+void MemoryHierarchy::handle_core_messages(W8 coreid, W64 before_cycle)
+{
+	CoreMemoryChannel *channel = channels_[coreid];
+	CPUController *cpuController = (CPUController*)cpuControllers_[coreid];
+	assert(cpuController != NULL);
+
+	CoreMessage message;
+	while(channel->toMemory.peek(message) &&
+			message.cycle < before_cycle) {
+		channel->toMemory.pop(message);
+
+		MemoryRequest *request = message.request;
+		memdebug("Core channel ", int(coreid), " message type ",
+				int(message.type), " ", *request, endl);
+
+		messageDigest_ = (messageDigest_ ^ sim_cycle ^ (W64(coreid) << 56) ^
+				(W64(message.type) << 48) ^
+				(W64(request->get_type()) << 40) ^
+				request->get_physical_address()) * 0x100000001b3ULL;
+
+		if(message.type == CORE_MSG_ANNUL) {
+			cpuController->annul_request(request);
+		} else if(cpuController->access(request) == 0 &&
+				request->get_type() != MEMORY_OP_WRITE) {
+			/* Hit in L1 fast path, there is no pending entry to finalize */
+			core_wakeup(request);
+		}
+
+		request->decRefCounter();
+	}
+}
+
+void MemoryHierarchy::send_core_wakeup(MemoryRequest *request)
+{
+	W8 coreid = request->get_coreid();
+
+	/* Reference is released once the core signal has been emitted */
+	request->incRefCounter();
+
+	CoreMemoryChannel *channel = channels_[coreid];
+	if unlikely (!channel->toCore.push(request)) {
+		if(parallel_) {
+			channel->toCore.spill(request);
+			return;
+		}
+		deliver_core_wakeups();
+		bool pushed = channel->toCore.push(request);
+		assert(pushed);
+	}
+}
+
+void MemoryHierarchy::deliver_core_wakeups()
+{
+	if likely (!useChannels_)
+		return;
+
+	foreach(i, channels_.count()) {
+		deliver_core_wakeups(i);
+	}
+}
+
+void MemoryHierarchy::deliver_core_wakeups(W8 coreid)
+{
+	CoreMemoryChannel *channel = channels_[coreid];
+	MemoryRequest *request;
+	while(channel->toCore.pop(request)) {
+		request->get_coreSignal()->emit((void*)request);
+		request->decRefCounter();
+	}
+}
+
 void MemoryHierarchy::clock()
 {
-	// First clock all the cpu controllers
+	// Receive requests sent by cores before this cycle
+	if(useChannels_) {
+		foreach(i, cpuControllers_.count()) {
+			handle_core_messages(i, sim_cycle);
+		}
+	}
+
+#ifdef DRAMSIM
+	if(dramsimClocked_) {
+		dramsimClocked_ = false;
+	} else
+#endif
+	{
+		// First clock all the cpu controllers
+		foreach(i, cpuControllers_.count()) {
+			CPUController *cpuController = (CPUController*)(
+					cpuControllers_[i]);
+			cpuController->clock();
+		}
+#ifdef DRAMSIM
+		((MemoryController*)memoryController_)->mem->update();
+#endif
+	}
+
+	Event *event;
+	while((event = eventQueue_.pop(sim_cycle)) != NULL) {
+		memdebug("Executing event: ", *event);
+		eventQueue_.free(event);
+		assert(event->execute());
+	}
+}
+W64 MemoryHierarchy::get_next_event_cycle()
+{
+	if(useChannels_) {
+		foreach(i, channels_.count()) {
+			if(!channels_[i]->toMemory.empty() ||
+					!channels_[i]->toCore.empty())
+				return sim_cycle;
+		}
+	}
+
+	W64 next = eventQueue_.next_clock();
+
 	foreach(i, cpuControllers_.count()) {
 		CPUController *cpuController = (CPUController*)(
 				cpuControllers_[i]);
-		cpuController->clock();
+		next = min(next, cpuController->get_next_event_cycle());
 	}
+
+	return max(next, sim_cycle);
+}
+
+/**
+ * @brief Skip idle cycles of memory hierarchy
+ *
+ * @param cycles Number of cycles to skip, all cycles before
+ * sim_cycle + cycles must be idle as reported by get_next_event_cycle()
+ *
+ * @return Number of cycles skipped
+ *
+ * With DRAMSim the DRAM state is not visible to us, so it is clocked cycle
+ * by cycle and skipping stops at the cycle that returned a transaction.
+ * Rest of that cycle is done by next clock().
+ */
+W64 MemoryHierarchy::skip_cycles(W64 cycles)
+{
 #ifdef DRAMSIM
-    ((MemoryController*)memoryController_)->mem->update();	
-#endif
+	MemoryController *memController = (MemoryController*)memoryController_;
+	W64 start_cycle = sim_cycle;
+	W64 completed = memController->dramsimCompleted;
+	W64 skipped = 0;
 
-	Event *event;
-	while(!eventQueue_.empty()) {
-		event = eventQueue_.head();
-		if(event->get_clock() <= sim_cycle) {
-			memdebug("Executing event: ", *event);
-			eventQueue_.free(event);
-			assert(event->execute());
-		} else {
+	while(skipped < cycles) {
+		sim_cycle = start_cycle + skipped;
+
+		foreach(i, cpuControllers_.count()) {
+			CPUController *cpuController = (CPUController*)(
+					cpuControllers_[i]);
+			cpuController->clock();
+		}
+		memController->mem->update();
+
+		if(memController->dramsimCompleted != completed) {
+			dramsimClocked_ = true;
 			break;
 		}
+
+		skipped++;
 	}
+
+	sim_cycle = start_cycle;
+	return skipped;
+#else
+	foreach(i, cpuControllers_.count()) {
+		CPUController *cpuController = (CPUController*)(
+				cpuControllers_[i]);
+		cpuController->skip_cycles(cycles);
+	}
+
+	return cycles;
+#endif
 }
+
 #ifdef DRAMSIM
 void MemoryHierarchy::simulation_done()
 {
@@ -129,6 +411,8 @@ int MemoryHierarchy::flush(uint8_t coreid)
 {
 	int delay = 0;
 
+	parallel_serialize();
+
 	if(coreid == -1) {
 		/* Here delay is not added because all the CPU Controllers
 		 * can be flushed in parallel */
@@ -222,6 +506,14 @@ void MemoryHierarchy::dump_info(ostream& os)
     }
 
 	os << "Request pool is done...\n";
+
+	foreach(i, channels_.count()) {
+		os << "Core channel ", i, ": toMemory[", channels_[i]->toMemory.count(),
+		   "] toCore[", channels_[i]->toCore.count(), "] spilled[",
+		   channels_[i]->toMemory.spilled(), ",",
+		   channels_[i]->toCore.spilled(), "]\n";
+	}
+
 	os << "::CPU Controllers::\n";
 	foreach(i, cpuControllers_.count()) {
 		os << *((CPUController*)cpuControllers_[i]);
@@ -264,55 +556,9 @@ void MemoryHierarchy::print_map(ostream& os)
 	os << "--End MemoryHierarchy Map\n";
 }
 
-void MemoryHierarchy::sort_event_queue(Event *event)
-{
-	// First make sure that given event is in tail of queue
-	assert(eventQueue_.tail() == event);
-
-	// No need to sort if only 1 event
-	if(eventQueue_.count() == 1)
-		return;
-
-	Event* entryEvent;
-	foreach_list_mutable(eventQueue_.list(), entryEvent, entry, preventry) {
-		if(*event < *entryEvent) {
-			eventQueue_.unlink(event);
-			eventQueue_.insert_after(event, (Event*)(entryEvent->prev));
-			return;
-		}
-	}
-
-	// Entry is already at the tail of queue, keep it there
-	return;
-}
-
-void MemoryHierarchy::sort_event_queue_tail(Event *event)
-{
-	// First make sure that given event is in tail of queue
-	assert(eventQueue_.tail() == event);
-
-	// No need to sort if only 1 event
-	if (eventQueue_.count() == 1)
-		return;
-
-	Event* entryEvent;
-	foreach_list_mutable_backwards(eventQueue_.list(), entryEvent, entry, preventry) {
-        if (entryEvent == event)
-            continue;
-
-        if (*event >= *entryEvent) {
-            eventQueue_.unlink(event);
-            eventQueue_.insert_after(event, (Event*)(entryEvent));
-            return;
-        }
-    }
-}
-
 void MemoryHierarchy::add_event(Signal *signal, int delay, void *arg)
 {
 	Event *event = eventQueue_.alloc();
-	if(eventQueue_.count() == 1)
-		assert(event == eventQueue_.head());
 	assert(event);
 	event->setup(signal, sim_cycle + delay, arg);
 
@@ -328,7 +574,7 @@ void MemoryHierarchy::add_event(Signal *signal, int delay, void *arg)
 
 	memdebug("Adding event:", *event);
 
-    sort_event_queue(event);
+	eventQueue_.schedule(event);
 
 	return;
 }
@@ -357,6 +603,10 @@ void MemoryHierarchy::annul_request(W8 coreid,
 	MemoryRequest* memRequest = get_free_request(coreid);
 	memRequest->init(coreid, threadid, physaddr, robid, sim_cycle, is_icache,
 			-1, -1, (is_write ? MEMORY_OP_WRITE : MEMORY_OP_READ));
+	if(useChannels_) {
+		send_core_message(coreid, memRequest, CORE_MSG_ANNUL);
+		return;
+	}
 	cpuControllers_[coreid]->annul_request(memRequest);
 	//foreach(i, allControllers_.count()) {
 	//	allControllers_[i]->annul_request(memRequest);
@@ -393,8 +643,7 @@ void MemoryHierarchy::annul_request(W8 coreid,
 
 int MemoryHierarchy::get_core_pending_offchip_miss(W8 coreid)
 {
-	return ((MemoryController*)memoryController_)->
-		get_no_pending_request(coreid);
+	return memoryController_->get_no_pending_request(coreid);
 }
 
 /**
@@ -408,6 +657,9 @@ int MemoryHierarchy::get_core_pending_offchip_miss(W8 coreid)
 bool MemoryHierarchy::grab_lock(W64 lockaddr, W8 ctx_id)
 {
     bool ret = false;
+
+    parallel_serialize();
+
     MemoryInterlockEntry* lock = interlocks.select_and_lock(lockaddr);
 
     if likely (lock && lock->ctx_id == (W8)-1) {
@@ -426,6 +678,8 @@ bool MemoryHierarchy::grab_lock(W64 lockaddr, W8 ctx_id)
  */
 void MemoryHierarchy::invalidate_lock(W64 lockaddr, W8 ctx_id)
 {
+    parallel_serialize();
+
     MemoryInterlockEntry* lock = interlocks.probe(lockaddr);
 
     assert(lock);
@@ -444,6 +698,9 @@ void MemoryHierarchy::invalidate_lock(W64 lockaddr, W8 ctx_id)
 bool MemoryHierarchy::probe_lock(W64 lockaddr, W8 ctx_id)
 {
     bool ret = false;
+
+    parallel_serialize();
+
     MemoryInterlockEntry* lock = interlocks.probe(lockaddr);
 
     if likely (!lock) { // If no one has grab the lock
@@ -455,6 +712,172 @@ bool MemoryHierarchy::probe_lock(W64 lockaddr, W8 ctx_id)
     return ret;
 }
 
+/* Line address bits used to pick a bank while warming */
+#define WARM_BANK_SHIFT 6
+
+/* Limit of warming path length, guards against loops in connections */
+#define WARM_MAX_LEVELS 8
+
+static bool has_controller(const dynarray<Controller*>& conts,
+        Controller* cont)
+{
+    foreach(i, conts.count()) {
+        if(conts[i] == cont)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Find controllers below given controllers
+ *
+ * @param upper Controllers of current level
+ * @param type How controllers of current level see the interconnect
+ * @param lower Filled with controllers that see the same interconnect as
+ * their upper interconnect
+ */
+void MemoryHierarchy::get_warm_lower(const WarmLevel& upper, int type,
+        WarmLevel& lower)
+{
+    foreach(i, machine_.connections.count()) {
+        ConnectionDef* connDef = machine_.connections[i];
+        bool connected = false;
+
+        foreach(j, connDef->connections.count()) {
+            SingleConnection* sg = connDef->connections[j];
+            Controller** cont = machine_.controller_hash.get(
+                    sg->controller);
+
+            if(sg->type == type && cont && has_controller(upper, *cont))
+                connected = true;
+        }
+
+        if(!connected)
+            continue;
+
+        foreach(j, connDef->connections.count()) {
+            SingleConnection* sg = connDef->connections[j];
+            Controller** cont = machine_.controller_hash.get(
+                    sg->controller);
+
+            if(!cont || has_controller(lower, *cont))
+                continue;
+
+            if(sg->type == INTERCONN_TYPE_UPPER ||
+                    sg->type == INTERCONN_TYPE_UPPER2)
+                lower.push(*cont);
+        }
+    }
+}
+
+void MemoryHierarchy::setup_warm_paths()
+{
+    foreach(i, cpuControllers_.count()) {
+        foreach(is_icache, 2) {
+            WarmPath* path = new WarmPath();
+            WarmLevel upper;
+            int type = is_icache ? INTERCONN_TYPE_I : INTERCONN_TYPE_D;
+
+            upper.push(cpuControllers_[i]);
+
+            while(path->levels.count() < WARM_MAX_LEVELS) {
+                WarmLevel* level = new WarmLevel();
+                get_warm_lower(upper, type, *level);
+
+                if(!level->count()) {
+                    delete level;
+                    break;
+                }
+
+                path->levels.push(level);
+                upper = *level;
+                type = INTERCONN_TYPE_LOWER;
+            }
+
+            warmPaths_.push(path);
+        }
+    }
+
+    foreach(i, machine_.controllers.count()) {
+        Controller* cont = machine_.controllers[i];
+        if(cont->is_private())
+            warmPeers_.push(cont);
+    }
+}
+
+/**
+ * @brief Update caches as if the access was simulated
+ *
+ * @param coreid Core that did the access
+ * @param threadid Thread of the core
+ * @param physaddr Physical address of the access
+ * @param is_icache Access is an instruction fetch
+ * @param is_write Access is a store
+ *
+ * Caches are probed from L1 down until one has the line, and the line is
+ * filled in all caches above it. Lower levels only see reads, as a write
+ * back L1 would do. When the L1 needs the line, private caches of other
+ * cores are snooped: a write invalidates their copy and a read marks the
+ * filled line shared if any of them has it.
+ */
+void MemoryHierarchy::warm_access(W8 coreid, W8 threadid, W64 physaddr,
+        bool is_icache, bool is_write)
+{
+    if unlikely (!warmPaths_.count())
+        setup_warm_paths();
+
+    WarmPath* path = warmPaths_[coreid * 2 + is_icache];
+    Controller* conts[WARM_MAX_LEVELS];
+    int levels = path->levels.count();
+    int fills = levels;
+    int result = WARM_MISS;
+    int l1_result = WARM_MISS;
+
+    if unlikely (!levels)
+        return;
+
+    warmRequest_.init(coreid, threadid, physaddr, 0, sim_cycle, is_icache,
+            0, 0, is_write ? MEMORY_OP_WRITE : MEMORY_OP_READ);
+
+    foreach(i, levels) {
+        WarmLevel& level = *path->levels[i];
+        conts[i] = level[(physaddr >> WARM_BANK_SHIFT) % level.count()];
+
+        result = conts[i]->warm_probe(&warmRequest_, is_write && i == 0);
+        if(i == 0)
+            l1_result = result;
+
+        if(result != WARM_MISS) {
+            fills = i;
+            break;
+        }
+    }
+
+    int probed = min(fills + 1, levels);
+    bool shared = false;
+
+    if(l1_result != WARM_HIT) {
+        foreach(i, warmPeers_.count()) {
+            Controller* peer = warmPeers_[i];
+            bool on_path = false;
+
+            foreach(j, probed) {
+                on_path |= (conts[j] == peer);
+            }
+
+            if(!on_path)
+                shared |= peer->warm_snoop(&warmRequest_, is_write);
+        }
+    }
+
+    if(l1_result == WARM_UPGRADE)
+        conts[0]->warm_fill(&warmRequest_, true, shared);
+
+    foreach(i, fills) {
+        conts[i]->warm_fill(&warmRequest_, is_write && i == 0, shared);
+    }
+}
+
 namespace Memory {
 
 MemoryInterlockBuffer interlocks;
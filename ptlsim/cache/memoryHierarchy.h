@@ -36,6 +36,9 @@
 #include <memoryRequest.h>
 #include <controller.h>
 #include <interconnect.h>
+#include <eventQueue.h>
+#include <memoryChannel.h>
+#include <memTrace.h>
 
 #include <statsBuilder.h>
 
@@ -56,16 +59,11 @@
 #define memdebug(...) (0)
 #endif
 
-#define ENABLE_MEM_REQUEST_HISTORY
-#ifdef ENABLE_MEM_REQUEST_HISTORY
-#define ADD_HISTORY(req, ...) req->get_history() << __VA_ARGS__
-#define ADD_HISTORY_ADD(req) ADD_HISTORY(req, "{+", get_name(), "} ")
-#define ADD_HISTORY_REM(req) ADD_HISTORY(req, "{-", get_name(), "} ")
-#else
-#define ADD_HISTORY(req, ...) (0)
-#define ADD_HISTORY_ADD(req) (0)
-#define ADD_HISTORY_REM(req) (0)
-#endif
+/* Request history is recorded only if enabled with -mem-request-history */
+#define ADD_HISTORY(req, type, id) (config.mem_request_history ? \
+		req->add_history(type, id, sim_cycle) : (void)0)
+#define ADD_HISTORY_ADD(req) ADD_HISTORY(req, HISTORY_ADD, get_history_id())
+#define ADD_HISTORY_REM(req) ADD_HISTORY(req, HISTORY_REM, get_history_id())
 
 #ifndef ENABLE_CHECKS
 #undef assert
@@ -86,73 +84,6 @@
 
 namespace Memory {
 
-  class Event : public FixStateListObject
-	{
-		private:
-			Signal *signal_;
-			W64    clock_;
-			void   *arg_;
-
-		public:
-			void init() {
-				signal_ = NULL;
-				clock_ = -1;
-				arg_ = NULL;
-			}
-
-			void setup(Signal *signal, W64 clock, void *arg) {
-				signal_ = signal;
-				clock_ = clock;
-				arg_ = arg;
-			}
-
-			bool execute() {
-				return signal_->emit(arg_);
-			}
-
-			W64 get_clock() {
-				return clock_;
-			}
-
-			ostream& print(ostream& os) const {
-				os << "Event< ";
-				if(signal_)
-					os << "Signal:" << signal_->get_name() << " ";
-				os << "Clock:" << clock_ << " ";
-				os << "arg:" << arg_ ;
-				os << ">" << endl, flush;
-				return os;
-			}
-
-			bool operator ==(Event &event) {
-				if(clock_ == event.clock_)
-					return true;
-				return false;
-			}
-
-			bool operator >(Event &event) {
-				if(clock_ > event.clock_)
-					return true;
-				return false;
-			}
-
-			bool operator <(Event &event) {
-				if(clock_ < event.clock_)
-					return true;
-				return false;
-			}
-
-            bool operator >=(Event &event) {
-                if (clock_ >= event.clock_)
-                    return true;
-                return false;
-            }
-	};
-
-  static inline ostream& operator <<(ostream& os, const Event& event) {
-      return event.print(os);
-  }
-
   struct MemoryInterlockEntry {
       W8 ctx_id;
 
@@ -187,11 +118,24 @@ namespace Memory {
     // if Signal is not setup, it uses old wrapper functions
     void core_wakeup(MemoryRequest *request) {
         if(request->get_coreSignal()) {
+            if(useChannels_) {
+                send_core_wakeup(request);
+                return;
+            }
             request->get_coreSignal()->emit((void*)request);
             return;
         }
     }
 
+    // Deliver wakeups queued in core channels, core side of the
+    // message passing interface (-core-mem-channels)
+    void deliver_core_wakeups();
+    void deliver_core_wakeups(W8 coreid);
+
+    // Digest of all core messages in the order the hierarchy took them,
+    // equal for runs that fed the same requests in the same cycles
+    W64 get_message_digest() const { return messageDigest_; }
+
 	// to remove the requests if rob eviction has occured
 	void annul_request(W8 coreid,
 			W8 threadid,
@@ -202,6 +146,14 @@ namespace Memory {
 
     void clock();
 
+    // Earliest cycle at which clock() has some work to do, used to skip
+    // idle cycles (-skip-idle-cycles)
+    W64 get_next_event_cycle();
+
+    // Advance the hierarchy by given number of idle cycles, returns the
+    // number of cycles actually skipped
+    W64 skip_cycles(W64 cycles);
+
     void reset();
 
 	// return the number of cycle used to flush the caches
@@ -257,11 +209,53 @@ namespace Memory {
     bool probe_lock(W64 lockaddr, W8 ctx_id);
     void invalidate_lock(W64 lockaddr, W8 ctx_id);
 
+    // Functional warming of caches with an access done in emulation
+    // mode (-fast-fwd-warming), no request is simulated
+    void warm_access(W8 coreid, W8 threadid, W64 physaddr,
+            bool is_icache, bool is_write);
+
   private:
 
+    // Caches an access goes through from a CPU controller, each level
+    // has one controller or address interleaved banks
+    typedef dynarray<Controller*> WarmLevel;
+    struct WarmPath {
+        dynarray<WarmLevel*> levels;
+    };
+
+    // Indexed by (coreid * 2 + is_icache), built on first warm_access
+    dynarray<WarmPath*> warmPaths_;
+    // Private caches that are kept coherent by warming
+    dynarray<Controller*> warmPeers_;
+    MemoryRequest warmRequest_;
+
+    void setup_warm_paths();
+    void get_warm_lower(const WarmLevel& upper, int type,
+            WarmLevel& lower);
+
     // machine
     BaseMachine &machine_;
 
+    // Core <-> CPUController message channels, one per core
+    bool useChannels_;
+    bool parallel_;
+    dynarray<CoreMemoryChannel*> channels_;
+    W64 messageDigest_;
+
+    // Trace of all accesses sent by cores (-mem-trace), NULL if disabled
+    MemTraceWriter *traceWriter_;
+
+    void trace_access(MemoryRequest *request);
+
+#ifdef DRAMSIM
+    // DRAMSim was already updated for current cycle by skip_cycles()
+    bool dramsimClocked_;
+#endif
+
+    void send_core_message(W8 coreid, MemoryRequest *request, W8 type);
+    void send_core_wakeup(MemoryRequest *request);
+    void handle_core_messages(W8 coreid, W64 before_cycle);
+
 	// array of caches and memory
 	dynarray<Controller*> cpuControllers_;
 	dynarray<Controller*> allControllers_;
@@ -285,10 +279,11 @@ namespace Memory {
 	FixStateList<Message, 128> messageQueue_;
 
 	// Event Queue
-	FixStateList<Event, 2048> eventQueue_;
-
-	void sort_event_queue(Event *event);
-	void sort_event_queue_tail(Event *event);
+#ifdef ENABLE_EVENT_WHEEL
+	EventWheel<2048> eventQueue_;
+#else
+	EventList<2048> eventQueue_;
+#endif
 
     // Temp Stats
     Stats *stats;
@@ -37,6 +37,7 @@
 #include <memoryRequest.h>
 #include <statelist.h>
 #include <memoryHierarchy.h>
+#include <memoryStats.h>
 
 
 using namespace Memory;
@@ -63,8 +64,7 @@ void MemoryRequest::init(W8 coreId,
 	opType_ = opType;
 	isData_ = !isInstruction;
 
-	if(history) delete history;
-	history = new stringbuf();
+	historyCount_ = 0;
 
 	memdebug("Init ", *this, endl);
 }
@@ -82,8 +82,7 @@ void MemoryRequest::init(MemoryRequest *request)
 	opType_ = request->opType_;
 	isData_ = request->isData_;
 
-	if(history) delete history;
-	history = new stringbuf();
+	historyCount_ = 0;
 
 	memdebug("Init ", *this, endl);
 }
@@ -123,48 +122,156 @@ bool MemoryRequest::is_same(MemoryRequest *request)
 }
 
 
-RequestPool::RequestPool()
+/* Names of controllers and interconnects indexed by history id */
+static dynarray<stringbuf*> history_names;
+
+/*
+ * @brief: Get history id of a controller or interconnect, a new id is
+ *         assigned only for a name that is not registered yet so machines
+ *         that are built again reuse the same ids.
+ */
+W16 MemoryRequest::register_history_name(const char *name)
+{
+	foreach(i, history_names.count()) {
+		if(strequal(history_names[i]->buf, name))
+			return W16(i);
+	}
+
+	stringbuf *historyName = new stringbuf();
+	*historyName << name;
+	history_names.push(historyName);
+
+	assert(history_names.count() <= 65536);
+	return W16(history_names.count() - 1);
+}
+
+const char* MemoryRequest::get_history_name(W16 id)
+{
+	if(id >= history_names.count())
+		return "unknown";
+	return history_names[id]->buf;
+}
+
+ostream& MemoryRequest::print_history(ostream& os) const
+{
+	if(!history_)
+		return os;
+
+	W32 start = 0;
+	if(historyCount_ > MEM_REQUEST_HISTORY_SIZE) {
+		start = historyCount_ - MEM_REQUEST_HISTORY_SIZE;
+		os << "... ";
+	}
+
+	for(W32 i = start; i < historyCount_; i++) {
+		const MemoryHistoryRecord &record = history_[i &
+			(MEM_REQUEST_HISTORY_SIZE - 1)];
+		os << "{", history_type_names[record.type],
+		   get_history_name(record.owner), "@", record.cycle, "} ";
+	}
+
+	return os;
+}
+
+RequestPool::RequestPool(const char *name, Statable *parent)
+{
+	size_ = 0;
+	stats_ = new RequestPoolStats(name, parent);
+	add_slab();
+}
+
+RequestPool::~RequestPool()
 {
-	size_ = REQUEST_POOL_SIZE;
+	delete stats_;
+	foreach(i, slabs_.count()) {
+		delete [] slabs_[i];
+		delete [] historySlabs_[i];
+	}
+}
+
+void RequestPool::add_slab()
+{
+	MemoryRequest *slab = new MemoryRequest[REQUEST_POOL_SIZE];
+	MemoryHistoryRecord *history = new MemoryHistoryRecord[
+		REQUEST_POOL_SIZE * MEM_REQUEST_HISTORY_SIZE];
+
 	foreach(i, REQUEST_POOL_SIZE) {
-		freeRequestList_.enqueue((selfqueuelink*)&((*this)[i]));
+		MemoryRequest &request = slab[i];
+		request.set_history_buffer(&history[i * MEM_REQUEST_HISTORY_SIZE]);
+		request.pool_ = this;
+		request.poolState_ = REQUEST_FREE;
+		freeRequestList_.enqueue((selfqueuelink*)&request);
+	}
+
+	slabs_.push(slab);
+	historySlabs_.push(history);
+	size_ += REQUEST_POOL_SIZE;
+}
+
+void RequestPool::move_to_list(MemoryRequest *request, StateList &list,
+		REQUEST_POOL_STATE state)
+{
+	get_list(request->poolState_).remove((selfqueuelink*)request);
+	list.enqueue((selfqueuelink*)request);
+	request->poolState_ = state;
+}
+
+/*
+ * @brief: Return requests that were never referenced in their allocation
+ *         cycle back to the free list. New requests list is in allocation
+ *         order so only its head is checked.
+ */
+void RequestPool::reclaim_new_requests()
+{
+	while(!newRequestsList_.empty()) {
+		MemoryRequest *request = (MemoryRequest*)newRequestsList_.peek();
+		if(request->allocCycle_ == sim_cycle)
+			break;
+
+		assert(request->refCounter_ == 0);
+		move_to_list(request, freeRequestList_, REQUEST_FREE);
+		stats_->reclaimed(user_stats)++;
 	}
 }
 
 MemoryRequest* RequestPool::get_free_request()
 {
-	if (isPoolLow()){
-		garbage_collection();
-        /* if asserted here please increase REQUEST_POOL_SIZE */
-		assert(!isEmpty());
+	reclaim_new_requests();
+
+	if(freeRequestList_.empty()) {
+		add_slab();
+		stats_->slab_allocs(user_stats)++;
+		memdebug("Request pool grown to ", size_, " requests\n");
 	}
+
 	MemoryRequest* memoryRequest = (MemoryRequest*)freeRequestList_.peek();
-	freeRequestList_.remove((selfqueuelink*)memoryRequest);
-	usedRequestsList_.enqueue((selfqueuelink*)memoryRequest);
+	move_to_list(memoryRequest, newRequestsList_, REQUEST_NEW);
+	memoryRequest->allocCycle_ = sim_cycle;
+	memoryRequest->refCounter_ = 0;
+
+	W64 used = get_used_count();
+	if(used > stats_->max_used(user_stats)) {
+		stats_->max_used(user_stats) = used;
+		stats_->size(user_stats) = size_;
+	}
 
 	return memoryRequest;
 }
 
-void RequestPool::freeRequest( MemoryRequest* memoryrequest)
+/*
+ * @brief: First reference to a request. Normally request is in new list,
+ *         but if it was released and referenced again in same hand-off
+ *         it is taken back from free list.
+ */
+void RequestPool::request_referenced(MemoryRequest *request)
 {
-    /* we should free it only when no one refrence to it  */
-	assert(0 == memoryrequest->get_ref_counter());
-	usedRequestsList_.remove(memoryrequest);
-	freeRequestList_.enqueue(memoryrequest);
-	memoryrequest->set_ref_counter(0);
+	assert(request->poolState_ != REQUEST_USED);
+	move_to_list(request, usedRequestsList_, REQUEST_USED);
 }
 
-void RequestPool::garbage_collection()
+void RequestPool::request_released(MemoryRequest *request)
 {
-	int cleaned = 0;
-	MemoryRequest *memoryRequest;
-	foreach_list_mutable(usedRequestsList_, memoryRequest, \
-			entry, nextentry){
-		if (0 == memoryRequest->get_ref_counter()){
-			freeRequest(memoryRequest);
-			cleaned++;
-		}
-	}
-	memdebug("number of Request cleaned by garbageCollector is: ",
-		   cleaned,	endl);
+	/* Freed requests go to list tail so they are reused last */
+	assert(request->poolState_ == REQUEST_USED);
+	move_to_list(request, freeRequestList_, REQUEST_FREE);
 }
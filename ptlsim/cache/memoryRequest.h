@@ -50,10 +50,49 @@ static const char* memory_op_names[NUM_MEMORY_OP] = {
 	"memory_op_evict"
 };
 
+enum HISTORY_TYPE {
+	HISTORY_ADD,   /* Request is added to a controller/interconnect queue */
+	HISTORY_REM,   /* Request is removed from a controller/interconnect queue */
+	HISTORY_MOESI, /* Response is sent by MOESI coherence logic */
+	NUM_HISTORY_TYPES
+};
+
+static const char* history_type_names[NUM_HISTORY_TYPES] = {
+	"+",
+	"-",
+	"MOESI ",
+};
+
+/*
+ * One entry of MemoryRequest history. 'owner' is the history id of the
+ * controller or interconnect, see MemoryRequest::register_history_name.
+ */
+struct MemoryHistoryRecord {
+	W64 cycle;
+	W16 owner;
+	W8 type;
+};
+
+/* List of RequestPool that a request is currently in */
+enum REQUEST_POOL_STATE {
+	REQUEST_FREE,   /* In free list */
+	REQUEST_NEW,    /* Given out by pool but never referenced yet */
+	REQUEST_USED,   /* Referenced by at least one queue */
+};
+
+class RequestPool;
+struct RequestPoolStats;
+
 class MemoryRequest: public selfqueuelink
 {
 	public:
-		MemoryRequest() { reset(); }
+		MemoryRequest() {
+			history_ = NULL;
+			pool_ = NULL;
+			poolState_ = REQUEST_FREE;
+			allocCycle_ = 0;
+			reset();
+		}
 
 		void reset() {
 			coreId_ = 0;
@@ -65,17 +104,12 @@ class MemoryRequest: public selfqueuelink
 			refCounter_ = 0; // or maybe 1
 			opType_ = MEMORY_OP_READ;
 			isData_ = 0;
-			history = new stringbuf();
+			historyCount_ = 0;
             coreSignal_ = NULL;
 		}
 
-		void incRefCounter(){
-			refCounter_++;
-		}
-
-		void decRefCounter(){
-			refCounter_--;
-		}
+		inline void incRefCounter();
+		inline void decRefCounter();
 
 		void init(W8 coreId,
 				W8 threadId,
@@ -128,7 +162,31 @@ class MemoryRequest: public selfqueuelink
 
 		W64 get_init_cycles() { return cycles_; }
 
-		stringbuf& get_history() { return *history; }
+		/*
+		 * History is a ring of last MEM_REQUEST_HISTORY_SIZE records. Ring
+		 * buffer is set once by RequestPool, requests without one don't
+		 * keep any history.
+		 */
+		void set_history_buffer(MemoryHistoryRecord *buffer) {
+			history_ = buffer;
+		}
+
+		void add_history(HISTORY_TYPE type, W16 owner, W64 cycle) {
+			if(!history_)
+				return;
+
+			MemoryHistoryRecord &record = history_[historyCount_ &
+				(MEM_REQUEST_HISTORY_SIZE - 1)];
+			record.cycle = cycle;
+			record.owner = owner;
+			record.type = type;
+			historyCount_++;
+		}
+
+		ostream& print_history(ostream& os) const;
+
+		static W16 register_history_name(const char *name);
+		static const char* get_history_name(W16 id);
 
         bool is_kernel() {
             // based on owner RIP value
@@ -160,7 +218,9 @@ class MemoryRequest: public selfqueuelink
 			os << "isData[", isData_, "] ";
 			os << "ownerUUID[", ownerUUID_, "] ";
 			os << "ownerRIP[", (void*)ownerRIP_, "] ";
-			os << "History[ " << *history << "] ";
+			os << "History[ ";
+			print_history(os);
+			os << "] ";
             if(coreSignal_) {
                 os << "Signal[ " << coreSignal_->get_name() << "] ";
             }
@@ -178,9 +238,15 @@ class MemoryRequest: public selfqueuelink
 		W64 ownerUUID_;
 		int refCounter_;
 		OP_TYPE opType_;
-		stringbuf *history;
+		MemoryHistoryRecord *history_;
+		W32 historyCount_;
         Signal *coreSignal_;
 
+		RequestPool *pool_;
+		REQUEST_POOL_STATE poolState_;
+		W64 allocCycle_;
+
+		friend class RequestPool;
 };
 
 static inline ostream& operator <<(ostream& os, const MemoryRequest& request)
@@ -188,19 +254,41 @@ static inline ostream& operator <<(ostream& os, const MemoryRequest& request)
 	return request.print(os);
 }
 
-class RequestPool: public array<MemoryRequest,REQUEST_POOL_SIZE>
+/*
+ * RequestPool
+ *
+ * Pool of MemoryRequests of one core. Requests are kept in slabs of
+ * REQUEST_POOL_SIZE requests and a new slab is added when all requests are
+ * in use. A request returns to the free list as soon as its reference
+ * counter drops to zero, so requests are never searched for reuse.
+ *
+ * Requests that are given out but never referenced (caller failed to queue
+ * it) are kept in a separate list ordered by allocation, and are reclaimed
+ * once their allocation cycle is over.
+ */
+class RequestPool
 {
 	public:
-		RequestPool();
+		RequestPool(const char *name, Statable *parent);
+		~RequestPool();
+
 		MemoryRequest* get_free_request();
-		void garbage_collection();
 
-		StateList& used_list() {
-			return usedRequestsList_;
+		/* Called by MemoryRequest on reference counter changes */
+		void request_referenced(MemoryRequest *request);
+		void request_released(MemoryRequest *request);
+
+		int get_size() const {
+			return size_;
+		}
+
+		int get_used_count() const {
+			return usedRequestsList_.count + newRequestsList_.count;
 		}
 
 		void print(ostream& os) {
-			os << "Request pool : size[", size_, "]\n";
+			os << "Request pool : size[", size_, "] slabs[",
+			   slabs_.count(), "]\n";
 			os << "used requests : count[", usedRequestsList_.count,
 			   "]\n", flush;
 
@@ -211,6 +299,15 @@ class RequestPool: public array<MemoryRequest,REQUEST_POOL_SIZE>
 				os << *usedReq , endl, flush;
 			}
 
+			os << "new requests : count[", newRequestsList_.count,
+			   "]\n", flush;
+
+			MemoryRequest *newReq;
+			foreach_list_mutable(newRequestsList_, newReq, \
+					entry__, nextentry__) {
+				os << *newReq, endl, flush;
+			}
+
 			os << "free request : count[", freeRequestList_.count,
 			   "]\n", flush;
 
@@ -226,22 +323,41 @@ class RequestPool: public array<MemoryRequest,REQUEST_POOL_SIZE>
 	private:
 		int size_;
 		StateList freeRequestList_;
+		StateList newRequestsList_;
 		StateList usedRequestsList_;
 
-		void freeRequest(MemoryRequest* request);
+		dynarray<MemoryRequest*> slabs_;
+		dynarray<MemoryHistoryRecord*> historySlabs_;
 
-		bool isEmpty()
-		{
-			return (freeRequestList_.empty());
-		}
+		RequestPoolStats *stats_;
 
-		bool isPoolLow()
-		{
-			return (freeRequestList_.count < (
-						REQUEST_POOL_SIZE * REQUEST_POOL_LOW_RATIO));
+		void add_slab();
+		void reclaim_new_requests();
+		void move_to_list(MemoryRequest *request, StateList &list,
+				REQUEST_POOL_STATE state);
+
+		StateList& get_list(REQUEST_POOL_STATE state) {
+			switch(state) {
+				case REQUEST_FREE: return freeRequestList_;
+				case REQUEST_NEW: return newRequestsList_;
+				default: return usedRequestsList_;
+			}
 		}
 };
 
+inline void MemoryRequest::incRefCounter()
+{
+	if(refCounter_++ == 0 && pool_)
+		pool_->request_referenced(this);
+}
+
+inline void MemoryRequest::decRefCounter()
+{
+	assert(refCounter_ > 0);
+	if(--refCounter_ == 0 && pool_)
+		pool_->request_released(this);
+}
+
 static inline ostream& operator <<(ostream& os, RequestPool &pool)
 {
 	pool.print(os);
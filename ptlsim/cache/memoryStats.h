@@ -196,6 +196,55 @@ struct MESIStats : public BaseCacheStats {
     {}
 };
 
+/*
+ * Hardware prefetcher stats of a cache:
+ *   accuracy - prefetched lines used by a demand request / prefetches sent
+ *   coverage - demand misses removed by prefetching / demand misses that
+ *              would happen without prefetcher
+ *   lateness - useful prefetches that were still in flight at demand
+ *
+ * 'demand_misses' counts demand misses plus first demand hits on prefetched
+ * lines, i.e. the misses this cache would have without the prefetcher.
+ */
+struct PrefetchStats : public Statable {
+    StatObj<W64> requests;
+    StatObj<W64> dropped;
+    StatObj<W64> redundant;
+    StatObj<W64> issued;
+    StatObj<W64> useful;
+    StatObj<W64> late;
+    StatObj<W64> useless;
+    StatObj<W64> demand_misses;
+
+    StatEquation<W64, double, StatObjFormulaDiv> accuracy;
+    StatEquation<W64, double, StatObjFormulaDiv> coverage;
+    StatEquation<W64, double, StatObjFormulaDiv> lateness;
+
+    PrefetchStats(const char *name, Statable *parent)
+        : Statable(name, parent)
+          , requests("requests", this)
+          , dropped("dropped", this)
+          , redundant("redundant", this)
+          , issued("issued", this)
+          , useful("useful", this)
+          , late("late", this)
+          , useless("useless", this)
+          , demand_misses("demand_misses", this)
+          , accuracy("accuracy", this)
+          , coverage("coverage", this)
+          , lateness("lateness", this)
+    {
+        accuracy.add_elem(&useful);
+        accuracy.add_elem(&issued);
+
+        coverage.add_elem(&useful);
+        coverage.add_elem(&demand_misses);
+
+        lateness.add_elem(&late);
+        lateness.add_elem(&useful);
+    }
+};
+
 struct BusStats : public Statable {
 
     struct broadcasts : public Statable {
@@ -254,6 +303,124 @@ struct RAMStats : public Statable {
     {}
 };
 
+/*
+ * Directory bank stats, counted at the home node of each line.
+ * Invalidations are counted per evict message sent to a cache: 'write'
+ * for write misses, 'eviction' for directory entry replacements and
+ * 'imprecise' for caches that got one only because the sharer encoding
+ * could not tell they don't have the line.
+ */
+struct DirectoryStats : public Statable {
+
+    struct invalidations : public Statable {
+        StatObj<W64> write;
+        StatObj<W64> eviction;
+        StatObj<W64> imprecise;
+
+        invalidations(Statable *parent)
+            : Statable("invalidations", parent)
+              , write("write", this)
+              , eviction("eviction", this)
+              , imprecise("imprecise", this)
+        {}
+    } invalidations;
+
+    StatObj<W64> access;
+    StatObj<W64> remote_access;
+    StatObj<W64> port_stall;
+    StatObj<W64> replacement;
+    StatObj<W64> overflow;
+
+    DirectoryStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , invalidations(this)
+          , access("access", this)
+          , remote_access("remote_access", this)
+          , port_stall("port_stall", this)
+          , replacement("replacement", this)
+          , overflow("overflow", this)
+    {}
+};
+
+/*
+ * Mesh and ring network stats. 'link_busy' counts the cycles each directed
+ * link (router * 4 + output port) was transferring flits, dividing it by
+ * the simulated cycles gives the link utilization. 'hop_latency' is a
+ * histogram of cycles spent per hop (link, queueing and router delay) and
+ * 'hops' a histogram of the hop count of delivered packets.
+ */
+struct NetworkStats : public Statable {
+
+    StatObj<W64> packets;
+    StatObj<W64> flits;
+    StatObj<W64> latency;
+    StatObj<W64> inject_stall;
+    StatObj<W64> credit_stall;
+    StatObj<W64> deliver_retry;
+    StatArray<W64, NOC_MAX_LINKS> link_busy;
+    StatArray<W64, NOC_HOP_LATENCY_BUCKETS> hop_latency;
+    StatArray<W64, NOC_MAX_HOPS> hops;
+
+    NetworkStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , packets("packets", this)
+          , flits("flits", this)
+          , latency("latency", this)
+          , inject_stall("inject_stall", this)
+          , credit_stall("credit_stall", this)
+          , deliver_retry("deliver_retry", this)
+          , link_busy("link_busy", this)
+          , hop_latency("hop_latency", this)
+          , hops("hops", this)
+    {}
+};
+
+/*
+ * RequestPool usage is not related to guest mode, so these counters are
+ * only updated in user stats.
+ */
+struct RequestPoolStats : public Statable {
+
+    StatObj<W64> max_used;
+    StatObj<W64> size;
+    StatObj<W64> slab_allocs;
+    StatObj<W64> reclaimed;
+
+    RequestPoolStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , max_used("max_used", this)
+          , size("size", this)
+          , slab_allocs("slab_allocs", this)
+          , reclaimed("reclaimed", this)
+    {}
+};
+
+struct DRAMStats : public Statable {
+
+    StatArray<W64, DRAM_MAX_CHANNELS> channel_access;
+    StatObj<W64> read;
+    StatObj<W64> write;
+    StatObj<W64> update;
+    StatObj<W64> row_hit;
+    StatObj<W64> row_miss;
+    StatObj<W64> row_conflict;
+    StatObj<W64> queue_cycles;
+    StatObj<W64> access_cycles;
+
+    DRAMStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , channel_access("channel_access", this)
+          , read("read", this)
+          , write("write", this)
+          , update("update", this)
+          , row_hit("row_hit", this)
+          , row_miss("row_miss", this)
+          , row_conflict("row_conflict", this)
+          , queue_cycles("queue_cycles", this)
+          , access_cycles("access_cycles", this)
+    {}
+};
+
 };
 
 #endif // MEMORY_STATS_H
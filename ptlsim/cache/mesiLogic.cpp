@@ -448,6 +448,43 @@ void MESILogic::handle_response(CacheQueueEntry *entry, Message &msg)
 {
 }
 
+bool MESILogic::warm_hit(CacheLine *line, bool is_write)
+{
+    if(!is_write)
+        return true;
+
+    switch(line->state) {
+        case MESI_MODIFIED:
+            return true;
+        case MESI_EXCLUSIVE:
+            line->state = MESI_MODIFIED;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void MESILogic::warm_fill(CacheLine *line, bool is_write, bool shared)
+{
+    if(is_write)
+        line->state = MESI_MODIFIED;
+    else
+        line->state = (shared) ? MESI_SHARED : MESI_EXCLUSIVE;
+}
+
+bool MESILogic::warm_snoop(CacheLine *line, bool is_write)
+{
+    if(line->state == MESI_INVALID)
+        return false;
+
+    if(is_write)
+        line->state = MESI_INVALID;
+    else
+        line->state = MESI_SHARED;
+
+    return true;
+}
+
 /**
  * @brief Dump MESI Coherence Logic Configuration
  *
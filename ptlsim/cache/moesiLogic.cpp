@@ -419,6 +419,50 @@ void MOESILogic::handle_response(CacheQueueEntry *queueEntry,
     }
 }
 
+bool MOESILogic::warm_hit(CacheLine *line, bool is_write)
+{
+    if (!is_write)
+        return true;
+
+    switch (line->state) {
+        case MOESI_MODIFIED:
+            return true;
+        case MOESI_EXCLUSIVE:
+            line->state = MOESI_MODIFIED;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void MOESILogic::warm_fill(CacheLine *line, bool is_write, bool shared)
+{
+    if (is_write)
+        line->state = MOESI_MODIFIED;
+    else
+        line->state = (shared) ? MOESI_SHARED : MOESI_EXCLUSIVE;
+}
+
+/**
+ * @brief Update line state when other cache accessed the line
+ *
+ * A dirty line read by other cache stays dirty as owned line.
+ */
+bool MOESILogic::warm_snoop(CacheLine *line, bool is_write)
+{
+    switch (line->state) {
+        case MOESI_INVALID:
+            return false;
+        case MOESI_MODIFIED:
+            line->state = (is_write) ? MOESI_INVALID : MOESI_OWNER;
+            break;
+        default:
+            line->state = (is_write) ? MOESI_INVALID : MOESI_SHARED;
+    }
+
+    return true;
+}
+
 /**
  * @brief Dump MOESI Cache Coherence Configuration
  *
@@ -440,7 +484,8 @@ void MOESILogic::send_to_cont(CacheQueueEntry *queueEntry,
         Interconnect *sendTo, Controller *dest)
 {
     queueEntry->dest = dest;
-    queueEntry->request->get_history() << "{MOESI} ";
+    ADD_HISTORY(queueEntry->request, HISTORY_MOESI,
+            controller->get_history_id());
 
     send_response(queueEntry, sendTo);
 }
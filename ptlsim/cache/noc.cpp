@@ -0,0 +1,479 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <noc.h>
+
+using namespace Memory;
+using namespace Memory::NetworkInterconnect;
+
+static void noc_config_error(const char *name, const char *msg)
+{
+    stringbuf err;
+    err << "::ERROR::Interconnect '" << name << "': " << msg << endl;
+    ptl_logfile << err;
+    cerr << err;
+    assert(0);
+}
+
+Network::Network(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Interconnect(name, memoryHierarchy)
+    , nodes_(0)
+    , new_stats(name, &memoryHierarchy->get_machine())
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    int dataBytes;
+
+    memoryHierarchy_->add_interconnect(this);
+
+    SET_SIGNAL_CB(name, "_route", route_, &Network::route_cb);
+    SET_SIGNAL_CB(name, "_deliver", deliver_, &Network::deliver_cb);
+
+    if (!machine.get_option(name, "nodes", configNodes_))
+        configNodes_ = 0;
+    if (!machine.get_option(name, "router_latency", routerLatency_))
+        routerLatency_ = NOC_ROUTER_DELAY;
+    if (!machine.get_option(name, "link_latency", linkLatency_))
+        linkLatency_ = NOC_LINK_DELAY;
+    if (!machine.get_option(name, "flit_bytes", flitBytes_))
+        flitBytes_ = NOC_FLIT_BYTES;
+    if (!machine.get_option(name, "data_bytes", dataBytes))
+        dataBytes = NOC_DATA_BYTES;
+    if (!machine.get_option(name, "vcs", vcs_))
+        vcs_ = NOC_VCS;
+    if (!machine.get_option(name, "vc_buffers", vcBuffers_))
+        vcBuffers_ = NOC_VC_BUFFERS;
+    if (!machine.get_option(name, "inject_queue", injectQueue_))
+        injectQueue_ = NOC_INJECT_QUEUE;
+    machine.get_option(name, "placement", placement_);
+
+    if (configNodes_ < 0 || configNodes_ > NOC_MAX_NODES)
+        noc_config_error(name, "nodes must not be more than 64");
+    if (routerLatency_ <= 0 || linkLatency_ <= 0)
+        noc_config_error(name, "router and link latency must be positive");
+    if (flitBytes_ <= 0 || dataBytes < 0)
+        noc_config_error(name, "flit_bytes must be positive");
+    if (vcs_ <= 0 || vcs_ > NOC_MAX_VCS)
+        noc_config_error(name, "vcs must be between 1 and 8");
+    if (injectQueue_ <= 0)
+        noc_config_error(name, "inject_queue must be positive");
+
+    /* Header flit plus the payload */
+    dataFlits_ = 1 + (dataBytes + flitBytes_ - 1) / flitBytes_;
+
+    if (vcBuffers_ < dataFlits_)
+        noc_config_error(name, "vc_buffers must hold a whole data packet");
+}
+
+Network::~Network()
+{
+}
+
+/**
+ * @brief Node given to controller in 'placement' option
+ *
+ * @param cont Controller to look up
+ *
+ * @return Node number or -1 if the controller is not placed
+ */
+int Network::placed_node(Controller *cont) const
+{
+    const char *name = cont->get_name();
+    const char *p = placement_.buf;
+    int len = strlen(name);
+
+    while (p && *p) {
+        while (*p == ' ' || *p == ',')
+            p++;
+
+        if (strncmp(p, name, len) == 0 && p[len] == ':')
+            return atoi(p + len + 1);
+
+        p = strchr(p, ',');
+    }
+
+    return -1;
+}
+
+bool Network::node_used(int node) const
+{
+    foreach (i, controllers_.count()) {
+        if (controllers_[i].node == node)
+            return true;
+    }
+    return false;
+}
+
+int Network::get_node(Controller *cont) const
+{
+    foreach (i, controllers_.count()) {
+        if (controllers_[i].controller == cont)
+            return controllers_[i].node;
+    }
+
+    stringbuf err;
+    err << "::ERROR::Controller '" << (cont ? cont->get_name() : "NULL")
+        << "' is not connected to " << get_name() << endl;
+    ptl_logfile << err;
+    cerr << err;
+    assert(0);
+    return -1;
+}
+
+void Network::register_controller(Controller *controller)
+{
+    NodeInfo info;
+    int minNodes = configNodes_;
+
+    info.controller = controller;
+    info.node = placed_node(controller);
+
+    /* Unplaced controllers take the lowest node nobody is attached to */
+    if (info.node < 0) {
+        info.node = 0;
+        while (node_used(info.node))
+            info.node++;
+    }
+
+    if (info.node >= NOC_MAX_NODES || (configNodes_ &&
+                info.node >= configNodes_)) {
+        noc_config_error(get_name(), "controller placed outside the network");
+    }
+
+    controllers_.push(info);
+
+    foreach (i, controllers_.count()) {
+        minNodes = max(minNodes, controllers_[i].node + 1);
+    }
+
+    setup_topology(minNodes);
+    setup_links();
+}
+
+void Network::setup_links()
+{
+    if (vc_classes() > vcs_)
+        noc_config_error(get_name(), "ring needs at least 2 vcs");
+
+    links_.resize(nodes_ * NOC_NUM_PORTS);
+    foreach (i, links_.count()) {
+        links_[i].reset(vcs_, vcBuffers_);
+    }
+
+    inFlight_.resize(nodes_);
+    foreach (i, inFlight_.count()) {
+        inFlight_[i] = 0;
+    }
+}
+
+int Network::access_fast_path(Controller *controller,
+        MemoryRequest *request)
+{
+    return -1;
+}
+
+void Network::annul_request(MemoryRequest *request)
+{
+    /* Packets hold VCs, so they are dropped at their next hop */
+    Packet *packet;
+    foreach_list_mutable (packets_.list(), packet, entry_t, nextentry_t) {
+        if (packet->request->is_same(request))
+            packet->annuled = true;
+    }
+}
+
+bool Network::controller_request_cb(void *arg)
+{
+    Message *msg = (Message*)arg;
+    int srcNode = get_node((Controller*)msg->sender);
+    bool kernel = msg->request->is_kernel();
+
+    if (inFlight_[srcNode] >= injectQueue_) {
+        N_STAT_UPDATE(new_stats.inject_stall, ++, kernel);
+        return false;
+    }
+
+    Packet *packet = packets_.alloc();
+
+    if (!packet) {
+        N_STAT_UPDATE(new_stats.inject_stall, ++, kernel);
+        return false;
+    }
+
+    packet->setup(*msg);
+    packet->srcNode     = srcNode;
+    packet->destNode    = get_node(packet->dest);
+    packet->node        = srcNode;
+    packet->flits       = packet->has_data ? dataFlits_ : 1;
+    packet->injectCycle = sim_cycle;
+    ADD_HISTORY_ADD(packet->request);
+
+    inFlight_[srcNode]++;
+
+    N_STAT_UPDATE(new_stats.packets, ++, kernel);
+    N_STAT_UPDATE(new_stats.flits, += packet->flits, kernel);
+
+    /* Through the local input port of the source router */
+    marss_add_event(&route_, routerLatency_, packet);
+
+    return true;
+}
+
+/**
+ * @brief Move a packet from its current router to the next one
+ *
+ * @param arg Packet that finished its router traversal
+ *
+ * Allocates a VC at the next router and the output link, and returns the
+ * credits of the VC held at the current router.
+ */
+bool Network::route_cb(void *arg)
+{
+    Packet *packet = (Packet*)arg;
+    bool kernel = packet->request->is_kernel();
+
+    if (packet->annuled) {
+        release_packet(packet);
+        return true;
+    }
+
+    int port = route(packet->node, packet->destNode);
+
+    if (port == NOC_PORT_EJECT) {
+        /* Tail flit arrives flits - 1 cycles after the head */
+        int delay = packet->hops ? packet->flits - 1 : 0;
+        marss_add_event(&deliver_, delay, packet);
+        return true;
+    }
+
+    int linkId = packet->node * NOC_NUM_PORTS + port;
+    Link &link = links_[linkId];
+
+    int vcClass = vc_class(packet, port);
+    int classVcs = vcs_ / vc_classes();
+    int vc = link.alloc_vc(vcClass * classVcs, classVcs, packet->flits);
+
+    if (vc < 0) {
+        N_STAT_UPDATE(new_stats.credit_stall, ++, kernel);
+        link.add_waiter(packet);
+        return true;
+    }
+
+    W64 start = link.reserve(sim_cycle, packet->flits);
+    N_STAT_UPDATE(new_stats.link_busy, [linkId] += packet->flits, kernel);
+
+    if (packet->inLink >= 0) {
+        Link &prev = links_[packet->inLink];
+        prev.release_vc(packet->vc, packet->flits);
+        wake_waiters(prev);
+    }
+
+    packet->inLink  = linkId;
+    packet->vc      = vc;
+    packet->vcClass = vcClass;
+    packet->node    = next_node(packet->node, port);
+    packet->hops++;
+
+    int delay = (start - sim_cycle) + linkLatency_ + routerLatency_;
+    N_STAT_UPDATE(new_stats.hop_latency,
+            [min(delay, NOC_HOP_LATENCY_BUCKETS - 1)]++, kernel);
+
+    marss_add_event(&route_, delay, packet);
+
+    return true;
+}
+
+bool Network::deliver_cb(void *arg)
+{
+    Packet *packet = (Packet*)arg;
+    bool kernel = packet->request->is_kernel();
+
+    if (packet->annuled) {
+        release_packet(packet);
+        return true;
+    }
+
+    Message *msg = memoryHierarchy_->get_message();
+    msg->sender  = this;
+    packet->fill(*msg);
+
+    bool success = packet->dest->get_interconnect_signal()->emit(msg);
+
+    memoryHierarchy_->free_message(msg);
+
+    memdebug(get_name() << " delivering packet success: " << success << endl);
+
+    /* Destination keeps the packet, and its VC, until it accepts it */
+    if (!success) {
+        N_STAT_UPDATE(new_stats.deliver_retry, ++, kernel);
+        marss_add_event(&deliver_, 1, packet);
+        return true;
+    }
+
+    N_STAT_UPDATE(new_stats.latency, += sim_cycle - packet->injectCycle,
+            kernel);
+    N_STAT_UPDATE(new_stats.hops,
+            [min(packet->hops, NOC_MAX_HOPS - 1)]++, kernel);
+
+    release_packet(packet);
+    return true;
+}
+
+/* Waiting packets retry next cycle, in the order they stalled */
+void Network::wake_waiters(Link &link)
+{
+    Packet *packet = link.waitHead;
+
+    link.waitHead = NULL;
+    link.waitTail = NULL;
+
+    while (packet) {
+        Packet *next = packet->nextWaiter;
+        packet->nextWaiter = NULL;
+        marss_add_event(&route_, 1, packet);
+        packet = next;
+    }
+}
+
+void Network::release_packet(Packet *packet)
+{
+    if (packet->inLink >= 0) {
+        Link &link = links_[packet->inLink];
+        link.release_vc(packet->vc, packet->flits);
+        wake_waiters(link);
+    }
+
+    inFlight_[packet->srcNode]--;
+
+    packet->request->decRefCounter();
+    ADD_HISTORY_REM(packet->request);
+    packets_.free(packet);
+}
+
+/**
+ * @brief Dump Network Interconnect Configuration in YAML Format
+ *
+ * @param out YAML Object
+ */
+void Network::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "interconnect");
+    YAML_KEY_VAL(out, "topology", topology());
+    YAML_KEY_VAL(out, "nodes", nodes_);
+    YAML_KEY_VAL(out, "router_latency", routerLatency_);
+    YAML_KEY_VAL(out, "link_latency", linkLatency_);
+    YAML_KEY_VAL(out, "flit_bytes", flitBytes_);
+    YAML_KEY_VAL(out, "data_flits", dataFlits_);
+    YAML_KEY_VAL(out, "vcs", vcs_);
+    YAML_KEY_VAL(out, "vc_buffers", vcBuffers_);
+    YAML_KEY_VAL(out, "inject_queue", injectQueue_);
+
+    out << YAML::Key << "placement" << YAML::Value << YAML::BeginMap;
+    foreach (i, controllers_.count()) {
+        YAML_KEY_VAL(out, controllers_[i].controller->get_name(),
+                controllers_[i].node);
+    }
+    out << YAML::EndMap;
+
+    dump_topology(out);
+
+    out << YAML::EndMap;
+}
+
+/* Mesh */
+
+Mesh::Mesh(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Network(name, memoryHierarchy)
+    , width_(0)
+{
+    if (!memoryHierarchy_->get_machine().get_option(name, "width",
+                configWidth_)) {
+        configWidth_ = 0;
+    }
+
+    if (configWidth_ < 0)
+        noc_config_error(name, "width must be positive");
+}
+
+void Mesh::setup_topology(int minNodes)
+{
+    width_ = configWidth_;
+
+    if (!width_) {
+        while (width_ * width_ < minNodes)
+            width_++;
+    }
+
+    int height = (minNodes + width_ - 1) / width_;
+    nodes_ = width_ * height;
+
+    if (nodes_ > NOC_MAX_NODES)
+        noc_config_error(get_name(), "mesh has more than 64 nodes");
+}
+
+void Mesh::dump_topology(YAML::Emitter &out) const
+{
+    YAML_KEY_VAL(out, "width", width_);
+}
+
+/* Ring */
+
+Ring::Ring(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Network(name, memoryHierarchy)
+{
+}
+
+void Ring::setup_topology(int minNodes)
+{
+    nodes_ = minNodes;
+}
+
+struct MeshBuilder : public InterconnectBuilder
+{
+    MeshBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Mesh(name, &mem);
+    }
+};
+
+struct RingBuilder : public InterconnectBuilder
+{
+    RingBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Ring(name, &mem);
+    }
+};
+
+MeshBuilder meshBuilder("mesh");
+RingBuilder ringBuilder("ring");
@@ -0,0 +1,414 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef NOC_H
+#define NOC_H
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <interconnect.h>
+#include <memoryHierarchy.h>
+#include <memoryStats.h>
+
+#include <machine.h>
+
+#define NOC_ROUTER_DELAY 1
+#define NOC_LINK_DELAY 1
+#define NOC_FLIT_BYTES 16
+#define NOC_DATA_BYTES 64
+#define NOC_VCS 2
+#define NOC_VC_BUFFERS 8
+#define NOC_INJECT_QUEUE 16
+#define NOC_MAX_PACKETS 1024
+
+namespace Memory {
+
+namespace NetworkInterconnect {
+
+    /*
+     * Output ports of a router. The ring only uses EAST (clockwise, to
+     * node + 1) and WEST (counter clockwise, to node - 1).
+     */
+    enum {
+        NOC_PORT_EAST = 0,
+        NOC_PORT_WEST,
+        NOC_PORT_NORTH,
+        NOC_PORT_SOUTH,
+    };
+
+    /* Route value returned when a packet has reached its destination */
+    const int NOC_PORT_EJECT = -1;
+
+    /* Dimension ordered (XY) routing: first along the row, then column */
+    static inline int mesh_route(int node, int dest, int width)
+    {
+        int x  = node % width, y  = node / width;
+        int dx = dest % width, dy = dest / width;
+
+        if (dx > x) return NOC_PORT_EAST;
+        if (dx < x) return NOC_PORT_WEST;
+        if (dy > y) return NOC_PORT_SOUTH;
+        if (dy < y) return NOC_PORT_NORTH;
+        return NOC_PORT_EJECT;
+    }
+
+    static inline int mesh_next(int node, int port, int width)
+    {
+        switch (port) {
+            case NOC_PORT_EAST:  return node + 1;
+            case NOC_PORT_WEST:  return node - 1;
+            case NOC_PORT_NORTH: return node - width;
+            case NOC_PORT_SOUTH: return node + width;
+        }
+        return node;
+    }
+
+    /* Shortest direction around the ring, ties go clockwise */
+    static inline int ring_route(int node, int dest, int nodes)
+    {
+        int dist = (dest - node + nodes) % nodes;
+
+        if (dist == 0) return NOC_PORT_EJECT;
+        return (dist <= nodes / 2) ? NOC_PORT_EAST : NOC_PORT_WEST;
+    }
+
+    static inline int ring_next(int node, int port, int nodes)
+    {
+        if (port == NOC_PORT_EAST)
+            return (node + 1) % nodes;
+        return (node + nodes - 1) % nodes;
+    }
+
+    /* Wrap around links of the ring are the dateline for its VC classes */
+    static inline bool ring_wraps(int node, int port, int nodes)
+    {
+        return (port == NOC_PORT_EAST && node == nodes - 1) ||
+            (port == NOC_PORT_WEST && node == 0);
+    }
+
+    struct Packet : public FixStateListObject
+    {
+        MemoryRequest *request;
+        Controller    *source;
+        Controller    *dest;
+        void          *m_arg;
+        bool           annuled;
+        bool           has_data;
+        bool           shared;
+
+        int  srcNode;
+        int  destNode;
+        int  node;
+        int  inLink;
+        int  vc;
+        int  vcClass;
+        int  flits;
+        int  hops;
+        W64  injectCycle;
+        Packet *nextWaiter;
+
+        void init() {
+            request    = NULL;
+            source     = NULL;
+            dest       = NULL;
+            m_arg      = NULL;
+            annuled    = 0;
+            has_data   = 0;
+            shared     = 0;
+            inLink     = -1;
+            vc         = -1;
+            vcClass    = 0;
+            hops       = 0;
+            nextWaiter = NULL;
+        }
+
+        void setup(const Message &msg) {
+            source   = (Controller*)msg.sender;
+            dest     = (Controller*)msg.dest;
+            request  = msg.request;
+            m_arg    = msg.arg;
+            has_data = msg.hasData;
+            shared   = msg.isShared;
+            request->incRefCounter();
+        }
+
+        void fill(Message &msg) const {
+            msg.origin   = source;
+            msg.dest     = dest;
+            msg.request  = request;
+            msg.arg      = m_arg;
+            msg.hasData  = has_data;
+            msg.isShared = shared;
+        }
+
+        ostream& print(ostream& os) const {
+            if (!request) {
+                os << "Free packet";
+                return os;
+            }
+
+            os << "request[", *request, "] ";
+            os << "source[", source->get_name(), "] ";
+            os << "dest[", dest->get_name(), "] ";
+            os << "node[", node, "->", destNode, "] ";
+            os << "vc[", vc, "] ";
+            os << "hops[", hops, "] ";
+            os << "annuled[", annuled, "]";
+            return os;
+        }
+    };
+
+    static inline ostream& operator <<(ostream& os, const Packet &packet)
+    {
+        return packet.print(os);
+    }
+
+    /*
+     * Directed link from a router output port to the input port of the
+     * neighbour router. 'credits' track the free flit buffers of each
+     * virtual channel at the receiving end; a packet allocates a VC with
+     * room for all of its flits (virtual cut-through) and returns the
+     * credits when it leaves that router. Packets that find no VC wait on
+     * the link until credits come back.
+     */
+    struct Link
+    {
+        W64     busyUntil;
+        int     credits[NOC_MAX_VCS];
+        Packet *waitHead;
+        Packet *waitTail;
+
+        void reset(int vcs, int buffers) {
+            busyUntil = 0;
+            foreach (i, NOC_MAX_VCS)
+                credits[i] = (i < vcs) ? buffers : 0;
+            waitHead = NULL;
+            waitTail = NULL;
+        }
+
+        /* Allocate one of VCs [first, first + count), -1 if all are full */
+        int alloc_vc(int first, int count, int flits) {
+            for (int vc = first; vc < first + count; vc++) {
+                if (credits[vc] >= flits) {
+                    credits[vc] -= flits;
+                    return vc;
+                }
+            }
+            return -1;
+        }
+
+        void release_vc(int vc, int flits) {
+            credits[vc] += flits;
+        }
+
+        /* Reserve the link for 'flits' cycles, returns the start cycle */
+        W64 reserve(W64 cycle, int flits) {
+            W64 start = max(cycle, busyUntil);
+            busyUntil = start + flits;
+            return start;
+        }
+
+        void add_waiter(Packet *packet) {
+            packet->nextWaiter = NULL;
+            if (waitTail)
+                waitTail->nextWaiter = packet;
+            else
+                waitHead = packet;
+            waitTail = packet;
+        }
+    };
+
+    struct NodeInfo {
+        Controller *controller;
+        int         node;
+    };
+
+    /*
+     * @brief Packet switched network-on-chip base
+     *
+     * Each registered controller is attached to a router node, either from
+     * the 'placement' option or to the next free node in registration
+     * order. Messages are split into flits and routed hop by hop with
+     * credit based flow control between routers. Everything is event
+     * driven per packet hop, so idle routers cost nothing.
+     *
+     * Machine config options of the interconnect:
+     *
+     *   option:
+     *       nodes: 64              # router count, default: controller count
+     *       width: 8               # mesh columns, default: sqrt(nodes)
+     *       router_latency: 1      # cycles per router traversal
+     *       link_latency: 1        # cycles per link traversal
+     *       flit_bytes: 16         # link width
+     *       data_bytes: 64         # payload of messages carrying data
+     *       vcs: 2                 # virtual channels per input port
+     *       vc_buffers: 8          # flit buffers per virtual channel
+     *       inject_queue: 16       # packets in flight per node
+     *       placement: "L3_0:27, DIR_0:36, MEM_0:0"
+     */
+    class Network : public Interconnect
+    {
+        protected:
+            dynarray<NodeInfo> controllers_;
+            dynarray<int> inFlight_;
+            dynarray<Link> links_;
+            FixStateList<Packet, NOC_MAX_PACKETS> packets_;
+
+            Signal route_;
+            Signal deliver_;
+
+            stringbuf placement_;
+            int configNodes_;
+            int nodes_;
+            int routerLatency_;
+            int linkLatency_;
+            int flitBytes_;
+            int dataFlits_;
+            int vcs_;
+            int vcBuffers_;
+            int injectQueue_;
+
+            NetworkStats new_stats;
+
+            bool node_used(int node) const;
+            int  get_node(Controller *cont) const;
+            int  placed_node(Controller *cont) const;
+            void setup_links();
+            void wake_waiters(Link &link);
+            void release_packet(Packet *packet);
+
+            virtual void setup_topology(int minNodes) = 0;
+            virtual int  route(int node, int dest) const = 0;
+            virtual int  next_node(int node, int port) const = 0;
+            virtual int  vc_class(Packet *packet, int port) const {
+                return 0;
+            }
+            virtual int  vc_classes() const { return 1; }
+            virtual const char* topology() const = 0;
+            virtual void dump_topology(YAML::Emitter &out) const {}
+
+        public:
+            Network(const char *name, MemoryHierarchy *memoryHierarchy);
+            virtual ~Network();
+
+            bool controller_request_cb(void *arg);
+            void register_controller(Controller *controller);
+            int  access_fast_path(Controller *controller,
+                    MemoryRequest *request);
+            void annul_request(MemoryRequest *request);
+            int  get_delay() { return routerLatency_ + linkLatency_; }
+            void dump_configuration(YAML::Emitter &out) const;
+
+            bool route_cb(void *arg);
+            bool deliver_cb(void *arg);
+
+            int get_nodes() const { return nodes_; }
+
+            void print(ostream& os) const {
+                os << "--", topology(), "-Interconnect: ", get_name(), endl;
+                os << packets_;
+                os << "--End-", topology(), "-Interconnect\n";
+            }
+
+            void print_map(ostream& os) {
+                os << topology(), " Interconnect: ", get_name(), endl;
+                os << "\tconnected to: ", endl;
+
+                foreach (i, controllers_.count()) {
+                    os << "\t\tnode[", controllers_[i].node, "]: ";
+                    os << controllers_[i].controller->get_name(), endl;
+                }
+            }
+    };
+
+    /* 2D mesh with XY routing, unused corner routers are simply idle */
+    class Mesh : public Network
+    {
+        private:
+            int configWidth_;
+            int width_;
+
+        protected:
+            void setup_topology(int minNodes);
+
+            int route(int node, int dest) const {
+                return mesh_route(node, dest, width_);
+            }
+
+            int next_node(int node, int port) const {
+                return mesh_next(node, port, width_);
+            }
+
+            const char* topology() const { return "Mesh"; }
+            void dump_topology(YAML::Emitter &out) const;
+
+        public:
+            Mesh(const char *name, MemoryHierarchy *memoryHierarchy);
+    };
+
+    /*
+     * Bidirectional ring with shortest path routing. VCs are split in two
+     * classes and packets switch to the upper class when crossing the wrap
+     * around link, which breaks the cyclic buffer dependency.
+     */
+    class Ring : public Network
+    {
+        protected:
+            void setup_topology(int minNodes);
+
+            int route(int node, int dest) const {
+                return ring_route(node, dest, nodes_);
+            }
+
+            int next_node(int node, int port) const {
+                return ring_next(node, port, nodes_);
+            }
+
+            int vc_class(Packet *packet, int port) const {
+                if (packet->vcClass || ring_wraps(packet->node, port, nodes_))
+                    return 1;
+                return 0;
+            }
+
+            int vc_classes() const { return 2; }
+
+            const char* topology() const { return "Ring"; }
+
+        public:
+            Ring(const char *name, MemoryHierarchy *memoryHierarchy);
+    };
+
+    static inline ostream& operator <<(ostream& os, const Network &net)
+    {
+        net.print(os);
+        return os;
+    }
+};
+
+};
+
+#endif // NOC_H
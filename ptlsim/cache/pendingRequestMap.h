@@ -0,0 +1,214 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PENDING_REQUEST_MAP_H
+#define PENDING_REQUEST_MAP_H
+
+#include <globals.h>
+#include <superstl.h>
+
+namespace Memory {
+
+/*
+ * PendingRequestMap
+ *
+ * Index of a FixStateList based pending queue by line address. Each line
+ * address present in the queue owns one slot of an open-addressed (linear
+ * probing) table; the slot keeps the head and tail of a FIFO chain of queue
+ * entry indices, so requests to the same line are returned in the same order
+ * they were added to the queue.
+ *
+ * Entries are identified by their FixStateListObject::idx, so the map itself
+ * never stores a pointer and can be reset along with the queue.
+ *
+ * SIZE      : number of entries in the indexed queue
+ * LINE_BITS : number of low address bits ignored for the lookup key
+ */
+template <int SIZE, int LINE_BITS = 6>
+class PendingRequestMap
+{
+	private:
+		/* Keep load factor at or below 0.5 so probe chains stay short */
+		static const int SLOT_BITS = log2(SIZE) + 2;
+		static const int SLOT_COUNT = 1 << SLOT_BITS;
+		static const int SLOT_MASK = SLOT_COUNT - 1;
+
+		struct Slot {
+			W64 tag;
+			int head;
+			int tail;
+		};
+
+		Slot slots_[SLOT_COUNT];
+		int next_[SIZE];
+		int count_;
+
+		static W64 tag_of(W64 addr) {
+			return addr >> LINE_BITS;
+		}
+
+		static int hash_of(W64 tag) {
+			return int((tag * 0x9e3779b97f4a7c15ULL) >> (64 - SLOT_BITS));
+		}
+
+		int find_slot(W64 tag) const {
+			int slot = hash_of(tag);
+			while(slots_[slot].head >= 0 && slots_[slot].tag != tag) {
+				slot = (slot + 1) & SLOT_MASK;
+			}
+			return slot;
+		}
+
+		/*
+		 * Remove slot from the table using backward shift deletion so
+		 * lookups never have to skip over tombstones.
+		 */
+		void erase_slot(int hole) {
+			int slot = hole;
+			for(;;) {
+				slot = (slot + 1) & SLOT_MASK;
+				if(slots_[slot].head < 0)
+					break;
+
+				int home = hash_of(slots_[slot].tag);
+				if(((slot - home) & SLOT_MASK) >= ((slot - hole) & SLOT_MASK)) {
+					slots_[hole] = slots_[slot];
+					hole = slot;
+				}
+			}
+			slots_[hole].head = -1;
+			slots_[hole].tail = -1;
+		}
+
+	public:
+		PendingRequestMap() {
+			reset();
+		}
+
+		void reset() {
+			foreach(i, SLOT_COUNT) {
+				slots_[i].tag = 0;
+				slots_[i].head = -1;
+				slots_[i].tail = -1;
+			}
+			foreach(i, SIZE) {
+				next_[i] = -1;
+			}
+			count_ = 0;
+		}
+
+		/* Append queue entry 'idx' to the chain of 'addr' */
+		void add(W64 addr, int idx) {
+			assert(idx >= 0 && idx < SIZE);
+			W64 tag = tag_of(addr);
+			Slot &slot = slots_[find_slot(tag)];
+
+			next_[idx] = -1;
+			if(slot.head < 0) {
+				slot.tag = tag;
+				slot.head = idx;
+			} else {
+				next_[slot.tail] = idx;
+			}
+			slot.tail = idx;
+			count_++;
+		}
+
+		/* Remove queue entry 'idx' from the chain of 'addr' */
+		void remove(W64 addr, int idx) {
+			int slotId = find_slot(tag_of(addr));
+			Slot &slot = slots_[slotId];
+			assert(slot.head >= 0);
+
+			int prev = -1;
+			int entry = slot.head;
+			while(entry != idx) {
+				assert(entry >= 0);
+				prev = entry;
+				entry = next_[entry];
+			}
+
+			if(prev < 0)
+				slot.head = next_[idx];
+			else
+				next_[prev] = next_[idx];
+
+			if(slot.tail == idx)
+				slot.tail = prev;
+
+			next_[idx] = -1;
+			count_--;
+
+			if(slot.head < 0)
+				erase_slot(slotId);
+		}
+
+		/* Oldest queue entry index for 'addr', -1 if none */
+		int head(W64 addr) const {
+			return slots_[find_slot(tag_of(addr))].head;
+		}
+
+		/* Youngest queue entry index for 'addr', -1 if none */
+		int tail(W64 addr) const {
+			return slots_[find_slot(tag_of(addr))].tail;
+		}
+
+		/* Next younger queue entry to the same line, -1 if none */
+		int next(int idx) const {
+			return next_[idx];
+		}
+
+		int count() const {
+			return count_;
+		}
+
+		bool empty() const {
+			return count_ == 0;
+		}
+
+		ostream& print(ostream& os) const {
+			os << "PendingRequestMap<", SIZE, " entries, ", SLOT_COUNT,
+			   " slots> containing ", count_, " entries:", endl;
+			foreach(i, SLOT_COUNT) {
+				if(slots_[i].head < 0)
+					continue;
+				os << "  slot[", i, "] line[0x",
+				   hexstring(slots_[i].tag << LINE_BITS, 48), "]:";
+				for(int idx = slots_[i].head; idx >= 0; idx = next_[idx])
+					os << " ", idx;
+				os << endl;
+			}
+			return os;
+		}
+};
+
+template <int SIZE, int LINE_BITS>
+static inline ostream& operator <<(ostream& os,
+		const PendingRequestMap<SIZE, LINE_BITS>& map)
+{
+	return map.print(os);
+}
+
+};
+
+#endif // PENDING_REQUEST_MAP_H
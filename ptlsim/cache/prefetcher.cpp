@@ -0,0 +1,336 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <prefetcher.h>
+#include <machine.h>
+
+using namespace Memory;
+
+void Prefetcher::dump_configuration(YAML::Emitter &out) const
+{
+    YAML_KEY_VAL(out, "prefetcher", type_);
+    YAML_KEY_VAL(out, "prefetch_degree", degree_);
+    YAML_KEY_VAL(out, "prefetch_distance", distance_);
+    YAML_KEY_VAL(out, "prefetch_table_size", tableSize_);
+}
+
+/* Next line prefetcher */
+
+NextLinePrefetcher::NextLinePrefetcher(int lineBits, int degree,
+        int distance)
+    : Prefetcher("next_line", lineBits, degree ? degree : 1,
+            distance ? distance : 1, 0)
+{ }
+
+void NextLinePrefetcher::next_lines(W64 line, dynarray<W64>& lines)
+{
+    foreach (i, degree_) {
+        W64 next = line + distance_ + i;
+        if (!same_page(line, next))
+            break;
+        lines.push(next);
+    }
+}
+
+void NextLinePrefetcher::miss(MemoryRequest *request, dynarray<W64>& lines)
+{
+    next_lines(request->get_physical_address() >> lineBits_, lines);
+}
+
+void NextLinePrefetcher::hit(MemoryRequest *request, bool prefetched,
+        dynarray<W64>& lines)
+{
+    /* Tagged prefetch: first use of a prefetched line continues the run */
+    if (prefetched)
+        next_lines(request->get_physical_address() >> lineBits_, lines);
+}
+
+/* Stride prefetcher */
+
+StridePrefetcher::StridePrefetcher(int lineBits, int degree, int distance,
+        int tableSize)
+    : Prefetcher("stride", lineBits, degree ? degree : 2,
+            distance ? distance : 1, tableSize ? tableSize : 64)
+{
+    table_.resize(tableSize_);
+    foreach (i, tableSize_) {
+        table_[i].rip = -1;
+        table_[i].lastAddr = 0;
+        table_[i].stride = 0;
+        table_[i].confidence = 0;
+    }
+}
+
+void StridePrefetcher::train(MemoryRequest *request, dynarray<W64>& lines)
+{
+    W64 rip = request->get_owner_rip();
+
+    if (request->is_instruction() || rip == (W64)-1)
+        return;
+
+    Entry& entry = table_[(rip ^ (rip >> 16)) % tableSize_];
+    W64 addr = request->get_physical_address();
+
+    if (entry.rip != rip) {
+        entry.rip = rip;
+        entry.lastAddr = addr;
+        entry.stride = 0;
+        entry.confidence = 0;
+        return;
+    }
+
+    W64s stride = addr - entry.lastAddr;
+    if (stride == 0)
+        return;
+
+    if (stride == entry.stride) {
+        if (entry.confidence < 3) entry.confidence++;
+    } else {
+        if (entry.confidence > 0) entry.confidence--;
+        if (entry.confidence == 0) entry.stride = stride;
+    }
+
+    W64 line = addr >> lineBits_;
+    bool newLine = (line != (entry.lastAddr >> lineBits_));
+    entry.lastAddr = addr;
+
+    /* Small strides only trigger when the access moves to a new line */
+    if (entry.confidence < 1 || stride != entry.stride || !newLine)
+        return;
+
+    W64s lineStride = stride >> lineBits_;
+    if (lineStride == 0)
+        lineStride = (stride > 0) ? 1 : -1;
+
+    foreach (i, degree_) {
+        W64 next = line + lineStride * (distance_ + i);
+        if (!same_page(line, next))
+            break;
+        lines.push(next);
+    }
+}
+
+void StridePrefetcher::miss(MemoryRequest *request, dynarray<W64>& lines)
+{
+    train(request, lines);
+}
+
+void StridePrefetcher::hit(MemoryRequest *request, bool prefetched,
+        dynarray<W64>& lines)
+{
+    train(request, lines);
+}
+
+/* Stream buffer prefetcher */
+
+StreamPrefetcher::StreamPrefetcher(int lineBits, int degree, int distance,
+        int tableSize)
+    : Prefetcher("stream", lineBits, degree ? degree : 2,
+            distance ? distance : 8, tableSize ? tableSize : 8)
+    , useCounter_(0)
+{
+    streams_.resize(tableSize_);
+    foreach (i, tableSize_) {
+        streams_[i].valid = false;
+        streams_[i].lastUse = 0;
+    }
+}
+
+StreamPrefetcher::Stream* StreamPrefetcher::find_stream(W64 line)
+{
+    foreach (i, streams_.count()) {
+        Stream& stream = streams_[i];
+        W64s delta = line - stream.lastLine;
+
+        if (stream.valid && delta <= distance_ && delta >= -distance_)
+            return &stream;
+    }
+
+    return NULL;
+}
+
+void StreamPrefetcher::train(MemoryRequest *request, dynarray<W64>& lines)
+{
+    W64 line = request->get_physical_address() >> lineBits_;
+    Stream *stream = find_stream(line);
+    W64 now = ++useCounter_;
+
+    if (!stream) {
+        /* Allocate in place of an invalid or least recently used stream */
+        stream = &streams_[0];
+        foreach (i, streams_.count()) {
+            if (!streams_[i].valid) {
+                stream = &streams_[i];
+                break;
+            }
+            if (streams_[i].lastUse < stream->lastUse)
+                stream = &streams_[i];
+        }
+
+        stream->valid = true;
+        stream->lastLine = line;
+        stream->nextLine = line;
+        stream->direction = 0;
+        stream->lastUse = now;
+        return;
+    }
+
+    stream->lastUse = now;
+
+    if (stream->direction == 0) {
+        if (line == stream->lastLine)
+            return;
+        stream->direction = (line > stream->lastLine) ? 1 : -1;
+        stream->nextLine = line + stream->direction;
+    }
+
+    int dir = stream->direction;
+
+    if (W64s(line - stream->lastLine) * dir > 0)
+        stream->lastLine = line;
+
+    if (W64s(stream->nextLine - line) * dir <= 0)
+        stream->nextLine = line + dir;
+
+    foreach (i, degree_) {
+        W64 next = stream->nextLine;
+        if (W64s(next - line) * dir > distance_ || !same_page(line, next))
+            break;
+        lines.push(next);
+        stream->nextLine += dir;
+    }
+}
+
+void StreamPrefetcher::miss(MemoryRequest *request, dynarray<W64>& lines)
+{
+    if (!request->is_instruction())
+        train(request, lines);
+}
+
+void StreamPrefetcher::hit(MemoryRequest *request, bool prefetched,
+        dynarray<W64>& lines)
+{
+    if (prefetched && !request->is_instruction())
+        train(request, lines);
+}
+
+/* Prefetcher Builders */
+
+PrefetcherBuilder::PrefetcherBuilder(const char *name)
+{
+    if (!prefetcherBuilders) {
+        prefetcherBuilders = new Hashtable<const char*,
+            PrefetcherBuilder*, 1>();
+    }
+    prefetcherBuilders->add(name, this);
+}
+
+Hashtable<const char*, PrefetcherBuilder*, 1>
+    *PrefetcherBuilder::prefetcherBuilders = NULL;
+
+Prefetcher* PrefetcherBuilder::get_prefetcher(BaseMachine& machine,
+        const char *name, int lineBits)
+{
+    stringbuf type;
+
+    if (!machine.get_option(name, "prefetcher", type) ||
+            strequal(type.buf, "none"))
+        return NULL;
+
+    PrefetcherBuilder **builder = prefetcherBuilders->get(type.buf);
+
+    if (!builder) {
+        stringbuf err;
+        err << "::ERROR::Can't find prefetcher '" << type << "' for cache '"
+            << name << "'. Please check your config file." << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(builder);
+    }
+
+    int degree = 0;
+    int distance = 0;
+    int tableSize = 0;
+
+    machine.get_option(name, "prefetch_degree", degree);
+    machine.get_option(name, "prefetch_distance", distance);
+    machine.get_option(name, "prefetch_table_size", tableSize);
+
+    if (degree < 0 || distance < 0 || tableSize < 0) {
+        stringbuf err;
+        err << "::ERROR::Prefetcher options of cache '" << name
+            << "' must not be negative." << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(0);
+    }
+
+    return (*builder)->get_new_prefetcher(lineBits, degree, distance,
+            tableSize);
+}
+
+struct NextLinePrefetcherBuilder : public PrefetcherBuilder
+{
+    NextLinePrefetcherBuilder(const char *name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(int lineBits, int degree, int distance,
+            int tableSize) {
+        return new NextLinePrefetcher(lineBits, degree, distance);
+    }
+};
+
+struct StridePrefetcherBuilder : public PrefetcherBuilder
+{
+    StridePrefetcherBuilder(const char *name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(int lineBits, int degree, int distance,
+            int tableSize) {
+        return new StridePrefetcher(lineBits, degree, distance, tableSize);
+    }
+};
+
+struct StreamPrefetcherBuilder : public PrefetcherBuilder
+{
+    StreamPrefetcherBuilder(const char *name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(int lineBits, int degree, int distance,
+            int tableSize) {
+        return new StreamPrefetcher(lineBits, degree, distance, tableSize);
+    }
+};
+
+NextLinePrefetcherBuilder nextLinePrefetcherBuilder("next_line");
+StridePrefetcherBuilder stridePrefetcherBuilder("stride");
+StreamPrefetcherBuilder streamPrefetcherBuilder("stream");
@@ -0,0 +1,191 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <memoryRequest.h>
+
+#include <yaml/yaml.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    /*
+     * Hardware prefetcher of a coherent cache
+     *
+     * The cache controller calls 'miss' for every demand miss and 'hit'
+     * for every demand hit, with 'prefetched' set when the hit line was
+     * brought in by the prefetcher and not used yet. The engine pushes
+     * line addresses (physical address >> line bits) it wants to prefetch
+     * into 'lines'; the controller issues them as normal read requests
+     * from the cache's request queue.
+     *
+     * Engines are selected per cache with machine config options:
+     *
+     *   option:
+     *       prefetcher: stride       # next_line, stride or stream
+     *       prefetch_degree: 2       # lines prefetched per trigger
+     *       prefetch_distance: 4     # how far ahead to prefetch
+     *       prefetch_table_size: 64  # stride table entries or streams
+     *
+     * Options that are not given use the engine's default.
+     */
+    class Prefetcher
+    {
+        protected:
+            const char *type_;
+            int lineBits_;
+            int degree_;
+            int distance_;
+            int tableSize_;
+
+            /* Prefetching never crosses a physical page */
+            bool same_page(W64 line1, W64 line2) const {
+                return ((line1 ^ line2) >> (12 - lineBits_)) == 0;
+            }
+
+        public:
+            Prefetcher(const char *type, int lineBits, int degree,
+                    int distance, int tableSize)
+                : type_(type)
+                  , lineBits_(lineBits)
+                  , degree_(degree)
+                  , distance_(distance)
+                  , tableSize_(tableSize)
+            {}
+
+            virtual ~Prefetcher() {}
+
+            virtual void miss(MemoryRequest *request,
+                    dynarray<W64>& lines) = 0;
+
+            virtual void hit(MemoryRequest *request, bool prefetched,
+                    dynarray<W64>& lines) {}
+
+            const char* get_type() const { return type_; }
+
+            void dump_configuration(YAML::Emitter &out) const;
+    };
+
+    /* Prefetch the next 'degree' lines after a miss or a prefetched hit */
+    class NextLinePrefetcher : public Prefetcher
+    {
+        private:
+            void next_lines(W64 line, dynarray<W64>& lines);
+
+        public:
+            NextLinePrefetcher(int lineBits, int degree, int distance);
+
+            void miss(MemoryRequest *request, dynarray<W64>& lines);
+            void hit(MemoryRequest *request, bool prefetched,
+                    dynarray<W64>& lines);
+    };
+
+    /*
+     * PC indexed stride prefetcher (reference prediction table)
+     *
+     * Each load/store PC has a direct mapped entry with last address,
+     * stride and a 2 bit confidence counter. Once the same stride is seen
+     * twice, 'degree' lines at 'distance' strides ahead are prefetched.
+     */
+    class StridePrefetcher : public Prefetcher
+    {
+        private:
+            struct Entry {
+                W64 rip;
+                W64 lastAddr;
+                W64s stride;
+                int confidence;
+            };
+
+            dynarray<Entry> table_;
+
+            void train(MemoryRequest *request, dynarray<W64>& lines);
+
+        public:
+            StridePrefetcher(int lineBits, int degree, int distance,
+                    int tableSize);
+
+            void miss(MemoryRequest *request, dynarray<W64>& lines);
+            void hit(MemoryRequest *request, bool prefetched,
+                    dynarray<W64>& lines);
+    };
+
+    /*
+     * Stream buffer prefetcher
+     *
+     * A miss that is not within 'distance' lines of a tracked stream
+     * allocates a new stream (LRU replaced). The second miss near it sets
+     * the direction and from then on every miss or prefetched hit in the
+     * stream moves its prefetch frontier up to 'distance' lines ahead of
+     * the access, at most 'degree' lines per access.
+     */
+    class StreamPrefetcher : public Prefetcher
+    {
+        private:
+            struct Stream {
+                W64 lastLine;
+                W64 nextLine;
+                W64 lastUse;
+                int direction;
+                bool valid;
+            };
+
+            dynarray<Stream> streams_;
+            W64 useCounter_;
+
+            Stream* find_stream(W64 line);
+            void train(MemoryRequest *request, dynarray<W64>& lines);
+
+        public:
+            StreamPrefetcher(int lineBits, int degree, int distance,
+                    int tableSize);
+
+            void miss(MemoryRequest *request, dynarray<W64>& lines);
+            void hit(MemoryRequest *request, bool prefetched,
+                    dynarray<W64>& lines);
+    };
+
+    struct PrefetcherBuilder {
+        PrefetcherBuilder(const char *name);
+        virtual Prefetcher* get_new_prefetcher(int lineBits, int degree,
+                int distance, int tableSize) = 0;
+        static Hashtable<const char*, PrefetcherBuilder*, 1>
+            *prefetcherBuilders;
+
+        /*
+         * Create prefetcher configured for cache 'name' in machine
+         * config, NULL if it has no prefetcher
+         */
+        static Prefetcher* get_prefetcher(BaseMachine& machine,
+                const char *name, int lineBits);
+    };
+
+};
+
+#endif // PREFETCHER_H
@@ -1821,7 +1821,9 @@ void AtomThread::reset()
     op_waiting_to_writeback_list.reset();
     op_ready_to_writeback_list.reset();
 
-    branchpred.init(core.get_coreid(), threadid);
+    /* Keep predictor trained by -fast-fwd-warming */
+    if(!config.fast_fwd_warming || !branchpred.impl)
+        branchpred.init(core.get_coreid(), threadid);
     branches_in_flight = 0;
 
     foreach(i, NUM_ATOM_OPS_PER_THREAD) {
@@ -1993,39 +1995,24 @@ bool AtomThread::fetch_check_current_bb()
     // We need to fetch new basic block from the buffer.
     fetchrip.update(ctx);
 
-    if(current_bb) {
-        current_bb->release();
-        current_bb = NULL;
-    }
+    // Old block is released once the new one is chained to it
+    BasicBlock *prev = current_bb;
 
-    BasicBlock *bb = bbcache[ctx.cpu_index](fetchrip);
+    // New block comes back acquired so its not flushed out
+    current_bb = bbcache.fetch(ctx, prev, fetchrip);
 
-    if likely (bb) {
-        current_bb = bb;
-    } else {
-        current_bb = bbcache[ctx.cpu_index].translate(ctx, fetchrip);
-
-        if unlikely (!current_bb) {
-            if(fetchrip.rip == ctx.eip) {
-                // Its a page fault in I-Cache
-                itlb_exception = true;
-                itlb_exception_addr = ctx.exec_fault_addr;
-                ATOMTHLOG1("ITLB Execption addr ",
-                        hexstring(itlb_exception_addr,48), " fetchrip ",
-                        hexstring(fetchrip.rip,48));
-            }
+    if unlikely (!current_bb) {
+        if(fetchrip.rip == ctx.eip) {
+            // Its a page fault in I-Cache
+            itlb_exception = true;
+            itlb_exception_addr = ctx.exec_fault_addr;
+            ATOMTHLOG1("ITLB Execption addr ",
+                    hexstring(itlb_exception_addr,48), " fetchrip ",
+                    hexstring(fetchrip.rip,48));
         }
     }
 
     if(current_bb) {
-        // acquire a lock on this basic block so its not flushed out
-        current_bb->acquire();
-        current_bb->use(sim_cycle);
-
-        if(!current_bb->synthops) {
-            synth_uops_for_bb(*current_bb);
-        }
-
         bb_transop_index = 0;
 
         st_fetch.bbs++;
@@ -2680,6 +2667,11 @@ bool AtomThread::commit_queue()
         if(buf.op->eom || commit_result == COMMIT_BARRIER) {
             total_insns_committed++;
             st_commit.insns++;
+            ctx.insns_committed++;
+
+            /* Replayed event is due right after this instruction */
+            if unlikely (ctx.insns_committed >= ctx.event_replay_insn)
+                handle_interrupt_at_next_eom = 1;
             break;
         }
     }
@@ -3151,6 +3143,7 @@ bool AtomCore::runcycle(void* none)
 
     if(exit_requested) {
         ATOMCORELOG("Exit to qemu requested");
+        parallel_serialize();
         machine.ret_qemu_env = &running_thread->ctx;
         return exit_requested;
     }
@@ -3241,8 +3234,11 @@ void AtomCore::reset()
         threads[i]->reset();
     }
 
-    dtlb.reset();
-    itlb.reset();
+    /* Keep TLB entries filled by -fast-fwd-warming */
+    if(!config.fast_fwd_warming) {
+        dtlb.reset();
+        itlb.reset();
+    }
     fetchq.reset();
 
     forwardbuf.reset();
@@ -3283,6 +3279,51 @@ void AtomCore::flush_tlb_virt(Context& ctx, Waddr virtaddr)
     }
 }
 
+/**
+ * @brief Warm TLBs and caches with an access done in emulation mode
+ *
+ * @param ctx Context that did the access
+ * @param virtaddr Virtual address of the access
+ * @param physaddr Physical address of the access
+ * @param is_store Access is a store
+ * @param is_code Access is an instruction fetch
+ */
+void AtomCore::warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+        bool is_store, bool is_code)
+{
+    foreach(i, threadcount) {
+        if(threads[i]->ctx.cpu_index == ctx.cpu_index) {
+            if(is_code)
+                itlb.insert(virtaddr, i);
+            else
+                dtlb.insert(virtaddr, i);
+
+            memoryHierarchy->warm_access(get_coreid(), i, physaddr,
+                    is_code, is_store);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Train branch predictor with a branch done in emulation mode
+ *
+ * @param ctx Context that executed the branch
+ * @param ripafter Address of instruction after the branch
+ * @param target Branch target
+ * @param taken Branch outcome
+ */
+void AtomCore::warm_branch(Context& ctx, W64 ripafter, W64 target,
+        bool taken)
+{
+    foreach(i, threadcount) {
+        if(threads[i]->ctx.cpu_index == ctx.cpu_index) {
+            threads[i]->branchpred.warm(ripafter, target, taken);
+            break;
+        }
+    }
+}
+
 void AtomCore::dump_state(ostream& os)
 {
     os << *this;
@@ -1044,6 +1044,9 @@ namespace ATOM_CORE_MODEL {
         void check_ctx_changes();
         void flush_tlb(Context& ctx);
         void flush_tlb_virt(Context& ctx, Waddr virtaddr);
+        void warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+                bool is_store, bool is_code);
+        void warm_branch(Context& ctx, W64 ripafter, W64 target, bool taken);
         void dump_state(ostream& os);
         void update_stats();
         void flush_pipeline();
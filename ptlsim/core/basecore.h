@@ -35,6 +35,43 @@ namespace Core {
             virtual void flush_pipeline() = 0;
 		    virtual void dump_configuration(YAML::Emitter &out) const = 0;
 
+            /**
+             * @brief Earliest cycle at which this core can make progress
+             * on its own
+             *
+             * @return sim_cycle if core did any work in last cycle, -1 if
+             * it only waits for memory or interrupt events
+             *
+             * Used by -skip-idle-cycles. A core that reports an idle cycle
+             * must behave the same in all following cycles until one of
+             * its memory requests is completed or an interrupt arrives.
+             */
+            virtual W64 get_next_active_cycle() { return sim_cycle; }
+
+            /**
+             * @brief Skip given number of idle cycles
+             *
+             * Called after stats updated in the idle cycles were replayed,
+             * only need to update state that is not part of stats.
+             */
+            virtual void skip_cycles(W64 cycles) {}
+
+            /**
+             * @brief Functional warming with a memory access done in
+             * emulation mode by given Context (-fast-fwd-warming)
+             *
+             * Cores that don't run this Context ignore it.
+             */
+            virtual void warm_mem(Context& ctx, Waddr virtaddr,
+                    W64 physaddr, bool is_store, bool is_code) {}
+
+            /**
+             * @brief Functional warming with a conditional branch done
+             * in emulation mode by given Context
+             */
+            virtual void warm_branch(Context& ctx, W64 ripafter,
+                    W64 target, bool taken) {}
+
             void update_memory_hierarchy_ptr();
 
             BaseMachine& machine;
@@ -466,6 +466,12 @@ void BranchPredictorInterface::annulras(const PredictorUpdate& predinfo) {
   impl->annulras(predinfo);
 };
 
+void BranchPredictorInterface::warm(W64 branchaddr, W64 target, bool taken) {
+  PredictorUpdate update;
+  impl->predict(update, BRANCH_HINT_COND, branchaddr, target);
+  impl->update(update, branchaddr, (taken) ? target : branchaddr);
+}
+
 void BranchPredictorInterface::flush() { }
 
 ostream& operator <<(ostream& os, const BranchPredictorInterface& branchpred) {
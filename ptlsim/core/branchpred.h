@@ -72,6 +72,8 @@ struct BranchPredictorInterface {
   void update(PredictorUpdate& update, W64 branchaddr, W64 target);
   void updateras(PredictorUpdate& predinfo, W64 branchaddr);
   void annulras(const PredictorUpdate& predinfo);
+  // Train on a conditional branch seen outside of the pipeline:
+  void warm(W64 branchaddr, W64 target, bool taken);
   void flush();
 };
 
@@ -321,14 +321,15 @@ void ThreadContext::reset_fetch_unit(W64 realrip) {
 
 /**
  * @brief Process any pending self-modifying code invalidate requests. This must
- * be called on all cores *after* flushing all pipelines, to ensure no stale BBs
- * are referenced, thus preventing them from being freed.
+ * be called *after* flushing the pipeline, so this thread holds no stale BBs.
+ * Stale BBs other cores still hold are retired by the shared BB cache and can't
+ * be fetched again, so invalidation always completes.
  */
 void ThreadContext::invalidate_smc() {
     if unlikely (smc_invalidate_pending) {
         if (logable(5)) ptl_logfile << "SMC invalidate pending on ", smc_invalidate_rvp, endl;
-        bbcache[ctx.cpu_index].invalidate_page(smc_invalidate_rvp.mfnlo, INVALIDATE_REASON_SMC);
-        if unlikely (smc_invalidate_rvp.mfnlo != smc_invalidate_rvp.mfnhi) bbcache[ctx.cpu_index].invalidate_page(smc_invalidate_rvp.mfnhi, INVALIDATE_REASON_SMC);
+        bbcache.invalidate_page(smc_invalidate_rvp.mfnlo, INVALIDATE_REASON_SMC, ctx.cpu_index);
+        if unlikely (smc_invalidate_rvp.mfnlo != smc_invalidate_rvp.mfnhi) bbcache.invalidate_page(smc_invalidate_rvp.mfnhi, INVALIDATE_REASON_SMC, ctx.cpu_index);
         smc_invalidate_pending = 0;
     }
 }
@@ -760,32 +761,22 @@ bool ThreadContext::fetch() {
  */
 BasicBlock* ThreadContext::fetch_or_translate_basic_block(const RIPVirtPhys& rvp) {
 
-    if likely (current_basic_block) {
-        /* Release our ref to the old basic block being fetched */
-        current_basic_block->release();
-        current_basic_block = NULL;
-    }
-
-    BasicBlock* bb = bbcache[ctx.cpu_index](rvp);
-
-    if likely (bb) {
-        current_basic_block = bb;
-    } else {
-        current_basic_block = bbcache[ctx.cpu_index].translate(ctx, rvp);
-        if (current_basic_block == NULL) return NULL;
-        assert(current_basic_block);
-    }
+    /*
+     * Keep our ref to the old basic block being fetched until the new
+     * one is chained to it, so it can't be reclaimed by translate.
+     */
+    BasicBlock* prev = current_basic_block;
+    current_basic_block = NULL;
 
-     /*
-      * Acquire a reference to the new basic block being fetched.
-      * This must be done right away so future allocations do not
-      * reclaim the BB while we still have a reference to it.
-      */
+    /*
+     * The new basic block comes back acquired, so future allocations
+     * do not reclaim it while we still have a reference to it.
+     */
+    BasicBlock* bb = bbcache.fetch(ctx, prev, rvp);
 
-    current_basic_block->acquire();
-    current_basic_block->use(sim_cycle);
+    if (bb == NULL) return NULL;
+    current_basic_block = bb;
 
-    if unlikely (!current_basic_block->synthops) synth_uops_for_bb(*current_basic_block);
     assert(current_basic_block->synthops);
 
     current_basic_block_transop_index = 0;
@@ -2270,6 +2261,11 @@ int ReorderBufferEntry::commit() {
         total_insns_committed++;
         thread.thread_stats.commit.insns++;
         thread.total_insns_committed++;
+        thread.ctx.insns_committed++;
+
+        /* Replayed event is due right after this instruction */
+        if unlikely (thread.ctx.insns_committed >= thread.ctx.event_replay_insn)
+            thread.handle_interrupt_at_next_eom = 1;
 
 #ifdef TRACE_RIP
             ptl_rip_trace << "commit_rip: ",
@@ -178,7 +178,10 @@ void ThreadContext::reset() {
     issueq_count = 0;
 #endif
     queued_mem_lock_release_count = 0;
-    branchpred.init(coreid, threadid);
+
+    /* Keep predictor trained by -fast-fwd-warming */
+    if(!config.fast_fwd_warming || !branchpred.impl)
+        branchpred.init(coreid, threadid);
 
     in_tlb_walk = 0;
 }
@@ -292,6 +295,7 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
  */
 void OooCore::reset() {
     round_robin_tid = 0;
+    idle_last_cycle = false;
     round_robin_reg_file_offset = 0;
 
     setzero(robs_on_fu);
@@ -515,6 +519,40 @@ int ThreadContext::get_priority() const {
     return priority;
 }
 
+/**
+ * @brief Check if thread has nothing to do until a memory request or an
+ * interrupt wakes it up
+ *
+ * Only uops waiting for operands or cache misses are allowed, anything that
+ * counts down or retries on its own makes the thread busy.
+ *
+ * @return true if thread is quiescent
+ */
+bool ThreadContext::is_quiescent() const {
+    if (!ctx.running) return true;
+
+    if (pause_counter || handle_interrupt_at_next_eom) return false;
+
+    if (!rob_frontend_list.empty() ||
+            !rob_ready_to_dispatch_list.empty() ||
+            !rob_tlb_miss_list.empty() ||
+            !rob_memory_fence_list.empty() ||
+            !rob_ready_to_commit_queue.empty())
+        return false;
+
+    for_each_cluster (cluster) {
+        if (!rob_ready_to_issue_list[cluster].empty() ||
+                !rob_ready_to_store_list[cluster].empty() ||
+                !rob_ready_to_load_list[cluster].empty() ||
+                !rob_issued_list[cluster].empty() ||
+                !rob_completed_list[cluster].empty() ||
+                !rob_ready_to_writeback_list[cluster].empty())
+            return false;
+    }
+
+    return true;
+}
+
 /**
  * @brief Execute one cycle of the entire core state machine
  *
@@ -611,6 +649,16 @@ bool OooCore::runcycle(void* none) {
 #endif
 #endif
 
+    /* Snapshot of frontend state to detect idle cycle */
+    int rob_count[threadcount];
+    int fetchq_count[threadcount];
+    W64 fetch_rip[threadcount];
+    foreach (i, threadcount) {
+        rob_count[i] = threads[i]->ROB.count;
+        fetchq_count[i] = threads[i]->fetchq.count;
+        fetch_rip[i] = threads[i]->fetchrip.rip;
+    }
+
     foreach (i, threadcount) threads[i]->loads_in_this_cycle = 0;
 
     fu_avail = bitmask(FU_COUNT);
@@ -679,7 +727,8 @@ bool OooCore::runcycle(void* none) {
         ptl_logfile << "OooCore::run():issue\n";
     }
 
-    for_each_cluster(i) { issue(i); }
+    int issuecount = 0;
+    for_each_cluster(i) { issuecount += issue(i); }
 
     /*
      * Most of the frontend (except fetch!) also works with round robin priority
@@ -809,14 +858,10 @@ bool OooCore::runcycle(void* none) {
                      *
                      *  BAD: machine.flush_all_pipelines();
                      *
-                     *  This is a temporary fix: in the *extremely* rare case where both
-                     *  threads have the same basic block in their pipelines and that
-                     *  BB is being invalidated, the BB cache will forbid us from
-                     *  freeing it (and will print a warning to that effect).
-                     *
-                     *  I'm working on a solution to this, to put some BBs on an
-                     *  "invisible" list, where they cannot be looked up anymore,
-                     *  but their memory is not freed until the lock is released.
+                     *  If other threads still have a basic block of the modified page
+                     *  in their pipelines, the BB cache retires it: it can't be looked
+                     *  up anymore, but its memory is not freed until the lock is
+                     *  released.
                      */
 
                     foreach (i, threadcount) {
@@ -871,8 +916,10 @@ bool OooCore::runcycle(void* none) {
                 }
         }
 
-        if(exiting)
+        if(exiting) {
+            parallel_serialize();
             machine.ret_qemu_env = &thread->ctx;
+        }
     }
 
     // return false;
@@ -931,11 +978,53 @@ bool OooCore::runcycle(void* none) {
         }
     }
 
+    idle_last_cycle = !exiting && !commitcount && !writecount &&
+        !dispatchcount && !issuecount;
+
+    foreach (i, threadcount) {
+        ThreadContext* thread = threads[i];
+        idle_last_cycle &= thread->is_quiescent() &&
+            thread->ROB.count == rob_count[i] &&
+            thread->fetchq.count == fetchq_count[i] &&
+            thread->fetchrip.rip == fetch_rip[i];
+    }
+
     core_stats.cycles++;
 
     return exiting;
 }
 
+/**
+ * @brief Earliest cycle at which the core may change its state without an
+ * external event
+ *
+ * @return sim_cycle if last cycle did any work, otherwise the cycle at
+ * which the deadlock check of a running thread will fire
+ */
+W64 OooCore::get_next_active_cycle() {
+    if (!idle_last_cycle) return sim_cycle;
+
+    W64 next = (W64)-1;
+    foreach (i, threadcount) {
+        ThreadContext* thread = threads[i];
+        if unlikely (!thread->ctx.running) continue;
+        next = min(next, thread->last_commit_at_cycle +
+                (W64)1024*1024*threadcount + 1);
+    }
+
+    return next;
+}
+
+/**
+ * @brief Skip idle cycles, stats are already updated by the caller
+ *
+ * @param cycles Number of skipped cycles
+ */
+void OooCore::skip_cycles(W64 cycles) {
+    round_robin_tid = add_index_modulo(round_robin_tid,
+            +int(cycles % threadcount), threadcount);
+}
+
 /*
  * ReorderBufferEntry
  */
@@ -1568,6 +1657,34 @@ void OooCore::flush_tlb_virt(Context& ctx, Waddr virtaddr) {
     /* FIXME AVADH DEFCORE */
 }
 
+void OooCore::warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+        bool is_store, bool is_code) {
+    foreach(i, threadcount) {
+        ThreadContext* thread = threads[i];
+        if(thread->ctx.cpu_index != ctx.cpu_index)
+            continue;
+
+        if(is_code)
+            thread->itlb.insert(virtaddr, thread->threadid);
+        else
+            thread->dtlb.insert(virtaddr, thread->threadid);
+
+        memoryHierarchy->warm_access(get_coreid(), thread->threadid,
+                physaddr, is_code, is_store);
+        break;
+    }
+}
+
+void OooCore::warm_branch(Context& ctx, W64 ripafter, W64 target, bool taken) {
+    foreach(i, threadcount) {
+        ThreadContext* thread = threads[i];
+        if(thread->ctx.cpu_index == ctx.cpu_index) {
+            thread->branchpred.warm(ripafter, target, taken);
+            break;
+        }
+    }
+}
+
 void OooCore::check_ctx_changes()
 {
     foreach(i, threadcount) {
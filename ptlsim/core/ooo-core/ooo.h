@@ -1079,6 +1079,7 @@ namespace OOO_CORE_MODEL {
         void redispatch_deadlock_recovery();
         void flush_mem_lock_release_list(int start = 0);
         int get_priority() const;
+        bool is_quiescent() const;
 
         void dump_smt_state(ostream& os);
         void print_smt_state(ostream& os);
@@ -1124,6 +1125,9 @@ namespace OOO_CORE_MODEL {
 
         byte round_robin_tid;
 
+        /* Last cycle only waited for memory or interrupts */
+        bool idle_last_cycle;
+
          /*
           * Issue Queues (one per cluster)
           */
@@ -1270,6 +1274,10 @@ namespace OOO_CORE_MODEL {
         void flush_tlb(Context& ctx);
         void flush_tlb_virt(Context& ctx, Waddr virtaddr);
 
+        void warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+                bool is_store, bool is_code);
+        void warm_branch(Context& ctx, W64 ripafter, W64 target, bool taken);
+
 		/* Cache Signals and Callbacks */
         Signal dcache_signal;
         Signal icache_signal;
@@ -1291,6 +1299,9 @@ namespace OOO_CORE_MODEL {
 
         void check_ctx_changes();
 
+        W64 get_next_active_cycle();
+        void skip_cycles(W64 cycles);
+
 		void dump_configuration(YAML::Emitter &out) const;
     };
 
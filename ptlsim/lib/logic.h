@@ -352,6 +352,55 @@ template <> struct InvalidTag<W32> { static const W32 INVALID = 0xffffffff; };
 template <> struct InvalidTag<W16> { static const W16 INVALID = 0xffff; };
 template <> struct InvalidTag<W8> { static const W8 INVALID = 0xff; };
 
+//
+// This is a clever way of doing branch-free matching
+// with conditional moves and addition. It relies on
+// having at most one matching entry in the array;
+// otherwise the algorithm breaks:
+//
+template <typename T>
+static inline int match_tags(const T* tags, int count, T target) {
+  int way = 0;
+  foreach (i, count) {
+    way += (tags[i] == target) ? (i + 1) : 0;
+  }
+
+  return way - 1;
+}
+
+//
+// 64-bit tags (caches, TLBs, directories) are compared 4 ways
+// at a time with AVX2 or 2 ways with SSE4.1 when the compiler
+// targets them (-march=native in optimized builds), collecting
+// a one-hot bitmap of the matching way. Any leftover ways and
+// other builds use scalar compares. Same uniqueness rule as
+// above applies.
+//
+static inline int match_tags(const W64* tags, int count, W64 target) {
+  if unlikely (count > 64) return match_tags<W64>(tags, count, target);
+
+  W64 hits = 0;
+  int i = 0;
+
+#if defined(__AVX2__)
+  vec4q target4 = x86_avx_dupq(target);
+  for (; i + 4 <= count; i += 4) {
+    hits |= W64(x86_avx_movmskq(x86_avx_pcmpeqq(x86_avx_ldvqu(tags + i), target4))) << i;
+  }
+#elif defined(__SSE4_1__)
+  vec2q target2 = x86_sse_dupq(target);
+  for (; i + 2 <= count; i += 2) {
+    hits |= W64(x86_sse_movmskq(x86_sse_pcmpeqq(x86_sse_ldvqu(tags + i), target2))) << i;
+  }
+#endif
+
+  for (; i < count; i++) {
+    hits |= W64(tags[i] == target) << i;
+  }
+
+  return (hits) ? lsbindex64(hits) : -1;
+}
+
 //
 // The replacement policy is pseudo-LRU using a most recently used
 // bit vector (mLRU), as described in the paper "Performance Evaluation
@@ -388,19 +437,8 @@ struct FullyAssociativeTags {
     // if (evictmap.allset()) evictmap = 0;
   }
 
-  //
-  // This is a clever way of doing branch-free matching
-  // with conditional moves and addition. It relies on
-  // having at most one matching entry in the array;
-  // otherwise the algorithm breaks:
-  //
   int match(T target) {
-    int way = 0;
-    foreach (i, ways) {
-      way += (tags[i] == target) ? (i + 1) : 0;
-    }
-
-    return way - 1;
+    return match_tags(tags, ways, target);
   }
 
   int probe(T target) {
@@ -931,19 +969,8 @@ struct LockableFullyAssociativeTags {
     // if (evictmap.allset()) evictmap = 0;
   }
 
-  //
-  // This is a clever way of doing branch-free matching
-  // with conditional moves and addition. It relies on
-  // having at most one matching entry in the array;
-  // otherwise the algorithm breaks:
-  //
   int match(T target) {
-    int way = 0;
-    foreach (i, ways) {
-      way += (tags[i] == target) ? (i + 1) : 0;
-    }
-
-    return way - 1;
+    return match_tags(tags, ways, target);
   }
 
   int probe(T target) {
@@ -0,0 +1,293 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <eventtrace.h>
+
+#include <ptlsim.h>
+#include <ptl-qemu.h>
+
+static const char event_trace_magic[8] = {'M', 'A', 'R', 'S', 'S', 'E', 'V', 'T'};
+
+/* Divergences logged in detail, later ones are only counted */
+static const W64 EVENT_TRACE_LOG_DIVERGED = 16;
+
+EventTrace event_trace;
+
+uint8_t ptl_event_replay = 0;
+
+EventTrace::EventTrace()
+    : recording(false)
+      , replaying(false)
+      , io_seq(0)
+      , recorded(0)
+      , replayed(0)
+      , diverged(0)
+{
+}
+
+bool EventTrace::start_record(const char *filename, int contexts)
+{
+    os.open(filename, std::ios::binary | std::ios::trunc);
+    if(!os.is_open()) return false;
+
+    EventTraceFileHeader header;
+    setzero(header);
+    memcpy(header.magic, event_trace_magic, sizeof(event_trace_magic));
+    header.format = EVENT_TRACE_FORMAT;
+    header.contexts = contexts;
+    header.core_freq_hz = config.core_freq_hz;
+
+    os.write((const char*)&header, sizeof(header));
+
+    recording = true;
+    recorded = 0;
+    io_seq = 0;
+    return true;
+}
+
+bool EventTrace::start_replay(const char *filename, int contexts)
+{
+    ifstream is(filename, std::ios::binary);
+    if(!is.is_open()) return false;
+
+    EventTraceFileHeader header;
+    is.read((char*)&header, sizeof(header));
+
+    if(!is || memcmp(header.magic, event_trace_magic,
+                sizeof(event_trace_magic)) != 0 ||
+            header.format != EVENT_TRACE_FORMAT ||
+            header.contexts != W32(contexts))
+        return false;
+
+    events.clear();
+    io_insns.clear();
+
+    EventTraceRecord rec;
+    while(is.read((char*)&rec, sizeof(rec))) {
+        if unlikely (rec.cpuid >= contexts)
+            return false;
+
+        if(rec.type == EVENT_TRACE_IO) {
+            if(rec.data >= W32(io_insns.size()))
+                io_insns.resize(rec.data + 1, (W64)-1);
+            io_insns[int(rec.data)] = rec.insns;
+        }
+
+        events.push(rec);
+    }
+
+    next_event.resize(contexts);
+    foreach (i, contexts) {
+        find_next(i, 0);
+    }
+
+    replaying = true;
+    replayed = 0;
+    diverged = 0;
+    io_seq = 0;
+    return true;
+}
+
+void EventTrace::stop_record()
+{
+    if(os.is_open())
+        os.close();
+    recording = false;
+}
+
+void EventTrace::stop()
+{
+    stop_record();
+    replaying = false;
+}
+
+void EventTrace::record(W8 type, W8 cpuid, W64 insns, W64 rip, W32 data)
+{
+    EventTraceRecord rec;
+    setzero(rec);
+    rec.insns = insns;
+    rec.cycle = sim_cycle;
+    rec.rip = rip;
+    rec.data = data;
+    rec.type = type;
+    rec.cpuid = cpuid;
+
+    os.write((const char*)&rec, sizeof(rec));
+    recorded++;
+}
+
+/**
+ * @brief Set next interrupt of a CPU Context, IO events are found by
+ * their sequence number instead
+ */
+void EventTrace::find_next(int cpuid, int from)
+{
+    int i = from;
+
+    while(i < events.size() && (events[i].cpuid != cpuid ||
+                events[i].type == EVENT_TRACE_IO))
+        i++;
+
+    next_event[cpuid] = i;
+}
+
+const EventTraceRecord* EventTrace::peek(int cpuid) const
+{
+    if(!replaying || cpuid >= next_event.size() ||
+            next_event[cpuid] >= events.size())
+        return NULL;
+
+    return &events.data[next_event[cpuid]];
+}
+
+void EventTrace::pop(int cpuid)
+{
+    if(cpuid >= next_event.size() || next_event[cpuid] >= events.size())
+        return;
+
+    find_next(cpuid, next_event[cpuid] + 1);
+    replayed++;
+}
+
+bool EventTrace::replay_done() const
+{
+    foreach (i, next_event.size()) {
+        if(next_event[i] < events.size())
+            return false;
+    }
+    return true;
+}
+
+ostream& EventTrace::print_summary(ostream &out) const
+{
+    out << "Event trace: ", recorded, " events recorded, ", replayed,
+        " interrupts replayed, ", diverged, " divergences", endl;
+    return out;
+}
+
+void event_trace_start()
+{
+    foreach (i, contextcount) {
+        Context& ctx = contextof(i);
+        ctx.insns_committed = 0;
+        ctx.event_replay_insn = (W64)-1;
+    }
+
+    if(config.event_trace_replay_filename.set()) {
+        if(!event_trace.start_replay(config.event_trace_replay_filename,
+                    contextcount)) {
+            cerr << "Error: can't replay events from ",
+                 config.event_trace_replay_filename, endl;
+            ptl_quit();
+        }
+
+        ptl_event_replay = !event_trace.replay_done();
+
+        foreach (i, contextcount) {
+            Context& ctx = contextof(i);
+            ctx.event_replay_insn = event_trace.get_next_insns(i);
+        }
+
+        ptl_logfile << "Replaying events from ",
+                    config.event_trace_replay_filename, endl;
+    }
+
+    if(config.event_trace_record_filename.set()) {
+        if(event_trace.start_record(config.event_trace_record_filename,
+                    contextcount)) {
+            ptl_logfile << "Recording events to ",
+                        config.event_trace_record_filename, endl;
+        } else {
+            ptl_logfile << "Can't record events to ",
+                        config.event_trace_record_filename, endl;
+        }
+    }
+}
+
+void event_trace_stop()
+{
+    if(!event_trace.is_recording() && !event_trace.is_replaying())
+        return;
+
+    event_trace.stop();
+    event_trace.print_summary(ptl_logfile);
+
+    ptl_event_replay = 0;
+
+    foreach (i, contextcount) {
+        contextof(i).event_replay_insn = (W64)-1;
+    }
+}
+
+/**
+ * @brief Count a replay divergence and log it
+ */
+static void event_replay_diverged(Context& ctx, const char *what,
+        W64 recorded, W64 replayed)
+{
+    event_trace.add_divergence();
+
+    if(event_trace.get_diverged() <= EVENT_TRACE_LOG_DIVERGED) {
+        ptl_logfile << "[vcpu ", ctx.cpu_index, "] Event replay diverged at ",
+                    ctx.insns_committed, " insns cycle ", sim_cycle, ": ",
+                    what, " recorded ", (void*)recorded, " replayed ",
+                    (void*)replayed, endl;
+    }
+}
+
+void ptl_event_record_interrupt(CPUX86State* env, int intno, int nmi)
+{
+    if likely (!event_trace.is_recording())
+        return;
+
+    Context& ctx = *(Context*)env;
+
+    event_trace.record(nmi ? EVENT_TRACE_NMI : EVENT_TRACE_INTERRUPT,
+            ctx.cpu_index, ctx.insns_committed, ctx.eip, intno);
+}
+
+int ptl_event_replay_interrupt(CPUX86State* env, int* intno, int* nmi)
+{
+    Context& ctx = *(Context*)env;
+
+    if(ctx.insns_committed < ctx.event_replay_insn)
+        return 0;
+
+    const EventTraceRecord* rec = event_trace.peek(ctx.cpu_index);
+    if(!rec)
+        return 0;
+
+    /* Wait for the guest to enable interrupts, only if diverged */
+    if(rec->type != EVENT_TRACE_NMI && !(ctx.eflags & IF_MASK))
+        return 0;
+
+    if unlikely (ctx.insns_committed != rec->insns)
+        event_replay_diverged(ctx, "insns", rec->insns, ctx.insns_committed);
+    if unlikely (ctx.eip != rec->rip)
+        event_replay_diverged(ctx, "rip", rec->rip, ctx.eip);
+
+    *intno = rec->data;
+    *nmi = (rec->type == EVENT_TRACE_NMI);
+
+    event_trace.pop(ctx.cpu_index);
+    ctx.event_replay_insn = event_trace.get_next_insns(ctx.cpu_index);
+
+    /* Guest gets interrupts from devices again after the trace */
+    if unlikely (event_trace.replay_done()) {
+        ptl_logfile << "All recorded interrupts replayed at cycle ",
+                    sim_cycle, endl;
+        ptl_event_replay = 0;
+    }
+
+    return 1;
+}
+
+void ptl_event_replay_acked(CPUX86State* env, int intno, int acked)
+{
+    if unlikely (intno != acked)
+        event_replay_diverged(*(Context*)env, "vector", intno, acked);
+}
@@ -0,0 +1,191 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/*
+ * Event trace file
+ *
+ * File layout:
+ *
+ *   EventTraceFileHeader
+ *   EventTraceRecord, ...
+ *
+ * Records are written in the order events happened. Each one is stamped
+ * with the number of x86 instructions its CPU Context has committed since
+ * recording started ('insns'), which doesn't depend on the simulated
+ * microarchitecture. The cycle is only kept for information.
+ */
+
+static const W32 EVENT_TRACE_FORMAT = 1;
+
+enum {
+    EVENT_TRACE_INTERRUPT = 0,  // data: interrupt vector
+    EVENT_TRACE_NMI,
+    EVENT_TRACE_IO,             // data: QEMU IO event sequence number
+};
+
+struct EventTraceFileHeader {
+    char magic[8];
+    W32 format;
+    W32 contexts;
+    W64 core_freq_hz;
+};
+
+struct EventTraceRecord {
+    W64 insns;
+    W64 cycle;
+    W64 rip;
+    W32 data;
+    W8 type;
+    W8 cpuid;
+    W16 pad;
+};
+
+/**
+ * @brief Record and replay asynchronous events (-event-record, -event-replay)
+ *
+ * Hardware interrupts and NMIs are recorded when they are delivered to a
+ * CPU Context, and QEMU IO events (DMA completions) when they fire, with
+ * the committed instruction count of the CPU Context. IO events are
+ * stamped with CPU Context 0, which gets device interrupts.
+ *
+ * On replay, interrupts raised by devices and timers are not delivered.
+ * Each recorded interrupt is instead delivered right after its CPU Context
+ * commits the same number of instructions, and each IO event fires when
+ * CPU Context 0 reaches its recorded count. So runs of different
+ * microarchitectures from the same checkpoint execute the same
+ * instructions, and can be compared one to one.
+ *
+ * Replay is checked against the trace: an interrupt delivered at another
+ * RIP, or with a different vector than the one acknowledged from the
+ * interrupt controller, counts as a divergence.
+ */
+class EventTrace {
+    private:
+        ofstream os;
+        dynarray<EventTraceRecord> events;
+
+        bool recording;
+        bool replaying;
+
+        /* Index of next replayed event of each CPU Context */
+        dynarray<int> next_event;
+        /* Recorded instruction count of IO events by sequence number */
+        dynarray<W64> io_insns;
+        W64 io_seq;
+
+        W64 recorded;
+        W64 replayed;
+        W64 diverged;
+
+        void find_next(int cpuid, int from);
+
+    public:
+        EventTrace();
+
+        /**
+         * @brief Start writing events to a trace file
+         *
+         * @param filename Trace file, truncated if exists
+         * @param contexts Number of CPU Contexts simulated
+         *
+         * @return false if file can't be opened
+         */
+        bool start_record(const char *filename, int contexts);
+
+        /**
+         * @brief Load all events of a trace file for replay
+         *
+         * @param filename Trace file
+         * @param contexts Number of CPU Contexts simulated
+         *
+         * @return false if file can't be read or doesn't match
+         */
+        bool start_replay(const char *filename, int contexts);
+
+        /**
+         * @brief Stop recording and close the file (-event-record-stop)
+         */
+        void stop_record();
+
+        /**
+         * @brief Stop recording and replaying
+         */
+        void stop();
+
+        bool is_recording() const { return recording; }
+        bool is_replaying() const { return replaying; }
+
+        void record(W8 type, W8 cpuid, W64 insns, W64 rip, W32 data);
+
+        /**
+         * @brief Next event of a CPU Context
+         *
+         * @return NULL if it has no more events
+         */
+        const EventTraceRecord* peek(int cpuid) const;
+
+        /**
+         * @brief Committed instruction count of the next event of a CPU
+         * Context, infinity if it has no more events
+         */
+        W64 get_next_insns(int cpuid) const {
+            const EventTraceRecord* rec = peek(cpuid);
+            return rec ? rec->insns : (W64)-1;
+        }
+
+        /**
+         * @brief Move to the following event of a CPU Context
+         */
+        void pop(int cpuid);
+
+        /**
+         * @brief Check if all recorded interrupts are replayed
+         */
+        bool replay_done() const;
+
+        /**
+         * @brief Sequence number of a new QEMU IO event
+         */
+        W64 add_io() { return io_seq++; }
+
+        /**
+         * @brief Committed instruction count of CPU Context 0 at which a
+         * QEMU IO event fired in recorded run, infinity if not recorded
+         */
+        W64 get_io_insns(W64 seq) const {
+            return (seq < (W64)io_insns.size()) ? io_insns[int(seq)] : (W64)-1;
+        }
+
+        void add_divergence() { diverged++; }
+
+        W64 get_recorded() const { return recorded; }
+        W64 get_replayed() const { return replayed; }
+        W64 get_diverged() const { return diverged; }
+
+        ostream& print_summary(ostream &os) const;
+};
+
+extern EventTrace event_trace;
+
+/**
+ * @brief Start recording or replaying events set with -event-record or
+ * -event-replay, at start of simulation
+ */
+void event_trace_start();
+
+/**
+ * @brief Stop recording or replaying, at end of simulation
+ */
+void event_trace_stop();
+
+#endif // EVENT_TRACE_H
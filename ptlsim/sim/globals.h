@@ -264,6 +264,8 @@ typedef W32 v4si __attribute__ ((vector_size(16)));
 typedef v4si vec4i;
 typedef float v2df __attribute__ ((vector_size(16)));
 typedef v2df vec2d;
+typedef W64 v2di __attribute__ ((vector_size(16)));
+typedef v2di vec2q;
 
 inline vec16b x86_sse_pcmpeqb(vec16b a, vec16b b) { asm("pcmpeqb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
 inline vec8w x86_sse_pcmpeqw(vec8w a, vec8w b) { asm("pcmpeqw %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
@@ -285,6 +287,24 @@ inline vec16b x86_sse_onesb() { vec16b rd = {0}; asm("pcmpeqb %[rd],%[rd]" : [rd
 inline vec8w x86_sse_zerow() { vec8w rd = {0}; asm("pxor %[rd],%[rd]" : [rd] "+x" (rd)); return rd; }
 inline vec8w x86_sse_onesw() { vec8w rd = {0}; asm("pcmpeqw %[rd],%[rd]" : [rd] "+x" (rd)); return rd; }
 
+// 64-bit lane compares: pcmpeqq needs SSE4.1, the 256-bit forms need AVX2
+inline vec2q x86_sse_ldvqu(const W64* p) { vec2q v; asm("movdqu %[p],%[v]" : [v] "=x" (v) : [p] "m" (*(const vec2q*)p)); return v; }
+inline vec2q x86_sse_dupq(W64 q) { vec2q v = {q, q}; return v; }
+inline W32 x86_sse_movmskq(vec2q vec) { W32 mask; asm("movmskpd %[vec],%[mask]" : [mask] "=r" (mask) : [vec] "x" (vec)); return mask; }
+#ifdef __SSE4_1__
+inline vec2q x86_sse_pcmpeqq(vec2q a, vec2q b) { asm("pcmpeqq %[b],%[a]" : [a] "+x" (a) : [b] "x" (b)); return a; }
+#endif
+
+#ifdef __AVX2__
+typedef W64 v4di __attribute__ ((vector_size(32)));
+typedef v4di vec4q;
+
+inline vec4q x86_avx_ldvqu(const W64* p) { vec4q v; asm("vmovdqu %[p],%[v]" : [v] "=x" (v) : [p] "m" (*(const vec4q*)p)); return v; }
+inline vec4q x86_avx_dupq(W64 q) { vec4q v = {q, q, q, q}; return v; }
+inline vec4q x86_avx_pcmpeqq(vec4q a, vec4q b) { vec4q rd; asm("vpcmpeqq %[b],%[a],%[rd]" : [rd] "=x" (rd) : [a] "x" (a), [b] "x" (b)); return rd; }
+inline W32 x86_avx_movmskq(vec4q vec) { W32 mask; asm("vmovmskpd %[vec],%[mask]" : [mask] "=r" (mask) : [vec] "x" (vec)); return mask; }
+#endif
+
 // If lddqu is available (SSE3: Athlon 64 (some cores, like X2), Pentium 4 Prescott), use that instead. It may be faster.
 
 extern const byte byte_to_vec16b[256][16];
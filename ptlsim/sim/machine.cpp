@@ -14,7 +14,11 @@
 
 #include <basecore.h>
 #include <statsBuilder.h>
+#include <timeStats.h>
+#include <statsWriter.h>
+#include <sampling.h>
 #include <memoryHierarchy.h>
+#include <parallel.h>
 
 #include <cstdarg>
 
@@ -37,6 +41,10 @@ BaseMachine::BaseMachine(const char *name)
 
     context_used = 0;
     coreid_counter = 0;
+
+    idle_probe_cycle = infinity;
+    idle_stats[0] = idle_stats[1] = NULL;
+    idle_cycles_skipped = 0;
 }
 
 BaseMachine::~BaseMachine()
@@ -226,6 +234,9 @@ int BaseMachine::run(PTLsimConfig& config)
     }
     first_run = 0;
 
+    if(config.parallel_threads > 0)
+        return run_parallel(config);
+
     // Run each core
     bool exiting = false;
 
@@ -241,12 +252,10 @@ int BaseMachine::run(PTLsimConfig& config)
         if(sim_cycle % 1000 == 0)
             update_progress();
 
-        if unlikely(sim_cycle == 0 && time_stats_file)
-            StatsBuilder::get().dump_header(*time_stats_file);
-
-        if unlikely (time_stats_file && sim_cycle > 0 &&
+        /* Copy is written to CSV or binary file by the stats writer */
+        if unlikely ((time_stats_file || time_stats_writer) && sim_cycle > 0 &&
                 sim_cycle % config.time_stats_period == 0) {
-            StatsBuilder::get().dump_periodic(*time_stats_file, sim_cycle);
+            stats_writer->periodic(sim_cycle, user_stats, kernel_stats);
         }
 
 
@@ -256,6 +265,7 @@ int BaseMachine::run(PTLsimConfig& config)
             backup_and_reopen_logfile();
 
         memoryHierarchyPtr->clock();
+        memoryHierarchyPtr->deliver_core_wakeups();
         clock_qemu_io_events();
 
 		foreach (i, coremodel.per_cycle_signals.size()) {
@@ -274,21 +284,252 @@ int BaseMachine::run(PTLsimConfig& config)
             exiting = 1;
             break;
         }
+        /* End of a sampling window, ptl_simulate decides what is next */
+        if unlikely (sampler.get_window_end() <= total_insns_committed) {
+            exiting = 1;
+            break;
+        }
         if unlikely (exiting) {
             if unlikely(ret_qemu_env == NULL)
                 ret_qemu_env = &contextof(0);
             break;
         }
+
+        if (config.skip_idle_cycles)
+            skip_idle_cycles();
     }
 
+    /* Next run starts with a fresh probe */
+    idle_probe_cycle = infinity;
+
     if(logable(1))
         ptl_logfile << "Exiting out-of-order core at ", total_insns_committed, " commits, ", total_uops_committed, " uops and ", iterations, " iterations (cycles)", endl;
 
+    if(logable(1) && config.skip_idle_cycles)
+        ptl_logfile << "Skipped ", idle_cycles_skipped, " idle cycles", endl;
+
+    config.dump_state_now = 0;
+
+    return exiting;
+}
+
+/* True if a multiple of period is in the cycles [start, end) */
+static inline bool quantum_has_multiple(W64 start, W64 end, W64 period,
+        W64& multiple)
+{
+    multiple = start + (period - start % period) % period;
+    return (multiple < end);
+}
+
+/**
+ * @brief Simulation loop of -parallel-threads
+ *
+ * Runs the steps of the serial loop in quanta, see ParallelSim. Stop
+ * conditions, progress and periodic stats are checked once per quantum
+ * and idle cycles are not skipped.
+ */
+int BaseMachine::run_parallel(PTLsimConfig& config)
+{
+    if unlikely (!parallel_sim.enabled())
+        parallel_sim.setup(*this, config.parallel_threads,
+                config.parallel_quantum);
+
+    W64 quantum = parallel_sim.get_quantum();
+    bool exiting = false;
+
+    for (;;) {
+        if unlikely ((!logenable) &&
+                iterations >= config.start_log_at_iteration &&
+                !config.log_user_only) {
+            ptl_logfile << "Start logging at level ", config.loglevel,
+                        " in cycle ", iterations, endl, flush;
+            logenable = 1;
+        }
+
+        W64 start = sim_cycle;
+        W64 cycles = quantum;
+
+        /* Stop in the same cycle as the serial loop */
+        if(config.stop_at_cycle <= start)
+            cycles = 1;
+        else
+            cycles = min(cycles, config.stop_at_cycle - start);
+
+        W64 multiple;
+
+        if(quantum_has_multiple(start, start + cycles, 1000, multiple))
+            update_progress();
+
+        if unlikely ((time_stats_file || time_stats_writer) &&
+                quantum_has_multiple(max(start, W64(1)), start + cycles,
+                    config.time_stats_period, multiple)) {
+            stats_writer->periodic(multiple, user_stats, kernel_stats);
+        }
+
+        // limit the ptl_logfile size
+        if unlikely (ptl_logfile.is_open() &&
+                ((W64)ptl_logfile.tellp() > config.log_file_size))
+            backup_and_reopen_logfile();
+
+        /* First memory cycle, its wakeups are delivered by the workers */
+        W64 memory_start = rdtsc();
+        memoryHierarchyPtr->clock();
+        clock_qemu_io_events();
+        W64 memory_ticks = rdtsc() - memory_start;
+
+        exiting = parallel_sim.run_cores(start, cycles);
+
+        /* Rest of the quantum takes the messages cores sent in it */
+        memory_start = rdtsc();
+        for(W64 c = 1; c < cycles; c++) {
+            sim_cycle = start + c;
+            memoryHierarchyPtr->clock();
+            clock_qemu_io_events();
+        }
+        parallel_sim.add_memory_ticks(memory_ticks + rdtsc() - memory_start);
+
+        sim_cycle = start + cycles;
+        iterations += cycles;
+
+        if unlikely (config.stop_at_insns <= total_insns_committed ||
+                config.stop_at_cycle <= sim_cycle) {
+            ptl_logfile << "Stopping simulation loop at specified limits (", sim_cycle, " cycles, ", total_insns_committed, " commits)", endl;
+            exiting = 1;
+            break;
+        }
+        /* End of a sampling window, ptl_simulate decides what is next */
+        if unlikely (sampler.get_window_end() <= total_insns_committed) {
+            exiting = 1;
+            break;
+        }
+        if unlikely (exiting) {
+            if unlikely(ret_qemu_env == NULL)
+                ret_qemu_env = &contextof(0);
+            break;
+        }
+    }
+
+    if(logable(1))
+        ptl_logfile << "Exiting parallel simulation loop at ", total_insns_committed, " commits, ", total_uops_committed, " uops and ", iterations, " iterations (cycles)", endl;
+
     config.dump_state_now = 0;
 
     return exiting;
 }
 
+/**
+ * @brief Find the first cycle that can not be skipped
+ *
+ * @return sim_cycle if some core or the memory hierarchy is busy, otherwise
+ * the earliest cycle at which any simulated component or the main loop
+ * itself has something to do
+ */
+W64 BaseMachine::get_idle_skip_target()
+{
+    /* Only cores know how to report idle cycles */
+    if unlikely (per_cycle_signals.count() != cores.count())
+        return sim_cycle;
+
+    W64 target = (W64)-1;
+
+    foreach(i, cores.count()) {
+        target = min(target, cores[i]->get_next_active_cycle());
+        if(target <= sim_cycle)
+            return sim_cycle;
+    }
+
+    target = min(target, memoryHierarchyPtr->get_next_event_cycle());
+    target = min(target, get_next_qemu_io_event_cycle());
+    target = min(target, sim_cycle + ns_to_simcycles(
+                qemu_next_sim_deadline()));
+
+    /* Keep periodic work of the main loop at the same cycles */
+    target = min(target, sim_cycle + (1000 - sim_cycle % 1000) % 1000);
+
+    if(time_stats_file || time_stats_writer) {
+        W64 period = config.time_stats_period;
+        target = min(target, sim_cycle + (period - sim_cycle % period) % period);
+    }
+
+    if(config.stop_at_cycle > sim_cycle)
+        target = min(target, config.stop_at_cycle - 1);
+
+    if(!logenable && config.start_log_at_iteration > iterations)
+        target = min(target, sim_cycle + (config.start_log_at_iteration -
+                    iterations));
+
+    return max(target, sim_cycle);
+}
+
+/**
+ * @brief Skip cycles in which all cores only wait for memory or IO
+ *
+ * When all cores report an idle cycle, the next cycle is simulated as a
+ * probe and the change of core stats in it is recorded. If the probe
+ * cycle is idle too, all cycles up to the next memory, IO or timer event
+ * are skipped and the probe's stats change is added once per skipped
+ * cycle, so stats are the same as simulating each cycle.
+ */
+void BaseMachine::skip_idle_cycles()
+{
+    W64 target = get_idle_skip_target();
+
+    if(target <= sim_cycle) {
+        idle_probe_cycle = infinity;
+        return;
+    }
+
+    if unlikely (!idle_stats[0]) {
+        idle_stats[0] = StatsBuilder::get().get_new_stats();
+        idle_stats[1] = StatsBuilder::get().get_new_stats();
+    }
+
+    Stats *live_stats[2] = {user_stats, kernel_stats};
+
+    if(idle_probe_cycle == infinity || idle_probe_cycle + 1 != sim_cycle) {
+        /* Snapshot core stats before running the probe cycle */
+        idle_probe_cycle = sim_cycle;
+
+        foreach(i, cores.count()) {
+            foreach(j, 2) {
+                cores[i]->sub_stats(*idle_stats[j], *idle_stats[j]);
+                cores[i]->add_stats(*idle_stats[j], *live_stats[j]);
+            }
+        }
+        return;
+    }
+
+    W64 n = memoryHierarchyPtr->skip_cycles(target - sim_cycle);
+
+    foreach(i, cores.count()) {
+        foreach(j, 2) {
+            Stats& delta = *idle_stats[j];
+            Stats& live = *live_stats[j];
+
+            /* delta = -(change in probe cycle), then live -= n * delta */
+            cores[i]->sub_stats(delta, live);
+
+            for(W64 k = n; k; k >>= 1) {
+                if(k & 1)
+                    cores[i]->sub_stats(live, delta);
+                if(k > 1)
+                    cores[i]->add_stats(delta, delta);
+            }
+        }
+
+        cores[i]->skip_cycles(n);
+    }
+
+    if(logable(5))
+        ptl_logfile << "Skipped idle cycles ", sim_cycle, " to ",
+                    sim_cycle + n, endl;
+
+    sim_cycle += n;
+    iterations += n;
+    idle_cycles_skipped += n;
+    idle_probe_cycle = infinity;
+}
+
 void BaseMachine::flush_tlb(Context& ctx)
 {
     foreach(i, cores.count()) {
@@ -305,6 +546,24 @@ void BaseMachine::flush_tlb_virt(Context& ctx, Waddr virtaddr)
     }
 }
 
+void BaseMachine::warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+        bool is_store, bool is_code)
+{
+    foreach(i, cores.count()) {
+        BaseCore* core = cores[i];
+        core->warm_mem(ctx, virtaddr, physaddr, is_store, is_code);
+    }
+}
+
+void BaseMachine::warm_branch(Context& ctx, W64 ripafter, W64 target,
+        bool taken)
+{
+    foreach(i, cores.count()) {
+        BaseCore* core = cores[i];
+        core->warm_branch(ctx, ripafter, target, taken);
+    }
+}
+
 void BaseMachine::dump_state(ostream& os)
 {
     foreach(i, cores.count()) {
@@ -60,11 +60,16 @@ struct BaseMachine: public PTLsimMachine {
     BaseMachine(const char* name);
     virtual bool init(PTLsimConfig& config);
     virtual int run(PTLsimConfig& config);
+    int run_parallel(PTLsimConfig& config);
     virtual W8 get_num_cores();
     virtual void dump_state(ostream& os);
     virtual void update_stats();
     virtual void flush_tlb(Context& ctx);
     virtual void flush_tlb_virt(Context& ctx, Waddr virtaddr);
+    virtual void warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+            bool is_store, bool is_code);
+    virtual void warm_branch(Context& ctx, W64 ripafter, W64 target,
+            bool taken);
     void flush_all_pipelines();
     virtual void reset();
 	virtual void dump_configuration(ostream& os) const;
@@ -72,6 +77,14 @@ struct BaseMachine: public PTLsimMachine {
     virtual ~BaseMachine();
     void simulation_done(); 
 
+    // Idle cycle skipping (-skip-idle-cycles)
+    W64 idle_probe_cycle;
+    Stats *idle_stats[2];
+    W64 idle_cycles_skipped;
+
+    W64 get_idle_skip_target();
+    void skip_idle_cycles();
+
     bitvec<NUM_SIM_CORES> context_used;
     W8 context_counter;
     W8 coreid_counter;
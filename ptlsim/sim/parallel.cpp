@@ -0,0 +1,548 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <parallel.h>
+
+#include <ptlsim.h>
+#include <machine.h>
+#include <basecore.h>
+#include <memoryHierarchy.h>
+
+#include <signal.h>
+
+ParallelSim parallel_sim;
+
+__thread bool parallel_unserialized = false;
+__thread int parallel_locks_held = 0;
+
+/* Worker running on this host thread, NULL outside of parallel mode */
+static __thread ParallelWorker *current_worker = NULL;
+
+void parallel_enter_exclusive()
+{
+    parallel_sim.enter_exclusive();
+}
+
+static inline void memory_fence()
+{
+    asm volatile("mfence" : : : "memory");
+}
+
+ParallelWorker::ParallelWorker()
+    : active(0)
+      , exclusive(false)
+      , key(0)
+      , id(0)
+      , started(false)
+      , insns(0)
+      , uops(0)
+      , ram_accesses(0)
+      , switched_accesses(0)
+      , busy_ticks(0)
+      , wait_ticks(0)
+      , exclusive_sections(0)
+{
+}
+
+void* ParallelWorker::operator new[](size_t size)
+{
+    void *mem = NULL;
+    int rc = posix_memalign(&mem, 64, size);
+    assert(rc == 0);
+    return mem;
+}
+
+void ParallelWorker::operator delete[](void *mem)
+{
+    free(mem);
+}
+
+ParallelSim::ParallelSim()
+    : machine(NULL)
+      , thread_count(0)
+      , quantum(1)
+      , workers(NULL)
+      , setup_done(false)
+      , quantum_start(0)
+      , quantum_cycles(0)
+      , go_seq(0)
+      , done_count(0)
+      , sleepers(0)
+      , stopping(false)
+      , exclusive_lock(0)
+      , exclusive_owner(0)
+      , inline_quantum(true)
+      , signal_count(0)
+      , quanta(0)
+      , core_ticks(0)
+      , memory_ticks(0)
+{
+    pthread_mutex_init(&sleep_lock, NULL);
+    pthread_cond_init(&sleep_cond, NULL);
+}
+
+ParallelSim::~ParallelSim()
+{
+    stop();
+
+    pthread_cond_destroy(&sleep_cond);
+    pthread_mutex_destroy(&sleep_lock);
+}
+
+bool ParallelSim::setup(BaseMachine& machine_, int threads, int quantum_)
+{
+    assert(!setup_done);
+
+    machine = &machine_;
+    quantum = max(quantum_, 1);
+
+    int signals = machine->per_cycle_signals.count();
+
+    /*
+     * Signal i clocks cores[i]; without one signal per core we can't tell
+     * which channel a signal's core uses.
+     */
+    if(signals != machine->cores.count()) {
+        ptl_logfile << "Parallel simulation needs one per-cycle signal ",
+                    "per core, running ", signals, " signals on one thread",
+                    endl;
+        threads = 1;
+    }
+
+    signal_count = signals;
+    thread_count = max(min(threads, signals), 1);
+    workers = new ParallelWorker[thread_count];
+
+    /* Contiguous blocks of cores, so neighbours share a host thread */
+    foreach(i, thread_count) {
+        workers[i].id = i;
+        for(int s = i * signals / thread_count;
+                s < (i + 1) * signals / thread_count; s++) {
+            workers[i].signals.push(s);
+        }
+    }
+
+    foreach(s, signals) {
+        all_signals.push(s);
+        exit_cycle.push(infinity);
+        exit_ctx.push(NULL);
+    }
+
+    current_worker = &workers[0];
+    start_workers();
+    setup_done = true;
+
+    ptl_logfile << "Parallel simulation of ", signals, " cores on ",
+                thread_count, " threads, quantum ", quantum, " cycles", endl;
+
+    return (thread_count > 1);
+}
+
+void ParallelSim::start_workers()
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PARALLEL_STACK_SIZE);
+
+    /* Host signals (SIGALRM, SIGIO of QEMU) stay on the simulation thread */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    for(int i = 1; i < thread_count; i++) {
+        workers[i].started = (pthread_create(&workers[i].thread, &attr,
+                    worker_thread, &workers[i]) == 0);
+
+        /* Fall back to the threads we have, cores of the others move */
+        if(!workers[i].started) {
+            ptl_logfile << "Can't start parallel worker ", i,
+                        ", running cores on ", i, " threads", endl;
+
+            for(int j = i; j < thread_count; j++) {
+                foreach(k, workers[j].signals.count()) {
+                    workers[i - 1].signals.push(workers[j].signals[k]);
+                }
+            }
+
+            thread_count = i;
+            break;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+void* ParallelSim::worker_thread(void *arg)
+{
+    ParallelWorker& worker = *(ParallelWorker*)arg;
+    ParallelSim& sim = parallel_sim;
+    W64 seen = 0;
+
+    current_worker = &worker;
+
+    for(;;) {
+        sim.wait_for_quantum(seen);
+
+        if(sim.stopping)
+            break;
+
+        sim.run_share(worker, worker.signals);
+        xadd((W32&)sim.done_count, W32(1));
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Wait until the simulation thread starts the next quantum
+ *
+ * Spins for a short while, quanta follow each other fast, then sleeps so
+ * idle workers don't take host cores from QEMU while it runs.
+ */
+void ParallelSim::wait_for_quantum(W64& seen)
+{
+    int spins = 0;
+
+    while(go_seq == seen) {
+        if(spins++ < PARALLEL_SPIN_LIMIT) {
+            cpu_pause();
+            continue;
+        }
+
+        pthread_mutex_lock(&sleep_lock);
+
+        /* Locked add orders it before the go_seq check, see run_cores */
+        xadd((W32&)sleepers, W32(1));
+
+        while(go_seq == seen)
+            pthread_cond_wait(&sleep_cond, &sleep_lock);
+
+        xadd((W32&)sleepers, W32(-1));
+        pthread_mutex_unlock(&sleep_lock);
+    }
+
+    seen = go_seq;
+}
+
+void ParallelSim::enter_core(ParallelWorker& worker, W64 key)
+{
+    if(inline_quantum)
+        return;
+
+    worker.key = key;
+
+    for(;;) {
+        worker.active = 1;
+        memory_fence();
+
+        if likely (!exclusive_owner)
+            break;
+
+        /* Another core is in an exclusive section, wait for its cycle */
+        W64 start = rdtsc();
+        worker.active = 0;
+
+        while(exclusive_owner)
+            cpu_pause();
+
+        worker.wait_ticks += rdtsc() - start;
+    }
+
+    parallel_unserialized = true;
+}
+
+void ParallelSim::leave_core(ParallelWorker& worker)
+{
+    if(inline_quantum)
+        return;
+
+    parallel_unserialized = false;
+
+    if unlikely (worker.exclusive) {
+        worker.exclusive = false;
+        exclusive_owner = 0;
+        barrier();
+        exclusive_lock = 0;
+        return;
+    }
+
+    barrier();
+    worker.active = 0;
+}
+
+/**
+ * @brief Run the rest of the calling core's cycle alone
+ *
+ * Called through parallel_serialize() by a core that is about to change
+ * shared state. Waits until the other workers are past the caller's step
+ * of the serial loop, so sections run in serial order, then until they
+ * are between two core cycles. Other workers stay out of their cores
+ * until the calling core's cycle ends in leave_core().
+ *
+ * A worker waiting here doesn't count as in a core: its section comes
+ * later in serial order and runs after this one, its core stays halfway
+ * in its cycle meanwhile. That is only safe without a parallel_lock()
+ * held, shared structures may change under it.
+ */
+void ParallelSim::enter_exclusive()
+{
+    ParallelWorker& worker = *current_worker;
+    W64 start = rdtsc();
+
+    assert(parallel_locks_held == 0);
+    worker.active = 0;
+
+    /* Earlier steps finish their cycle or stop in their own section */
+    foreach(i, thread_count) {
+        if(i == worker.id)
+            continue;
+
+        while(workers[i].key < worker.key)
+            cpu_pause();
+    }
+
+    while(xchg((W32&)exclusive_lock, W32(1)))
+        cpu_pause();
+
+    exclusive_owner = worker.id + 1;
+    memory_fence();
+
+    foreach(i, thread_count) {
+        if(i == worker.id)
+            continue;
+
+        while(workers[i].active)
+            cpu_pause();
+    }
+
+    parallel_unserialized = false;
+    worker.exclusive = true;
+    worker.exclusive_sections++;
+    worker.wait_ticks += rdtsc() - start;
+}
+
+void ParallelSim::run_share(ParallelWorker& worker, dynarray<int>& signals)
+{
+    W64 start = rdtsc();
+    W64 wait_ticks = worker.wait_ticks;
+
+    W64 insns = total_insns_committed;
+    W64 uops = total_uops_committed;
+    W64 ram_accesses = mem_ram_accesses;
+    W64 switched_accesses = mem_switched_accesses;
+
+    /* Responses of the last memory phase */
+    sim_cycle = quantum_start;
+
+    foreach(i, signals.count()) {
+        Core::BaseCore *core = machine->cores[signals[i]];
+
+        enter_core(worker, signals[i]);
+        machine->memoryHierarchyPtr->deliver_core_wakeups(core->get_coreid());
+        leave_core(worker);
+    }
+
+    foreach(c, quantum_cycles) {
+        sim_cycle = quantum_start + c;
+
+        foreach(i, signals.count()) {
+            int s = signals[i];
+
+            /* Stopped until the machine goes back to QEMU */
+            if unlikely (exit_cycle[s] != infinity)
+                continue;
+
+            enter_core(worker, W64(c + 1) * signal_count + s);
+
+            if unlikely (machine->per_cycle_signals[s]->emit(NULL)) {
+                /* Cores set ret_qemu_env in an exclusive section */
+                parallel_serialize();
+
+                exit_cycle[s] = sim_cycle;
+                exit_ctx[s] = machine->ret_qemu_env;
+                machine->ret_qemu_env = NULL;
+            }
+
+            leave_core(worker);
+        }
+    }
+
+    /* Sections of other workers don't wait for this one anymore */
+    worker.key = infinity;
+
+    /* Simulation thread adds the counters of other threads */
+    if(worker.id != 0) {
+        worker.insns = total_insns_committed - insns;
+        worker.uops = total_uops_committed - uops;
+        worker.ram_accesses = mem_ram_accesses - ram_accesses;
+        worker.switched_accesses = mem_switched_accesses - switched_accesses;
+    }
+
+    worker.busy_ticks += (rdtsc() - start) - (worker.wait_ticks - wait_ticks);
+}
+
+bool ParallelSim::run_cores(W64 start, int cycles)
+{
+    assert(setup_done);
+
+    foreach(s, exit_cycle.count()) {
+        exit_cycle[s] = infinity;
+        exit_ctx[s] = NULL;
+    }
+
+    quantum_start = start;
+    quantum_cycles = cycles;
+
+    /* Log lines of cores would interleave, run the quantum in order */
+    inline_quantum = (thread_count == 1) || logenable;
+
+    W64 start_tick = rdtsc();
+
+    if(inline_quantum) {
+        run_share(workers[0], all_signals);
+    } else {
+        foreach(i, thread_count) {
+            workers[i].key = 0;
+        }
+
+        /* Locked add orders it before the sleepers check */
+        xadd((W64&)go_seq, W64(1));
+
+        if(sleepers) {
+            pthread_mutex_lock(&sleep_lock);
+            pthread_cond_broadcast(&sleep_cond);
+            pthread_mutex_unlock(&sleep_lock);
+        }
+
+        run_share(workers[0], workers[0].signals);
+
+        while(done_count != W32(thread_count - 1))
+            cpu_pause();
+
+        done_count = 0;
+
+        for(int i = 1; i < thread_count; i++) {
+            total_insns_committed += workers[i].insns;
+            total_uops_committed += workers[i].uops;
+            mem_ram_accesses += workers[i].ram_accesses;
+            mem_switched_accesses += workers[i].switched_accesses;
+        }
+    }
+
+    sim_cycle = start;
+    core_ticks += rdtsc() - start_tick;
+    quanta++;
+
+    W64 first = infinity;
+    int exit_signal = -1;
+
+    foreach(s, exit_cycle.count()) {
+        if(exit_cycle[s] <= first && exit_cycle[s] != infinity) {
+            first = exit_cycle[s];
+            exit_signal = s;
+        }
+    }
+
+    if(exit_signal < 0)
+        return false;
+
+    machine->ret_qemu_env = exit_ctx[exit_signal];
+    return true;
+}
+
+void ParallelSim::stop()
+{
+    if(!workers)
+        return;
+
+    stopping = true;
+    xadd((W64&)go_seq, W64(1));
+
+    pthread_mutex_lock(&sleep_lock);
+    pthread_cond_broadcast(&sleep_cond);
+    pthread_mutex_unlock(&sleep_lock);
+
+    for(int i = 1; i < thread_count; i++) {
+        if(workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+    }
+
+    current_worker = NULL;
+    delete[] workers;
+    workers = NULL;
+    setup_done = false;
+}
+
+W64 ParallelSim::get_exclusive_sections() const
+{
+    W64 sections = 0;
+
+    foreach(i, thread_count) {
+        sections += workers[i].exclusive_sections;
+    }
+
+    return sections;
+}
+
+W64 ParallelSim::get_busy_ticks() const
+{
+    W64 ticks = 0;
+
+    foreach(i, thread_count) {
+        ticks += workers[i].busy_ticks;
+    }
+
+    return ticks;
+}
+
+double ParallelSim::get_efficiency() const
+{
+    if(!core_ticks || !thread_count)
+        return 0;
+
+    return 100.0 * double(get_busy_ticks()) /
+        (double(core_ticks) * thread_count);
+}
+
+double ParallelSim::get_speedup() const
+{
+    if(!core_ticks)
+        return 0;
+
+    return double(get_busy_ticks() + memory_ticks) /
+        double(core_ticks + memory_ticks);
+}
+
+ostream& ParallelSim::print_summary(ostream &os, W64 message_digest) const
+{
+    if(!workers)
+        return os;
+
+    os << "Parallel simulation: ", thread_count, " threads, quantum ",
+       quantum, " cycles, ", quanta, " quanta, ",
+       get_exclusive_sections(), " exclusive sections", endl;
+
+    os << "  Host time: cores ", ticks_to_native_seconds(core_ticks),
+       " s, memory ", ticks_to_native_seconds(memory_ticks), " s", endl;
+
+    foreach(i, thread_count) {
+        os << "  Worker ", i, ": ", workers[i].signals.count(), " cores, busy ",
+           ticks_to_native_seconds(workers[i].busy_ticks), " s, waiting ",
+           ticks_to_native_seconds(workers[i].wait_ticks), " s", endl;
+    }
+
+    os << "  Efficiency ", get_efficiency(), "%, estimated speedup ",
+       get_speedup(), "x over one thread", endl;
+
+    /* Same digest and stats as a -parallel-threads 1 run means same result */
+    os << "  Memory message digest ", hexstring(message_digest, 64),
+       ", compare with a -parallel-threads 1 run using",
+       " util/mstats.py --diff --diff-host serial.yml parallel.yml", endl;
+
+    return os;
+}
@@ -0,0 +1,210 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <pthread.h>
+
+struct BaseMachine;
+struct Context;
+
+/* Spins on a barrier before the waiting thread goes to sleep */
+#define PARALLEL_SPIN_LIMIT (1 << 16)
+
+/* Stack of worker threads, cores and decoder use large frames */
+#define PARALLEL_STACK_SIZE (64 << 20)
+
+/**
+ * @brief Host thread that clocks a fixed set of cores
+ *
+ * Worker 0 is the simulation thread itself. Fields written by a worker
+ * in a quantum are read by the simulation thread once all workers are
+ * done with it.
+ */
+struct ParallelWorker {
+    /* Between enter_core() and leave_core(), read by exclusive sections */
+    volatile W32 active alignto(64);
+    bool exclusive;
+
+    /*
+     * Place of the current core step in the serial loop, exclusive
+     * sections of other workers wait until it is past theirs
+     */
+    volatile W64 key;
+
+    int id;
+    pthread_t thread;
+    bool started;
+
+    /* Per-cycle signals (cores) clocked by this worker */
+    dynarray<int> signals;
+
+    /* Thread local counters of last quantum */
+    W64 insns;
+    W64 uops;
+    W64 ram_accesses;
+    W64 switched_accesses;
+
+    W64 busy_ticks;
+    W64 wait_ticks;
+    W64 exclusive_sections;
+
+    ParallelWorker();
+
+    /* Plain new[] doesn't honour alignto(64) before C++17 */
+    static void* operator new[](size_t size);
+    static void operator delete[](void *mem);
+};
+
+/**
+ * @brief Parallel simulation of cores in quanta (-parallel-threads)
+ *
+ * BaseMachine::run alternates two phases:
+ *
+ * - Core phase: every worker clocks its cores for one quantum of
+ *   -parallel-quantum cycles, on its own copy of sim_cycle. Cores only
+ *   reach the memory hierarchy through their CoreMemoryChannel, so memory
+ *   requests are queued with the cycle they were sent in and wakeups
+ *   queued for a core are delivered at the start of the quantum.
+ *
+ * - Memory phase: the simulation thread clocks the memory hierarchy and
+ *   IO events for the cycles of the quantum. At each cycle the hierarchy
+ *   takes the messages sent before it, core by core, so it sees the same
+ *   stream whatever the number of threads.
+ *
+ * With a quantum of 1 cycle the schedule is the one of the serial loop
+ * with -core-mem-channels. Longer quanta delay memory responses to the
+ * end of the quantum and stop conditions are only checked between quanta.
+ *
+ * Shared state (QEMU, Contexts of other cores, interlocks, decoder) is
+ * changed in exclusive sections. parallel_serialize() first waits until
+ * every other worker is past the calling core's place in the serial loop
+ * (cycle, then core), so sections run in serial order. It then waits
+ * until the others are between two core cycles or stopped in a section
+ * of their own, and keeps them there until the calling core's cycle ends.
+ * A core stopped in parallel_serialize() is halfway in its cycle and
+ * holds no parallel_lock() (asserted), so the section only sees its
+ * earlier changes to shared state.
+ *
+ * Results are the same as with one thread as long as a core doesn't read
+ * guest memory, QEMU state or a basic block that a core earlier in the
+ * serial order changes in the same quantum; the message digest and a
+ * stats diff against a -parallel-threads 1 run show if a run did.
+ */
+class ParallelSim {
+    private:
+        BaseMachine *machine;
+        int thread_count;
+        int quantum;
+
+        ParallelWorker *workers;
+        bool setup_done;
+
+        /* Quantum to run, set before go_seq is bumped */
+        W64 quantum_start;
+        int quantum_cycles;
+
+        volatile W64 go_seq alignto(64);
+        volatile W32 done_count alignto(64);
+        volatile W32 sleepers;
+        volatile bool stopping;
+        pthread_mutex_t sleep_lock;
+        pthread_cond_t sleep_cond;
+
+        /* Exclusive sections */
+        volatile W32 exclusive_lock alignto(64);
+        volatile W32 exclusive_owner;
+
+        /* Per-cycle signals of all workers, run by one thread when logging */
+        dynarray<int> all_signals;
+        bool inline_quantum;
+        int signal_count;
+
+        /*
+         * Cycle in which a core asked to return to QEMU (infinity if it
+         * didn't) and its context, in per-cycle signal order
+         */
+        dynarray<W64> exit_cycle;
+        dynarray<Context*> exit_ctx;
+
+        W64 quanta;
+        W64 core_ticks;
+        W64 memory_ticks;
+
+        void start_workers();
+        void run_share(ParallelWorker& worker, dynarray<int>& signals);
+        void wait_for_quantum(W64& seen);
+        void enter_core(ParallelWorker& worker, W64 key);
+        void leave_core(ParallelWorker& worker);
+
+        static void* worker_thread(void *arg);
+
+    public:
+        ParallelSim();
+        ~ParallelSim();
+
+        /**
+         * @brief Assign cores to threads and start the worker threads
+         *
+         * @return false if cores can't be clocked separately; the
+         * simulation then runs the same schedule on one thread
+         */
+        bool setup(BaseMachine& machine_, int threads, int quantum_);
+
+        bool enabled() const { return setup_done; }
+        int get_quantum() const { return quantum; }
+
+        /**
+         * @brief Clock all cores for one quantum
+         *
+         * @param start First cycle of the quantum
+         * @param cycles Cycles in the quantum
+         *
+         * @return true if any core asked to return to QEMU, ret_qemu_env
+         * of the machine is then set to the context of the first one to
+         * ask; in the same cycle the last core wins like in the serial loop
+         */
+        bool run_cores(W64 start, int cycles);
+
+        /* Host time spent in the memory phase, for the scaling report */
+        void add_memory_ticks(W64 ticks) { memory_ticks += ticks; }
+
+        void enter_exclusive();
+
+        /**
+         * @brief Stop and join worker threads
+         */
+        void stop();
+
+        int get_threads() const { return thread_count; }
+        W64 get_quanta() const { return quanta; }
+        W64 get_exclusive_sections() const;
+        W64 get_core_ticks() const { return core_ticks; }
+        W64 get_memory_ticks() const { return memory_ticks; }
+        W64 get_busy_ticks() const;
+
+        /**
+         * @brief Used host thread time in the core phase, in percent
+         */
+        double get_efficiency() const;
+
+        /**
+         * @brief Speedup over clocking all cores on one host thread,
+         * estimated from the busy time of all workers
+         */
+        double get_speedup() const;
+
+        ostream& print_summary(ostream &os, W64 message_digest) const;
+};
+
+extern ParallelSim parallel_sim;
+
+#endif // PARALLEL_H
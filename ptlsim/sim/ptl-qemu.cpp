@@ -49,6 +49,8 @@ extern "C" {
 #include <ptlcalls.h>
 
 #include <test.h>
+#include <sampling.h>
+#include <warming.h>
 
 /*
  * Physical address of the PTLsim PTLCALL hypercall page
@@ -65,6 +67,9 @@ uint8_t ptl_stable_state = 1;
 uint64_t ptl_start_sim_rip = 0;
 uint8_t qemu_initialized = 0;
 
+__thread W64 mem_ram_accesses = 0;
+__thread W64 mem_switched_accesses = 0;
+
 static char *pending_command_str = NULL;
 static int pending_call_type = -1;
 static int pending_call_arg3 = -1;
@@ -870,6 +875,36 @@ bool Context::is_mmio_addr(Waddr virtaddr, bool store) {
 
 }
 
+/**
+ * @brief Host address of guest RAM mapped by QEMU's TLB
+ *
+ * Simulated loads and stores to RAM access host memory directly through
+ * the TLB addend, without switching QEMU's CPU env and flags.
+ *
+ * @return NULL on TLB miss, for MMIO, watched or not-dirty (code) pages
+ * and for accesses that cross a page; these need QEMU's softmmu helpers
+ */
+byte* Context::get_ram_host_addr(Waddr virtaddr, int sizeshift, bool store) {
+    /* Same TLB as ld*_user/ld*_kernel used on slow path */
+    int mmu_index = kernel_mode ? 0 : MMU_USER_IDX;
+    int index = (virtaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry *tlb_entry = &tlb_table[mmu_index][index];
+    W64 tlb_addr = store ? tlb_entry->addr_write : tlb_entry->addr_read;
+
+    if unlikely ((virtaddr & TARGET_PAGE_MASK) !=
+            (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK)))
+        return NULL;
+
+    if unlikely (tlb_addr & ~TARGET_PAGE_MASK)
+        return NULL;
+
+    if unlikely ((virtaddr & ~TARGET_PAGE_MASK) + (1 << sizeshift) >
+            TARGET_PAGE_SIZE)
+        return NULL;
+
+    return (byte*)(virtaddr + tlb_entry->addend);
+}
+
 bool Context::has_page_fault(Waddr virtaddr, int store) {
     int mmu_index = cpu_mmu_index((CPUState*)this);
     int index = (virtaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
@@ -948,9 +983,30 @@ void Context::propagate_x86_exception(byte exception, W32 errorcode , Waddr virt
 W64 Context::loadvirt(Waddr virtaddr, int sizeshift) {
     Waddr addr = virtaddr;
     assert(virtaddr > 0xffff);
-    setup_qemu_switch_all_ctx(*this);
     W64 data = 0;
 
+    byte* host_addr = get_ram_host_addr(virtaddr, sizeshift, 0);
+
+    if likely (host_addr) {
+        switch(sizeshift) {
+            case 0: data = (W64)(W8)ldub_p(host_addr); break;
+            case 1: data = (W64)(W16)lduw_p(host_addr); break;
+            case 2: data = (W64)(W32)ldl_p(host_addr); break;
+            default: data = (W64)ldq_p(host_addr);
+        }
+
+        mem_ram_accesses++;
+
+        if(logable(10))
+            ptl_logfile << "Context::loadvirt addr[", hexstring(addr, 64),
+                        "] data[", hexstring(data, 64), "] host[",
+                        (void*)host_addr, "]\n";
+        return data;
+    }
+
+    mem_switched_accesses++;
+    setup_qemu_switch_all_ctx(*this);
+
     bool mmio = is_mmio_addr(virtaddr, 0);
 
     if likely (!kernel_mode && !mmio) {
@@ -1046,22 +1102,20 @@ W64 Context::loadphys(Waddr addr, bool internal, int sizeshift) {
         return data;
     }
 
+    /* Host address of RAM, QEMU's CPU env is not used */
     W64 data = 0;
     Waddr orig_addr = addr;
     addr = floor(addr, 8);
-    setup_qemu_switch_all_ctx(*this);
     data = ldq_raw((uint8_t*)addr);
 
     if(logable(10))
         ptl_logfile << "Context::loadphys addr[", hexstring(addr, 64),
                     "] data[", hexstring(data, 64), "] origaddr[",
                     hexstring(orig_addr, 64), "]\n";
-    setup_ptlsim_switch_all_ctx(*this);
     return data;
 }
 
 W64 Context::storemask_virt(Waddr virtaddr, W64 data, byte bytemask, int sizeshift) {
-    setup_qemu_switch_all_ctx(*this);
     Waddr paddr = floor(virtaddr, 8);
 
     if(logable(10))
@@ -1069,6 +1123,28 @@ W64 Context::storemask_virt(Waddr virtaddr, W64 data, byte bytemask, int sizeshi
                     " with bytemask ", bytemask, " data: ", hexstring(
                             data, 64), endl;
 
+    byte* host_addr = get_ram_host_addr(virtaddr, sizeshift, 1);
+
+    if likely (host_addr) {
+        switch(sizeshift) {
+            case 0: stb_p(host_addr, (W8)data); break;
+            case 1: stw_p(host_addr, (W16)data); break;
+            case 2: stl_p(host_addr, (W32)data); break;
+            default: stq_p(host_addr, data);
+        }
+
+        mem_ram_accesses++;
+
+        if(logable(10))
+            ptl_logfile << "Context::storemask addr[", hexstring(paddr, 64),
+                        "] data[", hexstring(data, 64), "] host[",
+                        (void*)host_addr, "]\n";
+        return data;
+    }
+
+    mem_switched_accesses++;
+    setup_qemu_switch_all_ctx(*this);
+
     if(is_mmio_addr(virtaddr, 1)) {
         switch(sizeshift) {
             case 0: {
@@ -1201,7 +1277,6 @@ W64 Context::store_internal(Waddr addr, W64 data, byte bytemask) {
 
 W64 Context::storemask(Waddr paddr, W64 data, byte bytemask) {
     W64 old_data = 0;
-    setup_qemu_switch_all_ctx(*this);
     if(logable(10))
         ptl_logfile << "Trying to write to addr: ", hexstring(paddr, 64),
                     " with bytemask ", bytemask, " data: ", hexstring(
@@ -1456,6 +1531,8 @@ void init_simpoints()
  */
 uint8_t ptl_fast_fwd_enabled = 0;
 
+uint8_t ptl_fast_fwd_warming = 0;
+
 uint8_t sim_update_clock_offset = 1;
 
 /**
@@ -1476,11 +1553,20 @@ void set_cpu_fast_fwd()
         fwd_insns = config.fast_fwd_user_insns;
     }
 
-    /* Set each CPU's counter specified from config.fast_fwd_insns */
-    W64 per_cpu_fast_fwd = fwd_insns / NUM_SIM_CORES;
-
     ptl_logfile << "All CPU context will be fast-forwared to " <<
-        per_cpu_fast_fwd << " instructions.\n";
+        (fwd_insns / NUM_SIM_CORES) << " instructions.\n";
+
+    fast_fwd_cpus(fwd_insns);
+}
+
+/**
+ * @brief Split fast-forward instructions evenly between all CPU Contexts
+ *
+ * @param insns Total number of instructions to fast-forward
+ */
+void fast_fwd_cpus(W64 insns)
+{
+    W64 per_cpu_fast_fwd = insns / NUM_SIM_CORES;
 
     foreach (i, NUM_SIM_CORES) {
         Context& ctx = contextof(i);
@@ -1600,6 +1686,9 @@ static void cpu_fast_fwded(Context& ctx)
 
         ptl_fast_fwd_enabled = 0;
 
+        if (ptl_fast_fwd_warming)
+            warm_flush_all();
+
         foreach (i, NUM_SIM_CORES) {
             contextof(i).stopped = 0;
             tb_flush(&contextof(i));
@@ -1637,7 +1726,9 @@ void ptl_simpoint_reached(int cpuid)
         delete chk_name;
     }
 
-    if (config.fast_fwd_insns > 0 || config.fast_fwd_user_insns > 0) {
+    if (config.fast_fwd_insns > 0 || config.fast_fwd_user_insns > 0 ||
+            (ptl_fast_fwd_enabled &&
+             sampler.get_phase() == Sampler::SAMPLING_FAST_FWD)) {
         cpu_fast_fwded(ctx);
     }
 }
@@ -44,10 +44,11 @@ extern "C" {
  * type		: W64 (unsigned long long)
  * working	: This variable represents a simulation clock cycle in PTLsim and
  *              it is used by QEMU to calculate wall clock time in simulation
- *              mode
+ *              mode. Each thread has its own copy so cores clocked in
+ *              parallel (-parallel-threads) run ahead on their own.
  */
 typedef unsigned long long W64;
-extern W64 sim_cycle;
+extern __thread W64 sim_cycle;
 
 /*
  * in_simulation
@@ -172,9 +173,9 @@ int ptl_cpuid(uint32_t index, uint32_t count, uint32_t *eax, uint32_t *ebx,
 
 /*
  * ptl_flush_bbcache
- * context_id	: ID of the context of which the BasicBlockCache will be
- *				  flushed
- * working		: Flush all the decoded cache on tlb flush
+ * context_id	: ID of the context whose TLB flush requested this
+ * working		: Flush the shared BasicBlockCache on tlb flush, blocks
+ *				  still referenced by any context are kept
  */
 void ptl_flush_bbcache(int8_t context_id);
 
@@ -206,6 +207,13 @@ typedef void (*QemuIOCB)(void*);
 
 void add_qemu_io_event(QemuIOCB fn, void* arg, int delay);
 
+/**
+ * @brief Time until the next virtual clock timer expires
+ *
+ * @return Nano-seconds of simulated time, INT32_MAX if no timer is armed
+ */
+int64_t qemu_next_sim_deadline(void);
+
 /*
  * ptl_start_sim_rip
  * RIP location from where to switch to simulation
@@ -248,12 +256,86 @@ void set_next_simpoint(CPUX86State* ctx);
  */
 extern uint8_t ptl_fast_fwd_enabled;
 
+/**
+ * @brief Feed caches, TLBs and branch predictors while fast-forwarding
+ *
+ * Set from -fast-fwd-warming. When set, code translated for fast-forward
+ * calls ptl_warm_mem and ptl_warm_branch.
+ */
+extern uint8_t ptl_fast_fwd_warming;
+
+/* Flags of ptl_warm_mem */
+#define PTL_WARM_STORE      1
+#define PTL_WARM_CODE       2
+#define PTL_WARM_MMU_SHIFT  2
+
+/* Instruction fetches are recorded once per line of this size */
+#define PTL_WARM_LINE_BITS  6
+
+/**
+ * @brief Record a memory access done in emulation mode
+ *
+ * @param cpuid CPU Context id
+ * @param addr Virtual address, TLB entry for it must be valid
+ * @param flags PTL_WARM_* flags and MMU index
+ */
+void ptl_warm_mem(int cpuid, W64 addr, uint32_t flags);
+
+/**
+ * @brief Record a conditional branch done in emulation mode
+ *
+ * @param cpuid CPU Context id
+ * @param ripafter Address of instruction after the branch
+ * @param target Branch target
+ * @param taken Branch outcome
+ */
+void ptl_warm_branch(int cpuid, W64 ripafter, W64 target, uint32_t taken);
+
+/**
+ * @brief Set while -event-replay delivers recorded interrupts in place of
+ * interrupts raised by devices and timers
+ */
+extern uint8_t ptl_event_replay;
+
+/**
+ * @brief Record an interrupt delivered to a CPU Context in simulation
+ *
+ * @param env CPU Context
+ * @param intno Interrupt vector
+ * @param nmi Set if it is an NMI
+ */
+void ptl_event_record_interrupt(CPUX86State* env, int intno, int nmi);
+
+/**
+ * @brief Get the recorded interrupt to deliver to a CPU Context on replay
+ *
+ * @param env CPU Context
+ * @param intno Set to interrupt vector
+ * @param nmi Set to 1 if it is an NMI
+ *
+ * @return 1 if an interrupt is due at current instruction
+ */
+int ptl_event_replay_interrupt(CPUX86State* env, int* intno, int* nmi);
+
+/**
+ * @brief Check vector acknowledged from interrupt controller against the
+ * replayed one
+ */
+void ptl_event_replay_acked(CPUX86State* env, int intno, int acked);
+
 /**
  * @brief Set each CPU Context to fast forward N instructions before
  * switching to simulation mode
  */
 void set_cpu_fast_fwd(void);
 
+/**
+ * @brief Set each CPU Context to fast forward its share of N instructions
+ *
+ * @param insns Total instructions to fast forward
+ */
+void fast_fwd_cpus(W64 insns);
+
 /**
  * @brief Initialize simulator structures after QEMU's initialization
  *
@@ -25,6 +25,14 @@
 #include <machine.h>
 #include <statelist.h>
 #include <decode.h>
+#include <uopcache.h>
+#include <timeStats.h>
+#include <statsWriter.h>
+#include <sampling.h>
+#include <tracesim.h>
+#include <eventtrace.h>
+#include <parallel.h>
+#include <memoryHierarchy.h>
 
 #include <fstream>
 #include <syscalls.h>
@@ -55,12 +63,12 @@ ofstream ptl_rip_trace;
 ofstream trace_mem_logfile;
 ofstream yaml_stats_file;
 bool logenable = 0;
-W64 sim_cycle = 0;
+__thread W64 sim_cycle = 0;
 W64 unhalted_cycle_count = 0;
 W64 iterations = 0;
 W64 total_uops_executed = 0;
-W64 total_uops_committed = 0;
-W64 total_insns_committed = 0;
+__thread W64 total_uops_committed = 0;
+__thread W64 total_insns_committed = 0;
 W64 total_basic_blocks_committed = 0;
 
 W64 last_printed_status_at_ticks;
@@ -71,6 +79,9 @@ W64 ticks_per_update;
 W64 last_stats_captured_at_cycle = 0;
 W64 tsc_at_start ;
 
+/* Memory trace simulation, only with -trace-sim */
+static TraceSim *trace_sim = NULL;
+
 const char *snapshot_names[] = {"user", "kernel", "global"};
 
 Stats *user_stats;
@@ -78,6 +89,8 @@ Stats *kernel_stats;
 Stats *global_stats;
 
 ofstream *time_stats_file;
+TimeStatsWriter *time_stats_writer;
+StatsWriter *stats_writer;
 
 #endif
 
@@ -115,6 +128,9 @@ struct SimStats : public Statable
         StatString   hostname;
         StatObj<W64> native_hz;
         StatObj<W64> seconds;
+        StatObj<W64> stats_snapshots;
+        StatObj<W64> stats_writer_stalls;
+        StatObj<W64> stats_writer_stall_ms;
 
         run(Statable *parent)
             : Statable("run", parent)
@@ -122,6 +138,9 @@ struct SimStats : public Statable
               , hostname("hostname", this)
               , native_hz("native_hz", this)
               , seconds("seconds", this)
+              , stats_snapshots("stats_snapshots", this)
+              , stats_writer_stalls("stats_writer_stalls", this)
+              , stats_writer_stall_ms("stats_writer_stall_ms", this)
         { }
     } run;
 
@@ -129,14 +148,98 @@ struct SimStats : public Statable
     {
         StatObj<W64> cycles_per_sec;
         StatObj<W64> commits_per_sec;
+        StatObj<W64> mem_accesses_per_sec;
 
         performance(Statable *parent)
             : Statable("performance", parent)
               , cycles_per_sec("cycles_per_sec", this)
               , commits_per_sec("commits_per_sec", this)
+              , mem_accesses_per_sec("mem_accesses_per_sec", this)
         { }
     } performance;
 
+    struct mem_access : public Statable
+    {
+        StatObj<W64> ram;
+        StatObj<W64> switched;
+
+        mem_access(Statable *parent)
+            : Statable("mem_access", parent)
+              , ram("ram", this)
+              , switched("switched", this)
+        { }
+    } mem_access;
+
+    struct sampling : public Statable
+    {
+        StatObj<W64> samples;
+        StatObj<W64> measured_insns;
+        StatObj<W64> measured_cycles;
+
+        sampling(Statable *parent)
+            : Statable("sampling", parent)
+              , samples("samples", this)
+              , measured_insns("measured_insns", this)
+              , measured_cycles("measured_cycles", this)
+        { }
+    } sampling;
+
+    struct trace_sim : public Statable
+    {
+        StatObj<W64> records;
+        StatObj<W64> skipped;
+        StatObj<W64> stalls;
+        StatObj<W64> stall_cycles;
+
+        trace_sim(Statable *parent)
+            : Statable("trace_sim", parent)
+              , records("records", this)
+              , skipped("skipped", this)
+              , stalls("stalls", this)
+              , stall_cycles("stall_cycles", this)
+        { }
+    } trace_sim;
+
+    struct event_trace : public Statable
+    {
+        StatObj<W64> recorded;
+        StatObj<W64> replayed;
+        StatObj<W64> diverged;
+
+        event_trace(Statable *parent)
+            : Statable("event_trace", parent)
+              , recorded("recorded", this)
+              , replayed("replayed", this)
+              , diverged("diverged", this)
+        { }
+    } event_trace;
+
+    struct parallel_sim : public Statable
+    {
+        StatObj<W64> threads;
+        StatObj<W64> quantum;
+        StatObj<W64> quanta;
+        StatObj<W64> exclusive_sections;
+        StatObj<W64> message_digest;
+        StatObj<W64> host_core_ms;
+        StatObj<W64> host_memory_ms;
+        StatObj<W64> host_busy_ms;
+        StatObj<W64> efficiency_pct;
+
+        parallel_sim(Statable *parent)
+            : Statable("parallel_sim", parent)
+              , threads("threads", this)
+              , quantum("quantum", this)
+              , quanta("quanta", this)
+              , exclusive_sections("exclusive_sections", this)
+              , message_digest("message_digest", this)
+              , host_core_ms("host_core_ms", this)
+              , host_memory_ms("host_memory_ms", this)
+              , host_busy_ms("host_busy_ms", this)
+              , efficiency_pct("efficiency_pct", this)
+        { }
+    } parallel_sim;
+
     StatString tags;
 
     SimStats()
@@ -144,6 +247,11 @@ struct SimStats : public Statable
           , version(this)
           , run(this)
           , performance(this)
+          , mem_access(this)
+          , sampling(this)
+          , trace_sim(this)
+          , event_trace(this)
+          , parallel_sim(this)
           , tags("tags", this)
     {
         tags.set_split(",");
@@ -181,13 +289,17 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   stats_format = "yaml";
   snapshot_cycles = infinity;
   snapshot_now.reset();
+  snapshot_file.reset();
   time_stats_logfile = "";
   time_stats_period = 10000;
+  time_stats_format = "csv";
+  stats_writer_queue = 4;
 
   start_at_rip = INVALIDRIP;
   fast_fwd_insns = 0;
   fast_fwd_user_insns = 0;
   fast_fwd_checkpoint = "";
+  fast_fwd_warming = 0;
 
   // memory model
   use_memory_model = 0;
@@ -213,12 +325,21 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   dumpcode_filename = "test.dat";
   dump_at_end = 0;
   bbcache_dump_filename.reset();
+  uop_cache_filename.reset();
 
   machine_config = "";
+  skip_idle_cycles = 0;
+  parallel_threads = 0;
+  parallel_quantum = 1;
 
   ///
   /// memory hierarchy implementation
   ///
+  mem_request_history = 1;
+  core_mem_channels = 0;
+  cache_geometry = "";
+  mem_trace_filename = "";
+  mem_trace_compress = 1;
 
   checker_enabled = 0;
   checker_start_rip = INVALIDRIP;
@@ -233,6 +354,8 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   // Test Framework
   run_tests = 0;
 
+  trace_sim_filename = "";
+
   // Utilities/Tools
   execute_after_kill = "";
 
@@ -243,6 +366,13 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   simpoint_file = "";
   simpoint_interval = 10e6;
   simpoint_chk_name = "simpoint";
+
+  sampling_interval = 0;
+  sampling_warmup = 100000;
+  sampling_measure = 10000;
+  sampling_error = 0.03;
+  sampling_min_samples = 30;
+  sampling_snapshots = 0;
 #ifdef DRAMSIM
   // DRAMSim2 options
   dramsim_device_ini_file = "ini/DDR3_micron_8M_8B_x16_sg15.ini";
@@ -283,15 +413,19 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(stats_filename,               "stats",                "Statistics data store hierarchy root");
   add(yaml_stats_filename,          "yamlstats",                "Statistics data stores in YAML format");
   add(stats_format,					"stats-format",          "Statistics output format, default is YAML");
-  add(snapshot_cycles,              "snapshot-cycles",      "Take statistical snapshot and reset every <snapshot> cycles");
+  add(snapshot_cycles,              "snapshot-cycles",      "Take statistical snapshot of changes since previous one every <snapshot> cycles");
   add(snapshot_now,                 "snapshot-now",         "Take statistical snapshot immediately, using specified name");
+  add(snapshot_file,                "snapshot-file",        "File to write statistical snapshots in YAML (default: <yamlstats>.snapshots)");
   add(time_stats_logfile,           "time-stats-logfile",   "File to write time-series statistics (new)");
   add(time_stats_period,            "time-stats-period",    "Frequency of capturing time-stats (in cycles)");
+  add(time_stats_format,            "time-stats-format",    "Format of time-stats file: csv, binary or binary-z (compressed)");
+  add(stats_writer_queue,           "stats-writer-queue",   "Snapshots queued for background stats writer thread (0: write in simulation thread)");
   section("Trace Start/Stop Point");
   add(start_at_rip,                 "startrip",             "Start at rip <startrip>");
   add(fast_fwd_insns,               "fast-fwd-insns",       "Fast Fwd each CPU by <N> instructions");
   add(fast_fwd_user_insns,          "fast-fwd-user-insns",  "Fast Fwd each CPU by <N> user level instructions");
   add(fast_fwd_checkpoint,          "fast-fwd-checkpoint",  "Create a checkpoint <chk-name> after fast-forwarding");
+  add(fast_fwd_warming,             "fast-fwd-warming",     "Warm caches, TLBs and branch predictors while fast-forwarding");
   add(stop_at_insns,                "stopinsns",            "Stop after executing <stopinsns> user instructions");
   add(stop_at_cycle,                "stopcycle",            "Stop after <stop> cycles");
   add(stop_at_iteration,            "stopiter",             "Stop after <stop> iterations (does not apply to cycle-accurate cores)");
@@ -305,7 +439,7 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Event Trace Recording");
   add(event_trace_record_filename,  "event-record",         "Save replayable events (interrupts, DMAs, etc) to this file");
   add(event_trace_record_stop,      "event-record-stop",    "Stop recording events");
-  add(event_trace_replay_filename,  "event-replay",         "Replay events (interrupts, DMAs, etc) to this file, starting at checkpoint");
+  add(event_trace_replay_filename,  "event-replay",         "Replay events (interrupts, DMAs, etc) from this file, recorded with -event-record from the same checkpoint");
 
   section("Timers and Interrupts");
   add(core_freq_hz,                 "corefreq",             "Core clock frequency in Hz (default uses host system frequency)");
@@ -321,11 +455,15 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(dumpcode_filename,            "dumpcode",             "Save page of user code at final rip to file <dumpcode>");
   add(dump_at_end,                  "dump-at-end",          "Set breakpoint and dump core before first instruction executed on return to native mode");
   add(bbcache_dump_filename,        "bbdump",               "Basic block cache dump filename");
+  add(uop_cache_filename,           "uop-cache",            "Persistent translated uop cache file, read at first translation and updated at exit");
 
  add(verify_cache,               "verify-cache",                   "run simulation with storing actual data in cache");
 
   section("Core Configuration");
   add(machine_config, "machine", "Name of machine configuration to simulate");
+  add(skip_idle_cycles, "skip-idle-cycles", "Skip cycles in which all cores are stalled waiting for memory or IO events");
+  add(parallel_threads, "parallel-threads", "Clock cores on <N> host threads in quanta, 1 runs the same schedule serially (0 to disable)");
+  add(parallel_quantum, "parallel-quantum", "Cycles cores run between two memory hierarchy synchronizations in parallel mode");
 
  ///
  /// following are for the new memory hierarchy implementation:
@@ -333,6 +471,11 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Memory Hierarchy Configuration");
   //  add(memory_log,               "memory-log",               "log memory debugging info");
+  add(mem_request_history,          "mem-request-history",      "Record controllers visited by each memory request for debug logs");
+  add(core_mem_channels,            "core-mem-channels",        "Connect cores and memory hierarchy with message channels instead of direct calls");
+  add(cache_geometry,               "cache-geometry",           "Override geometry of DYNAMIC caches: <name prefix>:<size>[:<ways>[:<latency>]],...");
+  add(mem_trace_filename,           "mem-trace",                "Record all accesses sent by cores to the memory hierarchy in given file (see -trace-sim)");
+  add(mem_trace_compress,           "mem-trace-compress",       "Compress memory trace blocks with zlib");
 
   // MongoDB
   section("bus configuration");
@@ -346,6 +489,9 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Unit Test Framework");
   add(run_tests,            "run-tests",            "Run Test cases");
 
+  section("Trace Driven Memory Simulation");
+  add(trace_sim_filename,   "trace-sim",            "Simulate only the memory hierarchy with given memory trace, guest is not run");
+
   // Utilities/Tools
   section("options for tools/utilities");
   add(execute_after_kill,	"execute-after-kill" ,	"Execute a shell command (on the host shell) after simulation receives kill signal");
@@ -357,6 +503,14 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(simpoint_file, "simpoint", "Create simpoint based checkpoints from given 'simpoint' file");
   add(simpoint_interval, "simpoint-interval", "Number of instructions in each interval");
   add(simpoint_chk_name, "simpoint-chk-name", "Checkpoint name prefix");
+
+  section("Sampling Options");
+  add(sampling_interval,    "sampling-interval",    "Simulate one sample every <N> instructions, fast-forward the rest (0 to disable)");
+  add(sampling_warmup,      "sampling-warmup",      "Detailed warmup instructions before each sample");
+  add(sampling_measure,     "sampling-measure",     "Measured instructions in each sample");
+  add(sampling_error,       "sampling-error",       "Stop when 95% confidence interval of CPI is within this fraction of mean");
+  add(sampling_min_samples, "sampling-min-samples", "Minimum number of samples before checking error");
+  add(sampling_snapshots,   "sampling-snapshots",   "Take stats snapshot at start and end of each measured sample");
 #ifdef DRAMSIM
   section("DRAMSim2 Config options");
   add(dramsim_device_ini_file,  "dramsim-device-ini-file",   "Device ini file that DRAMSim2 should load");
@@ -464,7 +618,8 @@ void capture_stats_snapshot(const char* name) {
     ptl_logfile << " at cycle " << sim_cycle << endl;
   }
 
-  /* TODO: Support stats snapshot in new Stats module */
+  if (stats_writer)
+    stats_writer->snapshot(name, sim_cycle, user_stats, kernel_stats);
 }
 
 void print_sysinfo(ostream& os) {
@@ -516,6 +671,10 @@ static void flush_stats()
     assert(machine);
     machine->update_stats();
 
+    /* Writer counters are part of run stats */
+    if(stats_writer)
+        stats_writer->drain();
+
     // Call this function to setup tags and other info
     setup_sim_stats();
 
@@ -531,8 +690,17 @@ static void flush_stats()
     if(config.enable_mongo)
         write_mongo_stats();
 
-    if(time_stats_file) {
-        time_stats_file->close();
+    if(stats_writer) {
+        stats_writer->close();
+        stats_writer->print_summary(ptl_logfile);
+    }
+
+    if(parallel_sim.enabled()) {
+        W64 digest = ((BaseMachine*)machine)->memoryHierarchyPtr->
+            get_message_digest();
+
+        parallel_sim.print_summary(ptl_logfile, digest);
+        parallel_sim.print_summary(cerr, digest);
     }
     //FIXME: this assumes that flush_stats is only called at the end, which is true now but might not be true in the long run
 #ifdef DRAMSIM
@@ -565,6 +733,7 @@ static void kill_simulation()
     }
 
     shutdown_decode();
+    parallel_sim.stop();
 
 	PTLsimMachine* machine = PTLsimMachine::getmachine(config.core_name.buf);
 	if (machine)
@@ -631,12 +800,40 @@ if ((config.loglevel > 0) & (config.start_log_at_rip == INVALIDRIP) & (config.st
     current_bbcache_dump_filename = config.bbcache_dump_filename;
   }
 
+  if (config.uop_cache_filename.set()) {
+    uopcache.set_filename(config.uop_cache_filename);
+  }
+
 #ifdef __x86_64__
   config.start_log_at_rip = signext64(config.start_log_at_rip, 48);
   config.start_at_rip = signext64(config.start_at_rip, 48);
   config.stop_at_rip = signext64(config.stop_at_rip, 48);
 #endif
 
+  if (config.sampling_interval && !sampler.enabled()) {
+      if (config.sampling_measure == 0 || config.sampling_interval <
+              config.sampling_warmup + config.sampling_measure) {
+          cerr << "Error: sampling-interval must be at least " <<
+              "sampling-warmup + sampling-measure instructions and " <<
+              "sampling-measure can't be 0" << endl;
+          ptl_quit();
+      }
+
+      sampler.setup(config.sampling_interval, config.sampling_warmup,
+              config.sampling_measure, config.sampling_error,
+              config.sampling_min_samples);
+  }
+
+  if (config.event_trace_record_stop) {
+      config.event_trace_record_stop = 0;
+      if (event_trace.is_recording()) {
+          event_trace.stop_record();
+          event_trace.print_summary(ptl_logfile);
+      }
+  }
+
+  ptl_fast_fwd_warming = config.fast_fwd_warming;
+
   if ((config.fast_fwd_insns || config.fast_fwd_user_insns) && qemu_initialized) {
       set_cpu_fast_fwd();
   }
@@ -806,6 +1003,8 @@ void PTLsimMachine::update_stats() { return; }
 void PTLsimMachine::dump_state(ostream& os) { return; }
 void PTLsimMachine::flush_tlb(Context& ctx) { return; }
 void PTLsimMachine::flush_tlb_virt(Context& ctx, Waddr virtaddr) { return; }
+void PTLsimMachine::warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr, bool is_store, bool is_code) { return; }
+void PTLsimMachine::warm_branch(Context& ctx, W64 ripafter, W64 target, bool taken) { return; }
 void PTLsimMachine::dump_configuration(ostream& os) const { return; }
 
 void PTLsimMachine::addmachine(const char* name, PTLsimMachine* machine) {
@@ -919,20 +1118,43 @@ extern "C" void ptl_machine_configure(const char* config_str_) {
         global_stats = builder.get_new_stats();
 
         // time based stats
+        time_stats_file = NULL;
+        time_stats_writer = NULL;
+
         if (config.time_stats_logfile.length > 0)
         {
-            time_stats_file = new ofstream(config.time_stats_logfile.buf);
-            builder.init_timer_stats();
-        } else {
-            time_stats_file = NULL;
+            if (config.time_stats_format == "binary" ||
+                    config.time_stats_format == "binary-z") {
+                time_stats_writer = new TimeStatsWriter(
+                        config.time_stats_logfile.buf,
+                        config.time_stats_format == "binary-z",
+                        config.time_stats_period);
+            } else {
+                if (config.time_stats_format != "csv")
+                    ptl_logfile << "Unknown time-stats format: " <<
+                        config.time_stats_format <<
+                        " writing in default CSV format." << endl;
+                time_stats_file = new ofstream(config.time_stats_logfile.buf);
+            }
         }
+
+        /* Named snapshots go next to the YAML stats by default */
+        stringbuf snapshot_file;
+        if (config.snapshot_file.set())
+            snapshot_file << config.snapshot_file;
+        else if (config.yaml_stats_filename.set())
+            snapshot_file << config.yaml_stats_filename << ".snapshots";
+
+        stats_writer = new StatsWriter(config.stats_writer_queue,
+                time_stats_file, time_stats_writer,
+                snapshot_file.size() ? snapshot_file.buf : NULL);
     }
 
     qemu_free(config_str);
 
     ptl_machine.disable_dump();
 
-    if(config.run_tests) {
+    if(config.run_tests || config.trace_sim_filename.set()) {
         in_simulation = 1;
     }
 }
@@ -1198,12 +1420,85 @@ static void set_run_stats()
     W64 cycles_per_sec = W64(double(sim_cycle) / double(seconds));
     W64 commits_per_sec = W64(
             double(total_insns_committed) / double(seconds));
+    W64 mem_accesses_per_sec = W64(
+            double(mem_ram_accesses + mem_switched_accesses) /
+            double(seconds));
+    W64 snapshots = 0, stalls = 0, stall_ms = 0;
+    W64 samples = sampler.get_samples();
+    W64 measured_insns = sampler.get_measured_insns();
+    W64 measured_cycles = sampler.get_measured_cycles();
+    W64 trace_records = 0, trace_skipped = 0;
+    W64 trace_stalls = 0, trace_stall_cycles = 0;
+    W64 events_recorded = event_trace.get_recorded();
+    W64 events_replayed = event_trace.get_replayed();
+    W64 events_diverged = event_trace.get_diverged();
+
+    if(trace_sim) {
+        trace_records = trace_sim->get_records();
+        trace_skipped = trace_sim->get_skipped();
+        trace_stalls = trace_sim->get_stalls();
+        trace_stall_cycles = trace_sim->get_stall_cycles();
+    }
+
+    W64 parallel_threads = 0, parallel_quanta = 0, exclusive_sections = 0;
+    W64 message_digest = 0, host_core_ms = 0, host_memory_ms = 0;
+    W64 host_busy_ms = 0, efficiency_pct = 0;
+    W64 parallel_quantum = parallel_sim.get_quantum();
+
+    if(parallel_sim.enabled()) {
+        BaseMachine *machine = (BaseMachine*)(PTLsimMachine::getmachine(
+                    config.core_name.buf));
+
+        parallel_threads = parallel_sim.get_threads();
+        parallel_quanta = parallel_sim.get_quanta();
+        exclusive_sections = parallel_sim.get_exclusive_sections();
+        message_digest = machine->memoryHierarchyPtr->get_message_digest();
+        host_core_ms = W64(ticks_to_native_seconds(
+                    parallel_sim.get_core_ticks()) * 1000);
+        host_memory_ms = W64(ticks_to_native_seconds(
+                    parallel_sim.get_memory_ticks()) * 1000);
+        host_busy_ms = W64(ticks_to_native_seconds(
+                    parallel_sim.get_busy_ticks()) * 1000);
+        efficiency_pct = W64(parallel_sim.get_efficiency());
+    }
+
+    if(stats_writer) {
+        snapshots = stats_writer->get_snapshots();
+        stalls = stats_writer->get_stalls();
+        stall_ms = W64(ticks_to_native_seconds(
+                    stats_writer->get_stall_ticks()) * 1000);
+    }
 
 #define RUN_STAT(stat) \
     simstats.set_default_stats(stat); \
     simstats.run.seconds = seconds; \
+    simstats.run.stats_snapshots = snapshots; \
+    simstats.run.stats_writer_stalls = stalls; \
+    simstats.run.stats_writer_stall_ms = stall_ms; \
     simstats.performance.cycles_per_sec = cycles_per_sec; \
-    simstats.performance.commits_per_sec = commits_per_sec;
+    simstats.performance.commits_per_sec = commits_per_sec; \
+    simstats.performance.mem_accesses_per_sec = mem_accesses_per_sec; \
+    simstats.mem_access.ram = mem_ram_accesses; \
+    simstats.mem_access.switched = mem_switched_accesses; \
+    simstats.sampling.samples = samples; \
+    simstats.sampling.measured_insns = measured_insns; \
+    simstats.sampling.measured_cycles = measured_cycles; \
+    simstats.trace_sim.records = trace_records; \
+    simstats.trace_sim.skipped = trace_skipped; \
+    simstats.trace_sim.stalls = trace_stalls; \
+    simstats.trace_sim.stall_cycles = trace_stall_cycles; \
+    simstats.event_trace.recorded = events_recorded; \
+    simstats.event_trace.replayed = events_replayed; \
+    simstats.event_trace.diverged = events_diverged; \
+    simstats.parallel_sim.threads = parallel_threads; \
+    simstats.parallel_sim.quantum = parallel_quantum; \
+    simstats.parallel_sim.quanta = parallel_quanta; \
+    simstats.parallel_sim.exclusive_sections = exclusive_sections; \
+    simstats.parallel_sim.message_digest = message_digest; \
+    simstats.parallel_sim.host_core_ms = host_core_ms; \
+    simstats.parallel_sim.host_memory_ms = host_memory_ms; \
+    simstats.parallel_sim.host_busy_ms = host_busy_ms; \
+    simstats.parallel_sim.efficiency_pct = efficiency_pct;
 
     RUN_STAT(user_stats);
     RUN_STAT(kernel_stats);
@@ -1286,7 +1581,69 @@ static void dump_machine_configuration(PTLsimMachine *machine)
 	}
 }
 
-extern "C" uint8_t ptl_simulate() {
+/**
+ * @brief Take stats snapshots around measured part of a sample
+ *
+ * @param prev Sampling phase of the window that just ended
+ * @param phase Sampling phase of the next window
+ */
+static void sampling_snapshot(Sampler::Phase prev, Sampler::Phase phase)
+{
+    if (!config.sampling_snapshots)
+        return;
+
+    if (prev == Sampler::SAMPLING_MEASURE) {
+        stringbuf name;
+        name << "sample_" << (sampler.get_samples() - 1);
+        capture_stats_snapshot(name);
+    }
+
+    if (phase == Sampler::SAMPLING_MEASURE) {
+        stringbuf name;
+        name << "sample_" << sampler.get_samples() << "_start";
+        capture_stats_snapshot(name);
+    }
+}
+
+/**
+ * @brief Current sampling window has ended
+ *
+ * @param machine Simulation machine
+ *
+ * @return true if simulation switches to emulation to fast-forward to the
+ * next sample
+ */
+static bool sampling_window_done(PTLsimMachine* machine)
+{
+    Sampler::Phase prev = sampler.get_phase();
+    Sampler::Phase phase = sampler.window_done(total_insns_committed,
+            sim_cycle);
+
+    sampling_snapshot(prev, phase);
+
+    if (phase == Sampler::SAMPLING_DONE) {
+        ptl_logfile << "Sampling error bound reached after " <<
+            sampler.get_samples() << " samples" << endl;
+        machine->stopped = 1;
+        return false;
+    }
+
+    if (phase == Sampler::SAMPLING_FAST_FWD) {
+        if (logable(1)) {
+            ptl_logfile << "Sample " << sampler.get_samples() <<
+                " done at sim_cycle " << sim_cycle << ", fast-forwarding " <<
+                sampler.get_fast_fwd_insns() << " instructions" << endl;
+        }
+
+        ptl_fast_fwd_enabled = 1;
+        fast_fwd_cpus(sampler.get_fast_fwd_insns());
+        return true;
+    }
+
+    return false;
+}
+
+PTLsimMachine* ptl_init_machine() {
 	PTLsimMachine* machine = NULL;
 	char* machinename = config.core_name;
 	if likely (curr_ptl_machine != NULL) {
@@ -1298,23 +1655,73 @@ extern "C" uint8_t ptl_simulate() {
 	if (!machine) {
 		ptl_logfile << "Cannot find core named '" << machinename << "'" << endl;
 		cerr << "Cannot find core named '" << machinename << "'" << endl;
-		return 0;
+		return NULL;
 	}
 
-    // If config.run_tests is enabled, then run testcases
-    if(config.run_tests) {
-        run_tests();
-    }
-
 	if (!machine->initialized) {
 		ptl_logfile << "Initializing core '" << machinename << "'" << endl;
 		if (!machine->init(config)) {
 			ptl_logfile << "Cannot initialize simulation machine; check the configuration!" << endl;
-            config.run = 0;
-			return 0;
+			return NULL;
 		}
 		machine->initialized = 1;
 		machine->first_run = 1;
+	}
+
+	return machine;
+}
+
+/**
+ * @brief Simulate only the memory hierarchy with a memory trace
+ * (-trace-sim), guest is never run and simulator exits at the end
+ */
+static void run_trace_sim()
+{
+    PTLsimMachine* machine = ptl_init_machine();
+    if (!machine) {
+        cerr << "Cannot initialize simulation machine for memory trace" << endl;
+        config.kill = true;
+        kill_simulation();
+    }
+
+    dump_machine_configuration(machine);
+
+    trace_sim = new TraceSim(*(BaseMachine*)machine);
+    tsc_at_start = rdtsc();
+
+    trace_sim->run(config.trace_sim_filename);
+
+    trace_sim->print_summary(ptl_logfile);
+    trace_sim->print_summary(cerr);
+
+    flush_stats();
+
+    config.kill = true;
+    kill_simulation();
+}
+
+extern "C" uint8_t ptl_simulate() {
+	static bool simulation_started = false;
+	char* machinename = config.core_name;
+
+    // If config.run_tests is enabled, then run testcases
+    if(config.run_tests) {
+        run_tests();
+    }
+
+    if unlikely (config.trace_sim_filename.set()) {
+        run_trace_sim();
+    }
+
+	PTLsimMachine* machine = ptl_init_machine();
+	if (!machine) {
+		config.run = 0;
+		return 0;
+	}
+
+	/* Machine can be initialized earlier by fast-forward warming */
+	if (!simulation_started) {
+		simulation_started = true;
 
 		if(logable(1)) {
 			ptl_logfile << "Switching to simulation core '" << machinename << "'..." << endl << flush;
@@ -1335,6 +1742,8 @@ extern "C" uint8_t ptl_simulate() {
 		tsc_at_start = rdtsc();
 		curr_ptl_machine = machine;
 
+		event_trace_start();
+
         if(config.enable_mongo) {
             // Check MongoDB connection
             hostent *host;
@@ -1385,6 +1794,13 @@ extern "C" uint8_t ptl_simulate() {
 	if(machine->stopped != 0)
 		machine->stopped = 0;
 
+	/* Coming back from emulation, start next sample */
+	if(sampler.get_phase() == Sampler::SAMPLING_FAST_FWD) {
+		Sampler::Phase prev = sampler.get_phase();
+		sampler.start_unit(total_insns_committed, sim_cycle);
+		sampling_snapshot(prev, sampler.get_phase());
+	}
+
     if(logable(1)) {
 		ptl_logfile << "Starting simulation at rip: ";
 		foreach(i, contextcount) {
@@ -1408,6 +1824,22 @@ extern "C" uint8_t ptl_simulate() {
     if(machine->ret_qemu_env)
         setup_qemu_switch_all_ctx(*machine->ret_qemu_env);
 
+	if (!machine->stopped && sampler.get_window_end() <= total_insns_committed
+			&& sampling_window_done(machine)) {
+		/* Fast-forward to next sample in emulation mode */
+		event_trace_stop();
+		machine->first_run = 1;
+		sim_update_clock_offset = 1;
+
+		foreach(ctx_no, contextcount) {
+			Context& ctx = contextof(ctx_no);
+			tb_flush((CPUX86State*)(&ctx));
+			ctx.old_eip = 0;
+		}
+
+		return 0;
+	}
+
 	if (!machine->stopped) {
         if(logable(1)) {
 			ptl_logfile << "Switching back to qemu rip: " << (void *)contextof(0).get_cs_eip() << " exception: " << contextof(0).exception_index <<
@@ -1425,6 +1857,8 @@ extern "C" uint8_t ptl_simulate() {
 	W64 tsc_at_end = rdtsc();
 	curr_ptl_machine = NULL;
 
+	event_trace_stop();
+
 	W64 seconds = W64(ticks_to_native_seconds(tsc_at_end - tsc_at_start));
 	stringbuf sb;
 	sb << endl << "Stopped after " << sim_cycle << " cycles, " << total_insns_committed << " instructions and " <<
@@ -1434,6 +1868,11 @@ extern "C" uint8_t ptl_simulate() {
 	ptl_logfile << sb << flush;
 	cerr << sb << flush;
 
+	if (sampler.enabled()) {
+		sampler.print_summary(ptl_logfile);
+		sampler.print_summary(cerr);
+	}
+
 	if (config.dumpcode_filename.set()) {
 		//    byte insnbuf[256];
 		//    PageFaultErrorCode pfec;
@@ -1540,12 +1979,14 @@ struct QemuIOSignal : public FixStateListObject
     QemuIOCB fn;
     void *arg;
     W64 cycle;
+    W64 seq;
 
     void init()
     {
         fn = 0;
         arg = 0;
         cycle = 0;
+        seq = 0;
     }
 
     void setup(QemuIOCB fn, void *arg, int delay)
@@ -1553,6 +1994,18 @@ struct QemuIOSignal : public FixStateListObject
         this->fn = fn;
         this->arg = arg;
         this->cycle = sim_cycle + delay;
+        this->seq = event_trace.add_io();
+    }
+
+    /* On event replay fire when CPU 0 reaches the recorded instruction */
+    bool due() const
+    {
+        if unlikely (ptl_event_replay) {
+            W64 insns = event_trace.get_io_insns(seq);
+            if (insns != (W64)-1)
+                return contextof(0).insns_committed >= insns;
+        }
+        return cycle <= sim_cycle;
     }
 };
 
@@ -1567,14 +2020,29 @@ void clock_qemu_io_events()
 {
     QemuIOSignal *signal;
     foreach_list_mutable(qemuIOEvents->list(), signal, entry, prev) {
-        if (signal->cycle <= sim_cycle) {
+        if (signal->due()) {
             ptl_logfile << "Executing QEMU IO Event at " << sim_cycle << endl;
+            if unlikely (event_trace.is_recording()) {
+                Context& ctx = contextof(0);
+                event_trace.record(EVENT_TRACE_IO, 0, ctx.insns_committed,
+                        ctx.eip, signal->seq);
+            }
             signal->fn(signal->arg);
             qemuIOEvents->free(signal);
         }
     }
 }
 
+W64 get_next_qemu_io_event_cycle()
+{
+    W64 next = (W64)-1;
+    QemuIOSignal *signal;
+    foreach_list_mutable(qemuIOEvents->list(), signal, entry, prev) {
+        next = min(next, signal->cycle);
+    }
+    return next;
+}
+
 extern "C" void add_qemu_io_event(QemuIOCB fn, void *arg, int delay)
 {
     QemuIOSignal* signal = qemuIOEvents->alloc();
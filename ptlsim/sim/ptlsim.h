@@ -39,6 +39,12 @@ extern Stats *global_stats;
 extern Stats *time_stats;
 extern ofstream *time_stats_file;
 
+class TimeStatsWriter;
+extern TimeStatsWriter *time_stats_writer;
+
+class StatsWriter;
+extern StatsWriter *stats_writer;
+
 struct PTLsimCore{
   virtual PTLsimCore& getcore() const{ return (*((PTLsimCore*)NULL));}
 };
@@ -61,6 +67,10 @@ struct PTLsimMachine : public Statable {
   virtual void dump_state(ostream& os);
   virtual void flush_tlb(Context& ctx);
   virtual void flush_tlb_virt(Context& ctx, Waddr virtaddr);
+  virtual void warm_mem(Context& ctx, Waddr virtaddr, W64 physaddr,
+      bool is_store, bool is_code);
+  virtual void warm_branch(Context& ctx, W64 ripafter, W64 target,
+      bool taken);
   virtual void dump_configuration(ostream& os) const;
   virtual void reset(){};
 #ifdef DRAMSIM
@@ -85,6 +95,13 @@ struct PTLsimMachine : public Statable {
   }
 };
 
+/**
+ * @brief Get current machine, initialize it if not done yet
+ *
+ * @return NULL if the machine can't be found or initialized
+ */
+PTLsimMachine* ptl_init_machine();
+
 void setup_qemu_switch_all_ctx(Context& last_ctx);
 void setup_qemu_switch_except_ctx(const Context& const_ctx);
 void setup_ptlsim_switch_all_ctx(Context& const_ctx);
@@ -167,13 +184,17 @@ struct PTLsimStats;
 
 extern ofstream ptl_logfile;
 extern ofstream trace_mem_logfile;
-extern W64 sim_cycle;
+extern __thread W64 sim_cycle;
 extern W64 user_insn_commits;
 extern W64 iterations;
 extern W64 total_uops_executed;
-extern W64 total_uops_committed;
-extern W64 total_insns_committed;
+/* Per thread, merged into the simulation thread after a parallel quantum */
+extern __thread W64 total_uops_committed;
+extern __thread W64 total_insns_committed;
 extern W64 total_basic_blocks_committed;
+/* Simulated loads/stores done directly on guest RAM or through QEMU */
+extern __thread W64 mem_ram_accesses;
+extern __thread W64 mem_switched_accesses;
 
 // #define TRACE_RIP
 #ifdef TRACE_RIP
@@ -199,6 +220,7 @@ struct PTLsimConfig {
   W64 fast_fwd_insns;
   W64 fast_fwd_user_insns;
   stringbuf fast_fwd_checkpoint;
+  bool fast_fwd_warming;
 
   // Logging
   bool quiet;
@@ -223,9 +245,12 @@ struct PTLsimConfig {
   stringbuf yaml_stats_filename;
   W64 snapshot_cycles;
   stringbuf snapshot_now;
+  stringbuf snapshot_file;
   stringbuf time_stats_logfile;
   W64 time_stats_period;
+  stringbuf time_stats_format;
   stringbuf stats_format;
+  W64 stats_writer_queue;
 
   // memory model:
   bool use_memory_model;
@@ -257,14 +282,23 @@ struct PTLsimConfig {
   stringbuf dumpcode_filename;
   bool dump_at_end;
   stringbuf bbcache_dump_filename;
+  stringbuf uop_cache_filename;
 
   // Machine configurations
   stringbuf machine_config;
+  bool skip_idle_cycles;
+  W64 parallel_threads;
+  W64 parallel_quantum;
 
   ///
   /// for memory hierarchy implementaion
   ///
   //  bool memory_log;
+  bool mem_request_history;
+  bool core_mem_channels;
+  stringbuf cache_geometry;
+  stringbuf mem_trace_filename;
+  bool mem_trace_compress;
 
   bool checker_enabled;
   W64 checker_start_rip;
@@ -279,6 +313,9 @@ struct PTLsimConfig {
   // Test Framework
   bool run_tests;
 
+  // Trace driven memory hierarchy simulation
+  stringbuf trace_sim_filename;
+
   //Utilities/Tools
   stringbuf execute_after_kill;
 
@@ -290,6 +327,14 @@ struct PTLsimConfig {
   W64 simpoint_interval;
   stringbuf simpoint_chk_name;
 
+  // Sampling options
+  W64 sampling_interval;
+  W64 sampling_warmup;
+  W64 sampling_measure;
+  double sampling_error;
+  W64 sampling_min_samples;
+  bool sampling_snapshots;
+
 #ifdef DRAMSIM
   // DRAMSim2 options
   stringbuf dramsim_device_ini_file;
@@ -325,6 +370,13 @@ void force_logging_enabled();
 void init_qemu_io_events();
 void clock_qemu_io_events();
 
+/**
+ * @brief Cycle of next pending QEMU IO event
+ *
+ * @return Simulation cycle of earliest event, -1 if none is pending
+ */
+W64 get_next_qemu_io_event_cycle();
+
 /**
  * @brief Convert nano-seconds to Simulation Cycles
  *
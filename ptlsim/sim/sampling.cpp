@@ -0,0 +1,159 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <sampling.h>
+
+#include <ptlsim.h>
+#include <math.h>
+
+Sampler sampler;
+
+Sampler::Sampler()
+    : phase(SAMPLING_OFF)
+      , interval(0)
+      , warmup(0)
+      , measure(0)
+      , error(0)
+      , min_samples(0)
+{
+    reset();
+}
+
+void Sampler::setup(W64 interval_, W64 warmup_, W64 measure_,
+        double error_, W64 min_samples_)
+{
+    assert(measure_ > 0);
+    assert(interval_ >= warmup_ + measure_);
+
+    interval = interval_;
+    warmup = warmup_;
+    measure = measure_;
+    error = error_;
+    min_samples = max(min_samples_, W64(2));
+
+    reset();
+    phase = SAMPLING_FAST_FWD;
+}
+
+void Sampler::reset()
+{
+    window_end = infinity;
+    measure_start_insns = 0;
+    measure_start_cycle = 0;
+    samples = 0;
+    cpi_mean = 0;
+    cpi_m2 = 0;
+    measured_insns = 0;
+    measured_cycles = 0;
+}
+
+void Sampler::start_unit(W64 insns, W64 cycle)
+{
+    if (warmup) {
+        phase = SAMPLING_WARMUP;
+        window_end = insns + warmup;
+    } else {
+        phase = SAMPLING_MEASURE;
+        measure_start_insns = insns;
+        measure_start_cycle = cycle;
+        window_end = insns + measure;
+    }
+}
+
+Sampler::Phase Sampler::window_done(W64 insns, W64 cycle)
+{
+    switch (phase) {
+        case SAMPLING_WARMUP:
+            phase = SAMPLING_MEASURE;
+            window_end = insns + measure;
+            measure_start_insns = insns;
+            measure_start_cycle = cycle;
+            break;
+
+        case SAMPLING_MEASURE:
+        {
+            /* Cores commit several instructions per cycle, so use the
+             * real window length instead of 'measure' */
+            W64 window_insns = insns - measure_start_insns;
+            W64 window_cycles = cycle - measure_start_cycle;
+
+            if (window_insns) {
+                add_sample(double(window_cycles) / double(window_insns));
+                measured_insns += window_insns;
+                measured_cycles += window_cycles;
+            }
+
+            window_end = infinity;
+
+            if (converged()) {
+                phase = SAMPLING_DONE;
+            } else if (get_fast_fwd_insns()) {
+                phase = SAMPLING_FAST_FWD;
+            } else {
+                start_unit(insns, cycle);
+            }
+            break;
+        }
+
+        default:
+            assert(0);
+    }
+
+    return phase;
+}
+
+void Sampler::add_sample(double cpi)
+{
+    double delta = cpi - cpi_mean;
+
+    samples++;
+    cpi_mean += delta / samples;
+    cpi_m2 += delta * (cpi - cpi_mean);
+}
+
+double Sampler::get_stddev() const
+{
+    if (samples < 2)
+        return 0;
+    return sqrt(cpi_m2 / (samples - 1));
+}
+
+double Sampler::get_confidence() const
+{
+    if (samples < 2)
+        return 0;
+    return SAMPLING_Z_95 * get_stddev() / sqrt(double(samples));
+}
+
+double Sampler::get_error() const
+{
+    if (cpi_mean == 0)
+        return 0;
+    return get_confidence() / cpi_mean;
+}
+
+bool Sampler::converged() const
+{
+    return samples >= min_samples && get_error() <= error;
+}
+
+ostream& Sampler::print_summary(ostream &os) const
+{
+    os << "Sampling: ", samples, " samples of ", measure,
+       " instructions every ", interval, " instructions";
+
+    if (samples) {
+        os << ", CPI ", cpi_mean, " +/- ", get_confidence(),
+           " (95% confidence, ", get_error() * 100.0, "% error)";
+    }
+
+    if (phase == SAMPLING_DONE)
+        os << ", target error ", error * 100.0, "% reached";
+
+    os << endl;
+    return os;
+}
@@ -0,0 +1,139 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/* Normal distribution quantile for 95% confidence intervals */
+#define SAMPLING_Z_95 1.96
+
+/**
+ * @brief Systematic sampling of detailed simulation (SMARTS)
+ *
+ * Execution is split in sampling units of 'interval' instructions. Each
+ * unit starts with a detailed warmup window of 'warmup' instructions,
+ * followed by a measured window of 'measure' instructions, and the rest
+ * of the unit is fast-forwarded in emulation mode. The CPI of each
+ * measured window is one sample.
+ *
+ * Once at least 'min_samples' samples are taken and the half width of the
+ * 95% confidence interval of the mean CPI is within 'error' of the mean,
+ * sampling is done and simulation stops.
+ *
+ * Instruction counts are totals of all simulated cores, so fast-forward
+ * instructions are split evenly between CPU contexts.
+ */
+class Sampler {
+    public:
+        enum Phase {
+            SAMPLING_OFF = 0,
+            SAMPLING_FAST_FWD,
+            SAMPLING_WARMUP,
+            SAMPLING_MEASURE,
+            SAMPLING_DONE,
+        };
+
+    private:
+        Phase phase;
+
+        W64 interval;
+        W64 warmup;
+        W64 measure;
+        double error;
+        W64 min_samples;
+
+        W64 window_end;
+        W64 measure_start_insns;
+        W64 measure_start_cycle;
+
+        /* Running mean and variance of sample CPI (Welford) */
+        W64 samples;
+        double cpi_mean;
+        double cpi_m2;
+
+        W64 measured_insns;
+        W64 measured_cycles;
+
+    public:
+        Sampler();
+
+        /**
+         * @brief Enable sampling
+         *
+         * @param interval_ Instructions in each sampling unit
+         * @param warmup_ Detailed warmup instructions of a unit
+         * @param measure_ Measured instructions of a unit
+         * @param error_ Target relative error of mean CPI
+         * @param min_samples_ Samples to take before checking the error
+         */
+        void setup(W64 interval_, W64 warmup_, W64 measure_, double error_,
+                W64 min_samples_);
+
+        void reset();
+
+        bool enabled() const { return phase != SAMPLING_OFF; }
+        Phase get_phase() const { return phase; }
+
+        /**
+         * @brief Total committed instructions at which current detailed
+         * window ends, infinity outside of a window
+         */
+        W64 get_window_end() const { return window_end; }
+
+        W64 get_fast_fwd_insns() const {
+            return interval - warmup - measure;
+        }
+
+        /**
+         * @brief Start warmup window of next sampling unit
+         *
+         * @param insns Total committed instructions
+         * @param cycle Current simulation cycle
+         */
+        void start_unit(W64 insns, W64 cycle);
+
+        /**
+         * @brief Current detailed window has reached its end
+         *
+         * @param insns Total committed instructions
+         * @param cycle Current simulation cycle
+         *
+         * @return Phase to continue with: SAMPLING_MEASURE or
+         * SAMPLING_WARMUP keep simulating, SAMPLING_FAST_FWD switches to
+         * emulation and SAMPLING_DONE stops the simulation.
+         */
+        Phase window_done(W64 insns, W64 cycle);
+
+        void add_sample(double cpi);
+
+        W64 get_samples() const { return samples; }
+        W64 get_measured_insns() const { return measured_insns; }
+        W64 get_measured_cycles() const { return measured_cycles; }
+        double get_cpi() const { return cpi_mean; }
+        double get_stddev() const;
+
+        /**
+         * @brief Half width of the 95% confidence interval of mean CPI
+         */
+        double get_confidence() const;
+
+        /**
+         * @brief Confidence interval relative to mean CPI
+         */
+        double get_error() const;
+
+        bool converged() const;
+
+        ostream& print_summary(ostream &os) const;
+};
+
+extern Sampler sampler;
+
+#endif // SAMPLING_H
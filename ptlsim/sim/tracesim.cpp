@@ -0,0 +1,180 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <tracesim.h>
+
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+
+using namespace Memory;
+
+/* Give up draining if no access completes for this many cycles */
+static const W64 TRACE_SIM_DRAIN_LIMIT = 10000000;
+
+TraceSim::TraceSim(BaseMachine& machine_)
+    : machine(machine_)
+      , memoryHierarchy(machine_.memoryHierarchyPtr)
+      , records(0)
+      , skipped(0)
+      , stalls(0)
+      , stall_cycles(0)
+      , completed(0)
+      , pending_reads(0)
+{
+    accessSignal.set_name("trace_sim_access");
+    accessSignal.connect(signal_mem_ptr(*this, &TraceSim::access_done));
+}
+
+bool TraceSim::access_done(void *arg)
+{
+    MemoryRequest *request = (MemoryRequest*)arg;
+
+    completed++;
+
+    if(request->get_type() == MEMORY_OP_READ) {
+        assert(pending_reads > 0);
+        pending_reads--;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Send one record to the CPU controller of its core
+ *
+ * @return false if L1 cache can't accept it in this cycle
+ */
+bool TraceSim::issue(const MemTraceRecord& rec)
+{
+    /* Only cores' requests can be sent to a CPU controller */
+    if unlikely (rec.coreid >= machine.get_num_cores() ||
+            (rec.type != MEMORY_OP_READ && rec.type != MEMORY_OP_WRITE)) {
+        skipped++;
+        return true;
+    }
+
+    if(!memoryHierarchy->is_cache_available(rec.coreid, rec.threadid,
+                rec.is_icache))
+        return false;
+
+    MemoryRequest *request = memoryHierarchy->get_free_request(rec.coreid);
+    assert(request != NULL);
+
+    request->init(rec.coreid, rec.threadid, rec.physaddr, 0, sim_cycle,
+            rec.is_icache, rec.rip, records, (OP_TYPE)rec.type);
+    request->set_coreSignal(&accessSignal);
+
+    /* Only reads that are not L1 hits report completion */
+    if(!memoryHierarchy->access_cache(request))
+        pending_reads++;
+
+    records++;
+    return true;
+}
+
+void TraceSim::clock()
+{
+    memoryHierarchy->clock();
+    memoryHierarchy->deliver_core_wakeups();
+    sim_cycle++;
+
+    if unlikely (ptl_logfile.is_open() &&
+            ((W64)ptl_logfile.tellp() > config.log_file_size))
+        backup_and_reopen_logfile();
+}
+
+bool TraceSim::run(const char *filename)
+{
+    MemTraceReader reader;
+
+    if(!reader.open(filename)) {
+        ptl_logfile << "Can't read memory trace ", filename, endl;
+        cerr << "Can't read memory trace ", filename, endl;
+        return false;
+    }
+
+    ptl_logfile << "Simulating memory trace ", filename, " from cycle ",
+                sim_cycle, endl, flush;
+
+    MemTraceRecord rec;
+    bool have = reader.next(rec);
+    W64 issue_cycle = sim_cycle;
+    bool stalled = false;
+
+    while(have && sim_cycle < config.stop_at_cycle) {
+        while(have && issue_cycle <= sim_cycle) {
+            if(!issue(rec)) {
+                stalls += !stalled;
+                stalled = true;
+                break;
+            }
+
+            stalled = false;
+
+            W64 last_cycle = rec.cycle;
+            have = reader.next(rec);
+
+            /* Keep the gap to previous record */
+            if(have)
+                issue_cycle = sim_cycle + ((rec.cycle > last_cycle) ?
+                        rec.cycle - last_cycle : 0);
+        }
+
+        if(stalled)
+            stall_cycles++;
+
+        clock();
+
+        if(have && !stalled && issue_cycle > sim_cycle) {
+            W64 target = min(issue_cycle,
+                    memoryHierarchy->get_next_event_cycle());
+            target = min(target, (W64)config.stop_at_cycle);
+
+            if(target > sim_cycle)
+                sim_cycle += memoryHierarchy->skip_cycles(
+                        target - sim_cycle);
+        }
+    }
+
+    /* Let all issued accesses finish */
+    W64 last_completed = completed;
+    W64 last_progress = sim_cycle;
+
+    while(sim_cycle < config.stop_at_cycle) {
+        W64 next = memoryHierarchy->get_next_event_cycle();
+
+        if(next == (W64)-1 && !pending_reads)
+            break;
+
+        if(completed != last_completed) {
+            last_completed = completed;
+            last_progress = sim_cycle;
+        } else if(sim_cycle - last_progress > TRACE_SIM_DRAIN_LIMIT) {
+            ptl_logfile << "Memory trace: ", pending_reads,
+                        " reads did not complete, stop waiting", endl;
+            break;
+        }
+
+        clock();
+
+        /* With DRAMSim pending reads have no event, clock each cycle */
+        next = memoryHierarchy->get_next_event_cycle();
+        if(next != (W64)-1 && next > sim_cycle)
+            sim_cycle += memoryHierarchy->skip_cycles(min(next,
+                        (W64)config.stop_at_cycle) - sim_cycle);
+    }
+
+    return true;
+}
+
+ostream& TraceSim::print_summary(ostream& os) const
+{
+    os << "Memory trace: ", records, " records simulated, ", skipped,
+       " skipped, ", stalls, " stalled for ", stall_cycles, " cycles, ",
+       completed, " completed in ", sim_cycle, " cycles", endl;
+    return os;
+}
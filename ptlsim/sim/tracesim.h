@@ -0,0 +1,71 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef TRACE_SIM_H
+#define TRACE_SIM_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <machine.h>
+#include <memTrace.h>
+
+namespace Memory {
+    class MemoryHierarchy;
+};
+
+/**
+ * @brief Trace driven simulation of the memory hierarchy (-trace-sim)
+ *
+ * Records of a memory trace are sent to the CPU controllers of the
+ * configured machine as if its cores had issued them. Cores are never
+ * clocked and the guest never runs, so only the caches, interconnects and
+ * memory are simulated.
+ *
+ * Each record is issued the same number of cycles after the previous one
+ * as in the trace. If the L1 cache of a record can't accept a request, it
+ * and all following records wait. Cycles without any memory hierarchy
+ * event are skipped.
+ */
+class TraceSim {
+    private:
+        BaseMachine& machine;
+        Memory::MemoryHierarchy *memoryHierarchy;
+        Signal accessSignal;
+
+        W64 records;
+        W64 skipped;
+        W64 stalls;
+        W64 stall_cycles;
+        W64 completed;
+        W64 pending_reads;
+
+        bool access_done(void *arg);
+        bool issue(const MemTraceRecord& rec);
+        void clock();
+
+    public:
+        TraceSim(BaseMachine& machine_);
+
+        /**
+         * @brief Simulate all records of a trace file
+         *
+         * @param filename Memory trace file
+         *
+         * @return false if trace can't be read
+         */
+        bool run(const char *filename);
+
+        W64 get_records() const { return records; }
+        W64 get_skipped() const { return skipped; }
+        W64 get_stalls() const { return stalls; }
+        W64 get_stall_cycles() const { return stall_cycles; }
+
+        ostream& print_summary(ostream& os) const;
+};
+
+#endif // TRACE_SIM_H
@@ -0,0 +1,113 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <warming.h>
+
+#include <ptlsim.h>
+#include <ptl-qemu.h>
+
+static WarmRing warm_rings[NUM_SIM_CORES];
+
+/* Records dropped because machine can't be initialized */
+static bool warm_disabled = false;
+
+/**
+ * @brief Feed recorded accesses and branches of one CPU Context to the
+ * simulated machine
+ *
+ * @param cpuid CPU Context id
+ */
+static void warm_flush(int cpuid)
+{
+    WarmRing& ring = warm_rings[cpuid];
+
+    if (!ring.count)
+        return;
+
+    PTLsimMachine* machine = NULL;
+    if (!warm_disabled) {
+        machine = ptl_init_machine();
+        warm_disabled = (machine == NULL);
+    }
+
+    if (!machine) {
+        ring.count = 0;
+        return;
+    }
+
+    Context& ctx = contextof(cpuid);
+
+    /* Most records hit the same page, so avoid the host to guest
+     * physical page map lookup for them */
+    W64 last_host_page = (W64)-1;
+    W64 last_phys_page = 0;
+
+    foreach (i, ring.count) {
+        WarmRecord& rec = ring.records[i];
+
+        if (rec.flags & WARM_BRANCH) {
+            machine->warm_branch(ctx, rec.addr, rec.data,
+                    (rec.flags & WARM_TAKEN) != 0);
+            continue;
+        }
+
+        W64 host_page = rec.data & TARGET_PAGE_MASK;
+        if (host_page != last_host_page) {
+            Waddr paddr;
+            if (ctx.get_phys_memory_address(host_page, paddr) < 0)
+                continue;
+            last_host_page = host_page;
+            last_phys_page = paddr;
+        }
+
+        machine->warm_mem(ctx, rec.addr,
+                last_phys_page | (rec.data & ~TARGET_PAGE_MASK),
+                (rec.flags & PTL_WARM_STORE) != 0,
+                (rec.flags & PTL_WARM_CODE) != 0);
+    }
+
+    ring.count = 0;
+}
+
+void warm_flush_all()
+{
+    foreach (i, NUM_SIM_CORES) {
+        warm_flush(i);
+    }
+}
+
+void ptl_warm_mem(int cpuid, W64 addr, uint32_t flags)
+{
+    Context& ctx = contextof(cpuid);
+    int mmu_idx = flags >> PTL_WARM_MMU_SHIFT;
+    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry& entry = ctx.tlb_table[mmu_idx][index];
+    target_ulong tlb_addr;
+
+    if (flags & PTL_WARM_CODE)
+        tlb_addr = entry.addr_code;
+    else if (flags & PTL_WARM_STORE)
+        tlb_addr = entry.addr_write;
+    else
+        tlb_addr = entry.addr_read;
+
+    /* Skip IO and accesses whose TLB entry is already replaced */
+    if ((addr & TARGET_PAGE_MASK) != tlb_addr)
+        return;
+
+    if (warm_rings[cpuid].push(addr, addr + entry.addend,
+                flags & (PTL_WARM_STORE | PTL_WARM_CODE)))
+        warm_flush(cpuid);
+}
+
+void ptl_warm_branch(int cpuid, W64 ripafter, W64 target, uint32_t taken)
+{
+    W32 flags = WARM_BRANCH | (taken ? WARM_TAKEN : 0);
+
+    if (warm_rings[cpuid].push(ripafter, target, flags))
+        warm_flush(cpuid);
+}
@@ -0,0 +1,62 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef WARMING_H
+#define WARMING_H
+
+#include <globals.h>
+
+/* Records per CPU Context before they are fed to the machine */
+#define WARM_RING_SIZE 4096
+
+/* Record type flags, above PTL_WARM_* flags and MMU index */
+#define WARM_BRANCH (1U << 30)
+#define WARM_TAKEN  (1U << 31)
+
+/**
+ * @brief Memory access or branch seen in emulation mode
+ *
+ * For memory accesses 'addr' is the virtual address and 'data' the host
+ * address it maps to, translated to a physical address when the ring is
+ * drained. For branches 'addr' is the address after the branch and 'data'
+ * the branch target.
+ */
+struct WarmRecord {
+    W64 addr;
+    W64 data;
+    W32 flags;
+};
+
+/**
+ * @brief Per CPU Context buffer of warming records
+ *
+ * Emulated code only appends records, so fast-forward speed doesn't depend
+ * on simulated structures. When the ring is full, or fast-forward ends,
+ * all records are fed to the machine in one batch.
+ */
+struct WarmRing {
+    WarmRecord records[WARM_RING_SIZE];
+    int count;
+
+    WarmRing() : count(0) {}
+
+    bool push(W64 addr, W64 data, W32 flags) {
+        WarmRecord &rec = records[count++];
+        rec.addr = addr;
+        rec.data = data;
+        rec.flags = flags;
+        return count == WARM_RING_SIZE;
+    }
+};
+
+/**
+ * @brief Feed recorded accesses and branches of all CPU Contexts to the
+ * simulated machine
+ */
+void warm_flush_all();
+
+#endif // WARMING_H
@@ -133,6 +133,19 @@ ostream& Statable::dump_header(ostream &os) const
     return os;
 }
 
+void Statable::get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+{
+    if(dump_disabled || !periodic_enabled) return;
+
+    foreach(i, leafs.count()) {
+        leafs[i]->get_periodic_columns(cols);
+    }
+
+    foreach(i, childNodes.count()) {
+        childNodes[i]->get_periodic_columns(cols);
+    }
+}
+
 ostream& Statable::dump_periodic(ostream &os, Stats *stats) const
 {
     if(dump_disabled || !periodic_enabled) return os;
@@ -348,6 +361,13 @@ Stats* StatsBuilder::get_new_stats()
     return stats;
 }
 
+Stats* StatsBuilder::get_new_snapshot_stats()
+{
+    Stats *stats = new Stats(stat_offset);
+
+    return stats;
+}
+
 void StatsBuilder::destroy_stats(Stats *stats)
 {
     delete stats->mem;
@@ -394,10 +414,16 @@ ostream& StatsBuilder::dump_periodic(ostream& os, W64 cycle) const
 
     sub_periodic_stats(*temp_stats, *temp2_stats);
 
+    return dump_periodic_row(os, cycle, temp_stats);
+}
+
+ostream& StatsBuilder::dump_periodic_row(ostream& os, W64 cycle,
+        Stats *delta) const
+{
     if(rootNode->is_dump_periodic()) {
         os << cycle << ",";
         os << simcycles_to_ns(cycle);
-        rootNode->dump_periodic(os, temp_stats);
+        rootNode->dump_periodic(os, delta);
         os << "\n";
     }
 
@@ -443,6 +469,12 @@ YAML::Emitter& StatsBuilder::dump(Stats *stats, YAML::Emitter &out) const
     return out;
 }
 
+YAML::Emitter& StatsBuilder::dump_snapshot(Stats *stats,
+        YAML::Emitter &out) const
+{
+    return rootNode->dump(out, stats);
+}
+
 bson_buffer* StatsBuilder::dump(Stats *stats, bson_buffer *bb) const
 {
     return rootNode->dump(bb, stats);
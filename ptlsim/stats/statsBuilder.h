@@ -26,6 +26,49 @@
 class StatObjBase;
 class Stats;
 
+/**
+ * @brief Description of one periodic stats column
+ *
+ * Used by TimeStatsWriter to save periodic stats directly from Stats memory
+ * instead of formatting them as text. Formula columns are not stored, their
+ * elements are and the value is computed when the file is converted.
+ */
+struct TimeStatsColumn {
+    enum { UINT = 0, SINT, FLOAT, FORMULA };
+    enum { FORMULA_NONE = 0, FORMULA_ADD, FORMULA_DIV };
+
+    stringbuf name;
+    W64 offset;
+    W8 type;
+    W8 size;
+    W8 formula;
+    W8 hidden;
+
+    /* For FORMULA columns: type, size and offsets of the elements */
+    W8 elem_type;
+    W8 elem_size;
+    dynarray<W64> elems;
+
+    TimeStatsColumn(stringbuf *name_, W64 offset_, W8 type_, W8 size_)
+        : offset(offset_), type(type_), size(size_)
+          , formula(FORMULA_NONE), hidden(0)
+          , elem_type(UINT), elem_size(0)
+    {
+        if (name_) name << *name_;
+    }
+};
+
+/**
+ * @brief Get TimeStatsColumn type of given counter type
+ */
+template<typename T>
+static inline W8 time_stats_column_type()
+{
+    if (T(0.5) != T(0)) return TimeStatsColumn::FLOAT;
+    if (T(-1) < T(0)) return TimeStatsColumn::SINT;
+    return TimeStatsColumn::UINT;
+}
+
 inline static YAML::Emitter& operator << (YAML::Emitter& out, const W64 value)
 {
     stringbuf buf;
@@ -244,6 +287,8 @@ class Statable {
 
         ostream& dump_header(ostream &os) const;
 
+        void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const;
+
         stringbuf *get_full_stat_string() const;
 
 		StatObjBase* get_stat_obj(dynarray<stringbuf*> &names, int idx);
@@ -322,6 +367,16 @@ class StatsBuilder {
          */
         Stats* get_new_stats();
 
+        /**
+         * @brief Get a new Stats object only big enough for stats
+         * registered so far
+         *
+         * @return new Stats*
+         *
+         * Used for snapshot copies, all stats must be created before.
+         */
+        Stats* get_new_snapshot_stats();
+
         /**
          * @brief Delte Stats object
          *
@@ -350,6 +405,20 @@ class StatsBuilder {
          */
         YAML::Emitter& dump(Stats *stats, YAML::Emitter &out) const;
 
+        /**
+         * @brief Dump Stats tree in YAML format from a snapshot
+         *
+         * @param stats Use given Stats* for values
+         * @param out YAML::Emitter object to dump YAML represetation
+         *
+         * @return
+         *
+         * Unlike dump() this does not change the default Stats of the
+         * tree, so it can run in another thread while simulation updates
+         * the stats.
+         */
+        YAML::Emitter& dump_snapshot(Stats *stats, YAML::Emitter &out) const;
+
         /**
          * @brief Dump Stats tree in BSON format
          *
@@ -387,6 +456,27 @@ class StatsBuilder {
         bool is_dump_periodic() { return rootNode->is_dump_periodic(); }
         ostream& dump_header(ostream &os) const;
         ostream& dump_periodic(ostream &os, W64 cycle) const;
+
+        /**
+         * @brief Dump one time-stats row of already diffed stats
+         *
+         * @param os ostream to write CSV row
+         * @param cycle Simulation cycle of the row
+         * @param delta Change of periodic stats since previous row
+         */
+        ostream& dump_periodic_row(ostream &os, W64 cycle,
+                Stats *delta) const;
+
+        /**
+         * @brief Get all periodic stats columns in dump_header order
+         *
+         * @param cols Array to add newly allocated columns into
+         */
+        void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+        {
+            if(rootNode->is_dump_periodic())
+                rootNode->get_periodic_columns(cols);
+        }
         ostream& dump_summary(ostream &os) const;
 
         void delete_nodes()
@@ -412,10 +502,12 @@ class StatsBuilder {
 class Stats {
     private:
         W8 *mem;
+        W64 size;
 
-        Stats()
+        Stats(W64 size_=STATS_SIZE)
+            : size(size_)
         {
-            mem = new W8[STATS_SIZE];
+            mem = new W8[size];
             reset();
         }
 
@@ -429,7 +521,7 @@ class Stats {
 
         void reset()
         {
-            memset(mem, 0, sizeof(W8) * STATS_SIZE);
+            memset(mem, 0, sizeof(W8) * size);
         }
 
         Stats& operator+=(Stats& rhs_stats)
@@ -440,7 +532,8 @@ class Stats {
 
         Stats& operator=(Stats& rhs_stats)
         {
-            memcpy(mem, rhs_stats.mem, sizeof(W8) * STATS_SIZE);
+            memcpy(mem, rhs_stats.mem, sizeof(W8) * min(size,
+                        rhs_stats.size));
             return *this;
         }
 };
@@ -540,6 +633,16 @@ class StatObjBase {
             return os;
         }
 
+        /**
+         * @brief Add periodic columns of this object
+         *
+         * @param cols Array to add newly allocated columns into
+         *
+         * Must add columns in the same order as dump_header prints them.
+         */
+        virtual void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+        { }
+
         virtual ostream& dump_summary(ostream& os, Stats* stats, const char* pfx) const = 0;
 
         virtual void add_stats(Stats& dest_stats, Stats& src_stats) = 0;
@@ -831,6 +934,14 @@ class StatObj : public StatObjBase {
             return *(T*)(stats->base() + offset);
         }
 
+        /**
+         * @brief Get offset of this counter in Stats memory
+         */
+        W64 get_offset() const
+        {
+            return offset;
+        }
+
         /**
          * @brief Dump a string representation to ostream
          *
@@ -927,6 +1038,17 @@ class StatObj : public StatObjBase {
             return os;
         }
 
+        void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+        {
+            if (is_dump_periodic())
+            {
+                stringbuf *full_string = get_full_stat_string();
+                cols.push(new TimeStatsColumn(full_string, offset,
+                            time_stats_column_type<T>(), sizeof(T)));
+                delete full_string;
+            }
+        }
+
         ostream &dump_summary(ostream &os, Stats *stats, const char* pfx) const
         {
             if (is_summarize_enabled()) {
@@ -1223,6 +1345,32 @@ class StatArray : public StatObjBase {
             return os;
         }
 
+        void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+        {
+            if (!is_dump_periodic()) return;
+
+            stringbuf *full_string = get_full_stat_string();
+
+            foreach(i, size) {
+                if(periodic_flag[i]) {
+                    stringbuf name;
+                    name << *full_string;
+
+                    if(labels) {
+                        name << "." << labels[i];
+                    } else {
+                        name << "." << i;
+                    }
+
+                    cols.push(new TimeStatsColumn(&name,
+                                offset + i * sizeof(T),
+                                time_stats_column_type<T>(), sizeof(T)));
+                }
+            }
+
+            delete full_string;
+        }
+
         void enable_summary(int id = -1)
         {
             StatObjBase::enable_summary();
@@ -1549,6 +1697,8 @@ class StatString : public StatObjBase {
 struct StatObjFormulaAdd {
     typedef dynarray<StatObj<W64>* > elems_t;
 
+    static const W8 formula_id = TimeStatsColumn::FORMULA_ADD;
+
     static W64 compute(Stats* stats, const elems_t& elems)
     {
         W64 ret = 0;
@@ -1568,6 +1718,8 @@ struct StatObjFormulaAdd {
 struct StatObjFormulaDiv {
     typedef dynarray<StatObj<W64>* > elems_t;
 
+    static const W8 formula_id = TimeStatsColumn::FORMULA_DIV;
+
     static double compute(Stats* stats, const elems_t& elems)
     {
         double ret = 0;
@@ -1702,6 +1854,32 @@ class StatEquation : public StatObj<K> {
             base_t::dump_periodic(os, stats);
             return os;
         }
+
+        /**
+         * @brief Add formula column of this Stats Object
+         *
+         * @param cols Array to add the column into
+         *
+         * Value is not stored in time-stats, its computed from elements.
+         */
+        void get_periodic_columns(dynarray<TimeStatsColumn*> &cols) const
+        {
+            if (!this->is_dump_periodic()) return;
+
+            stringbuf *full_string = this->get_full_stat_string();
+            TimeStatsColumn *col = new TimeStatsColumn(full_string,
+                    this->get_offset(), TimeStatsColumn::FORMULA, sizeof(K));
+            delete full_string;
+
+            col->formula = F::formula_id;
+            col->elem_type = time_stats_column_type<T>();
+            col->elem_size = sizeof(T);
+
+            foreach(i, elems.count())
+                col->elems.push(elems[i]->get_offset());
+
+            cols.push(col);
+        }
 };
 
 #endif // STATS_BUILDER_H
@@ -0,0 +1,355 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include "statsWriter.h"
+
+#include <ptlsim.h>
+
+StatsWriter::StatsWriter(int queue_size_, ofstream *csv_file_,
+        TimeStatsWriter *bin_writer_, const char *snapshot_filename_)
+    : queue_size(queue_size_)
+      , started(false)
+      , stopping(false)
+      , closed(false)
+      , free_list(NULL)
+      , queue_head(NULL)
+      , queue_tail(NULL)
+      , queued(0)
+      , writing(0)
+      , csv_file(csv_file_)
+      , bin_writer(bin_writer_)
+      , header_written(false)
+      , last_periodic(NULL)
+      , last_user(NULL)
+      , last_kernel(NULL)
+      , temp(NULL)
+      , snapshots(0)
+      , stalls(0)
+      , stall_ticks(0)
+      , max_queued(0)
+{
+    if(snapshot_filename_)
+        snapshot_filename << snapshot_filename_;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&queued_cond, NULL);
+    pthread_cond_init(&free_cond, NULL);
+}
+
+StatsWriter::~StatsWriter()
+{
+    close();
+
+    StatsBuilder &builder = StatsBuilder::get();
+
+    foreach(i, pool.count()) {
+        builder.destroy_stats(pool[i]->user);
+        builder.destroy_stats(pool[i]->kernel);
+        delete pool[i];
+    }
+    pool.clear();
+
+    if(last_periodic) {
+        builder.destroy_stats(last_periodic);
+        builder.destroy_stats(last_user);
+        builder.destroy_stats(last_kernel);
+        builder.destroy_stats(temp);
+    }
+
+    pthread_cond_destroy(&free_cond);
+    pthread_cond_destroy(&queued_cond);
+    pthread_mutex_destroy(&lock);
+}
+
+/**
+ * @brief Allocate snapshot pool and start the writer thread
+ *
+ * Done on first snapshot so Stats copies only cover stats that exist once
+ * the machine is built.
+ */
+void StatsWriter::setup()
+{
+    StatsBuilder &builder = StatsBuilder::get();
+
+    last_periodic = builder.get_new_snapshot_stats();
+    last_user = builder.get_new_snapshot_stats();
+    last_kernel = builder.get_new_snapshot_stats();
+    temp = builder.get_new_snapshot_stats();
+
+    foreach(i, max(queue_size, 1)) {
+        StatsSnapshot *snap = new StatsSnapshot();
+        snap->user = builder.get_new_snapshot_stats();
+        snap->kernel = builder.get_new_snapshot_stats();
+        snap->next = free_list;
+        free_list = snap;
+        pool.push(snap);
+    }
+
+    if(queue_size && !started) {
+        started = (pthread_create(&thread, NULL, writer_thread, this) == 0);
+
+        /* Fall back to writing on simulation thread */
+        if(!started) {
+            ptl_logfile << "Can't start stats writer thread, writing ",
+                        "stats in simulation thread", endl;
+            queue_size = 0;
+        }
+    }
+}
+
+StatsSnapshot* StatsWriter::get_snapshot()
+{
+    if unlikely (!pool.count())
+        setup();
+
+    if(!queue_size) return pool[0];
+
+    pthread_mutex_lock(&lock);
+
+    if unlikely (!free_list) {
+        W64 start = rdtsc();
+        stalls++;
+
+        while(!free_list)
+            pthread_cond_wait(&free_cond, &lock);
+
+        stall_ticks += rdtsc() - start;
+    }
+
+    StatsSnapshot *snap = free_list;
+    free_list = snap->next;
+
+    pthread_mutex_unlock(&lock);
+
+    return snap;
+}
+
+void StatsWriter::queue(StatsSnapshot *snap)
+{
+    snapshots++;
+
+    if(!queue_size) {
+        write(snap);
+        return;
+    }
+
+    snap->next = NULL;
+
+    pthread_mutex_lock(&lock);
+
+    if(queue_tail)
+        queue_tail->next = snap;
+    else
+        queue_head = snap;
+    queue_tail = snap;
+
+    queued++;
+    max_queued = max(max_queued, queued);
+
+    pthread_cond_signal(&queued_cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void StatsWriter::periodic(W64 cycle, Stats *user, Stats *kernel)
+{
+    if(closed || !has_time_stats()) return;
+
+    StatsSnapshot *snap = get_snapshot();
+
+    snap->type = StatsSnapshot::PERIODIC;
+    snap->cycle = cycle;
+    *snap->user = *user;
+    *snap->kernel = *kernel;
+
+    queue(snap);
+}
+
+void StatsWriter::snapshot(const char *name, W64 cycle, Stats *user,
+        Stats *kernel)
+{
+    if(closed || !snapshot_filename.size()) return;
+
+    if unlikely (!snapshot_file.is_open()) {
+        snapshot_file.open(snapshot_filename.buf);
+        if(!snapshot_file.is_open()) {
+            ptl_logfile << "Can't open stats snapshot file ",
+                        snapshot_filename, endl;
+            snapshot_filename.reset();
+            return;
+        }
+    }
+
+    StatsSnapshot *snap = get_snapshot();
+
+    snap->type = StatsSnapshot::NAMED;
+    snap->cycle = cycle;
+    snap->name.reset();
+    if(name)
+        snap->name << name;
+    else
+        snap->name << "snapshot_" << snapshots;
+    *snap->user = *user;
+    *snap->kernel = *kernel;
+
+    queue(snap);
+}
+
+void* StatsWriter::writer_thread(void *arg)
+{
+    ((StatsWriter*)arg)->run();
+    return NULL;
+}
+
+void StatsWriter::run()
+{
+    pthread_mutex_lock(&lock);
+
+    for(;;) {
+        while(!queue_head && !stopping)
+            pthread_cond_wait(&queued_cond, &lock);
+
+        if(!queue_head)
+            break;
+
+        StatsSnapshot *snap = queue_head;
+        queue_head = snap->next;
+        if(!queue_head)
+            queue_tail = NULL;
+        queued--;
+        writing++;
+
+        pthread_mutex_unlock(&lock);
+
+        write(snap);
+
+        pthread_mutex_lock(&lock);
+
+        snap->next = free_list;
+        free_list = snap;
+        writing--;
+
+        pthread_cond_broadcast(&free_cond);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+void StatsWriter::write(StatsSnapshot *snap)
+{
+    if(snap->type == StatsSnapshot::PERIODIC)
+        write_periodic(snap);
+    else
+        write_named(snap);
+}
+
+void StatsWriter::write_periodic(StatsSnapshot *snap)
+{
+    StatsBuilder &builder = StatsBuilder::get();
+
+    if(bin_writer)
+        bin_writer->write(snap->cycle, snap->user, snap->kernel);
+
+    if(!csv_file) return;
+
+    if unlikely (!header_written) {
+        builder.dump_header(*csv_file);
+        header_written = true;
+    }
+
+    /* Same diff as StatsBuilder::dump_periodic, done on the copies */
+    builder.add_periodic_stats(*snap->user, *snap->kernel);
+    *temp = *snap->user;
+    builder.sub_periodic_stats(*snap->user, *last_periodic);
+    *last_periodic = *temp;
+
+    builder.dump_periodic_row(*csv_file, snap->cycle, snap->user);
+}
+
+void StatsWriter::write_named(StatsSnapshot *snap)
+{
+    StatsBuilder &builder = StatsBuilder::get();
+    YAML::Emitter out;
+
+    *temp = *snap->user;
+    builder.sub_stats(*snap->user, *last_user);
+    *last_user = *temp;
+
+    *temp = *snap->kernel;
+    builder.sub_stats(*snap->kernel, *last_kernel);
+    *last_kernel = *temp;
+
+    out << YAML::BeginMap;
+    out << YAML::Key << "snapshot" << YAML::Value << snap->name.buf;
+    out << YAML::Key << "sim_cycle" << YAML::Value << snap->cycle;
+    out << YAML::Key << "user" << YAML::Value;
+    builder.dump_snapshot(snap->user, out);
+    out << YAML::Key << "kernel" << YAML::Value;
+    builder.dump_snapshot(snap->kernel, out);
+    out << YAML::EndMap;
+
+    snapshot_file << "---\n" << out.c_str() << "\n";
+    snapshot_file.flush();
+}
+
+void StatsWriter::drain()
+{
+    if(!started) return;
+
+    pthread_mutex_lock(&lock);
+
+    while(queue_head || writing)
+        pthread_cond_wait(&free_cond, &lock);
+
+    pthread_mutex_unlock(&lock);
+}
+
+void StatsWriter::close()
+{
+    if(closed) return;
+
+    drain();
+
+    if(started) {
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_signal(&queued_cond);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(thread, NULL);
+        started = false;
+    }
+
+    if(csv_file) {
+        if(!header_written)
+            StatsBuilder::get().dump_header(*csv_file);
+        csv_file->close();
+    }
+
+    if(bin_writer)
+        bin_writer->close();
+
+    if(snapshot_file.is_open())
+        snapshot_file.close();
+
+    closed = true;
+}
+
+ostream& StatsWriter::print_summary(ostream &os) const
+{
+    os << "Stats writer: ", snapshots, " snapshots";
+
+    if(queue_size) {
+        os << ", queue ", queue_size, " (max used ", max_queued, ")";
+        os << ", ", stalls, " simulation stalls for ",
+           ticks_to_native_seconds(stall_ticks), " seconds";
+    } else {
+        os << " written in simulation thread";
+    }
+
+    os << endl;
+    return os;
+}
@@ -0,0 +1,149 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <pthread.h>
+
+#include <statsBuilder.h>
+#include <timeStats.h>
+
+/**
+ * @brief Copy of user and kernel Stats waiting to be written
+ */
+struct StatsSnapshot {
+    enum { PERIODIC = 0, NAMED };
+
+    int type;
+    W64 cycle;
+    stringbuf name;
+    Stats *user;
+    Stats *kernel;
+    StatsSnapshot *next;
+};
+
+/**
+ * @brief Writer of time-series stats and named snapshots
+ *
+ * The simulation thread only copies user and kernel Stats into a snapshot
+ * from a fixed pool and queues it. A writer thread diffs it against the
+ * previous snapshot, formats it and writes it to the CSV or binary
+ * time-stats file, or to the YAML snapshot file for named snapshots.
+ *
+ * When every snapshot of the pool is queued the simulation waits for the
+ * writer to free one. These stalls and the time spent in them are counted
+ * and reported in the run summary.
+ *
+ * With a queue size of 0 no thread is started and each snapshot is
+ * written right away on the simulation thread.
+ */
+class StatsWriter {
+    private:
+        int queue_size;
+        bool started;
+        bool stopping;
+        bool closed;
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t queued_cond;
+        pthread_cond_t free_cond;
+
+        dynarray<StatsSnapshot*> pool;
+        StatsSnapshot *free_list;
+        StatsSnapshot *queue_head;
+        StatsSnapshot *queue_tail;
+        int queued;
+        int writing;
+
+        ofstream *csv_file;
+        TimeStatsWriter *bin_writer;
+        ofstream snapshot_file;
+        stringbuf snapshot_filename;
+        bool header_written;
+
+        /* Previous values for diffs, only used while writing */
+        Stats *last_periodic;
+        Stats *last_user;
+        Stats *last_kernel;
+        Stats *temp;
+
+        W64 snapshots;
+        W64 stalls;
+        W64 stall_ticks;
+        int max_queued;
+
+        void setup();
+        StatsSnapshot* get_snapshot();
+        void queue(StatsSnapshot *snap);
+        void write(StatsSnapshot *snap);
+        void write_periodic(StatsSnapshot *snap);
+        void write_named(StatsSnapshot *snap);
+        void run();
+
+        static void* writer_thread(void *arg);
+
+    public:
+        /**
+         * @brief Create stats writer
+         *
+         * @param queue_size_ Snapshots that can wait for the writer thread
+         * @param csv_file_ CSV time-stats file or NULL
+         * @param bin_writer_ Binary time-stats writer or NULL
+         * @param snapshot_filename_ YAML file for named snapshots, created
+         * on first snapshot, or NULL
+         */
+        StatsWriter(int queue_size_, ofstream *csv_file_,
+                TimeStatsWriter *bin_writer_, const char *snapshot_filename_);
+        ~StatsWriter();
+
+        bool has_time_stats() const { return csv_file || bin_writer; }
+
+        /**
+         * @brief Queue one row of time-series stats
+         *
+         * @param cycle Current simulation cycle
+         * @param user User mode Stats
+         * @param kernel Kernel mode Stats
+         */
+        void periodic(W64 cycle, Stats *user, Stats *kernel);
+
+        /**
+         * @brief Queue a named snapshot
+         *
+         * @param name Snapshot name, NULL to number them
+         * @param cycle Current simulation cycle
+         * @param user User mode Stats
+         * @param kernel Kernel mode Stats
+         *
+         * Snapshot holds the change of all stats since previous snapshot.
+         */
+        void snapshot(const char *name, W64 cycle, Stats *user,
+                Stats *kernel);
+
+        /**
+         * @brief Wait until all queued snapshots are written
+         */
+        void drain();
+
+        /**
+         * @brief Write all snapshots, stop the thread and close files
+         */
+        void close();
+
+        W64 get_snapshots() const { return snapshots; }
+        W64 get_stalls() const { return stalls; }
+        W64 get_stall_ticks() const { return stall_ticks; }
+
+        ostream& print_summary(ostream &os) const;
+};
+
+#endif // STATS_WRITER_H
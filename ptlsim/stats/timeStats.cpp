@@ -0,0 +1,263 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include "timeStats.h"
+
+#include <ptlsim.h>
+
+#include <zlib.h>
+
+static const char time_stats_magic[8] = {'M', 'A', 'R', 'S', 'S', 'T', 'S', 'B'};
+
+/* Rows are written to file in blocks of about this size */
+static const W32 TIME_STATS_BLOCK_SIZE = 256 * 1024;
+
+TimeStatsWriter::TimeStatsWriter(const char *filename, bool compress_,
+        W64 period_)
+    : os(filename, std::ios::binary | std::ios::trunc)
+      , compress(compress_)
+      , header_written(false)
+      , period(period_)
+      , last_cycle(0)
+      , block(NULL)
+      , block_size(0)
+      , block_used(0)
+      , block_rows(0)
+      , row_size(0)
+{
+}
+
+TimeStatsWriter::~TimeStatsWriter()
+{
+    close();
+
+    foreach(i, columns.count()) {
+        delete columns[i];
+    }
+    columns.clear();
+    stored.clear();
+}
+
+void TimeStatsWriter::write_header()
+{
+    StatsBuilder::get().get_periodic_columns(columns);
+
+    /* Resolve formula elements to column index, adding hidden columns for
+     * elements that are not periodic by themselves */
+    dynarray<dynarray<W32>*> elem_ids;
+
+    foreach(i, columns.count()) {
+        TimeStatsColumn *col = columns[i];
+        dynarray<W32> *ids = new dynarray<W32>();
+        elem_ids.push(ids);
+
+        if(col->type != TimeStatsColumn::FORMULA)
+            continue;
+
+        foreach(j, col->elems.count()) {
+            int id = -1;
+
+            foreach(k, columns.count()) {
+                if(columns[k]->type != TimeStatsColumn::FORMULA &&
+                        columns[k]->offset == col->elems[j]) {
+                    id = k;
+                    break;
+                }
+            }
+
+            if(id < 0) {
+                TimeStatsColumn *elem = new TimeStatsColumn(NULL,
+                        col->elems[j], col->elem_type, col->elem_size);
+                elem->hidden = 1;
+                id = columns.count();
+                columns.push(elem);
+                elem_ids.push(new dynarray<W32>());
+            }
+
+            ids->push(id);
+        }
+    }
+
+    foreach(i, columns.count()) {
+        if(columns[i]->type != TimeStatsColumn::FORMULA)
+            stored.push(columns[i]);
+    }
+
+    row_size = sizeof(W64) * (1 + stored.count());
+    last_values.resize(stored.count(), 0);
+
+    block_size = max(TIME_STATS_BLOCK_SIZE, row_size);
+    block_size -= block_size % row_size;
+    block = new W8[block_size];
+
+    TimeStatsFileHeader header;
+    setzero(header);
+    memcpy(header.magic, time_stats_magic, sizeof(time_stats_magic));
+    header.format = TIME_STATS_FORMAT;
+    header.flags = compress ? TIME_STATS_COMPRESSED : 0;
+    header.core_freq_hz = config.core_freq_hz;
+    header.period = period;
+    header.column_count = columns.count();
+    header.row_size = row_size;
+
+    os.write((const char*)&header, sizeof(header));
+
+    foreach(i, columns.count()) {
+        TimeStatsColumn *col = columns[i];
+        TimeStatsColumnHeader colheader;
+
+        colheader.type = col->type;
+        colheader.size = col->size;
+        colheader.formula = col->formula;
+        colheader.hidden = col->hidden;
+        colheader.name_length = col->name.size();
+        colheader.elem_count = elem_ids[i]->count();
+
+        os.write((const char*)&colheader, sizeof(colheader));
+        os.write(col->name.buf, colheader.name_length);
+        os.write((const char*)elem_ids[i]->data,
+                sizeof(W32) * colheader.elem_count);
+    }
+
+    foreach(i, elem_ids.count()) {
+        delete elem_ids[i];
+    }
+
+    header_written = true;
+}
+
+W64 TimeStatsWriter::read_value(const TimeStatsColumn *col, Stats *stats) const
+{
+    W8 *ptr = (W8*)(stats->base() + col->offset);
+
+    switch(col->type) {
+        case TimeStatsColumn::FLOAT:
+            {
+                /* Floats are saved as double */
+                union { double d; W64 w; } val;
+                val.d = (col->size == sizeof(float)) ? *(float*)ptr : *(double*)ptr;
+                return val.w;
+            }
+        case TimeStatsColumn::SINT:
+            switch(col->size) {
+                case 1: return W64(W64s(*(W8s*)ptr));
+                case 2: return W64(W64s(*(W16s*)ptr));
+                case 4: return W64(W64s(*(W32s*)ptr));
+                default: return *(W64*)ptr;
+            }
+        default:
+            switch(col->size) {
+                case 1: return *(W8*)ptr;
+                case 2: return *(W16*)ptr;
+                case 4: return *(W32*)ptr;
+                default: return *(W64*)ptr;
+            }
+    }
+}
+
+void TimeStatsWriter::write(W64 cycle, Stats *user, Stats *kernel)
+{
+    if(!os.is_open()) return;
+
+    if unlikely (!header_written)
+        write_header();
+
+    W64 *row = (W64*)(block + block_used);
+
+    row[0] = cycle - last_cycle;
+    last_cycle = cycle;
+
+    foreach(i, stored.count()) {
+        TimeStatsColumn *col = stored[i];
+        W64 u = read_value(col, user);
+        W64 k = read_value(col, kernel);
+        W64 delta;
+
+        if(col->type == TimeStatsColumn::FLOAT) {
+            union { double d; W64 w; } uv, kv, lv, dv;
+            uv.w = u; kv.w = k; lv.w = last_values[i];
+            dv.d = (uv.d + kv.d) - lv.d;
+            lv.d = uv.d + kv.d;
+            last_values[i] = lv.w;
+            delta = dv.w;
+        } else {
+            W64 value = u + k;
+            delta = value - last_values[i];
+            last_values[i] = value;
+
+            /* Keep same wrap around as the counter itself */
+            if(col->type == TimeStatsColumn::UINT && col->size < 8)
+                delta &= bitmask(col->size * 8);
+        }
+
+        row[1 + i] = delta;
+    }
+
+    block_used += row_size;
+    block_rows++;
+
+    if(block_used + row_size > block_size)
+        write_block();
+}
+
+void TimeStatsWriter::write_block()
+{
+    if(!block_rows) return;
+
+    TimeStatsBlockHeader bh;
+    bh.row_count = block_rows;
+    bh.raw_size = block_used;
+    bh.stored_size = block_used;
+    bh.pad = 0;
+
+    const W8 *data = block;
+    W8 *packed = NULL;
+
+    if(compress) {
+        uLongf packed_size = compressBound(block_used);
+        packed = new W8[packed_size];
+
+        if(compress2(packed, &packed_size, block, block_used, 1) == Z_OK &&
+                packed_size < block_used) {
+            bh.stored_size = packed_size;
+            data = packed;
+        }
+    }
+
+    os.write((const char*)&bh, sizeof(bh));
+    os.write((const char*)data, bh.stored_size);
+
+    if(packed) delete[] packed;
+
+    block_used = 0;
+    block_rows = 0;
+}
+
+void TimeStatsWriter::flush()
+{
+    if(!os.is_open()) return;
+
+    write_block();
+    os.flush();
+}
+
+void TimeStatsWriter::close()
+{
+    if(!os.is_open()) return;
+
+    /* Header is needed even if no row was written */
+    if(!header_written)
+        write_header();
+
+    flush();
+    os.close();
+
+    if(block) {
+        delete[] block;
+        block = NULL;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef TIME_STATS_H
+#define TIME_STATS_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#include <statsBuilder.h>
+
+/*
+ * Binary time-series stats file
+ *
+ * File layout:
+ *
+ *   TimeStatsFileHeader
+ *   TimeStatsColumnHeader + name + W32 elems[elem_count], one per column
+ *   TimeStatsBlockHeader + rows, ...
+ *
+ * Each row is 'row_size' bytes: W64 cycles since previous row followed by
+ * one W64 per stored column. Stored columns are all non-formula columns in
+ * header order. Values are the change of the counter since previous row,
+ * same as the CSV time-stats, for FLOAT columns it's the bits of a double.
+ * Formula columns refer to their element columns by index and are computed
+ * by the reader; elements that are not periodic themselves are added as
+ * hidden columns.
+ *
+ * Rows are collected in blocks and each block is optionally compressed
+ * with zlib. A block is stored uncompressed if stored_size == raw_size.
+ *
+ * Use 'util/mstats.py --time-stats-bin' to convert it to CSV or YAML.
+ */
+
+static const W32 TIME_STATS_FORMAT = 1;
+static const W32 TIME_STATS_COMPRESSED = 1;
+
+struct TimeStatsFileHeader {
+    char magic[8];
+    W32 format;
+    W32 flags;
+    W64 core_freq_hz;
+    W64 period;
+    W32 column_count;
+    W32 row_size;
+};
+
+struct TimeStatsColumnHeader {
+    W8 type;
+    W8 size;
+    W8 formula;
+    W8 hidden;
+    W16 name_length;
+    W16 elem_count;
+};
+
+struct TimeStatsBlockHeader {
+    W32 row_count;
+    W32 raw_size;
+    W32 stored_size;
+    W32 pad;
+};
+
+/**
+ * @brief Buffered writer for binary time-series stats
+ *
+ * Column description is taken from StatsBuilder when the first row is
+ * written, so all periodic stats must be enabled before that.
+ */
+class TimeStatsWriter {
+    private:
+        ofstream os;
+        bool compress;
+        bool header_written;
+        W64 period;
+
+        dynarray<TimeStatsColumn*> columns;
+        dynarray<TimeStatsColumn*> stored;
+
+        /* Cumulative value of each stored column at last row */
+        dynarray<W64> last_values;
+        W64 last_cycle;
+
+        W8 *block;
+        W32 block_size;
+        W32 block_used;
+        W32 block_rows;
+        W32 row_size;
+
+        void write_header();
+        void write_block();
+        W64 read_value(const TimeStatsColumn *col, Stats *stats) const;
+
+    public:
+        /**
+         * @brief Open a binary time-stats file
+         *
+         * @param filename File to write, truncated if exists
+         * @param compress_ Compress row blocks with zlib
+         * @param period_ Cycles between rows, saved in header for readers
+         */
+        TimeStatsWriter(const char *filename, bool compress_, W64 period_);
+        ~TimeStatsWriter();
+
+        bool is_open() const { return os.is_open(); }
+
+        /**
+         * @brief Add one row of periodic stats
+         *
+         * @param cycle Current simulation cycle
+         * @param user User mode Stats
+         * @param kernel Kernel mode Stats
+         *
+         * Value of each counter is taken as sum of user and kernel stats,
+         * same as text time-stats.
+         */
+        void write(W64 cycle, Stats *user, Stats *kernel);
+
+        /**
+         * @brief Write all buffered rows to file
+         */
+        void flush();
+
+        /**
+         * @brief Flush and close the file
+         */
+        void close();
+};
+
+#endif // TIME_STATS_H
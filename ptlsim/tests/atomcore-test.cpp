@@ -150,9 +150,7 @@ namespace {
                 sim_cycle = 0;
 
                 // clean up bbcache
-                foreach(i, NUM_SIM_CORES) {
-                    bbcache[i].flush(i);
-                }
+                bbcache.flush(-1);
             }
     };
 
@@ -555,7 +553,7 @@ namespace {
         setzero(rvp);
         rvp.rip = 0x410200;
 
-        BasicBlock* bb = bbcache[0].get(rvp);
+        BasicBlock* bb = bbcache.get(rvp);
         ASSERT_FALSE(bb);
 
         TraceDecoder trans(rvp);
@@ -571,8 +569,8 @@ namespace {
 
         bb = trans.bb.clone();
         ASSERT_TRUE(bb);
-        bbcache[0].add(bb);
-        bbcache[0].add_page(bb);
+        bbcache.add(bb);
+        bbcache.add_page(bb);
 
         thread->fetchrip = rvp;
         thread->current_bb = bb;
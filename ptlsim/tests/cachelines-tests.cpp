@@ -0,0 +1,216 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <cacheLines.h>
+#include <machine.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* 1MB, 8 way, 64 byte lines */
+    static const int SETS = 2048;
+    static const int WAYS = 8;
+    static const int LINE = 64;
+
+    typedef CacheLines<SETS, WAYS, LINE, 5> StaticLines;
+
+    /*
+     * Random mix of probes, inserts and invalidates over an address range
+     * a few times larger than the cache. Returns a hash of all results so
+     * two implementations can be compared.
+     */
+    W64 run_accesses(CacheLinesBase *lines, int count, W32 seed)
+    {
+        RandomNumberGenerator random(seed);
+        MemoryRequest request;
+        W64 hash = 0;
+        W64 range = W64(SETS) * WAYS * LINE * 4;
+
+        dynarray<W64> addrs(count);
+        dynarray<W8> ops(count);
+        addrs.resize(count);
+        ops.resize(count);
+        foreach(i, count) {
+            addrs[i] = (random.random64() % range) | (i & (LINE - 1));
+            ops[i] = random.random32() % 16;
+        }
+
+        foreach(i, count) {
+            request.set_physical_address(addrs[i]);
+
+            if(ops[i] < 10) {
+                CacheLine *line = lines->probe(&request);
+                if(!line) {
+                    W64 oldTag = -1;
+                    line = lines->insert(&request, oldTag);
+                    line->init(lines->tagOf(addrs[i]));
+                    hash = (hash * 31) + oldTag;
+                }
+                line->state = (line->state + 1) & 3;
+                hash = (hash * 31) + line->state;
+            } else if(ops[i] < 15) {
+                W64 oldTag = -1;
+                CacheLine *line = lines->insert(&request, oldTag);
+                line->init(lines->tagOf(addrs[i]));
+                hash = (hash * 31) + oldTag;
+            } else {
+                hash = (hash * 31) + lines->invalidate(&request);
+            }
+        }
+
+        return hash;
+    }
+
+    TEST(CacheLines, DynamicMatchesTemplated)
+    {
+        StaticLines *fixed = new StaticLines(2, 2);
+        DynamicCacheLines *dynamic = new DynamicCacheLines(SETS, WAYS, LINE,
+                5, 2, 2);
+        fixed->init();
+        dynamic->init();
+
+        ASSERT_EQ(fixed->get_size(), dynamic->get_size());
+        ASSERT_EQ(fixed->get_line_bits(), dynamic->get_line_bits());
+        ASSERT_EQ(fixed->tagOf(0x12345678), dynamic->tagOf(0x12345678));
+
+        foreach(seed, 3) {
+            ASSERT_EQ(run_accesses(fixed, 200000, seed + 1),
+                    run_accesses(dynamic, 200000, seed + 1));
+        }
+
+        delete fixed;
+        delete dynamic;
+    }
+
+    TEST(CacheLines, RuntimeGeometry)
+    {
+        BaseMachine machine("cachelines-test");
+
+        /* Options as config_gen.py writes them from the machine YAML */
+        machine.add_option("L2_", 0, "SIZE", "2M");
+        machine.add_option("L2_", 0, "ASSOC", WAYS);
+        machine.add_option("L2_", 0, "LATENCY", 5);
+        machine.add_option("L3_", 0, "SIZE", "8388608");
+        machine.add_option("L3_", 0, "ASSOC", 16);
+        machine.add_option("L3_", 0, "LATENCY", 30);
+
+        CacheLinesBase *l2 = get_dynamic_cachelines("L2_0", machine, LINE,
+                2, 2);
+        ASSERT_EQ(4096, l2->get_set_count());
+        ASSERT_EQ(WAYS, l2->get_way_count());
+        ASSERT_EQ(LINE, l2->get_line_size());
+        ASSERT_EQ(5, l2->get_access_latency());
+
+        CacheLinesBase *l3 = get_dynamic_cachelines("L3_0", machine, LINE,
+                2, 2);
+        ASSERT_EQ(8192, l3->get_set_count());
+        ASSERT_EQ(16, l3->get_way_count());
+        ASSERT_EQ(30, l3->get_access_latency());
+        ASSERT_EQ(8 << 20, l3->get_size());
+
+        delete l2;
+        delete l3;
+    }
+
+    TEST(CacheLines, GeometryOverride)
+    {
+        BaseMachine machine("cachelines-override-test");
+
+        machine.add_option("L2_", 0, "SIZE", "2M");
+        machine.add_option("L2_", 0, "ASSOC", WAYS);
+        machine.add_option("L2_", 0, "LATENCY", 5);
+
+        /* First matching prefix wins, left out fields keep the options */
+        config.cache_geometry = "L3_:8M,L2_:512K:4,L2_0:4M:16:9";
+
+        CacheLinesBase *l2 = get_dynamic_cachelines("L2_0", machine, LINE,
+                2, 2);
+        ASSERT_EQ(2048, l2->get_set_count());
+        ASSERT_EQ(4, l2->get_way_count());
+        ASSERT_EQ(5, l2->get_access_latency());
+
+        config.cache_geometry = "";
+
+        delete l2;
+    }
+
+    /*
+     * Templated vs dynamic cache lines benchmark: prints cycles per access
+     * of the same access mix on both, run with
+     * --gtest_filter=*CacheLinesBenchmark
+     */
+    template <int BSETS, int BWAYS>
+    void bench_cache_lines(int count)
+    {
+        CacheLines<BSETS, BWAYS, LINE, 5> *fixed =
+            new CacheLines<BSETS, BWAYS, LINE, 5>(2, 2);
+        DynamicCacheLines *dynamic = new DynamicCacheLines(BSETS, BWAYS,
+                LINE, 5, 2, 2);
+        CacheLinesBase *lines[2] = {fixed, dynamic};
+        fixed->init();
+        dynamic->init();
+
+        /* Addresses are generated first so only the cache is timed */
+        RandomNumberGenerator random(BSETS);
+        W64 range = W64(BSETS) * BWAYS * LINE * 4;
+        dynarray<W64> addrs(count);
+        dynarray<W8> ops(count);
+        addrs.resize(count);
+        ops.resize(count);
+        foreach(i, count) {
+            addrs[i] = random.random64() % range;
+            ops[i] = random.random32() % 16;
+        }
+
+        MemoryRequest request;
+        W64 sum[2] = {0, 0};
+        W64 cycles[2];
+
+        foreach(d, 2) {
+            CacheLinesBase *cache = lines[d];
+            CycleTimer timer;
+
+            timer.start();
+            foreach(i, count) {
+                request.set_physical_address(addrs[i]);
+
+                if(ops[i] < 15) {
+                    CacheLine *line = cache->probe(&request);
+                    if(!line) {
+                        W64 oldTag = -1;
+                        line = cache->insert(&request, oldTag);
+                        line->init(cache->tagOf(addrs[i]));
+                        sum[d] += oldTag;
+                    }
+                    sum[d] += line->tag;
+                } else {
+                    sum[d] += cache->invalidate(&request);
+                }
+            }
+            cycles[d] = timer.stop();
+        }
+
+        ASSERT_EQ(sum[0], sum[1]);
+
+        cout << intstring(BSETS, 5), " sets ", intstring(BWAYS, 2),
+             " ways: templated ",
+             floatstring(double(cycles[0]) / count, 0, 2),
+             " cycles/access, dynamic ",
+             floatstring(double(cycles[1]) / count, 0, 2),
+             " cycles/access", endl;
+
+        delete fixed;
+        delete dynamic;
+    }
+
+    TEST(CacheLines, CacheLinesBenchmark)
+    {
+        bench_cache_lines<64, 8>(1 << 21);
+        bench_cache_lines<2048, 8>(1 << 21);
+        bench_cache_lines<8192, 16>(1 << 21);
+    }
+};
@@ -0,0 +1,116 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <globalDirectory.h>
+
+namespace {
+
+    MemoryRequest* dir_request(MemoryRequest &request, W64 addr)
+    {
+        request.init(0, 0, addr, 0, 0, false, 0, 0, MEMORY_OP_READ);
+        return &request;
+    }
+
+    TEST(Directory, InsertProbe)
+    {
+        Directory dir(4, 2, 10, 1, SHARERS_FULL, 4, 4);
+        MemoryRequest request;
+        W64 old_tag;
+        W64 invalid = InvalidTag<W64>::INVALID;
+
+        /* Two banks, so lines 0, 8, 16 and 24 all map to set 0 */
+        dir.set_interleave(2);
+
+        ASSERT_TRUE(dir.probe(dir_request(request, 0)) == NULL);
+
+        DirectoryEntry *e0 = dir.insert(dir_request(request, 0), old_tag);
+        ASSERT_EQ(invalid, old_tag);
+        e0->init(0);
+        e0->present.set(1);
+
+        DirectoryEntry *e1 = dir.insert(dir_request(request, 8 * 64),
+                old_tag);
+        ASSERT_EQ(invalid, old_tag);
+        ASSERT_TRUE(e0 != e1);
+        e1->init(8 * 64);
+
+        ASSERT_TRUE(dir.probe(dir_request(request, 0)) == e0);
+        ASSERT_TRUE(dir.probe(dir_request(request, 8 * 64 + 5)) == e1);
+
+        /* Entry without sharers is replaced before the LRU one */
+        dir.probe(dir_request(request, 8 * 64));
+        DirectoryEntry *e2 = dir.insert(dir_request(request, 16 * 64),
+                old_tag);
+        ASSERT_TRUE(e2 == e1);
+        ASSERT_EQ(W64(8 * 64), old_tag);
+        e2->init(16 * 64);
+        e2->present.set(0);
+
+        /* Both have sharers, LRU is replaced */
+        dir.probe(dir_request(request, 16 * 64));
+        DirectoryEntry *e3 = dir.insert(dir_request(request, 24 * 64),
+                old_tag);
+        ASSERT_TRUE(e3 == e0);
+        ASSERT_EQ(W64(0), old_tag);
+
+        ASSERT_EQ(1, dir.invalidate(dir_request(request, 16 * 64)));
+        ASSERT_EQ(0, dir.invalidate(dir_request(request, 16 * 64)));
+        ASSERT_TRUE(dir.probe(dir_request(request, 16 * 64)) == NULL);
+    }
+
+    TEST(Directory, Ports)
+    {
+        Directory dir(4, 2, 10, 2, SHARERS_FULL, 4, 4);
+        int stall;
+
+        ASSERT_EQ(10, dir.access(100, stall));
+        ASSERT_EQ(0, stall);
+        ASSERT_EQ(10, dir.access(100, stall));
+        ASSERT_EQ(0, stall);
+
+        /* Both ports are busy this cycle */
+        ASSERT_EQ(11, dir.access(100, stall));
+        ASSERT_EQ(1, stall);
+
+        ASSERT_EQ(10, dir.access(102, stall));
+        ASSERT_EQ(0, stall);
+    }
+
+    TEST(Directory, SharerEncoding)
+    {
+        bitvec<NUM_SIM_CORES> caches, targets;
+        DirectoryEntry entry;
+
+        foreach(i, NUM_SIM_CORES) {
+            caches.set(i);
+        }
+        entry.init(0);
+        entry.present.set(0);
+
+        Directory full(4, 2, 10, 1, SHARERS_FULL, 1, 2);
+        ASSERT_FALSE(full.get_targets(&entry, caches, targets));
+        ASSERT_TRUE(targets == entry.present);
+
+        /* Coarse vector invalidates whole group */
+        Directory coarse(4, 2, 10, 1, SHARERS_COARSE, 1, 2);
+        ASSERT_FALSE(coarse.get_targets(&entry, caches, targets));
+        ASSERT_TRUE(targets.test(0));
+        ASSERT_TRUE(targets.test(1));
+        ASSERT_EQ(2, (int)targets.popcount());
+
+        /* Limited pointers broadcast on overflow */
+        Directory limited(4, 2, 10, 1, SHARERS_LIMITED, 1, 2);
+        ASSERT_FALSE(limited.get_targets(&entry, caches, targets));
+        ASSERT_TRUE(targets == entry.present);
+
+        entry.present.set(NUM_SIM_CORES - 1);
+        ASSERT_TRUE(limited.get_targets(&entry, caches, targets));
+        ASSERT_TRUE(targets == caches);
+
+        ASSERT_EQ(32, full.entry_bits(32));
+        ASSERT_EQ(16, coarse.entry_bits(32));
+        ASSERT_EQ(6, limited.entry_bits(32));
+    }
+};
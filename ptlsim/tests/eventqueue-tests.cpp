@@ -0,0 +1,250 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <eventQueue.h>
+
+using namespace Memory;
+
+namespace {
+
+    struct ExecutedEvent {
+        W64 cycle;
+        W64 clock;
+        W64 id;
+    };
+
+    /*
+     * Drive an event queue the same way MemoryHierarchy does: schedule few
+     * events with random delays every cycle and pop everything that is due.
+     * Delays are mostly short, including delay 0 events scheduled after the
+     * cycle is popped, with some long latency events that land in the wheel
+     * overflow bucket, and cycles are sometimes skipped.
+     */
+    template <typename Q>
+    void run_queue(Q& queue, W32 seed, dynarray<ExecutedEvent>& executed)
+    {
+        RandomNumberGenerator random(seed);
+        Signal signal("eventqueue-test");
+        W64 id = 0;
+        W64 cycle = 0;
+
+        while(cycle < 300000) {
+            int adds = random.random32() % 5;
+            foreach(i, adds) {
+                if(queue.count() >= 2000)
+                    break;
+
+                W32 type = random.random32() % 100;
+                W64 delay;
+                if(type < 85)
+                    delay = random.random32() % 33;
+                else if(type < 98)
+                    delay = 1 + random.random32() % 4096;
+                else
+                    delay = 1 + random.random32() % 200000;
+
+                Event *event = queue.alloc();
+                event->setup(&signal, cycle + delay, (void*)(id++));
+                queue.schedule(event);
+            }
+
+            if(random.random32() % 2000 == 0)
+                cycle += random.random32() % 70000;
+            else
+                cycle++;
+
+            Event *event;
+            while((event = queue.pop(cycle)) != NULL) {
+                ExecutedEvent e;
+                e.cycle = cycle;
+                e.clock = event->get_clock();
+                e.id = (W64)event->get_arg();
+                executed.push(e);
+                queue.free(event);
+            }
+        }
+    }
+
+    TEST(EventQueue, SameCycleFifo)
+    {
+        EventWheel<64> *wheel = new EventWheel<64>();
+        Signal signal("eventqueue-test");
+
+        /* Schedule same clock from near, far and overflow distance */
+        W64 clocks[4] = {100000, 100000, 100000, 100000};
+        W64 now[4] = {0, 90000, 99900, 99999};
+
+        foreach(i, 4) {
+            ASSERT_TRUE(wheel->pop(now[i]) == NULL);
+            Event *event = wheel->alloc();
+            event->setup(&signal, clocks[i], (void*)(W64)i);
+            wheel->schedule(event);
+        }
+
+        ASSERT_TRUE(wheel->pop(clocks[0] - 1) == NULL);
+
+        foreach(i, 4) {
+            Event *event = wheel->pop(clocks[0]);
+            ASSERT_TRUE(event != NULL);
+            ASSERT_EQ((W64)i, (W64)event->get_arg());
+            wheel->free(event);
+        }
+
+        ASSERT_TRUE(wheel->pop(clocks[0]) == NULL);
+        ASSERT_TRUE(wheel->empty());
+
+        delete wheel;
+    }
+
+    /*
+     * Caches and cores are clocked after MemoryHierarchy pops the events of
+     * a cycle, and schedule delay 0 events for that same cycle. They must
+     * come out ahead of events already queued for the next cycle, ordered by
+     * clock like EventList does.
+     */
+    TEST(EventQueue, DueEventsAfterPop)
+    {
+        EventList<64> *list = new EventList<64>();
+        EventWheel<64> *wheel = new EventWheel<64>();
+        Signal signal("eventqueue-test");
+
+        /* Clock of each event relative to the popped cycle */
+        W64 cycle = 300;
+        int deltas[8] = {1, 1, 0, 1, 0, -2, 2, 0};
+
+        Event *event;
+        foreach(i, 2) {
+            event = list->alloc();
+            event->setup(&signal, cycle + deltas[i], (void*)(W64)i);
+            list->schedule(event);
+
+            event = wheel->alloc();
+            event->setup(&signal, cycle + deltas[i], (void*)(W64)i);
+            wheel->schedule(event);
+        }
+
+        ASSERT_TRUE(list->pop(cycle) == NULL);
+        ASSERT_TRUE(wheel->pop(cycle) == NULL);
+
+        for(int i = 2; i < 8; i++) {
+            event = list->alloc();
+            event->setup(&signal, cycle + deltas[i], (void*)(W64)i);
+            list->schedule(event);
+
+            event = wheel->alloc();
+            event->setup(&signal, cycle + deltas[i], (void*)(W64)i);
+            wheel->schedule(event);
+        }
+
+        /* Due events of popped cycle are still returned for that cycle */
+        W64 due[4] = {5, 2, 4, 7};
+        foreach(i, 4) {
+            event = list->pop(cycle);
+            ASSERT_TRUE(event != NULL);
+            ASSERT_EQ(due[i], (W64)event->get_arg());
+            list->free(event);
+
+            event = wheel->pop(cycle);
+            ASSERT_TRUE(event != NULL);
+            ASSERT_EQ(due[i], (W64)event->get_arg());
+            wheel->free(event);
+        }
+
+        ASSERT_TRUE(list->pop(cycle) == NULL);
+        ASSERT_TRUE(wheel->pop(cycle) == NULL);
+
+        W64 next[4] = {0, 1, 3, 6};
+        foreach(i, 4) {
+            W64 c = cycle + 1 + (i == 3);
+
+            event = list->pop(c);
+            ASSERT_TRUE(event != NULL);
+            ASSERT_EQ(next[i], (W64)event->get_arg());
+            list->free(event);
+
+            event = wheel->pop(c);
+            ASSERT_TRUE(event != NULL);
+            ASSERT_EQ(next[i], (W64)event->get_arg());
+            wheel->free(event);
+        }
+
+        ASSERT_TRUE(list->empty());
+        ASSERT_TRUE(wheel->empty());
+
+        delete list;
+        delete wheel;
+    }
+
+    TEST(EventQueue, NextClock)
+    {
+        EventList<64> *list = new EventList<64>();
+        EventWheel<64> *wheel = new EventWheel<64>();
+        Signal signal("eventqueue-test");
+
+        ASSERT_EQ((W64)-1, list->next_clock());
+        ASSERT_EQ((W64)-1, wheel->next_clock());
+
+        /* Near, far and overflow distance in any order */
+        W64 clocks[5] = {70000, 30, 500, 200000, 12};
+
+        foreach(i, 5) {
+            Event *event = list->alloc();
+            event->setup(&signal, clocks[i], (void*)(W64)i);
+            list->schedule(event);
+
+            event = wheel->alloc();
+            event->setup(&signal, clocks[i], (void*)(W64)i);
+            wheel->schedule(event);
+        }
+
+        W64 sorted[5] = {12, 30, 500, 70000, 200000};
+
+        foreach(i, 5) {
+            ASSERT_EQ(sorted[i], list->next_clock());
+            ASSERT_EQ(sorted[i], wheel->next_clock());
+
+            /* Nothing is due before the reported clock */
+            ASSERT_TRUE(list->pop(sorted[i] - 1) == NULL);
+            ASSERT_TRUE(wheel->pop(sorted[i] - 1) == NULL);
+
+            Event *event = list->pop(sorted[i]);
+            ASSERT_TRUE(event != NULL);
+            list->free(event);
+
+            event = wheel->pop(sorted[i]);
+            ASSERT_TRUE(event != NULL);
+            wheel->free(event);
+        }
+
+        ASSERT_EQ((W64)-1, list->next_clock());
+        ASSERT_EQ((W64)-1, wheel->next_clock());
+
+        delete list;
+        delete wheel;
+    }
+
+    TEST(EventQueue, WheelMatchesList)
+    {
+        foreach(seed, 4) {
+            EventList<2048> *list = new EventList<2048>();
+            EventWheel<2048> *wheel = new EventWheel<2048>();
+            dynarray<ExecutedEvent> listOrder;
+            dynarray<ExecutedEvent> wheelOrder;
+
+            run_queue(*list, seed + 1, listOrder);
+            run_queue(*wheel, seed + 1, wheelOrder);
+
+            ASSERT_EQ(listOrder.count(), wheelOrder.count());
+            foreach(i, listOrder.count()) {
+                ASSERT_EQ(listOrder[i].id, wheelOrder[i].id);
+                ASSERT_EQ(listOrder[i].clock, wheelOrder[i].clock);
+                ASSERT_EQ(listOrder[i].cycle, wheelOrder[i].cycle);
+            }
+
+            delete list;
+            delete wheel;
+        }
+    }
+};
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <eventtrace.h>
+
+namespace {
+
+    TEST(EventTrace, RecordReplay)
+    {
+        const char *filename = "/tmp/test_event_trace";
+
+        EventTrace trace;
+        ASSERT_TRUE(trace.start_record(filename, 2));
+        ASSERT_TRUE(trace.is_recording());
+
+        trace.record(EVENT_TRACE_INTERRUPT, 0, 100, 0x1000, 0x20);
+        trace.record(EVENT_TRACE_IO, 0, 150, 0x1010, trace.add_io());
+        trace.record(EVENT_TRACE_INTERRUPT, 1, 120, 0x2000, 0x30);
+        trace.record(EVENT_TRACE_NMI, 0, 300, 0x1100, 2);
+        trace.record(EVENT_TRACE_IO, 0, 320, 0x1110, trace.add_io());
+        trace.stop();
+
+        ASSERT_FALSE(trace.is_recording());
+        ASSERT_EQ(W64(5), trace.get_recorded());
+
+        /* Other number of CPU Contexts */
+        ASSERT_FALSE(trace.start_replay(filename, 4));
+
+        ASSERT_TRUE(trace.start_replay(filename, 2));
+        ASSERT_TRUE(trace.is_replaying());
+        ASSERT_FALSE(trace.replay_done());
+
+        /* IO events are not returned as interrupts */
+        ASSERT_EQ(W64(150), trace.get_io_insns(0));
+        ASSERT_EQ(W64(320), trace.get_io_insns(1));
+        ASSERT_EQ(W64(-1), trace.get_io_insns(2));
+
+        const EventTraceRecord *rec = trace.peek(0);
+        ASSERT_TRUE(rec != NULL);
+        ASSERT_EQ(W64(100), rec->insns);
+        ASSERT_EQ(W64(0x1000), rec->rip);
+        ASSERT_EQ(W32(0x20), rec->data);
+        ASSERT_EQ(W8(EVENT_TRACE_INTERRUPT), rec->type);
+
+        ASSERT_EQ(W64(120), trace.get_next_insns(1));
+
+        trace.pop(0);
+        rec = trace.peek(0);
+        ASSERT_TRUE(rec != NULL);
+        ASSERT_EQ(W64(300), rec->insns);
+        ASSERT_EQ(W8(EVENT_TRACE_NMI), rec->type);
+
+        trace.pop(0);
+        ASSERT_TRUE(trace.peek(0) == NULL);
+        ASSERT_EQ(W64(-1), trace.get_next_insns(0));
+        ASSERT_FALSE(trace.replay_done());
+
+        trace.pop(1);
+        ASSERT_TRUE(trace.replay_done());
+        ASSERT_EQ(W64(3), trace.get_replayed());
+
+        trace.stop();
+        ASSERT_TRUE(trace.peek(1) == NULL);
+
+        ASSERT_FALSE(trace.start_replay("/tmp/test_event_trace_missing", 2));
+    }
+};
@@ -42,6 +42,83 @@ namespace {
         }
     }
 
+    /* Test vectorized W64 tag match against scalar one */
+    TEST(Logic, MatchTags64)
+    {
+        W64 tags[70];
+
+        for(int count = 1; count <= 70; count++) {
+            foreach(i, count) {
+                tags[i] = (W64(i) << 40) | (i * 0x1234567ULL);
+            }
+
+            ASSERT_EQ(-1, match_tags(tags, count, W64(0xdeadbeef)));
+
+            foreach(i, count) {
+                ASSERT_EQ(i, match_tags(tags, count, tags[i]));
+                ASSERT_EQ(match_tags<W64>(tags, count, tags[i]),
+                        match_tags(tags, count, tags[i]));
+            }
+        }
+
+        /* Tags that only differ in upper 32 bits */
+        FullyAssociativeTags<W64, 16> assoc;
+        foreach(i, 16) {
+            assoc.select(W64(i + 1) << 32);
+        }
+        ASSERT_EQ(5, assoc.probe(W64(6) << 32));
+        ASSERT_EQ(-1, assoc.probe((W64(6) << 32) | 1));
+    }
+
+    /*
+     * Tag match benchmark: prints cycles per probe of the scalar and the
+     * vectorized W64 match, run with --gtest_filter=*MatchTags64Benchmark
+     */
+    TEST(Logic, MatchTags64Benchmark)
+    {
+        const int probes = 1 << 20;
+        W64 tags[32];
+        W64 targets[256];
+
+        foreach(i, 32) {
+            tags[i] = W64(i * 0x9e3779b97f4a7c15ULL) >> 6;
+        }
+
+        const int way_counts[4] = {4, 8, 16, 32};
+
+        foreach(w, 4) {
+            int ways = way_counts[w];
+
+            /* Half hits, half misses */
+            foreach(i, 256) {
+                targets[i] = (i & 1) ? tags[(i >> 1) % ways] : W64(i);
+            }
+
+            W64 scalar_sum = 0, vector_sum = 0;
+            CycleTimer timer;
+
+            timer.start();
+            foreach(i, probes) {
+                scalar_sum += match_tags<W64>(tags, ways, targets[i & 255]);
+            }
+            W64 scalar_cycles = timer.stop();
+
+            timer.start();
+            foreach(i, probes) {
+                vector_sum += match_tags(tags, ways, targets[i & 255]);
+            }
+            W64 vector_cycles = timer.stop();
+
+            ASSERT_EQ(scalar_sum, vector_sum);
+
+            cout << intstring(ways, 2), "-way: scalar ",
+                 floatstring(double(scalar_cycles) / probes, 0, 2),
+                 " cycles/probe, vector ",
+                 floatstring(double(vector_cycles) / probes, 0, 2),
+                 " cycles/probe", endl;
+        }
+    }
+
     /* Test simulation freq related functions */
     TEST(Sim, SimFreq)
     {
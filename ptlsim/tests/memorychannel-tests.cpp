@@ -0,0 +1,105 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryChannel.h>
+
+using namespace Memory;
+
+namespace {
+
+    TEST(SPSCChannel, FullAndEmpty)
+    {
+        SPSCChannel<W64, 8> *channel = new SPSCChannel<W64, 8>();
+        W64 value;
+
+        /* Head and tail must sit on their own host cache lines */
+        ASSERT_EQ(0U, Waddr(channel) & 63);
+        ASSERT_TRUE(channel->empty());
+        ASSERT_FALSE(channel->pop(value));
+
+        foreach(i, 8) {
+            ASSERT_TRUE(channel->push(i));
+        }
+        ASSERT_TRUE(channel->full());
+        ASSERT_EQ(8, channel->count());
+        ASSERT_FALSE(channel->push(100));
+
+        ASSERT_TRUE(channel->pop(value));
+        ASSERT_EQ(0U, value);
+        ASSERT_FALSE(channel->full());
+        ASSERT_TRUE(channel->push(8));
+
+        foreach(i, 8) {
+            ASSERT_TRUE(channel->pop(value));
+            ASSERT_EQ(W64(i + 1), value);
+        }
+        ASSERT_TRUE(channel->empty());
+
+        delete channel;
+    }
+
+    TEST(SPSCChannel, FifoOrderAcrossWrap)
+    {
+        SPSCChannel<W64, 16> *channel = new SPSCChannel<W64, 16>();
+        RandomNumberGenerator random(7);
+        W64 pushed = 0;
+        W64 popped = 0;
+
+        /* Run indices past many wrap arounds of the ring */
+        while(popped < 100000) {
+            int pushes = random.random32() % 10;
+            foreach(i, pushes) {
+                if(!channel->push(pushed))
+                    break;
+                pushed++;
+            }
+
+            int pops = random.random32() % 10;
+            W64 value;
+            foreach(i, pops) {
+                if(!channel->pop(value))
+                    break;
+                ASSERT_EQ(popped, value);
+                popped++;
+            }
+
+            ASSERT_EQ(int(pushed - popped), channel->count());
+        }
+
+        delete channel;
+    }
+
+    TEST(SpillChannel, SpilledInOrderBehindRing)
+    {
+        SpillChannel<W64, 4> *channel = new SpillChannel<W64, 4>();
+        W64 value;
+
+        foreach(i, 4) {
+            ASSERT_TRUE(channel->push(i));
+        }
+        ASSERT_FALSE(channel->push(4));
+
+        /* Once anything is spilled, later messages go behind it */
+        channel->spill(4);
+        ASSERT_TRUE(channel->pop(value));
+        ASSERT_EQ(0U, value);
+        ASSERT_FALSE(channel->push(5));
+        channel->spill(5);
+        ASSERT_EQ(2, channel->spilled());
+        ASSERT_EQ(5, channel->count());
+
+        foreach(i, 5) {
+            ASSERT_TRUE(channel->peek(value));
+            ASSERT_EQ(W64(i + 1), value);
+            ASSERT_TRUE(channel->pop(value));
+            ASSERT_EQ(W64(i + 1), value);
+        }
+        ASSERT_TRUE(channel->empty());
+        ASSERT_EQ(0, channel->spilled());
+        ASSERT_TRUE(channel->push(6));
+
+        delete channel;
+    }
+};
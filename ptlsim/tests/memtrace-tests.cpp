@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memTrace.h>
+
+namespace {
+
+    MemTraceRecord make_record(W64 cycle, W64 physaddr, W64 rip,
+            W8 coreid, W8 type)
+    {
+        MemTraceRecord rec;
+        rec.reset();
+        rec.cycle = cycle;
+        rec.physaddr = physaddr;
+        rec.rip = rip;
+        rec.coreid = coreid;
+        rec.threadid = 0;
+        rec.type = type;
+        rec.kernel = bits(rip, 48, 16) != 0;
+        return rec;
+    }
+
+    void expect_same(const MemTraceRecord& a, const MemTraceRecord& b)
+    {
+        ASSERT_EQ(a.cycle, b.cycle);
+        ASSERT_EQ(a.physaddr, b.physaddr);
+        ASSERT_EQ(a.rip, b.rip);
+        ASSERT_EQ(a.coreid, b.coreid);
+        ASSERT_EQ(a.threadid, b.threadid);
+        ASSERT_EQ(a.type, b.type);
+        ASSERT_EQ(a.is_icache, b.is_icache);
+        ASSERT_EQ(a.kernel, b.kernel);
+    }
+
+    TEST(MemTrace, EncodeDecode)
+    {
+        MemTraceRecord recs[4];
+        recs[0] = make_record(100, 0x12340, 0x400000, 0, 0);
+        recs[1] = make_record(102, 0x12380, 0x400004, 0, 1);
+        /* Address and rip going down, other core, kernel */
+        recs[2] = make_record(102, 0x1000, 0xffffffff81000000ULL, 1, 0);
+        recs[3] = make_record(5000, 0x1040, 0x400008, 1, 0);
+        recs[3].is_icache = true;
+
+        MemTraceEncoder enc(1024);
+        foreach (i, 4) {
+            enc.add(recs[i]);
+        }
+
+        ASSERT_EQ(W32(4), enc.get_count());
+        /* Small deltas take a few bytes each */
+        ASSERT_LT(enc.get_size(), W32(4 * 16));
+
+        MemTraceDecoder dec;
+        dec.reset(enc.data(), enc.get_size());
+
+        MemTraceRecord rec;
+        foreach (i, 4) {
+            ASSERT_TRUE(dec.next(rec));
+            expect_same(recs[i], rec);
+        }
+        ASSERT_FALSE(dec.next(rec));
+
+        /* Truncated record is not returned */
+        dec.reset(enc.data(), enc.get_size() - 1);
+        foreach (i, 3) {
+            ASSERT_TRUE(dec.next(rec));
+        }
+        ASSERT_FALSE(dec.next(rec));
+    }
+
+    TEST(MemTrace, WriteRead)
+    {
+        const char *filename = "/tmp/test_mem_trace";
+        const int count = 5000;
+
+        foreach (mode, 4) {
+            bool compress = mode & 1;
+            bool background = mode >> 1;
+
+            /* Small blocks so records span many of them */
+            MemTraceWriter writer(filename, compress, 256, background);
+            ASSERT_TRUE(writer.is_open());
+
+            foreach (i, count) {
+                writer.write(make_record(i * 3, 0x100000 + (i % 64) * 64,
+                            0x400000 + (i % 7) * 4, i % 4, i % 2));
+            }
+            writer.close();
+            ASSERT_EQ(W64(count), writer.get_records());
+
+            MemTraceReader reader;
+            ASSERT_TRUE(reader.open(filename));
+
+            MemTraceRecord rec;
+            foreach (i, count) {
+                ASSERT_TRUE(reader.next(rec));
+                expect_same(make_record(i * 3, 0x100000 + (i % 64) * 64,
+                            0x400000 + (i % 7) * 4, i % 4, i % 2), rec);
+            }
+            ASSERT_FALSE(reader.next(rec));
+        }
+
+        MemTraceReader reader;
+        ASSERT_FALSE(reader.open("/tmp/test_mem_trace_missing"));
+    }
+};
@@ -100,6 +100,11 @@ namespace {
                 wait_interconn = true;
                 return true;
             }
+
+            MemoryRequest* get_free_request()
+            {
+                return memoryHierarchy_->get_free_request(0);
+            }
     };
 
     class MesiTest : public ::testing::Test {
@@ -405,4 +410,57 @@ namespace {
         ASSERT_EQ(st, exc);
         r();
     }
+
+    /*
+     * Send reads to a few lines through the pending queue, annul some of
+     * them, and check dependency stalls against a linear scan of the
+     * requests that are still pending.
+     */
+    TEST_F(MesiTest, PendingQueueDependency)
+    {
+        MESIStats *stats = (MESIStats*)cont->get_stats();
+        W64 start = stats->cpurequest.stall.read.dependency(user_stats);
+        W64 expected = 0;
+        dynarray<MemoryRequest*> pending;
+        RandomNumberGenerator random(7);
+
+        foreach(i, 200) {
+            if(i % 5 == 4 && pending.count() > 0) {
+                MemoryRequest *victim = pending[random.random32() %
+                    pending.count()];
+                cont->annul_request(victim);
+                pending.remove(victim);
+            }
+
+            W64 addr = 0x100000 + (random.random32() % 16) * 64 +
+                (random.random32() % 8) * 8;
+
+            foreach(j, pending.count()) {
+                if((pending[j]->get_physical_address() >> 6) ==
+                        (addr >> 6)) {
+                    expected++;
+                    break;
+                }
+            }
+
+            MemoryRequest *request = cont->get_free_request();
+            request->init(0, 0, addr, i, 0, false, 0x400000 + i, i,
+                    MEMORY_OP_READ);
+
+            Message message;
+            message.init();
+            message.request = request;
+
+            ASSERT_FALSE(cont->is_full());
+            ASSERT_TRUE(cont->handle_interconnect_cb(&message));
+            pending.push(request);
+        }
+
+        ASSERT_EQ(expected, stats->cpurequest.stall.read.dependency(
+                    user_stats) - start);
+
+        foreach(j, pending.count()) {
+            cont->annul_request(pending[j]);
+        }
+    }
 };
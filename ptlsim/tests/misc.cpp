@@ -5,6 +5,10 @@
 #include <ptlsim.h>
 #include <ptl-qemu.h>
 #include <superstl.h>
+#include <sampling.h>
+#include <decode.h>
+
+#include <pthread.h>
 
 void read_simpoint_file();
 int get_simpoint(int id);
@@ -111,4 +115,195 @@ namespace {
         EXPECT_STREQ("test_sp_0", name->buf);
         delete name;
     }
+
+    TEST(Sampling, Windows)
+    {
+        Sampler s;
+
+        s.setup(1000, 100, 50, 0.05, 2);
+        ASSERT_EQ(Sampler::SAMPLING_FAST_FWD, s.get_phase());
+        ASSERT_EQ(W64(850), s.get_fast_fwd_insns());
+
+        /* Warmup from 0 to 100, then measure 50 insns in 100 cycles */
+        s.start_unit(0, 0);
+        ASSERT_EQ(Sampler::SAMPLING_WARMUP, s.get_phase());
+        ASSERT_EQ(W64(100), s.get_window_end());
+
+        ASSERT_EQ(Sampler::SAMPLING_MEASURE, s.window_done(102, 400));
+        ASSERT_EQ(W64(152), s.get_window_end());
+
+        /* Window end is overshot by a few commits */
+        ASSERT_EQ(Sampler::SAMPLING_FAST_FWD, s.window_done(154, 504));
+        ASSERT_EQ(W64(1), s.get_samples());
+        ASSERT_DOUBLE_EQ(2.0, s.get_cpi());
+        ASSERT_EQ(W64(52), s.get_measured_insns());
+        ASSERT_EQ(W64(104), s.get_measured_cycles());
+
+        /* Same CPI again, no variance so error bound is reached */
+        s.start_unit(1004, 504);
+        s.window_done(1100, 600);
+        ASSERT_EQ(Sampler::SAMPLING_DONE, s.window_done(1150, 700));
+        ASSERT_EQ(W64(2), s.get_samples());
+    }
+
+    TEST(Sampling, ConfidenceInterval)
+    {
+        Sampler s;
+
+        s.setup(10, 0, 10, 0.01, 30);
+
+        /* No fast-forward, each measured window starts the next one */
+        s.start_unit(0, 0);
+        ASSERT_EQ(Sampler::SAMPLING_MEASURE, s.get_phase());
+
+        s.add_sample(1.0);
+        s.add_sample(2.0);
+        s.add_sample(3.0);
+        s.add_sample(4.0);
+
+        ASSERT_DOUBLE_EQ(2.5, s.get_cpi());
+        ASSERT_NEAR(1.2910, s.get_stddev(), 0.0001);
+        ASSERT_NEAR(1.96 * 1.2910 / 2, s.get_confidence(), 0.0001);
+        ASSERT_FALSE(s.converged());
+
+        ASSERT_EQ(Sampler::SAMPLING_MEASURE, s.window_done(10, 20));
+        ASSERT_EQ(W64(5), s.get_samples());
+        ASSERT_EQ(W64(20), s.get_window_end());
+    }
+
+    TEST(BasicBlockArena, AllocFree)
+    {
+        BasicBlockArena arena;
+        int size = BasicBlock::size_of(10);
+        int per_chunk = (BB_ARENA_CHUNK_SIZE - sizeof(BasicBlockArena::Chunk)) / ceil(size, 8);
+
+        dynarray<void*> blocks;
+        foreach (i, per_chunk + 1) {
+            blocks.push(arena.alloc(size));
+        }
+
+        /* BasicBlockPtr only keeps 32 bits of a block address */
+        ASSERT_EQ(0U, W64(Waddr(blocks[per_chunk])) >> 32);
+
+        /* Last block didn't fit in first chunk */
+        ASSERT_EQ(2, arena.chunk_count);
+        ASSERT_EQ(BasicBlockArena::chunk_of(blocks[0]),
+                BasicBlockArena::chunk_of(blocks[per_chunk - 1]));
+        ASSERT_NE(BasicBlockArena::chunk_of(blocks[0]),
+                BasicBlockArena::chunk_of(blocks[per_chunk]));
+
+        /* Older chunk is sparse once more than half of it is freed */
+        ASSERT_FALSE(arena.sparse(blocks[0]));
+        foreach (i, per_chunk / 2 + 1) {
+            arena.free(blocks[i], size);
+        }
+        ASSERT_TRUE(arena.sparse(blocks[per_chunk - 1]));
+        ASSERT_FALSE(arena.sparse(blocks[per_chunk]));
+
+        /* Empty chunk is given back */
+        for (int i = per_chunk / 2 + 1; i < per_chunk; i++) {
+            arena.free(blocks[i], size);
+        }
+        ASSERT_EQ(1, arena.chunk_count);
+        ASSERT_EQ(W64(ceil(size, 8)), arena.live_bytes);
+
+        /* Current chunk is reused from its start */
+        arena.free(blocks[per_chunk], size);
+        ASSERT_EQ(1, arena.chunk_count);
+        ASSERT_EQ(blocks[per_chunk], arena.alloc(size));
+    }
+
+    /* Blocks of the shared cache fetched by cores on several host threads */
+    static const int FETCH_THREADS = 4;
+    static const int FETCH_ROUNDS = 100000;
+    static dynarray<BasicBlock*> fetch_blocks;
+    static volatile W32 fetch_ready;
+
+    static void* fetch_thread(void *arg)
+    {
+        /* Threads share contexts on builds with fewer cores */
+        Context& ctx = contextof((Waddr)arg % NUM_SIM_CORES);
+        BasicBlock *bb = NULL;
+        Waddr misses = 0;
+
+        /* Cores of a parallel quantum, see ParallelSim::enter_core */
+        parallel_unserialized = true;
+
+        /* Start together so fetches overlap */
+        xadd((W32&)fetch_ready, W32(1));
+        while (fetch_ready < FETCH_THREADS) cpu_pause();
+
+        foreach (r, FETCH_ROUNDS) {
+            foreach (i, fetch_blocks.length) {
+                bb = bbcache.fetch(ctx, bb, fetch_blocks[i]->rip);
+                misses += (bb != fetch_blocks[i]);
+                if unlikely (!bb) break;
+            }
+        }
+
+        if (bb) bb->release();
+        parallel_unserialized = false;
+
+        return (void*)misses;
+    }
+
+    TEST(BasicBlockCache, ParallelFetch)
+    {
+        int count = 8;
+        int cores = min(FETCH_THREADS, NUM_SIM_CORES);
+
+        foreach (i, cores) {
+            if (!decoder_stats[i]) set_decoder_stats(NULL, i);
+        }
+
+        /* Loop of blocks each falling through to the next one */
+        foreach (i, count) {
+            RIPVirtPhys rvp;
+            setzero(rvp);
+            rvp.rip = 0x400000 + i * 16;
+            rvp.mfnlo = rvp.mfnhi = 0x400;
+            rvp.use64 = 1;
+
+            BasicBlock *bb = bbcache.alloc(1);
+            bb->reset(rvp);
+            bb->count = 1;
+            bb->bytes = 16;
+            bb->rip_taken = 0x400000 + ((i + 1) % count) * 16;
+            bb->rip_not_taken = bb->rip_taken;
+            bb->context_id = 0;
+            bb->synthops = bb->synthop_space();
+            bb->synthops[0] = NULL;
+            bbcache.add(bb);
+            bbcache.add_page(bb);
+            fetch_blocks.push(bb);
+        }
+
+        pthread_t threads[FETCH_THREADS];
+        fetch_ready = 0;
+        foreach (i, FETCH_THREADS) {
+            ASSERT_EQ(0, pthread_create(&threads[i], NULL, fetch_thread,
+                        (void*)(Waddr)i));
+        }
+
+        foreach (i, FETCH_THREADS) {
+            void *misses = NULL;
+            pthread_join(threads[i], &misses);
+            ASSERT_EQ(0, (Waddr)misses) << "Thread " << i;
+        }
+
+        /* Every reference was dropped and chain links point to the loop */
+        foreach (i, count) {
+            BasicBlock *bb = fetch_blocks[i];
+            ASSERT_EQ(0, bb->refcount);
+            ASSERT_EQ(fetch_blocks[(i + 1) % count], bb->chain[0]);
+            ASSERT_EQ(bbcache.generation, bb->chain_gen[0]);
+            ASSERT_TRUE(bb->users[0] && bb->users[cores - 1]);
+        }
+
+        foreach (i, count) {
+            ASSERT_TRUE(bbcache.invalidate(fetch_blocks[i],
+                        INVALIDATE_REASON_SPURIOUS));
+        }
+        fetch_blocks.clear();
+    }
 };
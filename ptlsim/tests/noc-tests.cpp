@@ -0,0 +1,82 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <noc.h>
+
+using namespace Memory::NetworkInterconnect;
+
+namespace {
+
+    int mesh_hops(int src, int dest, int width)
+    {
+        int hops = 0;
+        int port;
+
+        while ((port = mesh_route(src, dest, width)) != NOC_PORT_EJECT) {
+            src = mesh_next(src, port, width);
+            hops++;
+        }
+        return hops;
+    }
+
+    TEST(Network, MeshXYRoute)
+    {
+        /* 4x4 mesh: node 1 is (1,0) and node 14 is (2,3) */
+        ASSERT_EQ(NOC_PORT_EAST, mesh_route(1, 14, 4));
+        ASSERT_EQ(NOC_PORT_SOUTH, mesh_route(2, 14, 4));
+        ASSERT_EQ(NOC_PORT_NORTH, mesh_route(14, 2, 4));
+        ASSERT_EQ(NOC_PORT_WEST, mesh_route(14, 1, 4));
+        ASSERT_EQ(NOC_PORT_EJECT, mesh_route(5, 5, 4));
+
+        ASSERT_EQ(4, mesh_hops(1, 14, 4));
+        ASSERT_EQ(14, mesh_hops(0, 63, 8));
+        ASSERT_EQ(14, mesh_hops(63, 0, 8));
+        ASSERT_EQ(0, mesh_hops(9, 9, 8));
+    }
+
+    TEST(Network, RingRoute)
+    {
+        ASSERT_EQ(NOC_PORT_EAST, ring_route(0, 3, 8));
+        ASSERT_EQ(NOC_PORT_WEST, ring_route(0, 5, 8));
+        ASSERT_EQ(NOC_PORT_EAST, ring_route(6, 1, 8));
+        ASSERT_EQ(NOC_PORT_EJECT, ring_route(4, 4, 8));
+
+        ASSERT_EQ(0, ring_next(7, NOC_PORT_EAST, 8));
+        ASSERT_EQ(7, ring_next(0, NOC_PORT_WEST, 8));
+
+        ASSERT_TRUE(ring_wraps(7, NOC_PORT_EAST, 8));
+        ASSERT_TRUE(ring_wraps(0, NOC_PORT_WEST, 8));
+        ASSERT_FALSE(ring_wraps(3, NOC_PORT_EAST, 8));
+    }
+
+    TEST(Network, LinkCredits)
+    {
+        Link link;
+        Packet a, b;
+
+        link.reset(2, 5);
+
+        /* Data packet of 5 flits fills a whole VC */
+        ASSERT_EQ(0, link.alloc_vc(0, 2, 5));
+        ASSERT_EQ(1, link.alloc_vc(0, 2, 1));
+        ASSERT_EQ(1, link.alloc_vc(0, 2, 4));
+        ASSERT_EQ(-1, link.alloc_vc(0, 2, 1));
+
+        link.release_vc(0, 5);
+        ASSERT_EQ(-1, link.alloc_vc(1, 1, 1));
+        ASSERT_EQ(0, link.alloc_vc(0, 1, 1));
+
+        /* Serialization of back to back packets */
+        ASSERT_EQ(W64(10), link.reserve(10, 5));
+        ASSERT_EQ(W64(15), link.reserve(12, 1));
+        ASSERT_EQ(W64(20), link.reserve(20, 1));
+
+        link.add_waiter(&a);
+        link.add_waiter(&b);
+        ASSERT_TRUE(link.waitHead == &a);
+        ASSERT_TRUE(a.nextWaiter == &b);
+        ASSERT_TRUE(link.waitTail == &b);
+    }
+};
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <statelist.h>
+#include <pendingRequestMap.h>
+
+using namespace Memory;
+
+namespace {
+
+    struct PendingEntry : public FixStateListObject
+    {
+        W64 addr;
+
+        void init() {
+            addr = 0;
+        }
+
+        ostream& print(ostream& os) const {
+            os << "PendingEntry[", idx, "] addr[", (void*)addr, "]";
+            return os;
+        }
+    };
+
+    /* Oldest entry of the queue for addr's line, found the old way */
+    template <int SIZE>
+    PendingEntry* scan_oldest(FixStateList<PendingEntry, SIZE> *queue,
+            W64 addr)
+    {
+        PendingEntry *entry;
+        foreach_list_mutable(queue->list(), entry, entry_t, nextentry_t) {
+            if((entry->addr >> 6) == (addr >> 6))
+                return entry;
+        }
+        return NULL;
+    }
+
+    TEST(PendingRequestMap, MatchesLinearScan)
+    {
+        const int SIZE = 64;
+        FixStateList<PendingEntry, SIZE> *queue =
+            new FixStateList<PendingEntry, SIZE>();
+        PendingRequestMap<SIZE> *map = new PendingRequestMap<SIZE>();
+        RandomNumberGenerator random(1);
+
+        /* Few lines so chains get long and slots collide */
+        foreach(i, 100000) {
+            W64 addr = (random.random32() % 24) << 6 | (i & 63);
+            PendingEntry *oldest = scan_oldest(queue, addr);
+            int head = map->head(addr);
+
+            ASSERT_EQ(oldest ? oldest->idx : -1, head);
+
+            if((random.random32() & 1) && !queue->isFull()) {
+                PendingEntry *entry = queue->alloc();
+                entry->addr = addr;
+                map->add(entry->addr, entry->idx);
+            } else if(oldest) {
+                map->remove(oldest->addr, oldest->idx);
+                queue->free(oldest);
+            }
+
+            ASSERT_EQ(queue->count(), map->count());
+        }
+
+        delete map;
+        delete queue;
+    }
+
+    /*
+     * Completion lookup benchmark: fills a pending queue of SIZE entries,
+     * then retires requests in random order the way the DRAMSim callbacks
+     * do, looking up the oldest entry of the completed line and refilling
+     * the queue with a new request. Prints cycles per completion of the
+     * linear scan the memory controller used before and of the
+     * PendingRequestMap, run with --gtest_filter=*PendingRequestMapBenchmark
+     */
+    template <int SIZE>
+    void bench_pending_request_map(int completions)
+    {
+        FixStateList<PendingEntry, SIZE> *queue =
+            new FixStateList<PendingEntry, SIZE>();
+        PendingRequestMap<SIZE> *map = new PendingRequestMap<SIZE>();
+
+        /*
+         * Requests are generated first so only the lookup is timed. A
+         * quarter of the lines are shared to exercise the FIFO chains.
+         */
+        RandomNumberGenerator random(SIZE);
+        dynarray<W64> lines(SIZE + completions);
+        dynarray<int> picks(completions);
+        lines.resize(SIZE + completions);
+        picks.resize(completions);
+        foreach(i, SIZE + completions) {
+            lines[i] = W64(random.random32() % (SIZE * 3 / 4)) << 6;
+        }
+        foreach(i, completions) {
+            picks[i] = random.random32() % SIZE;
+        }
+
+        dynarray<W64> pending(SIZE);
+        W64 sum[2] = {0, 0};
+        W64 cycles[2];
+
+        foreach(useMap, 2) {
+            queue->reset();
+            map->reset();
+            pending.resize(SIZE);
+            foreach(i, SIZE) {
+                PendingEntry *entry = queue->alloc();
+                entry->addr = lines[i];
+                pending[i] = lines[i];
+                if(useMap) map->add(entry->addr, entry->idx);
+            }
+
+            CycleTimer timer;
+            timer.start();
+            foreach(i, completions) {
+                W64 addr = pending[picks[i]];
+                PendingEntry *found;
+
+                if(useMap) {
+                    found = &(*queue)[map->head(addr)];
+                    map->remove(found->addr, found->idx);
+                } else {
+                    found = scan_oldest(queue, addr);
+                }
+
+                sum[useMap] += found->idx;
+                queue->free(found);
+
+                PendingEntry *entry = queue->alloc();
+                entry->addr = lines[SIZE + i];
+                pending[picks[i]] = entry->addr;
+                if(useMap) map->add(entry->addr, entry->idx);
+            }
+            cycles[useMap] = timer.stop();
+        }
+
+        ASSERT_EQ(sum[0], sum[1]);
+
+        cout << "outstanding ", intstring(SIZE, 5), ": linear scan ",
+             floatstring(double(cycles[0]) / completions, 0, 2),
+             " cycles/completion, pending map ",
+             floatstring(double(cycles[1]) / completions, 0, 2),
+             " cycles/completion", endl;
+
+        delete map;
+        delete queue;
+    }
+
+    TEST(PendingRequestMap, PendingRequestMapBenchmark)
+    {
+        bench_pending_request_map<128>(1 << 18);
+        bench_pending_request_map<512>(1 << 18);
+        bench_pending_request_map<2048>(1 << 18);
+    }
+};
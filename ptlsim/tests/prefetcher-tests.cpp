@@ -0,0 +1,132 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryRequest.h>
+#include <prefetcher.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* 64 byte lines */
+    static const int LINE_BITS = 6;
+
+    void set_request(MemoryRequest& request, W64 addr, W64 rip)
+    {
+        request.init(0, 0, addr, 0, 0, false, rip, 0, MEMORY_OP_READ);
+    }
+
+    TEST(Prefetcher, NextLine)
+    {
+        NextLinePrefetcher prefetcher(LINE_BITS, 2, 0);
+        MemoryRequest request;
+        dynarray<W64> lines;
+
+        set_request(request, 0x10040, 0x400000);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(2, lines.count());
+        ASSERT_EQ(W64(0x10040 >> LINE_BITS) + 1, lines[0]);
+        ASSERT_EQ(W64(0x10040 >> LINE_BITS) + 2, lines[1]);
+
+        /* Only first use of a prefetched line triggers on hit */
+        lines.clear();
+        prefetcher.hit(&request, false, lines);
+        ASSERT_EQ(0, lines.count());
+        prefetcher.hit(&request, true, lines);
+        ASSERT_EQ(2, lines.count());
+
+        /* Never cross a 4K page */
+        lines.clear();
+        set_request(request, 0x10fc0, 0x400000);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(0, lines.count());
+    }
+
+    TEST(Prefetcher, Stride)
+    {
+        StridePrefetcher prefetcher(LINE_BITS, 1, 1, 16);
+        MemoryRequest request;
+        dynarray<W64> lines;
+        const W64 base = 0x200000;
+        const W64 stride = 256;
+
+        /* First two accesses train the entry, third one prefetches */
+        foreach(i, 2) {
+            set_request(request, base + i * stride, 0x400100);
+            prefetcher.miss(&request, lines);
+            ASSERT_EQ(0, lines.count());
+        }
+
+        set_request(request, base + 2 * stride, 0x400100);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(1, lines.count());
+        ASSERT_EQ((base + 3 * stride) >> LINE_BITS, lines[0]);
+
+        /* Different PC has its own entry */
+        lines.clear();
+        set_request(request, base + 3 * stride, 0x400200);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(0, lines.count());
+
+        /* Negative stride */
+        StridePrefetcher down(LINE_BITS, 1, 1, 16);
+        lines.clear();
+        foreach(i, 3) {
+            set_request(request, base - i * stride, 0x400300);
+            down.miss(&request, lines);
+        }
+        ASSERT_EQ(1, lines.count());
+        ASSERT_EQ((base - 3 * stride) >> LINE_BITS, lines[0]);
+    }
+
+    TEST(Prefetcher, Stream)
+    {
+        StreamPrefetcher prefetcher(LINE_BITS, 2, 4, 4);
+        MemoryRequest request;
+        dynarray<W64> lines;
+        const W64 line = 0x300000 >> LINE_BITS;
+
+        /* First miss allocates a stream */
+        set_request(request, line << LINE_BITS, 0);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(0, lines.count());
+
+        /* Second miss sets the direction and starts prefetching */
+        set_request(request, (line + 1) << LINE_BITS, 0);
+        prefetcher.miss(&request, lines);
+        ASSERT_EQ(2, lines.count());
+        ASSERT_EQ(line + 2, lines[0]);
+        ASSERT_EQ(line + 3, lines[1]);
+
+        /* Prefetched hits keep the stream going up to 'distance' ahead */
+        lines.clear();
+        prefetcher.hit(&request, true, lines);
+        ASSERT_EQ(2, lines.count());
+        ASSERT_EQ(line + 4, lines[0]);
+        ASSERT_EQ(line + 5, lines[1]);
+
+        lines.clear();
+        set_request(request, (line + 2) << LINE_BITS, 0);
+        prefetcher.hit(&request, true, lines);
+        ASSERT_EQ(1, lines.count());
+        ASSERT_EQ(line + 6, lines[0]);
+
+        /* Demand hits on already used lines do not train */
+        lines.clear();
+        set_request(request, (line + 3) << LINE_BITS, 0);
+        prefetcher.hit(&request, false, lines);
+        ASSERT_EQ(0, lines.count());
+
+        /* Descending stream */
+        StreamPrefetcher down(LINE_BITS, 1, 4, 4);
+        lines.clear();
+        set_request(request, (line + 10) << LINE_BITS, 0);
+        down.miss(&request, lines);
+        set_request(request, (line + 9) << LINE_BITS, 0);
+        down.miss(&request, lines);
+        ASSERT_EQ(1, lines.count());
+        ASSERT_EQ(line + 8, lines[0]);
+    }
+};
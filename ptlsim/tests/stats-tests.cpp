@@ -5,6 +5,10 @@
 #define DISABLE_ASSERT
 #include <ptlsim.h>
 #include <statsBuilder.h>
+#include <timeStats.h>
+#include <statsWriter.h>
+
+#include <zlib.h>
 
 #include <sstream>
 #define reset_stream(os) { os.str(""); }
@@ -318,4 +322,207 @@ namespace {
 
 		ASSERT_EQ(ct1_val, 10);
 	}
+
+    /* Read back all rows of a binary time-stats file */
+    static void read_time_stats(const char *filename, TimeStatsFileHeader &header,
+            dynarray<TimeStatsColumnHeader> &columns, dynarray<stringbuf*> &names,
+            dynarray<W64> &values)
+    {
+        std::ifstream is(filename, std::ios::binary);
+        ASSERT_TRUE(is.is_open());
+
+        is.read((char*)&header, sizeof(header));
+        ASSERT_EQ(0, memcmp(header.magic, "MARSSTSB", 8));
+
+        foreach(i, header.column_count) {
+            TimeStatsColumnHeader col;
+            is.read((char*)&col, sizeof(col));
+            columns.push(col);
+
+            char name[256];
+            is.read(name, col.name_length);
+            name[col.name_length] = '\0';
+            stringbuf *n = new stringbuf();
+            *n << name;
+            names.push(n);
+
+            is.ignore(sizeof(W32) * col.elem_count);
+        }
+
+        TimeStatsBlockHeader bh;
+        while(is.read((char*)&bh, sizeof(bh))) {
+            dynarray<W8> stored;
+            stored.resize(bh.stored_size);
+            is.read((char*)stored.data, bh.stored_size);
+
+            dynarray<W8> raw;
+            raw.resize(bh.raw_size);
+            if(bh.stored_size == bh.raw_size) {
+                memcpy(raw.data, stored.data, bh.raw_size);
+            } else {
+                uLongf raw_size = bh.raw_size;
+                ASSERT_EQ(Z_OK, uncompress(raw.data, &raw_size,
+                            stored.data, bh.stored_size));
+                ASSERT_EQ(bh.raw_size, raw_size);
+            }
+
+            ASSERT_EQ(bh.row_count * header.row_size, bh.raw_size);
+            foreach(i, bh.raw_size / sizeof(W64)) {
+                values.push(((W64*)raw.data)[i]);
+            }
+        }
+    }
+
+    TEST(Stats, BinaryTimeStats) {
+        StatsBuilder &builder = StatsBuilder::get();
+
+        foreach(compress, 2) {
+            builder.delete_nodes();
+            user_stats->reset();
+            kernel_stats->reset();
+
+            TestStat st;
+            st.ct1.set_default_stats(kernel_stats);
+            st.ct2.set_default_stats(user_stats);
+            st.ct3.set_default_stats(user_stats);
+            st.time_arr.set_default_stats(user_stats);
+            st.ct3.enable_periodic_dump();
+            st.sum.enable_periodic_dump();
+            st.time_arr.enable_periodic_dump(1);
+
+            const char *filename = "/tmp/marss-binary-time-stats.test";
+            TimeStatsWriter *writer = new TimeStatsWriter(filename, compress, 100);
+            ASSERT_TRUE(writer->is_open());
+
+            st.ct1 += 5;
+            st.ct2 += 3;
+            st.ct3 += 7;
+            st.time_arr[1] += 2;
+            writer->write(100, user_stats, kernel_stats);
+
+            st.ct1++;
+            st.ct3 += 10;
+            writer->write(200, user_stats, kernel_stats);
+
+            st.ct1.set_default_stats(user_stats);
+            st.ct1 += 4;
+            st.time_arr[1]++;
+            writer->write(300, user_stats, kernel_stats);
+
+            delete writer;
+
+            TimeStatsFileHeader header;
+            dynarray<TimeStatsColumnHeader> columns;
+            dynarray<stringbuf*> names;
+            dynarray<W64> values;
+            read_time_stats(filename, header, columns, names, values);
+            unlink(filename);
+
+            ASSERT_EQ(compress ? TIME_STATS_COMPRESSED : 0, header.flags);
+            ASSERT_EQ(100U, header.period);
+            ASSERT_EQ(5U, header.column_count);
+            ASSERT_EQ(5 * sizeof(W64), header.row_size);
+
+            ASSERT_STREQ("test.ct1", names[0]->buf);
+            ASSERT_STREQ("test.ct2", names[1]->buf);
+            ASSERT_STREQ("test.ct3", names[2]->buf);
+            ASSERT_STREQ("test.sum", names[3]->buf);
+            ASSERT_STREQ("test.time_arr.1", names[4]->buf);
+            ASSERT_EQ(TimeStatsColumn::FORMULA, columns[3].type);
+            ASSERT_EQ(TimeStatsColumn::FORMULA_ADD, columns[3].formula);
+            ASSERT_EQ(2, columns[3].elem_count);
+
+            /* cycle delta, ct1, ct2, ct3, time_arr.1 */
+            W64 expected[] = {
+                100, 5, 3, 7, 2,
+                100, 1, 0, 10, 0,
+                100, 4, 0, 0, 1,
+            };
+
+            ASSERT_EQ(sizeof(expected) / sizeof(W64), values.size());
+            foreach(i, values.size()) {
+                ASSERT_EQ(expected[i], values[i]);
+            }
+
+            foreach(i, names.size()) {
+                delete names[i];
+            }
+        }
+    }
+
+    static void read_file(const char *filename, stringbuf &buf)
+    {
+        char line[256];
+        FILE *fp = fopen(filename, "r");
+
+        buf.reset();
+        if(!fp) return;
+
+        while(fgets(line, sizeof(line), fp))
+            buf << line;
+        fclose(fp);
+    }
+
+    TEST(Stats, StatsWriter) {
+        StatsBuilder &builder = StatsBuilder::get();
+        const char *filenames[] = {
+            "/tmp/marss-stats-writer-sync.test",
+            "/tmp/marss-stats-writer-async.test",
+        };
+        const char *snapshot_filename = "/tmp/marss-stats-writer-snap.test";
+        stringbuf output[2];
+
+        /* Writing in simulation thread and in writer thread with a queue
+         * shorter than the snapshot count must give the same rows */
+        foreach(async, 2) {
+            builder.delete_nodes();
+            user_stats->reset();
+            kernel_stats->reset();
+
+            TestStat st;
+            st.ct1.set_default_stats(kernel_stats);
+            st.ct2.set_default_stats(user_stats);
+            st.ct3.set_default_stats(user_stats);
+            st.time_arr.set_default_stats(user_stats);
+            st.ct3.enable_periodic_dump();
+            st.sum.enable_periodic_dump();
+
+            ofstream *csv = new ofstream(filenames[async]);
+            StatsWriter *writer = new StatsWriter(async ? 2 : 0, csv, NULL,
+                    async ? snapshot_filename : NULL);
+
+            foreach(i, 20) {
+                st.ct1 += i;
+                st.ct2++;
+                if(i % 3 == 0)
+                    st.ct3 += 2;
+                writer->periodic((i + 1) * 100, user_stats, kernel_stats);
+            }
+
+            writer->snapshot("first", 2000, user_stats, kernel_stats);
+            st.ct2 += 7;
+            writer->snapshot(NULL, 2100, user_stats, kernel_stats);
+
+            ASSERT_EQ(async ? 22U : 20U, writer->get_snapshots());
+            writer->close();
+
+            read_file(filenames[async], output[async]);
+            unlink(filenames[async]);
+
+            delete writer;
+            delete csv;
+        }
+
+        ASSERT_TRUE(output[0].size() > 0);
+        ASSERT_STREQ(output[0].buf, output[1].buf);
+
+        stringbuf snapshots;
+        read_file(snapshot_filename, snapshots);
+        unlink(snapshot_filename);
+
+        /* Second snapshot only has the change since first one */
+        ASSERT_TRUE(strstr(snapshots.buf, "snapshot: first") != NULL);
+        ASSERT_TRUE(strstr(snapshots.buf, "snapshot: snapshot_21") != NULL);
+        ASSERT_TRUE(strstr(snapshots.buf, "ct2: 7") != NULL);
+    }
 };
@@ -35,7 +35,7 @@ void MemoryHierarchy::dcache_wakeup_wrapper(int coreid, int threadid,
 
 Config config;
 
-W64 sim_cycle;
+__thread W64 sim_cycle;
 
 ostream ptl_logfile;
 
@@ -135,15 +135,16 @@ void test_access_fast_path(MemoryHierarchy *memoryHierarchy)
 void test_request_pool()
 {
 	cout << "Testing request pool.." ;
-	RequestPool *requestPool = new RequestPool();
+	RequestPool *requestPool = new RequestPool("request_pool", NULL);
 
-	// First check if we get 100 free requests
-	// checked if we can have more than 100 , and it worked with 1500
+	// Requests are never referenced here, so pool has to grow in slabs
+	// to give out more than REQUEST_POOL_SIZE requests in same cycle
 	MemoryRequest* memoryRequest = NULL;
 	foreach(i, 1500) {
 		memoryRequest = requestPool->get_free_request();
 		assert(memoryRequest != NULL);
 	}
+	assert(requestPool->get_size() >= 1500);
 
 	cout << "Done" << endl;
 }
@@ -21,7 +21,7 @@ struct Config {
 
 extern Config config;
 
-extern W64 sim_cycle;
+extern __thread W64 sim_cycle;
 
 extern ostream ptl_logfile;
 
@@ -157,10 +157,22 @@ cache_case_stmt = '''
             return new %s(%s_READ_PORTS, %s_WRITE_PORTS);
 '''
 
+cache_dynamic_case_stmt = '''
+        case %(type)s:
+            return get_dynamic_cachelines(name, machine, %(type)s_LINE_SIZE,
+                    %(type)s_READ_PORTS, %(type)s_WRITE_PORTS);
+'''
+
+# Geometry params of DYNAMIC cache types that are read at run time
+cache_dynamic_params = ["SIZE", "ASSOC", "LATENCY"]
+
 cache_line_func = '''
+struct BaseMachine;
+
 namespace Memory {
     struct CacheLinesBase;
-    CacheLinesBase* get_cachelines(int type);
+    CacheLinesBase* get_cachelines(int type, const char *name,
+            BaseMachine &machine);
 };
 '''
 
@@ -434,12 +446,36 @@ def write_cont_logic(config, m_conf, of, n1, n2):
             of.write(machine_for_each_num_loop_i %
                     int(cache["insts"]))
 
+        # Memory controller params are run-time options, instance specific
+        # options are added after them so they can override params
+        if n2 == "memory" and cache_cfg.has_key("params"):
+            for key,val in cache_cfg["params"].items():
+                write_option_logic(machine_option_add_i, of, name_pfx,
+                        key, val)
+
+        # Geometry of DYNAMIC caches is read at run time from the cache
+        # params, instance options can override them. SIZE is always passed
+        # as a string so '2M' and 2097152 are both accepted.
+        geometry = {}
+        if n2 == "cache" and is_dynamic_cache(cache_cfg):
+            for key in cache_dynamic_params:
+                geometry[key] = cache_cfg["params"][key]
+
         # Check if there are any options to add
         if cache.has_key("option"):
             for key,val in cache["option"].items():
+                if key in geometry:
+                    geometry[key] = val
+                    continue
                 write_option_logic(machine_option_add_i, of, name_pfx,
                         key, val)
 
+        for key,val in geometry.items():
+            if key == "SIZE":
+                val = str(val)
+            write_option_logic(machine_option_add_i, of, name_pfx,
+                    key, val)
+
         of.write(machine_controller_create %
                 (name_pfx, base, c_type))
         of.write(machine_loop_end)
@@ -450,6 +486,9 @@ def write_cache_cont_logic(config, m_conf, of):
 def write_mem_cont_logic(config, m_conf, of):
     write_cont_logic(config, m_conf, of, "memory", "memory")
 
+def is_dynamic_cache(cfg):
+    return cfg["params"].get("DYNAMIC", False) == True
+
 def get_cache_line_size(config, m_conf, cache_name):
     for cache in m_conf["caches"]:
         if cache["name_prefix"] in cache_name:
@@ -686,6 +725,8 @@ def generate_cache_logic(config, options):
         for cache, cfg in config["cache"].items():
             # First write all params
             for param,val in cfg["params"].items():
+                if param == "DYNAMIC":
+                    continue
                 of.write("#define %s_%s %s\n" % (cache.upper(), param,
                     str(val)))
             # Find the number of sets
@@ -699,6 +740,11 @@ def generate_cache_logic(config, options):
             of.write("#define %s_%s %d\n" % (cache.upper(), "SETS",
                 sets))
 
+            # DYNAMIC caches get their geometry at run time, so they don't
+            # need a CacheLines template instance
+            if is_dynamic_cache(cfg):
+                continue
+
             # Now write typedef CacheLine
             of.write(cache_typedef_cacheline % (
                 c_pfx + "SETS",
@@ -710,12 +756,16 @@ def generate_cache_logic(config, options):
             typedefs[cache] = c_pfx + "CacheLines"
 
         # Now write function 'get_cachelines'
-        of.write("\nCacheLinesBase* get_cachelines(int cache_type)\n")
+        of.write("\nCacheLinesBase* get_cachelines(int cache_type, const char *name,\n")
+        of.write("\t\tBaseMachine &machine)\n")
         of.write("{\n")
         of.write("\tswitch(cache_type) {\n")
-        for cache in config["cache"].keys():
-            of.write(cache_case_stmt % (cache.upper(),
-                typedefs[cache], cache.upper(), cache.upper()))
+        for cache, cfg in config["cache"].items():
+            if is_dynamic_cache(cfg):
+                of.write(cache_dynamic_case_stmt % {'type' : cache.upper()})
+            else:
+                of.write(cache_case_stmt % (cache.upper(),
+                    typedefs[cache], cache.upper(), cache.upper()))
         of.write("\t\tdefault: assert(0);\n\t}\n")
         of.write("}\n")
         of.write("};\n")
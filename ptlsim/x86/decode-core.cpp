@@ -8,11 +8,12 @@
 #include <globals.h>
 #include <ptlsim.h>
 #include <decode.h>
+#include <uopcache.h>
 
 #include <setjmp.h>
+#include <sys/mman.h>
 
-BasicBlockCache bbcache[NUM_SIM_CORES];
-W8 BasicBlockCache::cpuid_counter = 0;
+BasicBlockCache bbcache;
 
 struct BasicBlockChunkListHashtableLinkManager {
     static inline BasicBlockChunkList* objof(selflistlink* link) {
@@ -1684,7 +1685,8 @@ bool assist_invalid_opcode(Context& ctx) {
 static const bool log_code_page_ops = 0;
 
 bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
-    BasicBlockChunkList* pagelist;
+    // Invalidations are accounted to the context that translated the block
+    int cpuid = bb->context_id;
     if unlikely (bb->refcount) {
         if(logable(8))
             ptl_logfile << "Warning: basic block ", bb, " ", *bb, " is still in use somewhere (refcount ", bb->refcount, ")", endl;
@@ -1695,6 +1697,23 @@ bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
         bbcache_dump_file << *bb << endl;
     }
 
+    unlink(bb);
+    W64 ct = count;
+    DECODERSTAT->bbcache.count = ct;
+    DECODERSTAT->bbcache.invalidates[reason]++;
+
+    arena.free(bb, BasicBlock::size_of(bb->count));
+    update_arena_stats(cpuid);
+    return true;
+}
+
+//
+// Remove a block from the hashtable and its code page lists, so no
+// context can look it up or follow a chain link to it anymore.
+//
+void BasicBlockCache::unlink(BasicBlock* bb) {
+    BasicBlockChunkList* pagelist;
+
     pagelist = bbpages.get(bb->rip.mfnlo);
     if (logable(10) | log_code_page_ops) ptl_logfile << "Remove bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) from low page list ", pagelist, ": loc ", bb->mfnlo_loc.chunk, ":", bb->mfnlo_loc.index, endl;
     assert(pagelist);
@@ -1709,15 +1728,53 @@ bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
     }
 
     remove(bb);
-    W64 ct = bbcache[cpuid].count;
+    unchain_all();
+}
+
+//
+// Invalidate a block that some fetch unit still holds: it is unlinked
+// right away and freed by free_retired() once it is released.
+//
+void BasicBlockCache::retire(BasicBlock* bb, int reason) {
+    int cpuid = bb->context_id;
+
+    if (logable(3) | log_code_page_ops) ptl_logfile << "Retire bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes): still has refcount ", bb->refcount, endl;
+
+    unlink(bb);
+    retired.push(bb);
+
+    W64 ct = count;
     DECODERSTAT->bbcache.count = ct;
     DECODERSTAT->bbcache.invalidates[reason]++;
+}
 
-    bb->free();
-    return true;
+//
+// Free the retired blocks that were released since they were retired
+//
+int BasicBlockCache::free_retired() {
+    int cpuid = 0;
+    int n = 0;
+    int kept = 0;
+
+    foreach (i, retired.length) {
+        BasicBlock* bb = retired[i];
+        if (bb->refcount) {
+            retired[kept++] = bb;
+            continue;
+        }
+
+        arena.free(bb, BasicBlock::size_of(bb->count));
+        n++;
+    }
+
+    retired.resize(kept);
+    if (n && DECODERSTAT) update_arena_stats(cpuid);
+    return n;
 }
 
 bool BasicBlockCache::invalidate(const RIPVirtPhys& rvp, int reason) {
+    parallel_serialize();
+
     BasicBlock* bb = get(rvp);
     // BasicBlock* bb = get(rvp.rip);
     if (!bb) return true;
@@ -1754,30 +1811,40 @@ void BasicBlockCache::add_page(BasicBlock* bb)
 // This function is suitable for calling from a reclaim handler
 // when we run out of memory (it may will allocate any memory).
 //
-bool BasicBlockCache::invalidate_page(Waddr mfn, int reason) {
+bool BasicBlockCache::invalidate_page(Waddr mfn, int reason, int cpuid) {
     //
     // We may try to invalidate the special invalid mfn if SMC
     // occurs on a page where the high virtual page is invalid.
     //
     if unlikely (mfn == RIPVirtPhys::INVALID) return 0;
 
+    // Fetch units of other cores may hold blocks of this page
+    parallel_serialize();
+
     BasicBlockChunkList* pagelist = bbpages.get(mfn);
 
     if (logable(3) | log_code_page_ops) ptl_logfile << "Invalidate page mfn ", mfn, ": pagelist ", pagelist, " has ", (pagelist ? pagelist->count() : 0), " entries", endl; // (dirty? ", smc_isdirty(mfn), ")", endl;
 
-    smc_cleardirty(mfn);
-
-    if unlikely (!pagelist) return 0;
+    if unlikely (!pagelist) {
+        smc_cleardirty(mfn);
+        return 0;
+    }
 
+    //
+    // The cache is shared, so other contexts may still be fetching from
+    // blocks of this page. Those are retired instead of being left in the
+    // cache, where every context could keep fetching the old code.
+    //
     int n = 0;
     BasicBlockChunkList::Iterator iter(pagelist);
     BasicBlockPtr* entry;
     while ((entry = iter.next())) {
         BasicBlock* bb = *entry;
         if (logable(3) | log_code_page_ops) ptl_logfile << "  Invalidate bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes)", endl;
-        if unlikely (!bbcache[cpuid].invalidate(bb, reason)) {
-            if (logable(3) | log_code_page_ops) ptl_logfile << "  Could not invalidate bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes): still has refcount ", bb->refcount, endl;
-            return false;
+        if unlikely (bb->refcount) {
+            retire(bb, reason);
+        } else {
+            invalidate(bb, reason);
         }
         n++;
     }
@@ -1786,6 +1853,10 @@ bool BasicBlockCache::invalidate_page(Waddr mfn, int reason) {
     //  assert(pagelist->count() == 0);
 
     pagelist->clear();
+
+    // Only protect the page again once none of its old blocks can be fetched
+    smc_cleardirty(mfn);
+
     W64 ct = bbpages.count;
     DECODERSTAT->pagecache.count = ct;
     DECODERSTAT->pagecache.invalidates[reason]++;
@@ -1800,6 +1871,11 @@ bool BasicBlockCache::invalidate_page(Waddr mfn, int reason) {
 //
 int BasicBlockCache::reclaim(size_t bytesreq, int urgency) {
     bool DEBUG = 1; // logable(1);
+    // Reclaim is machine wide, account it to first context
+    int cpuid = 0;
+
+    parallel_serialize();
+    free_retired();
 
     if (!count) return 0;
 
@@ -1822,7 +1898,7 @@ int BasicBlockCache::reclaim(size_t bytesreq, int urgency) {
         oldest = min(oldest, bb->lastused);
         newest = max(newest, bb->lastused);
         average += bb->lastused;
-        total_bytes += sizeof(bb);
+        total_bytes += BasicBlock::size_of(bb->count);
         n++;
     }
 
@@ -1868,18 +1944,28 @@ int BasicBlockCache::reclaim(size_t bytesreq, int urgency) {
 
         // We use '<=' to guarantee even a uniform distribution will eventually be reclaimed:
         if likely (bb->lastused <= average) {
-            reclaimed_bytes += sizeof(bb);
+            reclaimed_bytes += BasicBlock::size_of(bb->count);
             reclaimed_objs++;
             invalidate(bb, INVALIDATE_REASON_RECLAIM);
         }
         n++;
     }
 
+    int moved_objs = compact();
+    W64 moved = moved_objs;
+    if (DECODERSTAT) {
+        DECODERSTAT->bbcache_arena.moved_blocks += moved;
+        update_arena_stats(cpuid);
+    }
+
     if (DEBUG) {
         ptl_logfile << "After:", endl;
         ptl_logfile << "  Basic blocks:   ", intstring(reclaimed_objs, 12), " BBs reclaimed", endl;
         ptl_logfile << "  Bytes occupied: ", intstring(reclaimed_bytes, 12), " bytes reclaimed", endl;
         ptl_logfile << "  New pool size:  ", intstring(count, 12), " BBs", endl;
+        ptl_logfile << "  Moved:          ", intstring(moved_objs, 12), " BBs compacted", endl;
+        ptl_logfile << "  Arena:          ", intstring(arena.reserved_bytes(), 12), " bytes in ",
+                    arena.chunk_count, " chunks, ", arena.live_bytes, " bytes used", endl;
         ptl_logfile.flush();
     }
 
@@ -1912,12 +1998,174 @@ int BasicBlockCache::reclaim(size_t bytesreq, int urgency) {
     return n;
 }
 
+BasicBlockArena::Chunk* BasicBlockArena::alloc_chunk() {
+    Chunk* chunk = free_chunks;
+
+    if likely (chunk) {
+        free_chunks = chunk->next;
+        return chunk;
+    }
+
+    if unlikely (region_next == region_end) {
+        // One more chunk, so the region can start on a chunk boundary
+        size_t size = BB_ARENA_REGION_SIZE + BB_ARENA_CHUNK_SIZE;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+        flags |= MAP_32BIT;
+#endif
+        void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        assert(mem != MAP_FAILED);
+        assert(((Waddr)mem + size - 1) <= 0xffffffffULL);
+
+        regions.push((byte*)mem);
+        region_next = (byte*)ceil((Waddr)mem, BB_ARENA_CHUNK_SIZE);
+        region_end = region_next + BB_ARENA_REGION_SIZE;
+    }
+
+    chunk = (Chunk*)region_next;
+    region_next += BB_ARENA_CHUNK_SIZE;
+    return chunk;
+}
+
+void BasicBlockArena::free_chunk(Chunk* chunk) {
+    madvise(chunk, BB_ARENA_CHUNK_SIZE, MADV_DONTNEED);
+    chunk->next = free_chunks;
+    free_chunks = chunk;
+}
+
+void* BasicBlockArena::alloc(size_t bytes) {
+    bytes = ceil(bytes, 8);
+    assert(sizeof(Chunk) + bytes <= BB_ARENA_CHUNK_SIZE);
+
+    Chunk* chunk = chunks;
+
+    if unlikely (!chunk || (sizeof(Chunk) + chunk->used + bytes) > BB_ARENA_CHUNK_SIZE) {
+        chunk = alloc_chunk();
+        chunk->next = chunks;
+        chunk->used = 0;
+        chunk->live = 0;
+        chunks = chunk;
+        chunk_count++;
+    }
+
+    void* p = chunk->data() + chunk->used;
+    chunk->used += bytes;
+    chunk->live += bytes;
+    live_bytes += bytes;
+
+    return p;
+}
+
+void BasicBlockArena::free(void* p, size_t bytes) {
+    bytes = ceil(bytes, 8);
+
+    Chunk* chunk = chunk_of(p);
+    assert(chunk->live >= bytes);
+
+    chunk->live -= bytes;
+    live_bytes -= bytes;
+
+    if (chunk->live) return;
+
+    // Current chunk is reused from its start, others are released
+    if (chunk == chunks) {
+        chunk->used = 0;
+        return;
+    }
+
+    Chunk** prev = &chunks;
+    while (*prev != chunk) prev = &(*prev)->next;
+    *prev = chunk->next;
+
+    free_chunk(chunk);
+    chunk_count--;
+}
+
+void BasicBlockArena::reset() {
+    foreach (i, regions.length) {
+        munmap(regions[i], BB_ARENA_REGION_SIZE + BB_ARENA_CHUNK_SIZE);
+    }
+
+    regions.clear();
+    region_next = NULL;
+    region_end = NULL;
+    free_chunks = NULL;
+    chunks = NULL;
+    chunk_count = 0;
+    live_bytes = 0;
+}
+
+void BasicBlockCache::update_arena_stats(int cpuid) {
+    W64 reserved = arena.reserved_bytes();
+    W64 live = arena.live_bytes;
+    W64 chunks = arena.chunk_count;
+
+    DECODERSTAT->bbcache_arena.reserved_bytes = reserved;
+    DECODERSTAT->bbcache_arena.live_bytes = live;
+    DECODERSTAT->bbcache_arena.chunks = chunks;
+}
+
+//
+// Move a block nobody holds to the current arena chunk. The hash table
+// and code page lists are updated to point to the new copy.
+//
+BasicBlock* BasicBlockCache::move(BasicBlock* bb) {
+    assert(!bb->refcount);
+
+    size_t bytes = BasicBlock::size_of(bb->count);
+    BasicBlock* newbb = alloc(bb->count);
+
+    remove(bb);
+    unchain_all();
+    memcpy((void*)newbb, bb, bytes);
+    newbb->hashlink.reset();
+    newbb->unchain();
+    if (newbb->synthops) newbb->synthops = newbb->synthop_space();
+    add(newbb);
+
+    if (bb->mfnlo_loc.chunk)
+        bb->mfnlo_loc.chunk->data[bb->mfnlo_loc.index] = newbb;
+
+    int page_crossing = ((lowbits(bb->rip, 12) + (bb->bytes-1)) >> 12);
+    if (page_crossing && bb->mfnhi_loc.chunk)
+        bb->mfnhi_loc.chunk->data[bb->mfnhi_loc.index] = newbb;
+
+    arena.free(bb, bytes);
+    return newbb;
+}
+
+//
+// Move blocks out of arena chunks that are less than half used, so the
+// space of reclaimed blocks is given back once their chunks are empty.
+// Blocks held by a fetch unit can't be moved.
+//
+int BasicBlockCache::compact() {
+    dynarray<BasicBlock*> bblist;
+    getentries(bblist);
+
+    int moved = 0;
+
+    foreach (i, bblist.length) {
+        BasicBlock* bb = bblist[i];
+        if (bb->refcount || !arena.sparse(bb)) continue;
+
+        move(bb);
+        moved++;
+    }
+
+    bblist.clear();
+    return moved;
+}
+
 //
 // Flush the entire basic block cache immediately.
 // All basic blocks are flushed: no remaining
 // references are allowed.
 //
 void BasicBlockCache::flush(int8_t context_id) {
+    int cpuid = (context_id < 0) ? 0 : context_id;
+
+    parallel_serialize();
 
     if (logable(1))
         ptl_logfile << "Flushing basic block cache at ", sim_cycle, " cycles, ", total_insns_committed, " commits:", endl;
@@ -1965,7 +2213,7 @@ bool assist_exec_page_fault(Context& ctx) {
     Waddr bbcache_rip = ctx.reg_ar2;
 
     ctx.eip = ctx.reg_selfrip;
-    assert(bbcache[ctx.cpu_index].invalidate(RIPVirtPhys(bbcache_rip).update(ctx), INVALIDATE_REASON_SPURIOUS));
+    assert(bbcache.invalidate(RIPVirtPhys(bbcache_rip).update(ctx), INVALIDATE_REASON_SPURIOUS));
     ctx.handle_page_fault(faultaddr, 2);
 
     return true;
@@ -2322,6 +2570,115 @@ ostream& printflags(ostream& os, W64 flags) {
     return os;
 }
 
+//
+// Find a translated basic block in the shared cache. First use of a block
+// by a context other than the one that translated it is what the shared
+// cache saves compared to private per context caches: one copy of the
+// block and its translation time.
+//
+// First fetch of a block translated by another context
+static inline void count_shared_hit(int cpuid, BasicBlock* bb) {
+    if likely (bb->users[cpuid].testset()) return;
+
+    DECODERSTAT->shared_bbcache.shared_hits++;
+    DECODERSTAT->shared_bbcache.bytes_saved +=
+        BasicBlock::size_of(bb->count);
+    DECODERSTAT->shared_bbcache.translate_cycles_saved +=
+        bb->translate_cycles;
+}
+
+BasicBlock* BasicBlockCache::lookup(Context& ctx, const RIPVirtPhys& rvp) {
+    int cpuid = ctx.cpu_index;
+    BasicBlock* bb = get(rvp);
+
+    DECODERSTAT->shared_bbcache.lookups++;
+    if unlikely (!bb) return NULL;
+
+    DECODERSTAT->shared_bbcache.hits++;
+    count_shared_hit(cpuid, bb);
+
+    return bb;
+}
+
+// Chain slot of <prev> for a block starting at <rip>, -1 for indirect targets
+static inline int chain_slot(const BasicBlock* prev, W64 rip) {
+    if (rip == prev->rip_taken) return 0;
+    if (rip == prev->rip_not_taken) return 1;
+    return -1;
+}
+
+//
+// Find the block at rvp through the chain links of <prev>, the block
+// fetched before it. Returns NULL if the link is not set or stale, then
+// the caller does a regular lookup and chains the block it finds.
+//
+BasicBlock* BasicBlockCache::lookup_chained(Context& ctx, BasicBlock* prev, const RIPVirtPhys& rvp) {
+    int slot = chain_slot(prev, rvp.rip);
+    if unlikely (slot < 0) return NULL;
+
+    if unlikely (prev->chain_gen[slot] != generation) return NULL;
+
+    // Same virtual rip can map to other code or another mode
+    typedef HashtableKeyManager<RIPVirtPhys, BB_CACHE_SIZE> KeyManager;
+    BasicBlock* bb = prev->chain[slot];
+    if unlikely (!KeyManager::equal(bb->rip, rvp)) return NULL;
+
+    int cpuid = ctx.cpu_index;
+    DECODERSTAT->shared_bbcache.chained++;
+    count_shared_hit(cpuid, bb);
+
+    return bb;
+}
+
+void BasicBlockCache::chain(BasicBlock* prev, BasicBlock* bb) {
+    int slot = chain_slot(prev, bb->rip.rip);
+    if unlikely (slot < 0) return;
+
+    prev->chain[slot] = bb;
+    prev->chain_gen[slot] = generation;
+}
+
+//
+// Block at rvp for the fetch unit of ctx, translated on a miss. <prev>
+// is the block the fetch unit held so far: the new block is chained to
+// it before its reference is dropped, so translate can't reclaim it in
+// between. Returns the new block acquired, NULL if it can't be
+// translated.
+//
+// In a parallel quantum cores fetch without an exclusive section, so
+// hits, chain links and reference counts are changed under fetch_lock.
+// Translation serializes and isn't done under the lock.
+//
+BasicBlock* BasicBlockCache::fetch(Context& ctx, BasicBlock* prev, const RIPVirtPhys& rvp) {
+    bool locked = parallel_lock(fetch_lock);
+
+    BasicBlock* bb = NULL;
+    if likely (prev) bb = lookup_chained(ctx, prev, rvp);
+
+    if unlikely (!bb) {
+        bb = lookup(ctx, rvp);
+
+        if unlikely (!bb) {
+            parallel_unlock(fetch_lock, locked);
+            bb = translate(ctx, rvp);
+            locked = parallel_lock(fetch_lock);
+        }
+
+        if likely (bb && prev) chain(prev, bb);
+    }
+
+    if likely (prev) prev->release();
+
+    if likely (bb) {
+        bb->acquire();
+        bb->use(sim_cycle);
+        if unlikely (!bb->synthops) synth_uops_for_bb(*bb);
+    }
+
+    parallel_unlock(fetch_lock, locked);
+    return bb;
+}
+
 //
 // Translate one basic block. This function always returns
 // a BasicBlock, except in the very rare case where one or
@@ -2347,14 +2704,29 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
        }
        */
 
+    int cpuid = ctx.cpu_index;
     BasicBlock* bb = get(rvp);
-    if likely (bb && bb->context_id == ctx.cpu_index) {
+    if likely (bb) {
         return bb;
     }
 
-    bb = NULL;
+    /* Decoder and uop cache state is shared by all cores */
+    if unlikely (parallel_unserialized) {
+        parallel_serialize();
+
+        // Core earlier in the serial order may have translated it meanwhile
+        bb = get(rvp);
+        if unlikely (bb) {
+            DECODERSTAT->shared_bbcache.hits++;
+            count_shared_hit(cpuid, bb);
+            return bb;
+        }
+    }
+
+    if unlikely (retired.length) free_retired();
 
     translate_timer.start();
+    W64 translate_start = rdtsc();
 
     byte insnbuf[MAX_BB_BYTES];
 
@@ -2376,17 +2748,29 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
         assert(trans.valid_byte_count == 0);
     }
 
-    for (;;) {
-        if (!trans.translate()) break;
+    if unlikely (uopcache.enabled()) {
+        bb = uopcache.load(ctx, rvp, insnbuf, trans.valid_byte_count, arena);
     }
 
-    if(trans.handle_exec_fault) {
-        return NULL;
-    }
+    if likely (!bb) {
+        for (;;) {
+            if (!trans.translate()) break;
+        }
 
-    trans.bb.hitcount = 0;
-    trans.bb.predcount = 0;
-    bb = trans.bb.clone();
+        if(trans.handle_exec_fault) {
+            return NULL;
+        }
+
+        trans.bb.hitcount = 0;
+        trans.bb.predcount = 0;
+        bb = trans.bb.clone_to(alloc(trans.bb.count));
+
+        // Blocks cut short by an invalid page are not worth saving
+        if unlikely (uopcache.enabled() && !bb->invalidblock &&
+                bb->bytes <= trans.valid_byte_count) {
+            uopcache.store(ctx, *bb, insnbuf);
+        }
+    }
     //
     // Acquire a reference to the new basic block right away,
     // since we make allocations below that might reclaim it
@@ -2399,6 +2783,7 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     DECODERSTAT->bbcache.count = ct;
     DECODERSTAT->bbcache.inserts++;
     DECODERSTAT->throughput.basic_blocks++;
+    update_arena_stats(cpuid);
 
     BasicBlockChunkList* pagelist;
 
@@ -2451,8 +2836,10 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     }
 
     bb->context_id = ctx.cpu_index;
+    bb->users[ctx.cpu_index] = 1;
 
     translate_timer.stop();
+    bb->translate_cycles = rdtsc() - translate_start;
 
     bb->release();
 
@@ -2547,35 +2934,31 @@ ostream& BasicBlockCache::print(ostream& os) {
         os << endl;
     }
 
-    bblist.clear_and_free();
+    // Blocks live in the arena, only drop the pointers
+    bblist.clear();
     return os;
 }
 
 void bbcache_reclaim(size_t bytes, int urgency) {
-    foreach(i, NUM_SIM_CORES) {
-        bbcache[i].reclaim(bytes, urgency);
-    }
+    bbcache.reclaim(bytes, urgency);
 }
 
 void init_decode() {
 }
 
 void shutdown_decode() {
-    foreach(i, NUM_SIM_CORES) {
-        bbcache[i].flush(0);
-    }
+    bbcache.flush(-1);
+    uopcache.close();
     if (bbcache_dump_file) bbcache_dump_file.close();
 }
 
 void dump_bbcache_to_logfile() {
-    foreach(i, NUM_SIM_CORES) {
-        BasicBlockCache::Iterator iter(&bbcache[i]);
-        BasicBlock* bb;
-        while ((bb = iter.next())) {
-            ptl_logfile << "BasicBlock: ", *bb, endl;
-        }
-        ptl_logfile << flush;
+    BasicBlockCache::Iterator iter(&bbcache);
+    BasicBlock* bb;
+    while ((bb = iter.next())) {
+        ptl_logfile << "BasicBlock: ", *bb, endl;
     }
+    ptl_logfile << flush;
 }
 
 /* Decoder Stats */
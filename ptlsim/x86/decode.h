@@ -597,7 +597,15 @@ namespace superstl {
       return slot;
     }
 
-    static inline bool equal(const RIPVirtPhys& a, const RIPVirtPhys& b) { return (a == b); }
+    //
+    // The basic block cache is shared by all contexts, so a block can only
+    // be reused if it was translated from the same physical code in the
+    // same mode, not just from the same virtual rip.
+    //
+    static inline bool equal(const RIPVirtPhys& a, const RIPVirtPhys& b) {
+      return ((a.rip == b.rip) & (a.mfnlo == b.mfnlo) & (a.mfnhi == b.mfnhi) &
+              (a.use64 == b.use64) & (a.kernel == b.kernel) & (a.df == b.df));
+    }
     static inline RIPVirtPhys dup(const RIPVirtPhys& key) { return key; }
     static inline void free(RIPVirtPhys& key) { }
   };
@@ -627,28 +635,123 @@ enum {
   INVALIDATE_REASON_COUNT
 };
 
-struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager> {
-  BasicBlockCache(): SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager>() {
-      cpuid = cpuid_counter++;
+//
+// Bump allocator for the blocks of the basic block cache. Blocks are
+// packed back to back in fixed size chunks in translation order, so the
+// blocks fetched together share host cache lines. Space of a freed block
+// is only reused once its whole chunk is empty; the cache moves blocks
+// out of sparse chunks when it is reclaimed.
+//
+// Chunks are aligned to their size so the chunk of a block is found from
+// its address. BasicBlockPtr only keeps the low 32 bits of a block
+// address, so chunks are carved from regions mapped below 4GB rather than
+// malloc'ed: worker threads of a parallel simulation get their malloc
+// memory from arenas mapped anywhere. Empty chunks go back to the kernel
+// with madvise but keep their address for the next chunk.
+//
+static const int BB_ARENA_CHUNK_SIZE = 32768;
+static const int BB_ARENA_REGION_SIZE = 4 << 20;
+
+struct BasicBlockArena {
+  struct Chunk {
+    Chunk* next;
+    // Bump pointer, bytes handed out from this chunk
+    W32 used;
+    // Bytes of blocks not freed yet
+    W32 live;
+
+    byte* data() { return (byte*)(this + 1); }
+  };
+
+  // Current chunk is always first
+  Chunk* chunks;
+  int chunk_count;
+  W64 live_bytes;
+
+  // Chunks not handed out yet in the last region, and released ones
+  byte* region_next;
+  byte* region_end;
+  Chunk* free_chunks;
+  dynarray<byte*> regions;
+
+  BasicBlockArena() {
+    chunks = NULL; chunk_count = 0; live_bytes = 0;
+    region_next = NULL; region_end = NULL; free_chunks = NULL;
   }
+  ~BasicBlockArena() { reset(); }
 
+  void* alloc(size_t bytes);
+  void free(void* p, size_t bytes);
+  void reset();
+  Chunk* alloc_chunk();
+  void free_chunk(Chunk* chunk);
+
+  static Chunk* chunk_of(const void* p) {
+    return (Chunk*)floor((Waddr)p, BB_ARENA_CHUNK_SIZE);
+  }
+
+  // Less than half of the chunk is still in use
+  bool sparse(const void* p) const {
+    const Chunk* chunk = chunk_of(p);
+    return ((chunk != chunks) & ((chunk->live * 2) < chunk->used));
+  }
+
+  W64 reserved_bytes() const { return W64(chunk_count) * BB_ARENA_CHUNK_SIZE; }
+};
+
+//
+// Machine wide basic block cache, shared by all contexts. Blocks are
+// reference counted (BasicBlock::acquire/release) by every fetch unit
+// that holds them and can only be freed once nobody does.
+//
+// When a code page is invalidated (self modifying code), blocks another
+// context still holds are retired: they can't be looked up or chained
+// anymore, but their memory is only freed once the last fetch unit
+// releases them.
+//
+// Fetch units chain each block to the blocks found at its taken and
+// not-taken targets, so following direct control flow doesn't need a
+// hashtable lookup. Links don't hold a reference: every block that is
+// invalidated or moved bumps the cache generation, which unlinks all
+// chained blocks at once.
+//
+struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager> {
+  BasicBlockArena arena;
+  W64 generation;
+  // Invalidated blocks still held by a fetch unit
+  dynarray<BasicBlock*> retired;
+  // Held by fetch() in a parallel quantum, see parallel_lock()
+  W32 fetch_lock;
+
+  BasicBlockCache(): SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager>() { generation = 1; fetch_lock = 0; }
+
+  BasicBlock* alloc(int count) { return (BasicBlock*)arena.alloc(BasicBlock::size_of(count)); }
+  BasicBlock* lookup(Context& ctx, const RIPVirtPhys& rvp);
+  BasicBlock* lookup_chained(Context& ctx, BasicBlock* prev, const RIPVirtPhys& rvp);
+  void chain(BasicBlock* prev, BasicBlock* bb);
+  BasicBlock* fetch(Context& ctx, BasicBlock* prev, const RIPVirtPhys& rvp);
+  void unchain_all() { generation++; }
   BasicBlock* translate(Context& ctx, const RIPVirtPhys& rvp);
   void translate_in_place(BasicBlock& targetbb, Context& ctx, Waddr rip);
   BasicBlock* translate_and_clone(Context& ctx, Waddr rip);
   bool invalidate(const RIPVirtPhys& rvp, int reason);
   bool invalidate(BasicBlock* bb, int reason);
-  bool invalidate_page(Waddr mfn, int reason);
+  void unlink(BasicBlock* bb);
+  void retire(BasicBlock* bb, int reason);
+  int free_retired();
+  bool invalidate_page(Waddr mfn, int reason, int cpuid);
   int get_page_bb_count(Waddr mfn);
   void add_page(BasicBlock* bb);
   int reclaim(size_t reqbytes = 0, int urgency = 0);
+  BasicBlock* move(BasicBlock* bb);
+  int compact();
+  void update_arena_stats(int cpuid);
   void flush(int8_t context_id);
-  W8 cpuid;
-  static W8 cpuid_counter;
 
   ostream& print(ostream& os);
 };
 
-extern BasicBlockCache bbcache[NUM_SIM_CORES];
+extern BasicBlockCache bbcache;
 
 extern ofstream bbcache_dump_file;
 
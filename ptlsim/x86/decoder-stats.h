@@ -65,6 +65,64 @@ struct DecoderStats : public Statable
     cache bbcache;
     cache pagecache;
 
+    /* Use of the machine wide basic block cache by this context */
+    struct shared_bbcache : public Statable
+    {
+        StatObj<W64> lookups;
+        StatObj<W64> hits;
+        StatObj<W64> chained;
+        StatObj<W64> shared_hits;
+        StatObj<W64> bytes_saved;
+        StatObj<W64> translate_cycles_saved;
+        StatEquation<W64, double, StatObjFormulaDiv> hit_rate;
+
+        shared_bbcache(Statable *parent)
+            : Statable("shared_bbcache", parent)
+              , lookups("lookups", this)
+              , hits("hits", this)
+              , chained("chained", this)
+              , shared_hits("shared_hits", this)
+              , bytes_saved("bytes_saved", this)
+              , translate_cycles_saved("translate_cycles_saved", this)
+              , hit_rate("hit_rate", this)
+        {
+            hit_rate.add_elem(&hits);
+            hit_rate.add_elem(&lookups);
+        }
+    } shared_bbcache;
+
+    /* Persistent translated uop cache (-uop-cache) */
+    struct uop_cache : public Statable
+    {
+        StatObj<W64> hits;
+        StatObj<W64> misses;
+        StatObj<W64> stores;
+
+        uop_cache(Statable *parent)
+            : Statable("uop_cache", parent)
+              , hits("hits", this)
+              , misses("misses", this)
+              , stores("stores", this)
+        { }
+    } uop_cache;
+
+    /* Memory of the basic block cache arena */
+    struct bbcache_arena : public Statable
+    {
+        StatObj<W64> reserved_bytes;
+        StatObj<W64> live_bytes;
+        StatObj<W64> chunks;
+        StatObj<W64> moved_blocks;
+
+        bbcache_arena(Statable *parent)
+            : Statable("bbcache_arena", parent)
+              , reserved_bytes("reserved_bytes", this)
+              , live_bytes("live_bytes", this)
+              , chunks("chunks", this)
+              , moved_blocks("moved_blocks", this)
+        { }
+    } bbcache_arena;
+
     StatObj<W64> reclaim_rounds;
 
     DecoderStats(Statable *parent)
@@ -75,6 +133,9 @@ struct DecoderStats : public Statable
           , page_crossings(this)
           , bbcache("bbcache", this)
           , pagecache("pagecache", this)
+          , shared_bbcache(this)
+          , uop_cache(this)
+          , bbcache_arena(this)
           , reclaim_rounds("reclaim_rounds", this)
     { }
 };
@@ -6,6 +6,7 @@
 //
 
 #include <ptlsim.h>
+#include <ptl-qemu.h>
 
 Context* ptl_contexts[MAX_CONTEXTS];
 
@@ -296,12 +297,17 @@ const char* sizeshift_names[4] = {
 bool Context::check_events() const {
 	if(exit_request)
 		return true;
+	/* Only recorded interrupts are delivered on replay */
+	if unlikely (ptl_event_replay)
+		return (insns_committed >= event_replay_insn);
 	if(eflags & IF_MASK)
 		return (interrupt_request > 0);
 	return false;
 }
 
 bool Context::is_int_pending() const {
+    if unlikely (ptl_event_replay)
+        return (insns_committed >= event_replay_insn);
     if(eflags & IF_MASK)
         return (interrupt_request > 0);
     return false;
@@ -493,22 +499,29 @@ void BasicBlock::reset(const RIPVirtPhys& rip) {
 //
 // Once you call this, the basic block is *gone* and
 // cannot be accessed ever again, even if it is still
-// in scope. Don't call this with non-cloned() blocks.
+// in scope. Don't call this with non-cloned() blocks,
+// blocks of the basic block cache live in its arena.
 //
 void BasicBlock::free() {
-  if (synthops) delete[] synthops;
-  synthops = NULL;
   ::free(this);
 }
 
 BasicBlock* BasicBlock::clone() {
-  BasicBlock* bb = (BasicBlock*)malloc(sizeof(BasicBlockBase) + (count * sizeof(TransOp)));
+  return clone_to(malloc(size_of(count)));
+}
+
+//
+// Copy this block into <mem>, which must hold size_of(count) bytes.
+//
+BasicBlock* BasicBlock::clone_to(void* mem) {
+  BasicBlock* bb = (BasicBlock*)mem;
 
   memcpy(bb, this, sizeof(BasicBlockBase));
 
   bb->synthops = NULL;
   // hashlink, mfnlo_loc, mfnhi_loc are always updated after cloning
   bb->hashlink.reset();
+  bb->unchain();
   bb->use(0);
 
   foreach (i, count) bb->transops[i] = this->transops[i];
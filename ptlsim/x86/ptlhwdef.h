@@ -194,7 +194,45 @@ using std::map;
 //
 
 #include <globals.h>
-extern "C" W64 sim_cycle;
+extern "C" __thread W64 sim_cycle;
+
+//
+// When cores are clocked on several threads (-parallel-threads), QEMU
+// state, Contexts of other cores and shared simulator structures may only
+// be changed in an exclusive section. Code that does so calls
+// parallel_serialize() first; it does nothing unless the calling thread
+// is clocking a core in a parallel quantum. Sections run in the order of
+// the serial loop (cycle, then core) while every other core is between
+// two cycles or stopped in parallel_serialize() itself, halfway in its
+// cycle. So no parallel_lock() or unacquired pointer into a shared
+// structure may be held across parallel_serialize().
+//
+// parallel_lock() guards short updates of shared state that cores make
+// without an exclusive section, like basic block cache hits. Sections
+// never run while a lock is held, so they don't take it themselves.
+//
+extern __thread bool parallel_unserialized;
+extern __thread int parallel_locks_held;
+void parallel_enter_exclusive();
+
+static inline void parallel_serialize() {
+  if unlikely (parallel_unserialized) parallel_enter_exclusive();
+}
+
+static inline bool parallel_lock(W32& lock) {
+  if likely (!parallel_unserialized) return false;
+  while (xchg(lock, W32(1))) cpu_pause();
+  parallel_locks_held++;
+  return true;
+}
+
+static inline void parallel_unlock(W32& lock, bool locked) {
+  if likely (!locked) return;
+  parallel_locks_held--;
+  barrier();
+  *(volatile W32*)&lock = 0;
+}
+
 #include <logic.h>
 #include <config.h>
 
@@ -814,6 +852,8 @@ struct Context: public CPUX86State {
   W64 insns_at_last_mode_switch;
   W64 user_instructions_commited;
   W64 kernel_instructions_commited;
+  W64 insns_committed; // x86 instructions committed since event trace start
+  W64 event_replay_insn; // insns_committed of next replayed event
   W64 exception;
   W64 reg_trace;
   W64 reg_selfrip;
@@ -845,6 +885,7 @@ struct Context: public CPUX86State {
   }
 
   void setup_qemu_switch() {
+	  parallel_serialize();
 	  old_eip = eip;
 	  set_eip_qemu();
 	  set_cpu_env((CPUX86State*)this);
@@ -861,7 +902,7 @@ struct Context: public CPUX86State {
   }
 
   void setup_ptlsim_switch() {
-
+	  parallel_serialize();
 	  set_cpu_env((CPUX86State*)this);
 	  // W64 flags = compute_eflags();
 
@@ -893,6 +934,8 @@ struct Context: public CPUX86State {
 
   bool is_mmio_addr(Waddr virtaddr, bool store);
 
+  byte* get_ram_host_addr(Waddr virtaddr, int sizeshift, bool store);
+
   bool has_page_fault(Waddr virtaddr, int store);
 
   void handle_page_fault(Waddr virtaddr, int is_write) ;
@@ -987,7 +1030,8 @@ struct Context: public CPUX86State {
 
   void init();
 
-  Context() : invalid_reg(-1), reg_zero(0), reg_ctx((Waddr)this) { }
+  Context() : insns_committed(0), event_replay_insn(-1), invalid_reg(-1),
+    reg_zero(0), reg_ctx((Waddr)this) { }
 
   W64 virt_to_pte_phys_addr(Waddr virtaddr, byte& level);
 
@@ -1706,24 +1750,54 @@ struct BasicBlockBase {
   W64 lastused;
   W64 lasttarget;
   W16 context_id;
-
+  // Host cycles spent to translate this block
+  W64 translate_cycles;
+  // Contexts that have fetched this block from the shared cache
+  bitvec<NUM_SIM_CORES> users;
+  // Direct successors at rip_taken and rip_not_taken, only valid while
+  // chain_gen matches the basic block cache generation (see decode.h)
+  BasicBlock* chain[2];
+  W64 chain_gen[2];
+
+  // Fetch units of other cores may hold the block in a parallel quantum
   void acquire() {
-    refcount++;
+    if unlikely (parallel_unserialized) xadd(refcount, 1);
+    else refcount++;
   }
 
   bool release() {
-    refcount--;
-    assert(refcount >= 0);
-    return (!refcount);
+    int old;
+    if unlikely (parallel_unserialized) old = xadd(refcount, -1);
+    else old = refcount--;
+    assert(old > 0);
+    return (old == 1);
+  }
+
+  void unchain() {
+    chain[0] = chain[1] = NULL;
+    chain_gen[0] = chain_gen[1] = 0;
   }
 };
 
+//
+// Only the decoder's working block has room for MAX_BB_UOPS*2 uops. Copies
+// made by clone() and blocks in the basic block cache are a header with
+// exactly 'count' uops, followed by room for their synthops.
+//
 struct BasicBlock: public BasicBlockBase {
   TransOp transops[MAX_BB_UOPS*2];
 
+  // Bytes of a compact copy of a block with <count> uops
+  static size_t size_of(int count) {
+    return sizeof(BasicBlockBase) + (count * (sizeof(TransOp) + sizeof(uopimpl_func_t)));
+  }
+
+  uopimpl_func_t* synthop_space() { return (uopimpl_func_t*)&transops[count]; }
+
   void reset();
   void reset(const RIPVirtPhys& rip);
   BasicBlock* clone();
+  BasicBlock* clone_to(void* mem);
   void free();
   void use(W64 counter) { lastused = counter; };
 };
@@ -0,0 +1,305 @@
+//
+// MARSSx86 : A Full System Computer-Architecture Simulator
+//
+// Persistent translated uop cache
+//
+// This code is released under GPL.
+//
+
+#include <globals.h>
+#include <ptlsim.h>
+#include <decode.h>
+#include <uopcache.h>
+#include <syscalls.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+UopCache uopcache;
+
+static const char uop_cache_magic[8] = {'M', 'A', 'R', 'S', 'S', 'U', 'O', 'P'};
+
+//
+// Bump this whenever the decoder output changes without changing any of
+// the structure sizes below.
+//
+static const W32 UOP_CACHE_DECODER_REVISION = 1;
+
+//
+// Fingerprint of the decoder build that wrote a cache file. Any change in
+// uop or basic block layout, opcode or assist numbering, or build commit
+// makes old files unusable.
+//
+W32 uop_cache_decoder_version() {
+  CRC32 crc;
+  crc << UOP_CACHE_DECODER_REVISION, W32(sizeof(TransOp)),
+      W32(sizeof(BasicBlockBase)), W32(MAX_BB_UOPS),
+      W32(OP_MAX_OPCODE), W32(ASSIST_COUNT);
+
+  const char* commit = stringify(GITCOMMIT);
+  crc.update((byte*)commit, strlen(commit));
+
+  return crc;
+}
+
+// Qemu hflags bits that do not change translation
+static inline W32 decode_mode_of(Context& ctx) {
+  return W32(ctx.hflags & ~HF_INHIBIT_IRQ_MASK);
+}
+
+static inline int bucket_of(const RIPVirtPhysBase& rip, W32 bucket_count) {
+  W64 key = rip.rip ^ (W64(rip.mfnlo) << 12);
+  return int((key * 0x9e3779b97f4a7c15ULL) >> 32) & (bucket_count - 1);
+}
+
+static inline bool same_block(const RIPVirtPhysBase& a, const RIPVirtPhysBase& b) {
+  return ((a.rip == b.rip) & (a.mfnlo == b.mfnlo) & (a.mfnhi == b.mfnhi) &
+          (a.use64 == b.use64) & (a.kernel == b.kernel) & (a.df == b.df));
+}
+
+UopCache::UopCache() {
+  map_tried = 0;
+  map = NULL;
+  map_size = 0;
+  header = NULL;
+  buckets = NULL;
+}
+
+void UopCache::set_filename(const char* filename) {
+  if (this->filename.set() && strequal(this->filename, filename)) return;
+
+  close();
+  this->filename = filename;
+  map_tried = 0;
+}
+
+void UopCache::map_file() {
+  map_tried = 1;
+
+  int fd = sys_open(filename, O_RDONLY, 0);
+  if (fd < 0) {
+    ptl_logfile << "Uop cache: ", filename, " not found, starting empty cache", endl;
+    return;
+  }
+
+  W64 size = sys_seek(fd, 0, SEEK_END);
+  if (size < sizeof(UopCacheHeader)) {
+    ptl_logfile << "Uop cache: ", filename, " is too small, ignoring it", endl;
+    sys_close(fd);
+    return;
+  }
+
+  void* p = sys_mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  sys_close(fd);
+
+  if (p == MAP_FAILED) {
+    ptl_logfile << "Uop cache: cannot map ", filename, ", ignoring it", endl;
+    return;
+  }
+
+  map = (byte*)p;
+  map_size = size;
+  header = (const UopCacheHeader*)map;
+
+  bool valid = (memcmp(header->magic, uop_cache_magic, sizeof(uop_cache_magic)) == 0) &&
+    (header->format == UOP_CACHE_FORMAT) &&
+    (header->file_size == map_size) &&
+    (header->bucket_count > 0) &&
+    ((header->bucket_count & (header->bucket_count - 1)) == 0) &&
+    (sizeof(UopCacheHeader) + header->bucket_count * sizeof(W64) <= map_size);
+
+  if (!valid) {
+    ptl_logfile << "Uop cache: ", filename, " has unknown format, ignoring it", endl;
+    unmap_file();
+    return;
+  }
+
+  if (header->decoder != uop_cache_decoder_version()) {
+    ptl_logfile << "Uop cache: ", filename, " was written by another decoder version, ignoring it", endl;
+    unmap_file();
+    return;
+  }
+
+  buckets = (const W64*)(header + 1);
+
+  ptl_logfile << "Uop cache: mapped ", filename, " with ", header->record_count, " basic blocks", endl;
+}
+
+void UopCache::unmap_file() {
+  if (map) sys_munmap(map, map_size);
+  map = NULL;
+  map_size = 0;
+  header = NULL;
+  buckets = NULL;
+}
+
+const UopCacheRecord* UopCache::find(const RIPVirtPhys& rvp, W32 mode, const byte* insnbuf, int valid_byte_count) const {
+  W64 offset = buckets[bucket_of(rvp, header->bucket_count)];
+
+  while (offset) {
+    if unlikely (offset + sizeof(UopCacheRecord) > map_size) break;
+
+    const UopCacheRecord* record = (const UopCacheRecord*)(map + offset);
+    if unlikely (offset + record->size() > map_size) break;
+
+    const BasicBlock* bb = record->image();
+    if (same_block(record->rip, rvp) && (record->mode == mode) &&
+        (bb->bytes <= valid_byte_count)) {
+      CRC32 crc;
+      crc.update((byte*)insnbuf, bb->bytes);
+      if (W32(crc) == record->code_crc) return record;
+    }
+
+    offset = record->next;
+  }
+
+  return NULL;
+}
+
+BasicBlock* UopCache::load(Context& ctx, const RIPVirtPhys& rvp, const byte* insnbuf, int valid_byte_count, BasicBlockArena& arena) {
+  if unlikely (!map_tried) map_file();
+  if (!map) return NULL;
+
+  int cpuid = ctx.cpu_index;
+  const UopCacheRecord* record = find(rvp, decode_mode_of(ctx), insnbuf, valid_byte_count);
+
+  if (!record) {
+    DECODERSTAT->uop_cache.misses++;
+    return NULL;
+  }
+
+  DECODERSTAT->uop_cache.hits++;
+
+  // Image has no room for synthops, so size the copy from its uop count
+  const BasicBlock* image = (const BasicBlock*)record->image();
+  BasicBlock* bb = (BasicBlock*)arena.alloc(BasicBlock::size_of(image->count));
+  memcpy((void*)bb, image, record->image_size);
+
+  // Host side state is never valid in a saved image
+  bb->hashlink.reset();
+  bb->mfnlo_loc.reset();
+  bb->mfnhi_loc.reset();
+  bb->synthops = NULL;
+  bb->refcount = 0;
+  bb->hitcount = 0;
+  bb->predcount = 0;
+  bb->users.reset();
+  bb->unchain();
+  bb->use(0);
+
+  return bb;
+}
+
+void UopCache::store(Context& ctx, const BasicBlock& bb, const byte* insnbuf) {
+  W32 image_size = sizeof(BasicBlockBase) + (bb.count * sizeof(TransOp));
+  UopCacheRecord* record = (UopCacheRecord*)malloc(ceil(sizeof(UopCacheRecord) + image_size, 8));
+
+  record->next = 0;
+  record->rip = bb.rip;
+  record->mode = decode_mode_of(ctx);
+  CRC32 crc;
+  crc.update((byte*)insnbuf, bb.bytes);
+  record->code_crc = crc;
+  record->image_size = image_size;
+  record->pad = 0;
+  memcpy((void*)record->image(), &bb, image_size);
+
+  new_records.push(record);
+
+  int cpuid = ctx.cpu_index;
+  DECODERSTAT->uop_cache.stores++;
+}
+
+void UopCache::close() {
+  if (!new_records.size()) {
+    unmap_file();
+    return;
+  }
+
+  //
+  // Collect the records of old file followed by the new ones. New records
+  // are only made when no valid old record was found, so no duplicates.
+  //
+  dynarray<const UopCacheRecord*> records;
+
+  if (map) {
+    foreach (i, header->bucket_count) {
+      W64 offset = buckets[i];
+      while (offset && (offset + sizeof(UopCacheRecord) <= map_size)) {
+        const UopCacheRecord* record = (const UopCacheRecord*)(map + offset);
+        if (offset + record->size() > map_size) break;
+        records.push(record);
+        offset = record->next;
+      }
+    }
+  }
+
+  foreach (i, new_records.size()) {
+    records.push(new_records[i]);
+  }
+
+  W32 bucket_count = 1024;
+  while (bucket_count < W32(2 * records.size())) bucket_count <<= 1;
+
+  // Lay out the records and link each bucket's chain
+  dynarray<W64> bucket_heads;
+  dynarray<W64> offsets;
+  dynarray<W64> nexts;
+  bucket_heads.resize(bucket_count, 0);
+  offsets.resize(records.size());
+  nexts.resize(records.size());
+
+  W64 offset = sizeof(UopCacheHeader) + bucket_count * sizeof(W64);
+  foreach (i, records.size()) {
+    offsets[i] = offset;
+    int bucket = bucket_of(records[i]->rip, bucket_count);
+    nexts[i] = bucket_heads[bucket];
+    bucket_heads[bucket] = offset;
+    offset += records[i]->size();
+  }
+
+  UopCacheHeader newheader;
+  setzero(newheader);
+  memcpy(newheader.magic, uop_cache_magic, sizeof(uop_cache_magic));
+  newheader.format = UOP_CACHE_FORMAT;
+  newheader.decoder = uop_cache_decoder_version();
+  newheader.bucket_count = bucket_count;
+  newheader.record_count = records.size();
+  newheader.file_size = offset;
+
+  // Write to a temporary file and rename so a crash never leaves a partial cache
+  stringbuf tmpname;
+  tmpname << filename, ".tmp";
+
+  std::ofstream os(tmpname.buf, std::ios::binary | std::ios::trunc);
+  if (!os.is_open()) {
+    ptl_logfile << "Uop cache: cannot write ", tmpname, endl;
+  } else {
+    os.write((const char*)&newheader, sizeof(newheader));
+    os.write((const char*)bucket_heads.data, bucket_count * sizeof(W64));
+
+    foreach (i, records.size()) {
+      UopCacheRecord record = *records[i];
+      record.next = nexts[i];
+      os.write((const char*)&record, sizeof(record));
+      os.write((const char*)records[i]->image(), record.size() - sizeof(record));
+    }
+
+    os.close();
+
+    if (os.fail() || sys_rename(tmpname, filename) < 0) {
+      ptl_logfile << "Uop cache: failed to save ", filename, endl;
+      sys_unlink(tmpname);
+    } else {
+      ptl_logfile << "Uop cache: saved ", records.size(), " basic blocks (", new_records.size(), " new) to ", filename, endl;
+    }
+  }
+
+  foreach (i, new_records.size()) {
+    ::free(new_records[i]);
+  }
+  new_records.clear();
+
+  unmap_file();
+  map_tried = 0;
+}
@@ -0,0 +1,105 @@
+// -*- c++ -*-
+//
+// MARSSx86 : A Full System Computer-Architecture Simulator
+//
+// Persistent translated uop cache
+//
+// This code is released under GPL.
+//
+
+#ifndef _UOPCACHE_H_
+#define _UOPCACHE_H_
+
+#include <globals.h>
+#include <ptlsim.h>
+
+//
+// On-disk cache of translated basic blocks, used to skip decoding on warm
+// restarts (e.g. when many short regions are simulated from checkpoints of
+// the same workload).
+//
+// File layout (all offsets from start of file):
+//
+//   UopCacheHeader
+//   W64 buckets[bucket_count]     offset of first record of each chain
+//   UopCacheRecord + BasicBlock image, ...
+//
+// Records are keyed by the full RIPVirtPhys of the block (virtual rip and
+// physical pages) and carry the CRC32 of the x86 bytes they were decoded
+// from and the decoder mode flags. A record is used only if the guest code
+// currently at that location and the context mode still match, otherwise
+// the block is translated as usual.
+//
+// File is memory mapped read-only on the first translation so only the
+// pages of the blocks actually looked up are read from disk. Blocks
+// translated during the run are kept in memory and merged with the old
+// file at exit. A file written by a different decoder build is ignored
+// and replaced.
+//
+
+static const int UOP_CACHE_FORMAT = 1;
+
+struct BasicBlockArena;
+
+struct UopCacheHeader {
+  char magic[8];
+  W32 format;
+  W32 decoder;
+  W32 bucket_count;
+  W32 record_count;
+  W64 file_size;
+};
+
+struct UopCacheRecord {
+  // Offset of next record in same bucket, 0 if last
+  W64 next;
+  // Key of the block
+  RIPVirtPhysBase rip;
+  // Decoder mode flags (qemu hflags) the block was translated with
+  W32 mode;
+  // CRC32 of the x86 code bytes of the block
+  W32 code_crc;
+  // Size of BasicBlock image that follows this record
+  W32 image_size;
+  W32 pad;
+
+  BasicBlock* image() { return (BasicBlock*)(this + 1); }
+  const BasicBlock* image() const { return (const BasicBlock*)(this + 1); }
+  W64 size() const { return ceil(sizeof(UopCacheRecord) + image_size, 8); }
+};
+
+struct UopCache {
+  UopCache();
+
+  // Use given file, nothing is read until the first lookup
+  void set_filename(const char* filename);
+  bool enabled() const { return filename.set(); }
+
+  // Get a validated copy of the block at rvp allocated from arena, NULL if not in cache
+  BasicBlock* load(Context& ctx, const RIPVirtPhys& rvp, const byte* insnbuf, int valid_byte_count, BasicBlockArena& arena);
+
+  // Remember a newly translated block so it's saved at exit
+  void store(Context& ctx, const BasicBlock& bb, const byte* insnbuf);
+
+  // Merge new blocks with old file and write it back
+  void close();
+
+protected:
+  stringbuf filename;
+  bool map_tried;
+  byte* map;
+  W64 map_size;
+  const UopCacheHeader* header;
+  const W64* buckets;
+  dynarray<UopCacheRecord*> new_records;
+
+  void map_file();
+  void unmap_file();
+  const UopCacheRecord* find(const RIPVirtPhys& rvp, W32 mode, const byte* insnbuf, int valid_byte_count) const;
+};
+
+extern UopCache uopcache;
+
+W32 uop_cache_decoder_version();
+
+#endif // _UOPCACHE_H_
@@ -1789,12 +1789,16 @@ uopimpl_func_t get_synthcode_for_uop(int op, int size, bool setflags, int cond,
 }
 
 void synth_uops_for_bb(BasicBlock& bb) {
-  bb.synthops = new uopimpl_func_t[bb.count];
+  // Synthops are stored right after the uops of a compact block,
+  // published once filled since other cores may fetch the block
+  uopimpl_func_t* synthops = bb.synthop_space();
   foreach (i, bb.count) {
     const TransOp& transop = bb.transops[i];
     uopimpl_func_t func = get_synthcode_for_uop(transop.opcode, transop.size, transop.setflags, transop.cond, transop.extshift, 0, transop.internal);
-    bb.synthops[i] = func;
+    synthops[i] = func;
   }
+  barrier();
+  bb.synthops = synthops;
 }
 
 uopimpl_func_t get_synthcode_for_cond_branch(int opcode, int cond, int size, bool except) {
@@ -313,6 +313,26 @@ int sim_cpu_exec(void)
 				cpu_single_env = env;
 				/* env_to_regs(); */
 				interrupt_request = (env->handle_interrupt) ? env->interrupt_request : 0;
+				if (unlikely(ptl_event_replay)) {
+					/* Deliver recorded interrupts in place of live ones */
+					int intno, nmi;
+					if (ptl_event_replay_interrupt(env, &intno, &nmi)) {
+						if (nmi) {
+							env->interrupt_request &= ~CPU_INTERRUPT_NMI;
+							env->hflags2 |= HF2_NMI_MASK;
+							do_interrupt(EXCP02_NMI, 0, 0, 0, 1);
+						} else {
+							/* Keep interrupt controller state in sync */
+							if (env->interrupt_request & CPU_INTERRUPT_HARD) {
+								env->interrupt_request &= ~(CPU_INTERRUPT_HARD | CPU_INTERRUPT_VIRQ);
+								ptl_event_replay_acked(env, intno,
+										cpu_get_pic_interrupt(env));
+							}
+							do_interrupt(intno, 0, 0, 0, 1);
+						}
+					}
+					interrupt_request = 0;
+				}
 				if (unlikely(interrupt_request)) {
 					if (unlikely(env->singlestep_enabled & SSTEP_NOIRQ)) {
 						/* Mask out external interrupts for this step. */
@@ -337,6 +357,7 @@ int sim_cpu_exec(void)
 								!(env->hflags2 & HF2_NMI_MASK)) {
 							env->interrupt_request &= ~CPU_INTERRUPT_NMI;
 							env->hflags2 |= HF2_NMI_MASK;
+							ptl_event_record_interrupt(env, EXCP02_NMI, 1);
 							do_interrupt(EXCP02_NMI, 0, 0, 0, 1);
 						} else if ((interrupt_request & CPU_INTERRUPT_HARD) &&
 								(((env->hflags2 & HF2_VINTR_MASK) &&
@@ -349,6 +370,7 @@ int sim_cpu_exec(void)
 							env->interrupt_request &= ~(CPU_INTERRUPT_HARD | CPU_INTERRUPT_VIRQ);
 							intno = cpu_get_pic_interrupt(env);
 							qemu_log_mask(CPU_LOG_TB_IN_ASM, "Servicing hardware INT=0x%02x\n", intno);
+							ptl_event_record_interrupt(env, intno, 0);
 							do_interrupt(intno, 0, 0, 0, 1);
 							/* ensure that no TB jump will be modified as
 							   the program flow was changed */
@@ -764,6 +764,26 @@ int64_t qemu_next_deadline(void)
     return delta;
 }
 
+#ifdef MARSS_QEMU
+int64_t qemu_next_sim_deadline(void)
+{
+    /* Same limit as qemu_next_deadline */
+    int64_t delta = INT32_MAX;
+
+    if (active_timers[QEMU_CLOCK_VIRTUAL]) {
+        delta = active_timers[QEMU_CLOCK_VIRTUAL]->expire_time -
+            cpu_get_sim_clock();
+        if (delta > INT32_MAX)
+            delta = INT32_MAX;
+    }
+
+    if (delta < 0)
+        delta = 0;
+
+    return delta;
+}
+#endif
+
 static int64_t qemu_next_alarm_deadline(void)
 {
     int64_t delta;
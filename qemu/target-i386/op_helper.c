@@ -614,6 +614,17 @@ void helper_simpoint(void)
      * to handle this 'simpoint'. */
     ptl_simpoint_reached(env->cpu_index);
 }
+
+void helper_warm_mem(target_ulong addr, uint32_t flags)
+{
+    ptl_warm_mem(env->cpu_index, addr, flags);
+}
+
+void helper_warm_branch(target_ulong ripafter, target_ulong target,
+        uint32_t taken)
+{
+    ptl_warm_branch(env->cpu_index, ripafter, target, taken);
+}
 #endif
 
 static inline unsigned int get_sp_mask(unsigned int e2)
@@ -496,6 +496,45 @@ static inline void gen_op_addq_A0_reg_sN(int shift, int reg)
 }
 #endif
 
+#ifdef MARSS_QEMU
+/* Set while translating for fast-forward with warming enabled */
+static int warm_gen;
+static target_ulong warm_code_line;
+
+static inline void gen_warm_mem(int idx, TCGv a0, int flags)
+{
+    TCGv_i32 t;
+
+    if (!warm_gen)
+        return;
+
+    t = tcg_const_i32((((idx >> 2) - 1) << PTL_WARM_MMU_SHIFT) | flags);
+    gen_helper_warm_mem(a0, t);
+    tcg_temp_free_i32(t);
+}
+
+static inline void gen_warm_branch(DisasContext *s, target_ulong next_eip,
+        target_ulong val, int taken)
+{
+    TCGv ripafter, target;
+    TCGv_i32 t;
+
+    if (!warm_gen)
+        return;
+
+    ripafter = tcg_const_tl(s->cs_base + next_eip);
+    target = tcg_const_tl(s->cs_base + val);
+    t = tcg_const_i32(taken);
+    gen_helper_warm_branch(ripafter, target, t);
+    tcg_temp_free_i32(t);
+    tcg_temp_free(target);
+    tcg_temp_free(ripafter);
+}
+#else
+#define gen_warm_mem(idx, a0, flags)
+#define gen_warm_branch(s, next_eip, val, taken)
+#endif
+
 static inline void gen_op_lds_T0_A0(int idx)
 {
     int mem_index = (idx >> 2) - 1;
@@ -511,6 +550,7 @@ static inline void gen_op_lds_T0_A0(int idx)
         tcg_gen_qemu_ld32s(cpu_T[0], cpu_A0, mem_index);
         break;
     }
+    gen_warm_mem(idx, cpu_A0, 0);
 }
 
 static inline void gen_op_ld_v(int idx, TCGv t0, TCGv a0)
@@ -534,6 +574,7 @@ static inline void gen_op_ld_v(int idx, TCGv t0, TCGv a0)
 #endif
         break;
     }
+    gen_warm_mem(idx, a0, 0);
 }
 
 /* XXX: always use ldu or lds */
@@ -573,6 +614,7 @@ static inline void gen_op_st_v(int idx, TCGv t0, TCGv a0)
 #endif
         break;
     }
+    gen_warm_mem(idx, a0, PTL_WARM_STORE);
 }
 
 static inline void gen_op_st_T0_A0(int idx)
@@ -2296,10 +2338,12 @@ static inline void gen_jcc(DisasContext *s, int b,
     if (s->jmp_opt) {
         l1 = gen_new_label();
         gen_jcc1(s, cc_op, b, l1);
-        
+
+        gen_warm_branch(s, next_eip, val, 0);
         gen_goto_tb(s, 0, next_eip);
 
         gen_set_label(l1);
+        gen_warm_branch(s, next_eip, val, 1);
         gen_goto_tb(s, 1, val);
         s->is_jmp = DISAS_TB_JUMP;
     } else {
@@ -2308,10 +2352,12 @@ static inline void gen_jcc(DisasContext *s, int b,
         l2 = gen_new_label();
         gen_jcc1(s, cc_op, b, l1);
 
+        gen_warm_branch(s, next_eip, val, 0);
         gen_jmp_im(next_eip);
         tcg_gen_br(l2);
 
         gen_set_label(l1);
+        gen_warm_branch(s, next_eip, val, 1);
         gen_jmp_im(val);
         gen_set_label(l2);
         gen_eob(s);
@@ -2722,6 +2768,7 @@ static inline void gen_ldq_env_A0(int idx, int offset)
     int mem_index = (idx >> 2) - 1;
     tcg_gen_qemu_ld64(cpu_tmp1_i64, cpu_A0, mem_index);
     tcg_gen_st_i64(cpu_tmp1_i64, cpu_env, offset);
+    gen_warm_mem(idx, cpu_A0, 0);
 }
 
 static inline void gen_stq_env_A0(int idx, int offset)
@@ -2729,6 +2776,7 @@ static inline void gen_stq_env_A0(int idx, int offset)
     int mem_index = (idx >> 2) - 1;
     tcg_gen_ld_i64(cpu_tmp1_i64, cpu_env, offset);
     tcg_gen_qemu_st64(cpu_tmp1_i64, cpu_A0, mem_index);
+    gen_warm_mem(idx, cpu_A0, PTL_WARM_STORE);
 }
 
 static inline void gen_ldo_env_A0(int idx, int offset)
@@ -2739,6 +2787,7 @@ static inline void gen_ldo_env_A0(int idx, int offset)
     tcg_gen_addi_tl(cpu_tmp0, cpu_A0, 8);
     tcg_gen_qemu_ld64(cpu_tmp1_i64, cpu_tmp0, mem_index);
     tcg_gen_st_i64(cpu_tmp1_i64, cpu_env, offset + offsetof(XMMReg, XMM_Q(1)));
+    gen_warm_mem(idx, cpu_A0, 0);
 }
 
 static inline void gen_sto_env_A0(int idx, int offset)
@@ -2749,6 +2798,7 @@ static inline void gen_sto_env_A0(int idx, int offset)
     tcg_gen_addi_tl(cpu_tmp0, cpu_A0, 8);
     tcg_gen_ld_i64(cpu_tmp1_i64, cpu_env, offset + offsetof(XMMReg, XMM_Q(1)));
     tcg_gen_qemu_st64(cpu_tmp1_i64, cpu_tmp0, mem_index);
+    gen_warm_mem(idx, cpu_A0, PTL_WARM_STORE);
 }
 
 static inline void gen_op_movo(int d_offset, int s_offset)
@@ -7848,6 +7898,11 @@ static inline void gen_intermediate_code_internal(CPUState *env,
     gen_icount_start();
 #ifdef MARSS_QEMU
     gen_simpoint_check_start(env, dc);
+
+    /* Only feed the simulator while counting fast-forward instructions */
+    warm_gen = ptl_fast_fwd_warming && ptl_fast_fwd_enabled &&
+        env->simpoint_decr;
+    warm_code_line = -1;
 #endif
     for(;;) {
         if (unlikely(!QTAILQ_EMPTY(&env->breakpoints))) {
@@ -7874,6 +7929,15 @@ static inline void gen_intermediate_code_internal(CPUState *env,
         if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
             gen_io_start();
 
+#ifdef MARSS_QEMU
+        /* Instruction fetch, once per cache line of the block */
+        if (warm_gen && (pc_ptr >> PTL_WARM_LINE_BITS) != warm_code_line) {
+            TCGv t = tcg_const_tl(pc_ptr);
+            warm_code_line = pc_ptr >> PTL_WARM_LINE_BITS;
+            gen_warm_mem(dc->mem_index, t, PTL_WARM_CODE);
+            tcg_temp_free(t);
+        }
+#endif
         pc_ptr = disas_insn(dc, pc_ptr);
         num_insns++;
         /* stop translation if indicated */
@@ -0,0 +1,149 @@
+#!/usr/bin/env python
+
+# memtrace.py
+#
+# Print or summarize memory access traces recorded with '-mem-trace'. See
+# ptlsim/cache/memTrace.h for the file format. Please run --help to list all
+# the options.
+#
+# This script is provided under LGPL licence.
+#
+
+import sys
+import struct
+import zlib
+
+from optparse import OptionParser
+
+FILE_HDR = struct.Struct("<8sIIQ")
+BLOCK_HDR = struct.Struct("<IIII")
+
+OP_MASK, ICACHE, KERNEL, NEW_ID = 0x03, 0x04, 0x08, 0x10
+OP_NAMES = ["read", "write", "update", "evict"]
+
+def error(msg):
+    print("[ERROR] : %s" % msg)
+    sys.exit(-1)
+
+def get_varint(block, pos):
+    value, shift = 0, 0
+    while True:
+        b = ord(block[pos:pos + 1])
+        pos += 1
+        value |= (b & 0x7f) << shift
+        if not b & 0x80:
+            return value, pos
+        shift += 7
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+def read_trace(filename):
+    """Yield (cycle, core, thread, op, icache, kernel, physaddr, rip) for
+    each record in the trace."""
+    with open(filename, 'rb') as f:
+        data = f.read()
+
+    (magic, fmt, flags, freq) = FILE_HDR.unpack_from(data, 0)
+    if magic != b"MARSSMTR":
+        error("%s is not a memory trace file" % filename)
+    if fmt != 1:
+        error("Unsupported memory trace format %d in %s" % (fmt, filename))
+
+    mask = (1 << 64) - 1
+    pos = FILE_HDR.size
+    while pos + BLOCK_HDR.size <= len(data):
+        (nrecs, raw_size, stored_size, pad) = BLOCK_HDR.unpack_from(data, pos)
+        pos += BLOCK_HDR.size
+        block = data[pos:pos + stored_size]
+        pos += stored_size
+        if stored_size != raw_size:
+            block = zlib.decompress(block)
+
+        # Previous record state is reset at each block
+        cycle, addr, rip, core, thread = 0, 0, 0, 0, 0
+        bpos = 0
+        for r in range(nrecs):
+            fl = ord(block[bpos:bpos + 1])
+            bpos += 1
+            if fl & NEW_ID:
+                core = ord(block[bpos:bpos + 1])
+                thread = ord(block[bpos + 1:bpos + 2])
+                bpos += 2
+            delta, bpos = get_varint(block, bpos)
+            cycle += delta
+            delta, bpos = get_varint(block, bpos)
+            addr = (addr + unzigzag(delta)) & mask
+            delta, bpos = get_varint(block, bpos)
+            rip = (rip + unzigzag(delta)) & mask
+
+            yield (cycle, core, thread, fl & OP_MASK, bool(fl & ICACHE),
+                    bool(fl & KERNEL), addr, rip)
+
+def print_csv(filename, options):
+    print("cycle,core,thread,op,icache,kernel,physaddr,rip")
+    count = 0
+    for (cycle, core, thread, op, icache, kernel, addr, rip) in \
+            read_trace(filename):
+        if options.count and count >= options.count:
+            break
+        print("%d,%d,%d,%s,%d,%d,0x%x,0x%x" % (cycle, core, thread,
+            OP_NAMES[op], icache, kernel, addr, rip))
+        count += 1
+
+def print_summary(filename, options):
+    total, first, last = 0, None, 0
+    ops = {}
+    cores = {}
+    kernel_count, icache_count = 0, 0
+    lines = set()
+
+    for (cycle, core, thread, op, icache, kernel, addr, rip) in \
+            read_trace(filename):
+        if first is None:
+            first = cycle
+        last = cycle
+        total += 1
+        ops[op] = ops.get(op, 0) + 1
+        key = (core, thread)
+        cores[key] = cores.get(key, 0) + 1
+        kernel_count += kernel
+        icache_count += icache
+        if options.lines:
+            lines.add(addr >> 6)
+
+    print("%s:" % filename)
+    print("  records: %d" % total)
+    if total == 0:
+        return
+    print("  cycles: %d - %d" % (first, last))
+    for op in sorted(ops.keys()):
+        print("  %s: %d" % (OP_NAMES[op], ops[op]))
+    print("  icache: %d" % icache_count)
+    print("  kernel: %d (%.2f%%)" % (kernel_count,
+        100.0 * kernel_count / total))
+    for (core, thread) in sorted(cores.keys()):
+        print("  core %d thread %d: %d" % (core, thread,
+            cores[(core, thread)]))
+    if options.lines:
+        print("  unique 64B lines: %d" % len(lines))
+
+if __name__ == "__main__":
+    opt = OptionParser("Usage: %prog [options] trace_file...")
+    opt.add_option("-p", "--print", action="store_true", default=False,
+            dest="csv", help="Print all records as CSV")
+    opt.add_option("-n", "--count", type="int", default=0, dest="count",
+            help="Print at most this many records")
+    opt.add_option("-l", "--lines", action="store_true", default=False,
+            dest="lines", help="Count unique cache lines in summary")
+
+    (options, args) = opt.parse_args()
+    if not args:
+        opt.print_help()
+        sys.exit(-1)
+
+    for filename in args:
+        if options.csv:
+            print_csv(filename, options)
+        else:
+            print_summary(filename, options)
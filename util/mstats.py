@@ -14,6 +14,8 @@ import os
 import sys
 import re
 import operator
+import struct
+import zlib
 
 from optparse import OptionParser,OptionGroup
 
@@ -241,6 +243,132 @@ class TimeGraphGen(Writers):
         elif options.sg:
             options.sg.draw(options.time_graph, "sim_cycle", options.time_col)
 
+class TimeStatsBinReader(Readers):
+    """
+    Read binary time stats files written with 'time-stats-format' set to
+    'binary' or 'binary-z'. Each file becomes one document with a list of
+    per period values for 'sim_cycle', 'time_ns' and each stats column.
+    """
+
+    FILE_HDR = struct.Struct("<8sIIQQII")
+    COL_HDR = struct.Struct("<BBBBHH")
+    BLOCK_HDR = struct.Struct("<IIII")
+
+    UINT, SINT, FLOAT, FORMULA = range(4)
+    FORMULA_ADD, FORMULA_DIV = 1, 2
+
+    def set_options(self, parser):
+        parser.add_option("--time-stats-bin", action="store_true",
+                default=False, dest="time_stats_bin",
+                help="Treat arguments as binary time stats files")
+
+    def decode(self, col, val):
+        if col['type'] == self.FLOAT:
+            return struct.unpack("<d", struct.pack("<Q", val))[0]
+        if col['type'] == self.SINT and val >= (1 << 63):
+            return val - (1 << 64)
+        return val
+
+    def compute(self, col, row):
+        elems = [row[e] for e in col['elems']]
+        if col['formula'] == self.FORMULA_ADD:
+            return sum(elems)
+        if col['formula'] == self.FORMULA_DIV:
+            if len(elems) != 2 or elems[1] == 0:
+                return 0.0
+            return float(elems[0]) / float(elems[1])
+        error("Unknown formula %d in time stats" % col['formula'])
+
+    def load(self, filename):
+        with open(filename, 'rb') as f:
+            data = f.read()
+
+        (magic, fmt, flags, freq, period, ncols, row_size) = \
+                self.FILE_HDR.unpack_from(data, 0)
+        if magic != b"MARSSTSB":
+            error("%s is not a binary time stats file" % filename)
+        if fmt != 1:
+            error("Unsupported time stats format %d in %s" % (fmt, filename))
+
+        pos = self.FILE_HDR.size
+        cols = []
+        for i in range(ncols):
+            (ctype, size, formula, hidden, name_len, elem_count) = \
+                    self.COL_HDR.unpack_from(data, pos)
+            pos += self.COL_HDR.size
+            name = str(data[pos:pos + name_len].decode())
+            pos += name_len
+            elems = list(struct.unpack_from("<%dI" % elem_count, data, pos))
+            pos += 4 * elem_count
+            cols.append({'name': name, 'type': ctype, 'formula': formula,
+                'hidden': hidden, 'elems': elems})
+
+        stored = [i for i in range(ncols) if cols[i]['type'] != self.FORMULA]
+        row_fmt = struct.Struct("<%dQ" % (1 + len(stored)))
+        assert(row_fmt.size == row_size)
+
+        names = ['sim_cycle', 'time_ns'] + \
+                [c['name'] for c in cols if not c['hidden']]
+        series = dict([(n, []) for n in names])
+
+        cycle = 0
+        while pos < len(data):
+            (nrows, raw_size, stored_size, pad) = \
+                    self.BLOCK_HDR.unpack_from(data, pos)
+            pos += self.BLOCK_HDR.size
+            block = data[pos:pos + stored_size]
+            pos += stored_size
+            if stored_size != raw_size:
+                block = zlib.decompress(block)
+
+            for r in range(nrows):
+                vals = row_fmt.unpack_from(block, r * row_size)
+                cycle += vals[0]
+
+                row = [None] * ncols
+                for i, c in enumerate(stored):
+                    row[c] = self.decode(cols[c], vals[1 + i])
+                for i in range(ncols):
+                    if cols[i]['type'] == self.FORMULA:
+                        row[i] = self.compute(cols[i], row)
+
+                series['sim_cycle'].append(cycle)
+                series['time_ns'].append((1e9 / freq) * cycle if freq else 0)
+                for i in range(ncols):
+                    if not cols[i]['hidden']:
+                        series[cols[i]['name']].append(row[i])
+
+        return { '_file' : filename,
+                '_name' : os.path.splitext(filename)[0],
+                '_columns' : names,
+                'time_stats' : series }
+
+    def read(self, options, args):
+        if options.time_stats_bin == True:
+            return [self.load(f) for f in args]
+
+class TimeStatsCSVWriter(Writers):
+    """
+    Print time stats read with '--time-stats-bin' in CSV format, same as
+    the text time stats file.
+    """
+
+    def set_options(self, parser):
+        parser.add_option("--time-csv", action="store_true", default=False,
+                dest="time_csv",
+                help="Print time stats in CSV format")
+
+    def write(self, stats, options):
+        if options.time_csv == True:
+            for stat in stats:
+                if '_columns' not in stat:
+                    continue
+                cols = stat['_columns']
+                series = stat['time_stats']
+                print(",".join(cols))
+                for i in range(len(series['sim_cycle'])):
+                    print(",".join([str(series[c][i]) for c in cols]))
+
 class TagFilter(Filters):
     """
     Filter the stats based on tags.
@@ -611,6 +739,63 @@ class HistogramWriter(Writers):
             for stat in stats:
                 self.histogram_of_node(stat,"")
 
+# Diff Writer
+class DiffWriter(Writers):
+    """
+    Compare all stats with the first one and print the nodes that differ.
+    Useful to check that two runs of the same configuration are
+    deterministic, for example after a change in the simulator.
+    """
+
+    # Stats that change with the host and not with the simulated machine
+    host_stats = [r'simulator:run:', r'simulator:performance:',
+            r'simulator:parallel_sim:(threads|quanta|exclusive_sections|' +
+            r'host_|efficiency)']
+
+    def set_options(self, parser):
+        parser.add_option("--diff", action="store_true", default=False,
+                help="Print stats that differ from the first input")
+        parser.add_option("--diff-ignore", type="string", action="append",
+                default=[], dest="diff_ignore",
+                help="Regex of stats to ignore in diff, like host time")
+        parser.add_option("--diff-host", action="store_true", default=False,
+                dest="diff_host",
+                help="Ignore stats of the host, like time and the number " +
+                "of parallel threads, to compare -parallel-threads runs")
+
+    def is_ignored(self, name):
+        for pattern in self.ignore:
+            if pattern.search(name):
+                return True
+        return False
+
+    def diff_node(self, base, node, pfx):
+        if type(base) == dict and type(node) == dict:
+            for key in sorted(set(base.keys()) | set(node.keys())):
+                if str(key).startswith('_'):
+                    continue
+                name = "%s:%s" % (pfx, key) if pfx else str(key)
+                self.diff_node(base.get(key), node.get(key), name)
+        elif base != node and not self.is_ignored(pfx):
+            self.diffs += 1
+            print("%s : %s -> %s" % (pfx, str(base), str(node)))
+
+    def write(self, stats, options):
+        if options.diff == True:
+            if len(stats) < 2:
+                error("--diff requires at least two stats to compare")
+
+            self.ignore = [re.compile(x) for x in options.diff_ignore]
+            if options.diff_host:
+                self.ignore += [re.compile(x) for x in self.host_stats]
+            base = stats[0]
+            for stat in stats[1:]:
+                self.diffs = 0
+                print("Diff of %s against %s:" % (stat.get('_file', '?'),
+                    base.get('_file', '?')))
+                self.diff_node(base, stat, "")
+                print("%d stats differ" % self.diffs)
+
 ############ Simpoints Merg Support Plugins  ############
 
 class SPWeight(Readers):